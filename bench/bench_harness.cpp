@@ -0,0 +1,87 @@
+#include "bench_harness.h"
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+void BenchSuite::add(const std::string &name, BenchFunction function, bool sized) {
+    Entry entry;
+    entry.name = name;
+    entry.function = function;
+    entry.sized = sized;
+    _entries.push_back(entry);
+}
+
+BenchResult BenchSuite::measure(const Entry &entry, size_t size, double minSampleMilliseconds, uint32_t samples) {
+    //grow the iteration count until a single sample is long enough to time reliably
+    uint64_t iterations = 1;
+    while (true) {
+        BenchState state(size, iterations);
+        entry.function(state);
+        double elapsedMilliseconds = state.elapsedNanoseconds() / 1000000.0;
+        if (elapsedMilliseconds >= minSampleMilliseconds || iterations >= (1ull << 30)) {
+            break;
+        }
+        iterations *= elapsedMilliseconds < minSampleMilliseconds / 10.0 ? 10 : 2;
+    }
+
+    std::vector<double> perIteration;
+    perIteration.reserve(samples);
+    for (uint32_t i = 0; i < samples; i++) {
+        BenchState state(size, iterations);
+        entry.function(state);
+        perIteration.push_back(state.elapsedNanoseconds() / iterations);
+    }
+
+    BenchResult result;
+    result.name = entry.name;
+    result.size = size;
+    result.iterations = iterations;
+    result.nanosecondsPerIteration = summarizeTimings(perIteration);
+    return result;
+}
+
+void BenchSuite::run(const std::vector<size_t> &sizes, const std::string &filter, double minSampleMilliseconds,
+                     uint32_t samples) {
+    std::cout << std::left << std::setw(40) << "benchmark" << std::right << std::setw(10) << "size"
+              << std::setw(16) << "median ns" << std::setw(16) << "p99 ns" << std::setw(16) << "ns/element"
+              << std::endl;
+
+    for (const Entry &entry : _entries) {
+        if (!filter.empty() && entry.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        std::vector<size_t> entrySizes = entry.sized ? sizes : std::vector<size_t>(1, 1);
+        for (size_t size : entrySizes) {
+            BenchResult result = measure(entry, size, minSampleMilliseconds, samples);
+            _results.push_back(result);
+
+            std::cout << std::left << std::setw(40) << result.name << std::right << std::setw(10) << result.size
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(16) << result.nanosecondsPerIteration.median
+                      << std::setw(16) << result.nanosecondsPerIteration.p99
+                      << std::setw(16) << result.nanosecondsPerIteration.median / result.size
+                      << std::defaultfloat << std::endl;
+        }
+    }
+}
+
+bool BenchSuite::writeJson(const std::string &path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Failed to write benchmark results " << path << std::endl;
+        return false;
+    }
+
+    file << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < _results.size(); i++) {
+        const BenchResult &result = _results[i];
+        const TimingSummary &ns = result.nanosecondsPerIteration;
+        file << "    {\"name\": \"" << result.name << "\", \"size\": " << result.size
+             << ", \"iterations\": " << result.iterations
+             << ", \"ns_per_iteration\": {\"mean\": " << ns.mean << ", \"median\": " << ns.median
+             << ", \"p95\": " << ns.p95 << ", \"p99\": " << ns.p99 << ", \"max\": " << ns.max << "}}"
+             << (i + 1 < _results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return true;
+}
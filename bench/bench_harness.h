@@ -0,0 +1,107 @@
+#ifndef VULKAN_STEP_BY_STEP_BENCH_HARNESS_H
+#define VULKAN_STEP_BY_STEP_BENCH_HARNESS_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "timing_stats.h"
+
+//keeps a value alive so the optimizer can't drop the computation that produced it
+template<typename T>
+inline void benchDoNotOptimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    const volatile char *sink = reinterpret_cast<const volatile char *>(&value);
+    (void) *sink;
+#endif
+}
+
+//handed to a benchmark body, which loops `while (state.keepRunning())` over its scene of `size` elements
+class BenchState {
+public:
+    BenchState(size_t size, uint64_t iterations) : _size(size), _iterations(iterations), _remaining(iterations) {}
+
+    size_t size() const { return _size; }
+
+    bool keepRunning() {
+        if (_remaining == _iterations) {
+            resumeTiming();
+        }
+        if (_remaining == 0) {
+            pauseTiming();
+            return false;
+        }
+        _remaining--;
+        return true;
+    }
+
+    //exclude per-iteration setup such as refilling a queue from the measurement
+    void pauseTiming() {
+        _elapsed += std::chrono::steady_clock::now() - _start;
+    }
+
+    void resumeTiming() {
+        _start = std::chrono::steady_clock::now();
+    }
+
+    double elapsedNanoseconds() const {
+        return std::chrono::duration<double, std::nano>(_elapsed).count();
+    }
+
+private:
+    size_t _size;
+    uint64_t _iterations;
+    uint64_t _remaining;
+    std::chrono::steady_clock::time_point _start;
+    std::chrono::steady_clock::duration _elapsed{0};
+};
+
+struct BenchResult {
+    std::string name;
+    size_t size;
+    uint64_t iterations;
+    TimingSummary nanosecondsPerIteration;
+};
+
+class BenchSuite {
+public:
+    typedef std::function<void(BenchState &)> BenchFunction;
+
+    //sized benchmarks run once per scene size, unsized ones once with size 1
+    void add(const std::string &name, BenchFunction function, bool sized = true);
+
+    //filter only runs benchmarks whose name contains it. each sample repeats the body until it takes at least
+    //minSampleMilliseconds
+    void run(const std::vector<size_t> &sizes, const std::string &filter, double minSampleMilliseconds,
+             uint32_t samples);
+
+    bool writeJson(const std::string &path) const;
+
+private:
+    struct Entry {
+        std::string name;
+        BenchFunction function;
+        bool sized;
+    };
+
+    BenchResult measure(const Entry &entry, size_t size, double minSampleMilliseconds, uint32_t samples);
+
+    std::vector<Entry> _entries;
+    std::vector<BenchResult> _results;
+};
+
+//one per bench/*.cpp file
+void registerMeshBenchmarks(BenchSuite &suite);
+
+void registerSceneBenchmarks(BenchSuite &suite);
+
+void registerSceneGraphBenchmarks(BenchSuite &suite);
+
+void registerBvhBenchmarks(BenchSuite &suite);
+
+void registerTextureBenchmarks(BenchSuite &suite);
+
+#endif //VULKAN_STEP_BY_STEP_BENCH_HARNESS_H
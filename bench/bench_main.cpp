@@ -0,0 +1,87 @@
+#include "bench_harness.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+//comma separated element counts, each a positive integer without trailing characters
+static bool parseSizes(const char *list, std::vector<size_t> &outSizes) {
+    std::vector<size_t> sizes;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.empty() || item[0] < '0' || item[0] > '9') { return false; }
+        char *end = nullptr;
+        errno = 0;
+        unsigned long long size = strtoull(item.c_str(), &end, 10);
+        if (*end != '\0' || errno == ERANGE || size == 0) { return false; }
+        sizes.push_back((size_t) size);
+    }
+    if (sizes.empty() || list[strlen(list) - 1] == ',') { return false; }
+    outSizes = sizes;
+    return true;
+}
+
+//engine-bench [--sizes 100,1000,10000] [--filter name] [--samples n] [--min-ms ms] [--out results.json]
+int main(int argc, char **argv) {
+    std::vector<size_t> sizes = {100, 1000, 10000, 100000};
+    std::string filter;
+    std::string output;
+    uint32_t samples = 15;
+    double minSampleMilliseconds = 5.0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--sizes") == 0 && value) {
+            if (!parseSizes(value, sizes)) {
+                std::cerr << "--sizes must be a comma separated list of positive counts" << std::endl;
+                return 1;
+            }
+            i++;
+        } else if (strcmp(arg, "--filter") == 0 && value) {
+            filter = value;
+            i++;
+        } else if (strcmp(arg, "--samples") == 0 && value) {
+            char *end = nullptr;
+            errno = 0;
+            long count = strtol(value, &end, 10);
+            if (end == value || *end != '\0' || errno == ERANGE || count < 1 || count > 1000000) {
+                std::cerr << "--samples must be between 1 and 1000000" << std::endl;
+                return 1;
+            }
+            samples = (uint32_t) count;
+            i++;
+        } else if (strcmp(arg, "--min-ms") == 0 && value) {
+            char *end = nullptr;
+            minSampleMilliseconds = strtod(value, &end);
+            if (end == value || *end != '\0' || !std::isfinite(minSampleMilliseconds) || minSampleMilliseconds <= 0.0) {
+                std::cerr << "--min-ms must be a positive number" << std::endl;
+                return 1;
+            }
+            i++;
+        } else if (strcmp(arg, "--out") == 0 && value) {
+            output = value;
+            i++;
+        } else {
+            std::cerr << "Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    BenchSuite suite;
+    registerMeshBenchmarks(suite);
+    registerSceneBenchmarks(suite);
+    registerSceneGraphBenchmarks(suite);
+    registerBvhBenchmarks(suite);
+    registerTextureBenchmarks(suite);
+
+    suite.run(sizes, filter, minSampleMilliseconds, samples);
+
+    if (!output.empty() && !suite.writeJson(output)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include "bench_harness.h"
+#include "bvh.h"
+#include <gtc/matrix_transform.hpp>
+#include <random>
+
+//props scattered over a flat level, a few metres tall, like the renderables of a large map
+static std::vector<Aabb> scatterBoxes(size_t count, uint32_t seed) {
+    std::mt19937 random(seed);
+    float extent = 10.0f * std::sqrt((float) count);
+    std::uniform_real_distribution<float> position(-extent, extent);
+    std::uniform_real_distribution<float> height(0.0f, 20.0f);
+    std::uniform_real_distribution<float> radius(0.2f, 3.0f);
+
+    std::vector<Aabb> boxes(count);
+    for (Aabb &box : boxes) {
+        box = Aabb::fromSphere(glm::vec3(position(random), height(random), position(random)), radius(random));
+    }
+    return boxes;
+}
+
+//the engine's camera settings, looking across the level
+static Frustum levelFrustum(size_t count) {
+    float extent = 10.0f * std::sqrt((float) count);
+    glm::mat4 view = glm::lookAt(glm::vec3(-extent * 0.5f, 10.0f, 0.0f), glm::vec3(0.0f, 0.0f, extent * 0.25f),
+                                 glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, 200.0f);
+    projection[1][1] *= -1;
+    return Frustum::fromViewProjection(projection * view);
+}
+
+static void benchBuild(BenchState &state) {
+    std::vector<Aabb> boxes = scatterBoxes(state.size(), 1);
+    Bvh bvh;
+    while (state.keepRunning()) {
+        bvh.build(boxes);
+        benchDoNotOptimize(bvh.nodes().data());
+    }
+}
+
+//every box moves a little, the per-frame cost for a scene where everything is animated
+static void benchRefit(BenchState &state) {
+    std::vector<Aabb> boxes = scatterBoxes(state.size(), 1);
+    Bvh bvh;
+    bvh.build(boxes);
+
+    uint32_t frame = 0;
+    while (state.keepRunning()) {
+        state.pauseTiming();
+        glm::vec3 offset(0.0f, (frame++ % 2) ? 0.1f : -0.1f, 0.0f);
+        for (Aabb &box : boxes) {
+            box.minimum += offset;
+            box.maximum += offset;
+        }
+        state.resumeTiming();
+        bvh.refit(boxes);
+        benchDoNotOptimize(bvh.nodes().data());
+    }
+}
+
+static void benchQueryFrustum(BenchState &state) {
+    std::vector<Aabb> boxes = scatterBoxes(state.size(), 1);
+    Bvh bvh;
+    bvh.build(boxes);
+    Frustum frustum = levelFrustum(state.size());
+
+    std::vector<uint32_t> visible;
+    while (state.keepRunning()) {
+        visible.clear();
+        bvh.queryFrustum(frustum, visible);
+        benchDoNotOptimize(visible.data());
+    }
+}
+
+//the linear scan the BVH replaces
+static void benchLinearFrustum(BenchState &state) {
+    std::vector<Aabb> boxes = scatterBoxes(state.size(), 1);
+    Frustum frustum = levelFrustum(state.size());
+
+    std::vector<uint32_t> visible;
+    while (state.keepRunning()) {
+        visible.clear();
+        for (size_t i = 0; i < boxes.size(); i++) {
+            if (frustum.classifyAabb(boxes[i]) != FRUSTUM_OUTSIDE) {
+                visible.push_back((uint32_t) i);
+            }
+        }
+        benchDoNotOptimize(visible.data());
+    }
+}
+
+//1000 small sphere queries per iteration, like proximity checks of agents
+static void benchQuerySphere(BenchState &state) {
+    std::vector<Aabb> boxes = scatterBoxes(state.size(), 1);
+    Bvh bvh;
+    bvh.build(boxes);
+    std::vector<Aabb> centers = scatterBoxes(1000, 2);
+
+    std::vector<uint32_t> nearby;
+    while (state.keepRunning()) {
+        nearby.clear();
+        for (const Aabb &center : centers) {
+            bvh.querySphere(center.center(), 10.0f, nearby);
+        }
+        benchDoNotOptimize(nearby.data());
+    }
+}
+
+//1000 rays per iteration from random points in random directions
+static void benchRaycast(BenchState &state) {
+    std::vector<Aabb> boxes = scatterBoxes(state.size(), 1);
+    Bvh bvh;
+    bvh.build(boxes);
+
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+    std::vector<Aabb> origins = scatterBoxes(1000, 4);
+    std::vector<glm::vec3> directions(origins.size());
+    for (glm::vec3 &d : directions) {
+        d = glm::normalize(glm::vec3(direction(random), direction(random) * 0.2f, direction(random)) +
+                           glm::vec3(0.0f, 0.0f, 0.001f));
+    }
+
+    while (state.keepRunning()) {
+        uint32_t hits = 0;
+        for (size_t i = 0; i < origins.size(); i++) {
+            uint32_t item;
+            float distance;
+            hits += bvh.raycast(origins[i].center(), directions[i], 500.0f, item, distance) ? 1 : 0;
+        }
+        benchDoNotOptimize(hits);
+    }
+}
+
+void registerBvhBenchmarks(BenchSuite &suite) {
+    suite.add("bvh/build", benchBuild);
+    suite.add("bvh/refit", benchRefit);
+    suite.add("bvh/query_frustum", benchQueryFrustum);
+    suite.add("bvh/linear_frustum", benchLinearFrustum);
+    suite.add("bvh/query_sphere_x1000", benchQuerySphere);
+    suite.add("bvh/raycast_x1000", benchRaycast);
+}
@@ -0,0 +1,90 @@
+#include "bench_harness.h"
+#include "vk_mesh.h"
+#include "mesh_simplify.h"
+#include "mesh_chunks.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+//writes a flat grid with at least `triangles` triangles, positions, normals and uvs like an exported scene
+static std::string writeGridObj(size_t triangles) {
+    size_t quadsPerSide = 1;
+    while (quadsPerSide * quadsPerSide * 2 < triangles) {
+        quadsPerSide++;
+    }
+    size_t verticesPerSide = quadsPerSide + 1;
+
+    std::string path = "engine_bench_grid_" + std::to_string(triangles) + ".obj";
+    std::ofstream file(path);
+    for (size_t z = 0; z < verticesPerSide; z++) {
+        for (size_t x = 0; x < verticesPerSide; x++) {
+            file << "v " << x << " 0 " << z << "\n";
+            file << "vt " << (float) x / quadsPerSide << " " << (float) z / quadsPerSide << "\n";
+        }
+    }
+    file << "vn 0 1 0\n";
+    for (size_t z = 0; z < quadsPerSide; z++) {
+        for (size_t x = 0; x < quadsPerSide; x++) {
+            //obj indices start at 1
+            size_t a = z * verticesPerSide + x + 1;
+            size_t b = a + 1;
+            size_t c = a + verticesPerSide;
+            size_t d = c + 1;
+            file << "f " << a << "/" << a << "/1 " << c << "/" << c << "/1 " << b << "/" << b << "/1\n";
+            file << "f " << b << "/" << b << "/1 " << c << "/" << c << "/1 " << d << "/" << d << "/1\n";
+        }
+    }
+    return path;
+}
+
+static void benchLoadFromObj(BenchState &state) {
+    std::string path = writeGridObj(state.size());
+    while (state.keepRunning()) {
+        Mesh mesh;
+        mesh.loadFromObj(path.c_str());
+        benchDoNotOptimize(mesh._vertices.data());
+    }
+    std::remove(path.c_str());
+}
+
+//halves a grid mesh of size() triangles, the per-level cost of building a LOD chain at load time
+static void benchSimplifyHalf(BenchState &state) {
+    std::string path = writeGridObj(state.size());
+    Mesh mesh;
+    mesh.loadFromObj(path.c_str());
+    std::remove(path.c_str());
+
+    std::vector<Vertex> simplified;
+    while (state.keepRunning()) {
+        float error;
+        simplifyMesh(mesh._vertices, mesh._vertices.size() / 6, simplified, error);
+        benchDoNotOptimize(simplified.data());
+    }
+}
+
+//splits a grid mesh of size() triangles into 4096 triangle chunks, the load time cost of chunking a map
+static void benchSplitChunks(BenchState &state) {
+    std::string path = writeGridObj(state.size());
+    Mesh mesh;
+    mesh.loadFromObj(path.c_str());
+    std::remove(path.c_str());
+
+    while (state.keepRunning()) {
+        std::vector<Mesh> chunks = splitMeshIntoChunks(mesh, 4096);
+        benchDoNotOptimize(chunks.data());
+    }
+}
+
+static void benchVertexDescription(BenchState &state) {
+    while (state.keepRunning()) {
+        VertexInputDescription description = Vertex::getVertexDescription();
+        benchDoNotOptimize(description.attributes.data());
+    }
+}
+
+void registerMeshBenchmarks(BenchSuite &suite) {
+    suite.add("mesh/load_obj_triangles", benchLoadFromObj);
+    suite.add("mesh/simplify_half", benchSimplifyHalf);
+    suite.add("mesh/split_chunks", benchSplitChunks);
+    suite.add("mesh/vertex_description", benchVertexDescription, false);
+}
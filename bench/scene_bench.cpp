@@ -0,0 +1,106 @@
+#include "bench_harness.h"
+#include "render_object.h"
+#include "camera.h"
+#include "deletion_queue.h"
+#include <gtc/matrix_transform.hpp>
+#include <unordered_map>
+
+//the chunks of a split level, size() objects drawing them round robin
+static const size_t LOOKUP_MESH_COUNT = 256;
+
+//the transforms drawObjects walks every frame, scattered like the scene's render objects
+static std::vector<RenderObject> makeRenderObjects(size_t count) {
+    std::vector<RenderObject> objects(count);
+    for (size_t i = 0; i < count; i++) {
+        objects[i].transformMatrix = glm::translate(glm::mat4{1.0f}, glm::vec3(i % 100, 0, i / 100));
+    }
+    return objects;
+}
+
+static void benchPackObjectData(BenchState &state) {
+    std::vector<RenderObject> objects = makeRenderObjects(state.size());
+    std::vector<GPUObjectData> objectData(state.size());
+    SceneGraph sceneGraph;
+    while (state.keepRunning()) {
+        packObjectData(objects.data(), (int) objects.size(), sceneGraph, objectData.data());
+        benchDoNotOptimize(objectData.data());
+    }
+}
+
+//per-frame camera work of processInput and draw: mouse look, view and projection
+static void benchCameraMatrices(BenchState &state) {
+    std::vector<Camera> cameras(state.size());
+    glm::mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, 200.0f);
+    projection[1][1] *= -1;
+    while (state.keepRunning()) {
+        for (Camera &camera : cameras) {
+            camera.ProcessMouseMovement(1.0f, 0.5f);
+            glm::mat4 viewProjection = projection * camera.GetViewMatrix();
+            benchDoNotOptimize(viewProjection);
+        }
+    }
+}
+
+static void benchDeletionQueueFlush(BenchState &state) {
+    size_t destroyed = 0;
+    while (state.keepRunning()) {
+        state.pauseTiming();
+        deletion_queue queue;
+        state.resumeTiming();
+        for (size_t i = 0; i < state.size(); i++) {
+            queue.push_function([&destroyed]() {
+                destroyed++;
+            });
+        }
+        queue.flush();
+    }
+    benchDoNotOptimize(destroyed);
+}
+
+//what the draw loops do per object to reach its mesh, through a handle
+static void benchMeshHandleLookup(BenchState &state) {
+    AssetPool<Mesh> meshes;
+    std::vector<MeshHandle> objects(state.size());
+    for (size_t i = 0; i < LOOKUP_MESH_COUNT; i++) {
+        Mesh mesh{};
+        mesh._boundsRadius = (float) i;
+        meshes.add("lostEmpire#chunk" + std::to_string(i), mesh);
+    }
+    for (size_t i = 0; i < objects.size(); i++) {
+        objects[i] = meshes.find("lostEmpire#chunk" + std::to_string(i % LOOKUP_MESH_COUNT));
+    }
+    while (state.keepRunning()) {
+        float radius = 0.0f;
+        for (MeshHandle object : objects) {
+            radius += meshes.get(object)->_boundsRadius;
+        }
+        benchDoNotOptimize(radius);
+    }
+}
+
+//the same through the mesh name, as objects keyed by string would
+static void benchMeshNameLookup(BenchState &state) {
+    std::unordered_map<std::string, Mesh> meshes;
+    std::vector<std::string> objects(state.size());
+    for (size_t i = 0; i < LOOKUP_MESH_COUNT; i++) {
+        meshes["lostEmpire#chunk" + std::to_string(i)]._boundsRadius = (float) i;
+    }
+    for (size_t i = 0; i < objects.size(); i++) {
+        objects[i] = "lostEmpire#chunk" + std::to_string(i % LOOKUP_MESH_COUNT);
+    }
+    while (state.keepRunning()) {
+        float radius = 0.0f;
+        for (const std::string &object : objects) {
+            radius += meshes.find(object)->second._boundsRadius;
+        }
+        benchDoNotOptimize(radius);
+    }
+}
+
+void registerSceneBenchmarks(BenchSuite &suite) {
+    suite.add("scene/pack_object_data", benchPackObjectData);
+    suite.add("scene/camera_matrices", benchCameraMatrices);
+    suite.add("scene/deletion_queue_push_flush", benchDeletionQueueFlush);
+    suite.add("scene/mesh_handle_lookup", benchMeshHandleLookup);
+    suite.add("scene/mesh_name_lookup", benchMeshNameLookup);
+}
@@ -0,0 +1,105 @@
+#include "bench_harness.h"
+#include "scene_graph.h"
+#include <gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <thread>
+
+static const uint32_t CHILDREN_PER_NODE = 8;
+
+//wide, shallow hierarchy like a level full of props
+static void buildHierarchy(SceneGraph &sceneGraph, size_t count) {
+    sceneGraph.clear();
+    for (size_t i = 0; i < count; i++) {
+        uint32_t parent = i == 0 ? INVALID_NODE : (uint32_t) ((i - 1) / CHILDREN_PER_NODE);
+        sceneGraph.createNode(parent, glm::vec3(i % 7, 1.0f, i % 5),
+                              glm::angleAxis(0.1f * (i % 13), glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(1.0f));
+    }
+    sceneGraph.updateAll();
+}
+
+//moves one node in a hundred of the whole graph, taken from firstNode onwards
+static void moveOnePercent(SceneGraph &sceneGraph, uint32_t frame, uint32_t firstNode) {
+    uint32_t moved = std::max<uint32_t>(1, (uint32_t) sceneGraph.size() / 100);
+    uint32_t step = std::max<uint32_t>(1, ((uint32_t) sceneGraph.size() - firstNode) / moved);
+    for (uint32_t node = firstNode + frame % step; node < sceneGraph.size(); node += step) {
+        glm::vec3 translation = sceneGraph.getTranslation(node);
+        translation.y = (float) (frame % 17);
+        sceneGraph.setTranslation(node, translation);
+    }
+}
+
+enum UpdateMode {
+    UPDATE_ALL,
+    UPDATE_DIRTY,
+    UPDATE_DIRTY_PARALLEL
+};
+
+//leavesOnly moves nodes past the inner ones, which is what animated scenes mostly touch. otherwise some moved
+//nodes drag large subtrees along
+static void runUpdate(BenchState &state, UpdateMode mode, bool leavesOnly) {
+    SceneGraph sceneGraph;
+    buildHierarchy(sceneGraph, state.size());
+    uint32_t firstNode = leavesOnly ? (uint32_t) (state.size() / CHILDREN_PER_NODE) + 1 : 0;
+    uint32_t workers = std::max(1u, std::thread::hardware_concurrency());
+
+    uint32_t frame = 0;
+    while (state.keepRunning()) {
+        moveOnePercent(sceneGraph, frame++, firstNode);
+        if (mode == UPDATE_ALL) {
+            sceneGraph.updateAll();
+        } else {
+            sceneGraph.update(mode == UPDATE_DIRTY_PARALLEL ? workers : 1);
+        }
+        benchDoNotOptimize(sceneGraph.worldMatrix(0));
+    }
+}
+
+//worst case for the incremental path, the root moves and the whole tree is dirty
+static void benchUpdateRootMoved(BenchState &state) {
+    SceneGraph sceneGraph;
+    buildHierarchy(sceneGraph, state.size());
+    uint32_t workers = std::max(1u, std::thread::hardware_concurrency());
+
+    uint32_t frame = 0;
+    while (state.keepRunning()) {
+        sceneGraph.setTranslation(0, glm::vec3(0.0f, (float) (frame++ % 17), 0.0f));
+        sceneGraph.update(workers);
+        benchDoNotOptimize(sceneGraph.worldMatrix(0));
+    }
+}
+
+static void benchMultiplyMatrix(BenchState &state) {
+    std::vector<glm::mat4> matrices(state.size(), glm::rotate(glm::mat4{1.0f}, 0.5f, glm::vec3(0, 1, 0)));
+    glm::mat4 parent = glm::translate(glm::mat4{1.0f}, glm::vec3(1, 2, 3));
+    while (state.keepRunning()) {
+        for (glm::mat4 &matrix : matrices) {
+            multiplyMatrix(parent, matrix, matrix);
+        }
+        benchDoNotOptimize(matrices.data());
+    }
+}
+
+static void benchMultiplyMatrixGlm(BenchState &state) {
+    std::vector<glm::mat4> matrices(state.size(), glm::rotate(glm::mat4{1.0f}, 0.5f, glm::vec3(0, 1, 0)));
+    glm::mat4 parent = glm::translate(glm::mat4{1.0f}, glm::vec3(1, 2, 3));
+    while (state.keepRunning()) {
+        for (glm::mat4 &matrix : matrices) {
+            matrix = parent * matrix;
+        }
+        benchDoNotOptimize(matrices.data());
+    }
+}
+
+void registerSceneGraphBenchmarks(BenchSuite &suite) {
+    suite.add("scene_graph/update_all", [](BenchState &state) { runUpdate(state, UPDATE_ALL, false); });
+    suite.add("scene_graph/update_dirty_1pct", [](BenchState &state) { runUpdate(state, UPDATE_DIRTY, false); });
+    suite.add("scene_graph/update_dirty_1pct_parallel", [](BenchState &state) {
+        runUpdate(state, UPDATE_DIRTY_PARALLEL, false);
+    });
+    suite.add("scene_graph/update_dirty_1pct_leaves", [](BenchState &state) {
+        runUpdate(state, UPDATE_DIRTY, true);
+    });
+    suite.add("scene_graph/update_root_moved_parallel", benchUpdateRootMoved);
+    suite.add("scene_graph/multiply_sse", benchMultiplyMatrix);
+    suite.add("scene_graph/multiply_glm", benchMultiplyMatrixGlm);
+}
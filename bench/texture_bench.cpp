@@ -0,0 +1,93 @@
+#include "bench_harness.h"
+#include "texture_decode.h"
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <thread>
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+//the textures --scene-obj ../assets/sponza/sponza.obj loads, relative to binaries like the engine
+static const char *SPONZA_TEXTURES = "../assets/sponza/";
+
+static std::vector<ImageDecodeJob> findTextures(const std::string &directory) {
+    std::vector<ImageDecodeJob> jobs;
+#ifndef _WIN32
+    DIR *dir = opendir(directory.c_str());
+    if (!dir) {
+        return jobs;
+    }
+    while (dirent *entry = readdir(dir)) {
+        ImageDecodeJob job;
+        job.file = directory + entry->d_name;
+        if (entry->d_name[0] != '.' && readImageSize(job)) {
+            jobs.push_back(job);
+        }
+    }
+    closedir(dir);
+    std::sort(jobs.begin(), jobs.end(), [](const ImageDecodeJob &a, const ImageDecodeJob &b) {
+        return a.file < b.file;
+    });
+#endif
+    return jobs;
+}
+
+//wall time of decoding the whole set into one buffer standing in for the engine's mapped staging memory
+static void benchDecodeTextures(BenchState &state, std::vector<ImageDecodeJob> jobs, uint32_t workerCount) {
+    size_t bytes = 0;
+    for (const ImageDecodeJob &job : jobs) {
+        bytes += (size_t) job.width * job.height * 4;
+    }
+    std::unique_ptr<uint8_t[]> staging(new uint8_t[bytes]);
+    size_t offset = 0;
+    for (ImageDecodeJob &job : jobs) {
+        job.destination = staging.get() + offset;
+        offset += (size_t) job.width * job.height * 4;
+    }
+
+    while (state.keepRunning()) {
+        decodeImages(jobs, workerCount);
+        benchDoNotOptimize(staging[0]);
+    }
+}
+
+//size() texels of a decoded JPEG, which stb hands over as RGB
+static void benchExpand(BenchState &state, uint32_t channels, bool simd) {
+    std::vector<uint8_t> src(state.size() * channels);
+    for (size_t i = 0; i < src.size(); i++) {
+        src[i] = (uint8_t) (i * 31);
+    }
+    std::vector<uint8_t> dst(state.size() * 4);
+    while (state.keepRunning()) {
+        if (simd) {
+            expandToRgba(src.data(), channels, state.size(), dst.data());
+        } else {
+            expandToRgbaScalar(src.data(), channels, state.size(), dst.data());
+        }
+        benchDoNotOptimize(dst.data());
+    }
+}
+
+void registerTextureBenchmarks(BenchSuite &suite) {
+    suite.add("texture/expand_rgb", [](BenchState &state) { benchExpand(state, 3, true); });
+    suite.add("texture/expand_rgb_scalar", [](BenchState &state) { benchExpand(state, 3, false); });
+    suite.add("texture/expand_grey", [](BenchState &state) { benchExpand(state, 1, true); });
+    suite.add("texture/expand_grey_scalar", [](BenchState &state) { benchExpand(state, 1, false); });
+
+    std::vector<ImageDecodeJob> jobs = findTextures(SPONZA_TEXTURES);
+    if (jobs.empty()) {
+        std::cout << "No textures in " << SPONZA_TEXTURES << ", skipping texture/decode_sponza" << std::endl;
+        return;
+    }
+    std::vector<uint32_t> threadCounts = {1, 2, 4, 8};
+    uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    if (std::find(threadCounts.begin(), threadCounts.end(), cores) == threadCounts.end()) {
+        threadCounts.push_back(cores);
+    }
+    for (uint32_t threads : threadCounts) {
+        suite.add("texture/decode_sponza_threads_" + std::to_string(threads), [=](BenchState &state) {
+            benchDecodeTextures(state, jobs, threads);
+        }, false);
+    }
+}
@@ -0,0 +1,32 @@
+//sun shadows from the cascaded shadow maps, set 0 next to the camera and scene data.
+//include after declaring SceneData as sceneData
+
+//casters that never move, redrawn only when a cascade is refitted
+layout (set = 0, binding = 6) uniform sampler2DArrayShadow staticShadowMap;
+//the moving casters of this frame, valid where sceneData.cascadeDynamic is set
+layout (set = 0, binding = 7) uniform sampler2DArrayShadow dynamicShadowMap;
+
+const int SHADOW_CASCADE_COUNT = 4;
+
+//1 where the sun reaches the fragment, 0 in full shadow. past the last cascade everything is lit
+float sunShadow(vec3 worldPosition, vec3 normal, float viewDepth) {
+    int cascade = 0;
+    while (cascade < SHADOW_CASCADE_COUNT && viewDepth > sceneData.cascadeSplits[cascade]) {
+        cascade++;
+    }
+    if (cascade == SHADOW_CASCADE_COUNT) {
+        return 1.0;
+    }
+
+    //a texel along the normal keeps surfaces from shadowing themselves
+    bool hasNormal = dot(normal, normal) > 1e-8;
+    vec3 offset = hasNormal ? normalize(normal) * sceneData.cascadeTexelSizes[cascade] * 1.5 : vec3(0.0);
+    vec4 lightPosition = sceneData.shadowMatrices[cascade] * vec4(worldPosition + offset, 1.0);
+    vec4 coord = vec4(lightPosition.xy * 0.5 + 0.5, float(cascade), lightPosition.z);
+
+    float lit = texture(staticShadowMap, coord);
+    if (sceneData.cascadeDynamic[cascade] > 0.5) {
+        lit = min(lit, texture(dynamicShadowMap, coord));
+    }
+    return lit;
+}
@@ -0,0 +1,56 @@
+//clustered point lights for lit fragment shaders, set 0 next to the camera and scene data.
+//include after enabling GL_GOOGLE_include_directive
+
+struct PointLight {
+    vec4 positionRadius;
+    vec4 color;
+};
+
+layout (set = 0, binding = 2) uniform ClusterData {
+    mat4 view;
+    //P00, P11, near and far plane
+    vec4 projection;
+    //log(view depth) * x - y is the depth slice, zw is the size of a screen tile in pixels
+    vec4 slicing;
+    uvec4 grid;
+    uvec4 limits;
+} clusterData;
+
+layout (std430, set = 0, binding = 3) readonly buffer LightBuffer {
+    PointLight lights[];
+} lightBuffer;
+
+layout (std430, set = 0, binding = 4) readonly buffer ClusterGrid {
+    uvec2 clusters[];
+} clusterGrid;
+
+layout (std430, set = 0, binding = 5) readonly buffer LightIndices {
+    uint indices[];
+} lightIndices;
+
+//diffuse light from the lights of the fragment's cluster. a zero normal, like the vertex colored meshes have,
+//is lit from every side
+vec3 clusteredLighting(vec3 worldPosition, vec3 normal, float viewDepth) {
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / clusterData.slicing.zw), clusterData.grid.xy - 1);
+    float slice = log(max(viewDepth, clusterData.projection.z)) * clusterData.slicing.x - clusterData.slicing.y;
+    uint depthSlice = min(uint(max(slice, 0.0)), clusterData.grid.z - 1);
+    uint clusterIndex = (depthSlice * clusterData.grid.y + tile.y) * clusterData.grid.x + tile.x;
+
+    bool hasNormal = dot(normal, normal) > 1e-8;
+    vec3 n = hasNormal ? normalize(normal) : vec3(0.0);
+
+    vec3 result = vec3(0.0);
+    uvec2 range = clusterGrid.clusters[clusterIndex];
+    for (uint i = 0; i < range.y; i++) {
+        PointLight light = lightBuffer.lights[lightIndices.indices[range.x + i]];
+        vec3 toLight = light.positionRadius.xyz - worldPosition;
+        float distanceSquared = dot(toLight, toLight);
+        float radius = light.positionRadius.w;
+        //smooth window that reaches zero at the radius, so lights never pop at cluster borders
+        float window = clamp(1.0 - distanceSquared / (radius * radius), 0.0, 1.0);
+        float attenuation = window * window / (1.0 + distanceSquared);
+        float diffuse = hasNormal ? max(dot(n, toLight * inversesqrt(max(distanceSquared, 1e-8))), 0.0) : 1.0;
+        result += light.color.rgb * (diffuse * attenuation);
+    }
+    return result;
+}
@@ -0,0 +1,21 @@
+#version 460
+layout (location = 0) in vec3 vPosition;
+
+struct ObjectData{
+    mat4 model;
+};
+
+//the object set is the only set of the shadow pipeline
+layout (std140, set = 0, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+layout (push_constant) uniform constants {
+    //world to shadow map transform of the cascade being drawn
+    mat4 lightViewProjection;
+} params;
+
+void main() {
+    mat4 modelMatrix = objectBuffer.objects[gl_BaseInstance].model;
+    gl_Position = params.lightViewProjection * modelMatrix * vec4(vPosition, 1.0f);
+}
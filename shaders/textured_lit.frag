@@ -1,22 +1,42 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 layout (location = 0) in vec3 inColor;
 layout (location = 1) in vec2 texCoord;
+layout (location = 2) in vec3 inWorldPosition;
+layout (location = 3) in vec3 inNormal;
+layout (location = 4) in float inViewDepth;
 layout (location = 0) out vec4 outFragColor;
 
 layout(set = 0, binding = 1) uniform  SceneData{
     vec4 fogColor;
     vec4 fogDistances;
     vec4 ambientColor;
+    //xyz points towards the sun, w is the ambient term
     vec4 sunlightDirection;
+    //rgb times the intensity in w
     vec4 sunlightColor;
+    mat4 shadowMatrices[4];
+    vec4 cascadeSplits;
+    vec4 cascadeTexelSizes;
+    vec4 cascadeDynamic;
 } sceneData;
 
 
 layout(set = 2, binding = 0) uniform sampler2D tex1;
 
+#include "clustered_lights.glsl"
+#include "cascaded_shadows.glsl"
+
 void main()
 {
     vec3 color = texture(tex1,texCoord).xyz;
-    outFragColor = vec4(color,1.0f);
-}
\ No newline at end of file
+    vec3 normal = normalize(inNormal);
+    float sun = max(dot(normal, normalize(sceneData.sunlightDirection.xyz)), 0.0);
+    if (sun > 0.0) {
+        sun *= sunShadow(inWorldPosition, inNormal, inViewDepth);
+    }
+    vec3 lighting = vec3(sceneData.sunlightDirection.w) + sceneData.sunlightColor.rgb * sceneData.sunlightColor.w * sun
+            + clusteredLighting(inWorldPosition, inNormal, inViewDepth);
+    outFragColor = vec4(color * lighting,1.0f);
+}
@@ -0,0 +1,99 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout (location = 0) in vec3 inColor;
+layout (location = 1) in vec2 texCoord;
+layout (location = 2) in vec3 inWorldPosition;
+layout (location = 3) in vec3 inNormal;
+layout (location = 4) in float inViewDepth;
+layout (location = 0) out vec4 outFragColor;
+
+layout(set = 0, binding = 1) uniform  SceneData{
+    vec4 fogColor;
+    vec4 fogDistances;
+    vec4 ambientColor;
+    //xyz points towards the sun, w is the ambient term
+    vec4 sunlightDirection;
+    //rgb times the intensity in w
+    vec4 sunlightColor;
+    mat4 shadowMatrices[4];
+    vec4 cascadeSplits;
+    vec4 cascadeTexelSizes;
+    vec4 cascadeDynamic;
+} sceneData;
+
+//square pages of every level of the virtual texture, at the slots the page table points to
+layout(set = 2, binding = 0) uniform sampler2D pageCache;
+
+//laid out like GPUVirtualTextureHeader followed by one entry per page
+layout(std430, set = 2, binding = 1) readonly buffer PageTable {
+    //width and height of the finest level, the level count and the pixel of a feedback block that writes this frame
+    uvec4 size;
+    //pages along x and y and the first entry of every level
+    uvec4 levels[16];
+    //cache slot of the page, INVALID_PAGE when it is not resident
+    uint entries[];
+} pageTable;
+
+//non-zero for every page some pixel wanted this frame
+layout(std430, set = 2, binding = 2) writeonly buffer Feedback {
+    uint wanted[];
+} feedback;
+
+const uint PAGE_SIZE = 128;
+const uint FEEDBACK_STRIDE = 4;
+const uint INVALID_PAGE = 0xffffffffu;
+
+#include "clustered_lights.glsl"
+#include "cascaded_shadows.glsl"
+
+uvec2 levelTexel(vec2 uv, uint level) {
+    uvec2 levelSize = max(pageTable.size.xy >> level, uvec2(1));
+    return min(uvec2(uv * vec2(levelSize)), levelSize - 1u);
+}
+
+uint pageEntry(uvec2 texel, uint level) {
+    uvec2 page = texel / PAGE_SIZE;
+    return pageTable.levels[level].z + page.y * pageTable.levels[level].x + page.x;
+}
+
+vec3 sampleVirtual(vec2 uv) {
+    //the footprint of the pixel in texels of the finest level picks the level, like hardware mip selection
+    vec2 dx = dFdx(uv) * vec2(pageTable.size.xy);
+    vec2 dy = dFdy(uv) * vec2(pageTable.size.xy);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0));
+    uint levelCount = pageTable.size.z;
+    uint level = min(uint(lod), levelCount - 1u);
+    uv = fract(uv);
+
+    //a sparse grid of pixels is enough to find the pages the screen needs
+    uvec2 block = uvec2(gl_FragCoord.xy) % FEEDBACK_STRIDE;
+    if (block.x + block.y * FEEDBACK_STRIDE == pageTable.size.w) {
+        feedback.wanted[pageEntry(levelTexel(uv, level), level)] = 1u;
+    }
+
+    //missing pages fall back to coarser levels, the coarsest one is always resident
+    uint cachePages = uint(textureSize(pageCache, 0).x) / PAGE_SIZE;
+    for (; level < levelCount; level++) {
+        uvec2 texel = levelTexel(uv, level);
+        uint slot = pageTable.entries[pageEntry(texel, level)];
+        if (slot != INVALID_PAGE) {
+            uvec2 origin = uvec2(slot % cachePages, slot / cachePages) * PAGE_SIZE;
+            return texelFetch(pageCache, ivec2(origin + texel % PAGE_SIZE), 0).rgb;
+        }
+    }
+    return vec3(1.0, 0.0, 1.0);
+}
+
+void main()
+{
+    vec3 color = sampleVirtual(texCoord);
+    vec3 normal = normalize(inNormal);
+    float sun = max(dot(normal, normalize(sceneData.sunlightDirection.xyz)), 0.0);
+    if (sun > 0.0) {
+        sun *= sunShadow(inWorldPosition, inNormal, inViewDepth);
+    }
+    vec3 lighting = vec3(sceneData.sunlightDirection.w) + sceneData.sunlightColor.rgb * sceneData.sunlightColor.w * sun
+            + clusteredLighting(inWorldPosition, inNormal, inViewDepth);
+    outFragColor = vec4(color * lighting,1.0f);
+}
@@ -1,7 +1,11 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 //shader input
 layout (location = 0) in vec3 inColor;
+layout (location = 2) in vec3 inWorldPosition;
+layout (location = 3) in vec3 inNormal;
+layout (location = 4) in float inViewDepth;
 
 //output write
 layout (location = 0) out vec4 outFragColor;
@@ -14,8 +18,10 @@ layout(set = 0, binding = 1) uniform  SceneData{
 	vec4 sunlightColor;
 } sceneData;
 
+#include "clustered_lights.glsl"
 
 void main()
 {
-	outFragColor = vec4(inColor + sceneData.ambientColor.xyz,1.0f);
-}
\ No newline at end of file
+	vec3 lighting = clusteredLighting(inWorldPosition, inNormal, inViewDepth);
+	outFragColor = vec4(inColor + sceneData.ambientColor.xyz + inColor * lighting,1.0f);
+}
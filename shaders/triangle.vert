@@ -6,6 +6,10 @@ layout (location = 3) in vec2 vTexCoord;
 
 layout (location = 0) out vec3 outColor;
 layout (location = 1) out vec2 texCoord;
+//what the clustered lighting needs to find and shade with the fragment's lights
+layout (location = 2) out vec3 outWorldPosition;
+layout (location = 3) out vec3 outNormal;
+layout (location = 4) out float outViewDepth;
 
 layout (set = 0, binding = 0) uniform  CameraBuffer{
     mat4 view;
@@ -27,10 +31,18 @@ layout (push_constant) uniform constants {
     mat4 renderMatrix;
 } PushConstants;
 
+//depth_only.vert has to produce the same positions, the colour pass after the pre-pass tests depth with EQUAL
+invariant gl_Position;
+
 void main() {
     mat4 modelMatrix = objectBuffer.objects[gl_BaseInstance].model;
     mat4 transformMatrix = (cameraData.viewproj * modelMatrix);
     gl_Position = transformMatrix * vec4(vPosition, 1.0f);
     outColor = vColor;
     texCoord = vTexCoord;
+
+    vec4 worldPosition = modelMatrix * vec4(vPosition, 1.0f);
+    outWorldPosition = worldPosition.xyz;
+    outNormal = mat3(modelMatrix) * vNormal;
+    outViewDepth = -(cameraData.view * worldPosition).z;
 }
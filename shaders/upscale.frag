@@ -0,0 +1,48 @@
+#version 450
+
+layout (location = 0) in vec2 inUV;
+layout (location = 0) out vec4 outFragColor;
+
+//the offscreen scene target, only its top left renderScale part holds this frame
+layout (set = 0, binding = 0) uniform sampler2D sceneColor;
+
+layout (push_constant) uniform constants {
+    //rendered size over the size of the scene target
+    vec2 renderScale;
+    //one texel of the scene target in uv
+    vec2 texelSize;
+    //0 bilinear, 1 edge aware, see UpscaleFilter
+    uint filterMode;
+    //0 to 1, how hard the edge aware filter sharpens
+    float sharpness;
+} params;
+
+vec3 fetch(vec2 uv) {
+    //bilinear taps must not reach into the stale part of the target
+    vec2 maximum = params.renderScale - params.texelSize * 0.5;
+    return texture(sceneColor, clamp(uv, params.texelSize * 0.5, maximum)).rgb;
+}
+
+void main() {
+    vec2 uv = inUV * params.renderScale;
+    vec3 center = fetch(uv);
+    if (params.filterMode == 0) {
+        outFragColor = vec4(center, 1.0);
+        return;
+    }
+
+    //contrast adaptive sharpening over the cross neighbourhood: the sharpening weight shrinks where the local
+    //contrast is already high, so edges get crisper without ringing and flat areas keep their noise level
+    vec3 north = fetch(uv + vec2(0.0, -params.texelSize.y));
+    vec3 south = fetch(uv + vec2(0.0, params.texelSize.y));
+    vec3 west = fetch(uv + vec2(-params.texelSize.x, 0.0));
+    vec3 east = fetch(uv + vec2(params.texelSize.x, 0.0));
+
+    vec3 minimum = min(center, min(min(north, south), min(west, east)));
+    vec3 maximum = max(center, max(max(north, south), max(west, east)));
+    vec3 amplitude = clamp(min(minimum, 1.0 - maximum) / max(maximum, 1e-4), 0.0, 1.0);
+    vec3 weight = -sqrt(amplitude) * mix(0.125, 0.2, params.sharpness);
+
+    vec3 color = (center + (north + south + west + east) * weight) / (1.0 + 4.0 * weight);
+    outFragColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
@@ -4,7 +4,17 @@
 #include "vk_initializers.h"
 #include "vk_pipeline.h"
 #include "vk_textures.h"
+#include "cpu_profiler.h"
+#include "timing_stats.h"
+#include "camera_path.h"
+#include "benchmark.h"
+#include "mesh_simplify.h"
+#include "mesh_chunks.h"
 #include <fstream>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <random>
 
 #define GLFW_INCLUDE_VULKAN
 
@@ -16,6 +26,26 @@
 #include "vk_mem_alloc.h"
 #include <gtx/transform.hpp>
 
+static const uint32_t MAX_OBJECTS = 10000;
+//how hard the edge aware upscale sharpens, 0 to 1
+static const float UPSCALE_SHARPNESS = 0.5f;
+static const char *LOST_EMPIRE_TEXTURE = "../assets/lost-empire/lost_empire-RGBA.png";
+//texture sets the descriptor pool holds beyond the built in ones, one per diffuse texture of a --scene-obj
+static const uint32_t MAX_TEXTURE_MATERIALS = 64;
+
+//matches the push constants of upscale.frag
+struct UpscalePushConstants {
+    glm::vec2 renderScale;
+    glm::vec2 texelSize;
+    uint32_t filterMode;
+    float sharpness;
+};
+
+//the vertex buffer of a mesh and its position-only copy
+static uint64_t meshBytes(size_t vertexCount) {
+    return vertexCount * (sizeof(Vertex) + sizeof(glm::vec3));
+}
+
 #define VK_CHECK(x)                                                 \
     do                                                              \
     {                                                               \
@@ -29,18 +59,31 @@
 
 //TODO: Add error information output
 void VulkanEngine::init() {
-    initWindow();
+    initArchive();
+    if (!_config.headless) {
+        initWindow();
+    }
     initVulkan();
     initSwapchain();
     initCommands();
     initDefaultRenderPass();
     initFrameBuffers();
     initSyncStructures();
+    initProfiler();
     initDescriptors();
+    initVirtualTexture();
     initPipelines();
+    initUpscalePass();
+    initOcclusionCulling();
+    initLighting();
+    initShadows();
     loadImages();
     loadMeshes();
     initScene();
+    if (_renderables.size() > MAX_OBJECTS) {
+        std::cout << "The scene has " << _renderables.size() << " objects, only the first " << MAX_OBJECTS
+                  << " are drawn" << std::endl;
+    }
 }
 
 void VulkanEngine::initVulkan() {
@@ -48,6 +91,7 @@ void VulkanEngine::initVulkan() {
     auto instance_builder_return = instance_builder
             .set_app_name("vulkan-step-by-step")
             .require_api_version(1, 1, 0)
+            .set_headless(_config.headless)
             .request_validation_layers(true)
             .use_default_debug_messenger()
             .build();
@@ -61,18 +105,45 @@ void VulkanEngine::initVulkan() {
     _instance = vkb_instance.instance;
     _debugMessenger = vkb_instance.debug_messenger;
 
-    VkResult error = glfwCreateWindowSurface(_instance, _window, nullptr, &_surface);
-    if (error != VK_SUCCESS) {
-        std::cerr << "Failed to create glfw window surface. Error code: " << '\n' << error << '\n';
-        return;
+    vkb::PhysicalDeviceSelector selector{vkb_instance};
+    selector.set_minimum_version(1, 1)
+            .add_required_extension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+    if (_config.headless) {
+        selector.require_present(false);
+    } else {
+        VkResult error = glfwCreateWindowSurface(_instance, _window, nullptr, &_surface);
+        if (error != VK_SUCCESS) {
+            std::cerr << "Failed to create glfw window surface. Error code: " << '\n' << error << '\n';
+            return;
+        }
+        selector.set_surface(_surface);
     }
 
-    vkb::PhysicalDeviceSelector selector{vkb_instance};
-    vkb::PhysicalDevice physicalDevice = selector
-            .set_minimum_version(1, 1)
-            .set_surface(_surface)
-            .select()
-            .value();
+    vkb::PhysicalDevice physicalDevice = selector.select().value();
+
+    //pipeline statistics are only used for profiling, so don't reject devices without them
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice.physical_device, &supportedFeatures);
+    _pipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+    physicalDevice.features.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+    //occlusion culling draws indirectly with the object index as firstInstance and writes an rg32f depth pyramid
+    bool occlusionCullingSupported = supportedFeatures.drawIndirectFirstInstance == VK_TRUE &&
+                                     supportedFeatures.shaderStorageImageExtendedFormats == VK_TRUE;
+    _occlusionCulling = _config.occlusionCulling && occlusionCullingSupported;
+    if (_config.occlusionCulling && !occlusionCullingSupported) {
+        std::cout << "Occlusion culling is not supported by this GPU, drawing everything in the frustum" << std::endl;
+    }
+    physicalDevice.features.drawIndirectFirstInstance = _occlusionCulling ? VK_TRUE : VK_FALSE;
+    physicalDevice.features.shaderStorageImageExtendedFormats = _occlusionCulling ? VK_TRUE : VK_FALSE;
+    //the virtual texture's lit shader writes its page requests into a storage buffer
+    _virtualTexturing = _config.virtualTexturing && supportedFeatures.fragmentStoresAndAtomics == VK_TRUE;
+    if (_config.virtualTexturing && !_virtualTexturing) {
+        std::cout << "Virtual texturing is not supported by this GPU, uploading the whole texture" << std::endl;
+    }
+    physicalDevice.features.fragmentStoresAndAtomics = _virtualTexturing ? VK_TRUE : VK_FALSE;
+    //real heap budgets for the memory stats, without it VMA estimates them from its own blocks
+    bool memoryBudget = physicalDevice.enable_extension_if_present(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
 
     vkb::DeviceBuilder deviceBuilder{physicalDevice};
     VkPhysicalDeviceShaderDrawParametersFeatures shaderDrawParametersFeatures = {};
@@ -80,7 +151,16 @@ void VulkanEngine::initVulkan() {
     shaderDrawParametersFeatures.pNext = nullptr;
     shaderDrawParametersFeatures.shaderDrawParameters = VK_TRUE;
 
-    vkb::Device vkbDevice = deviceBuilder.add_pNext(&shaderDrawParametersFeatures).build().value();
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures = {};
+    timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    timelineSemaphoreFeatures.pNext = nullptr;
+    timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+
+    vkb::Device vkbDevice = deviceBuilder
+            .add_pNext(&shaderDrawParametersFeatures)
+            .add_pNext(&timelineSemaphoreFeatures)
+            .build()
+            .value();
 
 
     _device = vkbDevice.device;
@@ -89,12 +169,25 @@ void VulkanEngine::initVulkan() {
     _graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
     _graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+    //the device only targets 1.1, so the timeline entry points come from the KHR extension
+    _vkWaitSemaphores = (PFN_vkWaitSemaphoresKHR) vkGetDeviceProcAddr(_device, "vkWaitSemaphoresKHR");
+
     VmaAllocatorCreateInfo allocatorInfo = {};
     allocatorInfo.physicalDevice = _chosenGPU;
     allocatorInfo.device = _device;
     allocatorInfo.instance = _instance;
+    allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_1;
+    allocatorInfo.flags = memoryBudget ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0;
     vmaCreateAllocator(&allocatorInfo, &_allocator);
 
+    _gpuMemory.init(_device, _allocator, memoryBudget, (VkDeviceSize) _config.defragMegabytesPerPass * 1024 * 1024);
+    _mainDeletionQueue.push_function([=]() {
+        _gpuMemory.cleanup();
+    });
+
+    _deferredDestruction.init(_device, _allocator, _config.framesInFlight);
+    _residency.init((uint64_t) _config.residencyBudgetMegabytes * 1024 * 1024, _config.framesInFlight);
+
     _gpuProperties = vkbDevice.physical_device.properties;
 
     std::cout << "The GPU has a minimum buffer alignment of " << _gpuProperties.limits.minUniformBufferOffsetAlignment
@@ -110,19 +203,36 @@ void VulkanEngine::initWindow() {
 }
 
 void VulkanEngine::initSwapchain() {
-    vkb::SwapchainBuilder swapchainBuilder{_chosenGPU, _device, _surface};
+    if (_config.headless) {
+        initOffscreenTargets();
+    } else {
+        vkb::SwapchainBuilder swapchainBuilder{_chosenGPU, _device, _surface};
+
+        vkb::Swapchain vkbSwapchain = swapchainBuilder
+                .use_default_format_selection()
+                .set_desired_present_mode(_config.presentMode)
+                .add_fallback_present_mode(VK_PRESENT_MODE_FIFO_KHR)
+                .set_desired_min_image_count(_config.framesInFlight + 1)
+                .set_desired_extent(_windowExtent.width, _windowExtent.height)
+                //the scene target is copied over when the upscale pass is unavailable
+                .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+                .build()
+                .value();
+
+        if (vkbSwapchain.present_mode != _config.presentMode) {
+            std::cout << "Present mode " << presentModeName(_config.presentMode) << " is not supported, falling back to "
+                      << presentModeName(vkbSwapchain.present_mode) << std::endl;
+        }
 
-    vkb::Swapchain vkbSwapchain = swapchainBuilder
-            .use_default_format_selection()
-            .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
-            .set_desired_extent(_windowExtent.width, _windowExtent.height)
-            .build()
-            .value();
+        _swapchain = vkbSwapchain.swapchain;
+        _swapchainImages = vkbSwapchain.get_images().value();
+        _swapchainImageViews = vkbSwapchain.get_image_views().value();
+        _swapchainImageFormat = vkbSwapchain.image_format;
 
-    _swapchain = vkbSwapchain.swapchain;
-    _swapchainImages = vkbSwapchain.get_images().value();
-    _swapchainImageViews = vkbSwapchain.get_image_views().value();
-    _swapchainImageFormat = vkbSwapchain.image_format;
+        _mainDeletionQueue.push_function([=]() {
+            vkDestroySwapchainKHR(_device, _swapchain, nullptr);
+        });
+    }
 
     VkExtent3D depthImageExtent = {
             _windowExtent.width,
@@ -130,22 +240,85 @@ void VulkanEngine::initSwapchain() {
             1
     };
     _depthFormat = VK_FORMAT_D32_SFLOAT;
-    VkImageCreateInfo deepImgInfo = vkinit::imageCreateInfo(_depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+    //sampled by the depth pyramid build of the occlusion culler
+    VkImageCreateInfo deepImgInfo = vkinit::imageCreateInfo(_depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                                                          VK_IMAGE_USAGE_SAMPLED_BIT,
                                                             depthImageExtent);
     VmaAllocationCreateInfo deepImgAllocInfo = {};
     deepImgAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     deepImgAllocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    vmaCreateImage(_allocator, &deepImgInfo, &deepImgAllocInfo, &_depthImage._image, &_depthImage._allocation, nullptr);
+    VK_CHECK(vmaCreateImage(_allocator, &deepImgInfo, &deepImgAllocInfo, &_depthImage._image,
+                            &_depthImage._allocation, nullptr));
+    _gpuMemory.track(_depthImage._allocation, MEMORY_RENDER_TARGET);
 
     VkImageViewCreateInfo deepViewInfo = vkinit::imageviewCreateInfo(_depthFormat, _depthImage._image,
                                                                      VK_IMAGE_ASPECT_DEPTH_BIT);
     VK_CHECK(vkCreateImageView(_device, &deepViewInfo, nullptr, &_depthImageView));
 
     _mainDeletionQueue.push_function([=]() {
-        vkDestroySwapchainKHR(_device, _swapchain, nullptr);
         vkDestroyImageView(_device, _depthImageView, nullptr);
-        vmaDestroyImage(_allocator, _depthImage._image, _depthImage._allocation);
+        _gpuMemory.destroyImage(_depthImage);
+    });
+
+    //the scene renders into the top left corner of this image at the dynamic resolution and the upscale pass
+    //stretches that over the swapchain image. it is as large as the window, so a new scale never reallocates
+    VkImageCreateInfo sceneImgInfo = vkinit::imageCreateInfo(_swapchainImageFormat,
+                                                             VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                                             VK_IMAGE_USAGE_SAMPLED_BIT |
+                                                             VK_IMAGE_USAGE_TRANSFER_SRC_BIT, depthImageExtent);
+    VK_CHECK(vmaCreateImage(_allocator, &sceneImgInfo, &deepImgAllocInfo, &_sceneColorImage._image,
+                            &_sceneColorImage._allocation, nullptr));
+    _gpuMemory.track(_sceneColorImage._allocation, MEMORY_RENDER_TARGET);
+
+    VkImageViewCreateInfo sceneViewInfo = vkinit::imageviewCreateInfo(_swapchainImageFormat, _sceneColorImage._image,
+                                                                      VK_IMAGE_ASPECT_COLOR_BIT);
+    VK_CHECK(vkCreateImageView(_device, &sceneViewInfo, nullptr, &_sceneColorView));
+
+    _mainDeletionQueue.push_function([=]() {
+        vkDestroyImageView(_device, _sceneColorView, nullptr);
+        _gpuMemory.destroyImage(_sceneColorImage);
+    });
+    _renderExtent = _windowExtent;
+}
+
+void VulkanEngine::initOffscreenTargets() {
+    _swapchainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+
+    VkExtent3D imageExtent = {
+            _windowExtent.width,
+            _windowExtent.height,
+            1
+    };
+    VkImageCreateInfo imgInfo = vkinit::imageCreateInfo(_swapchainImageFormat,
+                                                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                                        VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                                        VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent);
+    VmaAllocationCreateInfo imgAllocInfo = {};
+    imgAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    imgAllocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    //one target per frame in flight so consecutive frames never write the same image
+    for (int i = 0; i < _config.framesInFlight; i++) {
+        AllocatedImage image;
+        VK_CHECK(vmaCreateImage(_allocator, &imgInfo, &imgAllocInfo, &image._image, &image._allocation, nullptr));
+        _gpuMemory.track(image._allocation, MEMORY_RENDER_TARGET);
+
+        VkImageViewCreateInfo viewInfo = vkinit::imageviewCreateInfo(_swapchainImageFormat, image._image,
+                                                                      VK_IMAGE_ASPECT_COLOR_BIT);
+        VkImageView imageView;
+        VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &imageView));
+
+        _offscreenImages.push_back(image);
+        _swapchainImages.push_back(image._image);
+        _swapchainImageViews.push_back(imageView);
+    }
+
+    //the views are destroyed together with the framebuffers
+    _mainDeletionQueue.push_function([=]() {
+        for (const AllocatedImage &image : _offscreenImages) {
+            _gpuMemory.destroyImage(image);
+        }
     });
 }
 
@@ -153,7 +326,7 @@ void VulkanEngine::initCommands() {
     VkCommandPoolCreateInfo commandPoolInfo = vkinit::commandPoolCreateInfo(_graphicsQueueFamily,
                                                                             VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
-    for (int i = 0; i < FRAME_OVERLAP; i++) {
+    for (int i = 0; i < _config.framesInFlight; i++) {
         VK_CHECK(vkCreateCommandPool(_device, &commandPoolInfo, nullptr, &_frames[i]._commandPool));
 
         VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::commandBufferAllocateInfo(_frames[i]._commandPool, 1);
@@ -188,7 +361,8 @@ void VulkanEngine::initDefaultRenderPass() {
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    //the scene target, sampled by the upscale pass afterwards
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
     VkAttachmentReference colorAttachmentRef = {};
     colorAttachmentRef.attachment = 0;
@@ -218,7 +392,8 @@ void VulkanEngine::initDefaultRenderPass() {
     VkSubpassDependency dependency = {};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    //the previous frame's upscale pass may still be reading the scene target
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
     dependency.srcAccessMask = 0;
     dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
@@ -233,7 +408,15 @@ void VulkanEngine::initDefaultRenderPass() {
             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
     depthDependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
-    VkSubpassDependency dependencies[2] = {dependency, depthDependency};
+    VkSubpassDependency sampleDependency = {};
+    sampleDependency.srcSubpass = 0;
+    sampleDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    sampleDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    sampleDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    sampleDependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    sampleDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkSubpassDependency dependencies[3] = {dependency, depthDependency, sampleDependency};
 
     VkAttachmentDescription attachments[2] = {colorAttachment, depthAttachment};
 
@@ -243,12 +426,97 @@ void VulkanEngine::initDefaultRenderPass() {
     renderPassInfo.pAttachments = &attachments[0];
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subPass;
-    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.dependencyCount = 3;
     renderPassInfo.pDependencies = &dependencies[0];
     vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_renderPass);
 
+    //the upscale pass covers the whole swapchain image, so nothing has to be loaded
+    VkAttachmentDescription swapchainAttachment = colorAttachment;
+    swapchainAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    swapchainAttachment.finalLayout = _config.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                                       : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkSubpassDescription upscaleSubpass = subPass;
+    upscaleSubpass.pDepthStencilAttachment = nullptr;
+
+    VkSubpassDependency swapchainDependency = dependency;
+    swapchainDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+    VkRenderPassCreateInfo upscalePassInfo = renderPassInfo;
+    upscalePassInfo.attachmentCount = 1;
+    upscalePassInfo.pAttachments = &swapchainAttachment;
+    upscalePassInfo.pSubpasses = &upscaleSubpass;
+    upscalePassInfo.dependencyCount = 1;
+    upscalePassInfo.pDependencies = &swapchainDependency;
+    vkCreateRenderPass(_device, &upscalePassInfo, nullptr, &_upscaleRenderPass);
+
     _mainDeletionQueue.push_function([=]() {
         vkDestroyRenderPass(_device, _renderPass, nullptr);
+        vkDestroyRenderPass(_device, _upscaleRenderPass, nullptr);
+    });
+
+    if (!_occlusionCulling) {
+        return;
+    }
+
+    //the early pass leaves color attached for the late pass and depth readable for the pyramid build
+    VkAttachmentDescription earlyAttachments[2] = {colorAttachment, depthAttachment};
+    earlyAttachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    earlyAttachments[1].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkSubpassDependency depthReadDependency = {};
+    depthReadDependency.srcSubpass = 0;
+    depthReadDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    depthReadDependency.srcStageMask =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    depthReadDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    depthReadDependency.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    depthReadDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkSubpassDependency earlyDependencies[3] = {dependency, depthDependency, depthReadDependency};
+
+    renderPassInfo.pAttachments = &earlyAttachments[0];
+    renderPassInfo.dependencyCount = 3;
+    renderPassInfo.pDependencies = &earlyDependencies[0];
+    vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_earlyRenderPass);
+
+    //the late pass keeps what the early one drew and finishes the frame like the default pass
+    VkAttachmentDescription lateAttachments[2] = {colorAttachment, depthAttachment};
+    lateAttachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    lateAttachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    lateAttachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    lateAttachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    lateAttachments[1].initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkSubpassDependency colorLoadDependency = {};
+    colorLoadDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    colorLoadDependency.dstSubpass = 0;
+    colorLoadDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    colorLoadDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    colorLoadDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    colorLoadDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    //the pyramid build has to be done reading depth before it goes back to being an attachment
+    VkSubpassDependency depthLoadDependency = {};
+    depthLoadDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    depthLoadDependency.dstSubpass = 0;
+    depthLoadDependency.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    depthLoadDependency.srcAccessMask = 0;
+    depthLoadDependency.dstStageMask =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    depthLoadDependency.dstAccessMask =
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    VkSubpassDependency lateDependencies[3] = {colorLoadDependency, depthLoadDependency, sampleDependency};
+
+    renderPassInfo.pAttachments = &lateAttachments[0];
+    renderPassInfo.dependencyCount = 3;
+    renderPassInfo.pDependencies = &lateDependencies[0];
+    vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_lateRenderPass);
+
+    _mainDeletionQueue.push_function([=]() {
+        vkDestroyRenderPass(_device, _earlyRenderPass, nullptr);
+        vkDestroyRenderPass(_device, _lateRenderPass, nullptr);
     });
 }
 
@@ -258,20 +526,28 @@ void VulkanEngine::initFrameBuffers() {
     fbInfo.pNext = nullptr;
 
     fbInfo.renderPass = _renderPass;
-    fbInfo.attachmentCount = 1;
     fbInfo.width = _windowExtent.width;
     fbInfo.height = _windowExtent.height;
     fbInfo.layers = 1;
+
+    //every scene pass renders to the same target, the early and late passes are compatible with _renderPass
+    VkImageView sceneAttachments[2] = {_sceneColorView, _depthImageView};
+    fbInfo.pAttachments = sceneAttachments;
+    fbInfo.attachmentCount = 2;
+    VK_CHECK(vkCreateFramebuffer(_device, &fbInfo, nullptr, &_sceneFramebuffer));
+
+    _mainDeletionQueue.push_function([=]() {
+        vkDestroyFramebuffer(_device, _sceneFramebuffer, nullptr);
+    });
+
+    //the swapchain images are only written by the upscale pass
+    fbInfo.renderPass = _upscaleRenderPass;
+    fbInfo.attachmentCount = 1;
     const uint32_t swapchainImageCount = _swapchainImages.size();
     _frameBuffers = std::vector<VkFramebuffer>(swapchainImageCount);
 
     for (int i = 0; i < swapchainImageCount; i++) {
-        VkImageView attachments[2];
-        attachments[0] = _swapchainImageViews[i];
-        attachments[1] = _depthImageView;
-
-        fbInfo.pAttachments = attachments;
-        fbInfo.attachmentCount = 2;
+        fbInfo.pAttachments = &_swapchainImageViews[i];
 
         VK_CHECK(vkCreateFramebuffer(_device, &fbInfo, nullptr, &_frameBuffers[i]));
 
@@ -283,7 +559,6 @@ void VulkanEngine::initFrameBuffers() {
 }
 
 void VulkanEngine::initSyncStructures() {
-    VkFenceCreateInfo fenceCreateInfo = vkinit::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
     VkFenceCreateInfo uploadFenceCreateInfo = vkinit::fenceCreateInfo();
     VkSemaphoreCreateInfo semaphoreCreateInfo = vkinit::semaphoreCreateInfo();
 
@@ -292,14 +567,17 @@ void VulkanEngine::initSyncStructures() {
         vkDestroyFence(_device, _uploadContext._uploadFence, nullptr);
     });
 
-    for (int i = 0; i < FRAME_OVERLAP; i++) {
+    VkSemaphoreTypeCreateInfoKHR timelineTypeInfo = vkinit::semaphoreTypeCreateInfo(VK_SEMAPHORE_TYPE_TIMELINE_KHR, 0);
+    VkSemaphoreCreateInfo timelineCreateInfo = vkinit::semaphoreCreateInfo();
+    timelineCreateInfo.pNext = &timelineTypeInfo;
 
-        VK_CHECK(vkCreateFence(_device, &fenceCreateInfo, nullptr, &_frames[i]._renderFence));
-
-        _mainDeletionQueue.push_function([=]() {
-            vkDestroyFence(_device, _frames[i]._renderFence, nullptr);
-        });
+    VK_CHECK(vkCreateSemaphore(_device, &timelineCreateInfo, nullptr, &_frameTimeline));
+    _mainDeletionQueue.push_function([=]() {
+        vkDestroySemaphore(_device, _frameTimeline, nullptr);
+    });
 
+    for (int i = 0; i < _config.framesInFlight; i++) {
+        _frames[i]._timelineValue = 0;
 
         VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_frames[i]._presentSemaphore));
         VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_frames[i]._renderSemaphore));
@@ -311,12 +589,31 @@ void VulkanEngine::initSyncStructures() {
     }
 }
 
+void VulkanEngine::initProfiler() {
+    _gpuProfiler.init(_device, _chosenGPU, _graphicsQueueFamily, _config.framesInFlight, _pipelineStatisticsSupported);
+    _frameScope = _gpuProfiler.registerScope("frame");
+    _mainPassScope = _gpuProfiler.registerScope("main_pass");
+    _depthPrepassScope = _gpuProfiler.registerScope("depth_prepass");
+    _depthPrepass = _config.depthPrepass;
+
+    _mainDeletionQueue.push_function([=]() {
+        _gpuProfiler.cleanup();
+    });
+}
+
 void VulkanEngine::draw() {
-    VK_CHECK(vkWaitForFences(_device, 1, &getCurrentFrame()._renderFence, true, 1000000000));
-    VK_CHECK(vkResetFences(_device, 1, &getCurrentFrame()._renderFence));
+    CPU_ZONE("draw");
+    //the slot is free again once the submission that last used it has reached its timeline value
+    waitForTimeline(getCurrentFrame()._timelineValue);
+    _deferredDestruction.beginFrame(getCurrentFrameIndex());
+    _frameAllocator.beginFrame(getCurrentFrameIndex());
     uint32_t swapchainImageIndex;
-    VK_CHECK(vkAcquireNextImageKHR(_device, _swapchain, 1000000000, getCurrentFrame()._presentSemaphore, nullptr,
-                                   &swapchainImageIndex));
+    if (_config.headless) {
+        swapchainImageIndex = getCurrentFrameIndex();
+    } else {
+        VK_CHECK(vkAcquireNextImageKHR(_device, _swapchain, 1000000000, getCurrentFrame()._presentSemaphore, nullptr,
+                                       &swapchainImageIndex));
+    }
     VK_CHECK(vkResetCommandBuffer(getCurrentFrame()._mainCommandBuffer, 0));
 
     VkCommandBuffer cmd = getCurrentFrame()._mainCommandBuffer;
@@ -327,6 +624,15 @@ void VulkanEngine::draw() {
     cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
     VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+    _gpuProfiler.beginFrame(cmd, getCurrentFrameIndex(), _frameNumber);
+    _gpuProfiler.beginScope(cmd, _frameScope);
+    updateRenderScale();
+    {
+        CPU_ZONE("defragment");
+        _gpuMemory.defragment(cmd, getCurrentFrameIndex(), _frameNumber, _bufferMoves);
+        remapMeshBuffers(_bufferMoves);
+    }
+
     VkClearValue clearValue;
     clearValue.color = {{0, 0, 0.0f, 1.0f}};
 
@@ -340,16 +646,97 @@ void VulkanEngine::draw() {
     rpInfo.renderPass = _renderPass;
     rpInfo.renderArea.offset.x = 0;
     rpInfo.renderArea.offset.y = 0;
+    //the whole target is cleared even when the scene covers less of it, the depth pyramid then sees the far plane
+    //outside the viewport and stays conservative
     rpInfo.renderArea.extent = _windowExtent;
-    rpInfo.framebuffer = _frameBuffers[swapchainImageIndex];
+    rpInfo.framebuffer = _sceneFramebuffer;
     rpInfo.clearValueCount = 2;
     VkClearValue clearValues[] = {clearValue, depthClear};
     rpInfo.pClearValues = &clearValues[0];
-    vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
-    drawObjects(cmd, _renderables.data(), _renderables.size());
+    {
+        CPU_ZONE("sceneGraph");
+        _sceneGraph.update(std::thread::hardware_concurrency());
+    }
 
-    vkCmdEndRenderPass(cmd);
+    if (_occlusionCulling) {
+        _occlusionCuller.beginFrame(cmd, getCurrentFrameIndex(), _frameNumber);
+    }
+    if (_clusteredLightingReady) {
+        _clusteredLighting.beginFrame(cmd, getCurrentFrameIndex(), _frameNumber);
+    }
+    if (_virtualTexturing) {
+        CPU_ZONE("virtualTexture");
+        _virtualTexture.beginFrame(cmd, getCurrentFrameIndex(), _frameNumber);
+    }
+    //the ring is sized for a frame's uniforms at init, a failure here is a bug the ring buffer reports. the passes
+    //still clear and present
+    int objectCount = (int) std::min(_renderables.size(), (size_t) MAX_OBJECTS);
+    int drawCount = objectCount;
+    if (!prepareObjects(_renderables.data(), objectCount)) {
+        drawCount = 0;
+        _drawList.clear();
+    }
+
+    if (_clusteredLightingReady && drawCount > 0) {
+        GpuProfileScope lightScope(_gpuProfiler, cmd, _lightScope);
+        _clusteredLighting.buildClusters(cmd, _globalOffsets[2]);
+    }
+
+    if (drawCount > 0) {
+        drawShadows(cmd);
+    }
+
+    if (_occlusionCulling) {
+        {
+            GpuProfileScope cullScope(_gpuProfiler, cmd, _cullScope);
+            _occlusionCuller.cullEarly(cmd, _cullDataOffset, drawCount);
+        }
+
+        _gpuProfiler.beginScope(cmd, _mainPassScope);
+        rpInfo.renderPass = _earlyRenderPass;
+        vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+        setRenderViewport(cmd);
+        drawScene(cmd, _renderables.data(), _drawList, _occlusionCuller.commandBuffer(),
+                  _occlusionCuller.earlyCommandOffset());
+        vkCmdEndRenderPass(cmd);
+        _gpuProfiler.endScope(cmd);
+
+        {
+            GpuProfileScope hizScope(_gpuProfiler, cmd, _hizScope);
+            _occlusionCuller.buildPyramid(cmd);
+        }
+        {
+            GpuProfileScope cullScope(_gpuProfiler, cmd, _cullScope);
+            _occlusionCuller.cullLate(cmd, _cullDataOffset, drawCount);
+        }
+
+        _gpuProfiler.beginScope(cmd, _mainPassScope);
+        rpInfo.renderPass = _lateRenderPass;
+        vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+        setRenderViewport(cmd);
+        drawScene(cmd, _renderables.data(), _drawList, _occlusionCuller.commandBuffer(),
+                  _occlusionCuller.lateCommandOffset());
+        vkCmdEndRenderPass(cmd);
+        _gpuProfiler.endScope(cmd);
+    } else {
+        _gpuProfiler.beginScope(cmd, _mainPassScope);
+        vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+        setRenderViewport(cmd);
+        drawScene(cmd, _renderables.data(), _drawList, VK_NULL_HANDLE, 0);
+
+        vkCmdEndRenderPass(cmd);
+        _gpuProfiler.endScope(cmd);
+    }
+
+    if (_virtualTexturing) {
+        _virtualTexture.endFrame(cmd);
+    }
+    drawUpscale(cmd, swapchainImageIndex);
+    evictAssets();
+
+    _gpuProfiler.endScope(cmd);
     VK_CHECK(vkEndCommandBuffer(cmd));
+    _frameAllocator.flush();
 
 
     VkSubmitInfo submit = {};
@@ -357,13 +744,34 @@ void VulkanEngine::draw() {
     submit.pNext = nullptr;
     VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     submit.pWaitDstStageMask = &waitStage;
-    submit.waitSemaphoreCount = 1;
+    submit.waitSemaphoreCount = _config.headless ? 0 : 1;
     submit.pWaitSemaphores = &getCurrentFrame()._presentSemaphore;
-    submit.signalSemaphoreCount = 1;
-    submit.pSignalSemaphores = &getCurrentFrame()._renderSemaphore;
     submit.commandBufferCount = 1;
     submit.pCommandBuffers = &cmd;
-    VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submit, getCurrentFrame()._renderFence));
+
+    getCurrentFrame()._timelineValue = ++_frameTimelineValue;
+
+    //binary semaphore for the presentation engine, timeline semaphore for frame pacing
+    VkSemaphore signalSemaphores[] = {getCurrentFrame()._renderSemaphore, _frameTimeline};
+    uint64_t signalValues[] = {0, getCurrentFrame()._timelineValue};
+    uint64_t waitValue = 0;
+    //nothing is presented in headless mode, only the timeline is signalled
+    uint32_t firstSignal = _config.headless ? 1 : 0;
+
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo = vkinit::timelineSemaphoreSubmitInfo(
+            submit.waitSemaphoreCount, &waitValue, 2 - firstSignal, signalValues + firstSignal);
+    submit.pNext = &timelineInfo;
+    submit.signalSemaphoreCount = 2 - firstSignal;
+    submit.pSignalSemaphores = signalSemaphores + firstSignal;
+    {
+        CPU_ZONE("vkQueueSubmit");
+        VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submit, VK_NULL_HANDLE));
+    }
+
+    if (_config.headless) {
+        _frameNumber++;
+        return;
+    }
 
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -373,11 +781,23 @@ void VulkanEngine::draw() {
     presentInfo.pWaitSemaphores = &getCurrentFrame()._renderSemaphore;
     presentInfo.waitSemaphoreCount = 1;
     presentInfo.pImageIndices = &swapchainImageIndex;
-    VK_CHECK(vkQueuePresentKHR(_graphicsQueue, &presentInfo));
+    {
+        CPU_ZONE("vkQueuePresentKHR");
+        VK_CHECK(vkQueuePresentKHR(_graphicsQueue, &presentInfo));
+    }
     _frameNumber++;
 }
 
 void VulkanEngine::run() {
+    if (!_config.benchmarkPath.empty()) {
+        runBenchmark();
+        return;
+    }
+    if (_config.headless) {
+        runHeadless();
+        return;
+    }
+
     while (!glfwWindowShouldClose(_window)) {
         float currentFrame = glfwGetTime();
         _deltaTime = currentFrame - _lastFrame;
@@ -389,18 +809,204 @@ void VulkanEngine::run() {
     }
 }
 
+void VulkanEngine::runHeadless() {
+    //there is no input without a window, the camera stays put and time advances in fixed steps
+    _deltaTime = 1.0f / 60.0f;
+
+    std::vector<double> frameMilliseconds;
+    frameMilliseconds.reserve(_config.frameCount);
+    //occlusion statistics of every frame that was read back
+    uint64_t occludedTotal = 0;
+    uint64_t drawnTotal = 0;
+    uint32_t statsFrames = 0;
+    int64_t statsFrame = -1;
+    double resolutionScaleTotal = 0.0;
+
+    auto runStart = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < _config.frameCount; i++) {
+        auto frameStart = std::chrono::steady_clock::now();
+        draw();
+        auto frameEnd = std::chrono::steady_clock::now();
+        frameMilliseconds.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+        resolutionScaleTotal += _resolutionController.scale();
+
+        if (_occlusionCulling && _occlusionCuller.lastStatsFrame() != statsFrame) {
+            const OcclusionStats &stats = _occlusionCuller.lastStats();
+            statsFrame = _occlusionCuller.lastStatsFrame();
+            occludedTotal += stats.occluded;
+            drawnTotal += stats.drawnEarly + stats.drawnLate;
+            statsFrames++;
+        }
+    }
+    waitForTimeline(_frameTimelineValue);
+    double totalMilliseconds = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - runStart).count();
+
+    if (!frameMilliseconds.empty()) {
+        std::cout << "Headless run: " << frameMilliseconds.size() << " frames in " << totalMilliseconds << " ms, "
+                  << "CPU frame p50 " << percentile(frameMilliseconds, 50.0) << " ms, p99 "
+                  << percentile(frameMilliseconds, 99.0) << " ms" << std::endl;
+    }
+    if (statsFrames > 0) {
+        std::cout << "Occlusion culling: " << (double) occludedTotal / statsFrames << " objects occluded and "
+                  << (double) drawnTotal / statsFrames << " drawn per frame" << std::endl;
+    } else if (!_occlusionCulling) {
+        std::cout << "Frustum culling: " << _drawList.size() << " of " << _objectBounds.size()
+                  << " objects drawn in the last frame" << std::endl;
+    }
+    std::cout << "Object BVH: " << _objectBvh.nodes().size() << " nodes, rebuilt " << _bvhRebuilds
+              << " times, SAH cost " << _objectBvh.costRatio() << "x of the last build" << std::endl;
+    if (_clusteredLightingReady && _clusteredLighting.lastStatsFrame() >= 0) {
+        const LightingStats &stats = _clusteredLighting.lastStats();
+        std::cout << "Clustered lighting: " << _lights.size() << " lights, "
+                  << (double) stats.lightReferences / ClusteredLighting::CLUSTER_COUNT
+                  << " lights per cluster on average, " << stats.overflowedClusters << " clusters overflowed"
+                  << std::endl;
+    }
+    if (_shadowsReady) {
+        std::cout << "Shadows: " << _shadows.staticRefreshes() << " static cascade redraws in "
+                  << frameMilliseconds.size() << " frames" << std::endl;
+    }
+    MemoryUsage meshMemory = _gpuMemory.categoryUsage(MEMORY_MESH);
+    MemoryUsage textureMemory = _gpuMemory.categoryUsage(MEMORY_TEXTURE);
+    std::cout << "Memory: " << meshMemory.bytes / (1024.0 * 1024.0) << " MB of meshes in " << meshMemory.allocations
+              << " buffers, " << textureMemory.bytes / (1024.0 * 1024.0) << " MB of textures, "
+              << 100.0f * _gpuMemory.fragmentation() << "% of the allocated blocks unused, "
+              << _gpuMemory.bytesMoved() / (1024.0 * 1024.0) << " MB moved by defragmentation" << std::endl;
+    if (_residency.budget() > 0) {
+        std::cout << "Residency: " << _residency.residentBytes() / (1024.0 * 1024.0) << " of "
+                  << _residency.totalBytes() / (1024.0 * 1024.0) << " MB of meshes and textures resident, "
+                  << _residency.evictions() << " evictions and " << _residency.reloads() << " reloads" << std::endl;
+    }
+    if (_virtualTexturing) {
+        std::cout << "Virtual texture: " << _virtualTexture.residentPages() << " of " << _virtualTexture.totalPages()
+                  << " pages resident in a " << _virtualTexture.cacheBytes() / (1024.0 * 1024.0) << " MB cache for "
+                  << _virtualTexture.textureBytes() / (1024.0 * 1024.0) << " MB of texture, "
+                  << _virtualTexture.pagesUploaded() << " pages uploaded" << std::endl;
+    }
+    if (_resolutionController.enabled() && !frameMilliseconds.empty()) {
+        std::cout << "Dynamic resolution: average scale " << resolutionScaleTotal / frameMilliseconds.size()
+                  << ", last frame rendered at " << _renderExtent.width << "x" << _renderExtent.height << std::endl;
+    }
+}
+
+void VulkanEngine::runBenchmark() {
+    CameraPath path;
+    if (!path.loadFromFile(_config.benchmarkPath.c_str())) {
+        return;
+    }
+
+    BenchmarkResults results;
+    results.cameraPath = _config.benchmarkPath;
+    results.warmupFrames = _config.benchmarkWarmupFrames;
+    results.timestep = _config.benchmarkTimestep;
+    results.cpuMilliseconds.reserve(_config.frameCount);
+    results.gpuMilliseconds.assign(_config.frameCount, -1.0);
+    if (_occlusionCulling) {
+        results.occludedObjects.assign(_config.frameCount, -1.0);
+    }
+
+    //the camera follows the path on a fixed timestep, so every run renders the same sequence of frames
+    _deltaTime = _config.benchmarkTimestep;
+    const uint32_t renderedFrames = _config.benchmarkWarmupFrames + _config.frameCount;
+    const int64_t firstMeasuredFrame = _frameNumber + _config.benchmarkWarmupFrames;
+
+    //GPU timings resolve framesInFlight frames late, the trailing frames flush the last measured ones
+    for (uint32_t i = 0; i < renderedFrames + _config.framesInFlight; i++) {
+        if (_window) {
+            glfwPollEvents();
+        }
+        path.sample(i * _config.benchmarkTimestep, _cameraPos, _yaw, _pitch);
+        calculationDirection();
+
+        auto frameStart = std::chrono::steady_clock::now();
+        draw();
+        auto frameEnd = std::chrono::steady_clock::now();
+
+        if (i >= _config.benchmarkWarmupFrames && i < renderedFrames) {
+            results.cpuMilliseconds.push_back(
+                    std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+        }
+
+        int64_t resolvedFrame = _gpuProfiler.lastResolvedFrame();
+        if (resolvedFrame >= firstMeasuredFrame && resolvedFrame < firstMeasuredFrame + _config.frameCount) {
+            results.gpuMilliseconds[resolvedFrame - firstMeasuredFrame] = _gpuProfiler.lastMilliseconds(_frameScope);
+        }
+        int64_t statsFrame = _occlusionCuller.lastStatsFrame();
+        if (_occlusionCulling && statsFrame >= firstMeasuredFrame &&
+            statsFrame < firstMeasuredFrame + _config.frameCount) {
+            results.occludedObjects[statsFrame - firstMeasuredFrame] = _occlusionCuller.lastStats().occluded;
+        }
+    }
+    waitForTimeline(_frameTimelineValue);
+
+    results.printSummary();
+    results.writeCsv(_config.benchmarkOutput + ".csv");
+    results.writeJson(_config.benchmarkOutput + ".json");
+}
+
 void VulkanEngine::cleanup() {
+    CPU_PROFILER_WRITE_TRACE(_config.cpuTraceOutput);
+    reportDepthPrepass();
+    if (!_config.gpuProfileOutput.empty()) {
+        _gpuProfiler.writeCsv(_config.gpuProfileOutput + ".csv");
+        _gpuProfiler.writeJson(_config.gpuProfileOutput + ".json");
+    }
+    if (!_config.memoryStatsOutput.empty()) {
+        _gpuMemory.writeStats(_config.memoryStatsOutput);
+    }
 
-    if (vkDeviceWaitIdle(_device)) {
+    if (vkDeviceWaitIdle(_device) == VK_SUCCESS) {
+        _deferredDestruction.flush();
         _mainDeletionQueue.flush();
-        vkDestroySurfaceKHR(_instance, _surface, nullptr);
+        if (_surface != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(_instance, _surface, nullptr);
+        }
         vkDestroyDevice(_device, nullptr);
         vkDestroyInstance(_instance, nullptr);
-        glfwTerminate();
+        if (_window) {
+            glfwTerminate();
+        }
+    }
+}
+
+bool VulkanEngine::initArchive() {
+    if (_config.archivePath.empty()) {
+        return true;
+    }
+    //mount printed why, every asset still loads from its own file
+    if (!_archive.mount(_config.archivePath.c_str())) {
+        std::cout << "Running without the archive " << _config.archivePath << std::endl;
+        return false;
     }
+    _mainDeletionQueue.push_function([=]() {
+        _archive.unmount();
+    });
+    return true;
 }
 
 bool VulkanEngine::loadShaderModule(const char *filePath, VkShaderModule *outShaderModule) {
+    VkShaderModuleCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.pNext = nullptr;
+
+    //a stored blob starts on a page boundary of the mapping, so its words go to the driver without a copy
+    const ArchiveEntry *entry = _archive.mounted() ? _archive.find(filePath) : nullptr;
+    if (entry && entry->type == ARCHIVE_SHADER) {
+        std::vector<uint32_t> code;
+        if (entry->compression == ARCHIVE_STORED) {
+            createInfo.pCode = (const uint32_t *) _archive.data(*entry);
+        } else {
+            code.resize((size_t) entry->size / sizeof(uint32_t) + 1);
+            if (!_archive.read(*entry, code.data())) {
+                return false;
+            }
+            createInfo.pCode = code.data();
+        }
+        createInfo.codeSize = (size_t) entry->size & ~(sizeof(uint32_t) - 1);
+        return vkCreateShaderModule(_device, &createInfo, nullptr, outShaderModule) == VK_SUCCESS;
+    }
+
     std::ifstream file(filePath, std::ios::ate | std::ios::binary);
 
     if (!file.is_open()) {
@@ -414,10 +1020,6 @@ bool VulkanEngine::loadShaderModule(const char *filePath, VkShaderModule *outSha
     file.read((char *) buffer.data(), fileSize);
     file.close();
 
-    VkShaderModuleCreateInfo createInfo = {};
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.pNext = nullptr;
-
     createInfo.codeSize = buffer.size() * sizeof(uint32_t);
     createInfo.pCode = buffer.data();
     VkShaderModule shaderModule;
@@ -457,6 +1059,13 @@ void VulkanEngine::initPipelines() {
     VkPipelineLayout texturedPipeLayout;
     VK_CHECK(vkCreatePipelineLayout(_device, &texturedPipelineLayoutInfo, nullptr, &texturedPipeLayout));
 
+    //the level reads the virtual texture, the textures of a --scene-obj still go through the regular set
+    VkPipelineLayout virtualTexturedPipeLayout = VK_NULL_HANDLE;
+    if (_virtualTexturing) {
+        texturedSetLayouts[2] = _virtualTexture.setLayout();
+        VK_CHECK(vkCreatePipelineLayout(_device, &texturedPipelineLayoutInfo, nullptr, &virtualTexturedPipeLayout));
+    }
+
 
     PipelineBuilder pipelineBuilder;
 
@@ -471,6 +1080,8 @@ void VulkanEngine::initPipelines() {
     pipelineBuilder.viewport.maxDepth = 1.0f;
     pipelineBuilder.scissor.offset = {0, 0};
     pipelineBuilder.scissor.extent = _windowExtent;
+    //the scene viewport follows the dynamic resolution, see setRenderViewport
+    pipelineBuilder.dynamicViewport = true;
 
     pipelineBuilder.rasterizer = vkinit::rasterizationStateCreateInfo(VK_POLYGON_MODE_FILL);
 
@@ -524,7 +1135,14 @@ void VulkanEngine::initPipelines() {
     //build the mesh triangle pipeline
     VkPipeline meshPipeline = pipelineBuilder.buildPipeline(_device, _renderPass);
 
-    createMaterial(meshPipeline, meshPipelineLayout, "defaultmesh");
+    //after the depth pre-pass only the front-most fragment of every pixel passes
+    VkPipelineDepthStencilStateCreateInfo prepassDepthStencil = vkinit::depthStencilCreateInfo(true, false,
+                                                                                              VK_COMPARE_OP_EQUAL);
+    pipelineBuilder.depthStencil = prepassDepthStencil;
+    VkPipeline meshPrepassPipeline = pipelineBuilder.buildPipeline(_device, _renderPass);
+    pipelineBuilder.depthStencil = vkinit::depthStencilCreateInfo(true, true, VK_COMPARE_OP_LESS_OR_EQUAL);
+
+    createMaterial(meshPipeline, meshPipelineLayout, "defaultmesh", meshPrepassPipeline);
 
     pipelineBuilder.shaderStages.clear();
     pipelineBuilder.shaderStages.push_back(
@@ -535,134 +1153,890 @@ void VulkanEngine::initPipelines() {
 
     pipelineBuilder.pipelineLayout = texturedPipeLayout;
     VkPipeline texPipeline = pipelineBuilder.buildPipeline(_device, _renderPass);
-    createMaterial(texPipeline, texturedPipeLayout, "texturedmesh");
+
+    pipelineBuilder.depthStencil = prepassDepthStencil;
+    VkPipeline texPrepassPipeline = pipelineBuilder.buildPipeline(_device, _renderPass);
+    pipelineBuilder.depthStencil = vkinit::depthStencilCreateInfo(true, true, VK_COMPARE_OP_LESS_OR_EQUAL);
+
+    createMaterial(texPipeline, texturedPipeLayout, "texturedmesh", texPrepassPipeline);
+
+    VkPipeline virtualTexPipeline = VK_NULL_HANDLE;
+    VkPipeline virtualTexPrepassPipeline = VK_NULL_HANDLE;
+    if (_virtualTexturing) {
+        VkShaderModule virtualTexturedShader;
+        if (!loadShaderModule("../shaders/textured_lit_vt.frag.spv", &virtualTexturedShader)) {
+            std::cout << "Error when building the virtual textured mesh shader" << std::endl;
+        }
+        pipelineBuilder.shaderStages[1] = vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT,
+                                                                                virtualTexturedShader);
+        pipelineBuilder.pipelineLayout = virtualTexturedPipeLayout;
+        virtualTexPipeline = pipelineBuilder.buildPipeline(_device, _renderPass);
+
+        pipelineBuilder.depthStencil = prepassDepthStencil;
+        virtualTexPrepassPipeline = pipelineBuilder.buildPipeline(_device, _renderPass);
+        pipelineBuilder.depthStencil = vkinit::depthStencilCreateInfo(true, true, VK_COMPARE_OP_LESS_OR_EQUAL);
+        vkDestroyShaderModule(_device, virtualTexturedShader, nullptr);
+
+        MaterialHandle virtualTexturedMaterial = createMaterial(virtualTexPipeline, virtualTexturedPipeLayout,
+                                                                "virtualtexturedmesh", virtualTexPrepassPipeline);
+        _materials.get(virtualTexturedMaterial)->virtualTexture = true;
+    }
+
+    //the depth pre-pass has no fragment shader and writes no colour, only depth
+    VkShaderModule depthOnlyVertShader;
+    if (!loadShaderModule("../shaders/depth_only.vert.spv", &depthOnlyVertShader)) {
+        std::cout << "Error when building the depth only vertex shader module" << std::endl;
+    }
+
+    VertexInputDescription positionDescription = Vertex::getPositionOnlyDescription();
+    pipelineBuilder.vertexInputInfo.pVertexAttributeDescriptions = positionDescription.attributes.data();
+    pipelineBuilder.vertexInputInfo.vertexAttributeDescriptionCount = positionDescription.attributes.size();
+    pipelineBuilder.vertexInputInfo.pVertexBindingDescriptions = positionDescription.bindings.data();
+    pipelineBuilder.vertexInputInfo.vertexBindingDescriptionCount = positionDescription.bindings.size();
+
+    pipelineBuilder.shaderStages.clear();
+    pipelineBuilder.shaderStages.push_back(
+            vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, depthOnlyVertShader));
+    pipelineBuilder.colorBlendAttachment.colorWriteMask = 0;
+    pipelineBuilder.pipelineLayout = meshPipelineLayout;
+    _depthPrepassPipeline = pipelineBuilder.buildPipeline(_device, _renderPass);
+    _depthPrepassLayout = meshPipelineLayout;
 
     //deleting all of the vulkan shaders
     vkDestroyShaderModule(_device, meshVertShader, nullptr);
     vkDestroyShaderModule(_device, triangleFragShader, nullptr);
     vkDestroyShaderModule(_device, texturedMeshShader, nullptr);
+    vkDestroyShaderModule(_device, depthOnlyVertShader, nullptr);
 
     //adding the pipelines to the deletion queue
     _mainDeletionQueue.push_function([=]() {
         vkDestroyPipeline(_device, meshPipeline, nullptr);
+        vkDestroyPipeline(_device, meshPrepassPipeline, nullptr);
         vkDestroyPipelineLayout(_device, meshPipelineLayout, nullptr);
         vkDestroyPipeline(_device, texPipeline, nullptr);
+        vkDestroyPipeline(_device, texPrepassPipeline, nullptr);
         vkDestroyPipelineLayout(_device, texturedPipeLayout, nullptr);
+        if (virtualTexturedPipeLayout != VK_NULL_HANDLE) {
+            vkDestroyPipeline(_device, virtualTexPipeline, nullptr);
+            vkDestroyPipeline(_device, virtualTexPrepassPipeline, nullptr);
+            vkDestroyPipelineLayout(_device, virtualTexturedPipeLayout, nullptr);
+        }
+        vkDestroyPipeline(_device, _depthPrepassPipeline, nullptr);
     });
 }
 
-void VulkanEngine::loadMeshes() {
-    Mesh triangleMesh{};
-
-    triangleMesh._vertices.resize(3);
+void VulkanEngine::initOcclusionCulling() {
+    if (!_occlusionCulling) {
+        return;
+    }
 
-    triangleMesh._vertices[0].position = {1.f, 1.f, 0.0f};
-    triangleMesh._vertices[1].position = {-1.f, 1.f, 0.0f};
-    triangleMesh._vertices[2].position = {0.f, -1.f, 0.0f};
+    VkShaderModule reduceShader;
+    if (!loadShaderModule("../shaders/hiz_reduce.comp.spv", &reduceShader)) {
+        std::cout << "Error when building the depth pyramid shader, occlusion culling is disabled" << std::endl;
+        _occlusionCulling = false;
+        return;
+    }
+    VkShaderModule cullShader;
+    if (!loadShaderModule("../shaders/occlusion_cull.comp.spv", &cullShader)) {
+        std::cout << "Error when building the occlusion culling shader, occlusion culling is disabled" << std::endl;
+        vkDestroyShaderModule(_device, reduceShader, nullptr);
+        _occlusionCulling = false;
+        return;
+    }
 
-    triangleMesh._vertices[0].color = {1.0f, 0.0f, 0.0f};
-    triangleMesh._vertices[1].color = {0.0f, 1.0f, 0.0f};
-    triangleMesh._vertices[2].color = {0.0f, 0.0f, 1.0f};
-    uploadMesh(triangleMesh);
+    _occlusionCuller.init(_device, _allocator, _gpuMemory, _config.framesInFlight, MAX_OBJECTS, _windowExtent,
+                          _depthImageView, reduceShader, cullShader, _frameAllocator.buffer());
+    vkDestroyShaderModule(_device, reduceShader, nullptr);
+    vkDestroyShaderModule(_device, cullShader, nullptr);
 
-    Mesh bunnyMesh{};
-    bunnyMesh.loadFromObj("../assets/bunny.obj");
+    immediateSubmit([=](VkCommandBuffer cmd) {
+        _occlusionCuller.recordInitialization(cmd);
+    });
 
-    uploadMesh(bunnyMesh);
+    _cullScope = _gpuProfiler.registerScope("occlusion_cull");
+    _hizScope = _gpuProfiler.registerScope("hiz_pyramid");
 
-    _meshes["bunny"] = bunnyMesh;
-    _meshes["triangle"] = triangleMesh;
+    _mainDeletionQueue.push_function([=]() {
+        _occlusionCuller.cleanup();
+    });
+}
 
-    Mesh lostEmpire{};
-    lostEmpire.loadFromObj("../assets/lost-empire/lost_empire.obj");
+void VulkanEngine::initVirtualTexture() {
+    if (!_virtualTexturing) {
+        return;
+    }
+    if (!_virtualTexture.init(_device, _allocator, _gpuMemory, _config.framesInFlight, LOST_EMPIRE_TEXTURE,
+                              _config.virtualTextureCacheSize)) {
+        _virtualTexturing = false;
+        return;
+    }
 
-    uploadMesh(lostEmpire);
+    immediateSubmit([=](VkCommandBuffer cmd) {
+        _virtualTexture.recordInitialization(cmd);
+    });
 
-    _meshes["lostEmpire"] = lostEmpire;
+    _mainDeletionQueue.push_function([=]() {
+        _virtualTexture.cleanup();
+    });
 }
 
-void VulkanEngine::uploadMesh(Mesh &mesh) {
-    const size_t bufferSize= mesh._vertices.size() * sizeof(Vertex);
-    VkBufferCreateInfo stagingBufferInfo = {};
-    stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    stagingBufferInfo.pNext = nullptr;
+void VulkanEngine::initLighting() {
+    VkShaderModule clusterShader = VK_NULL_HANDLE;
+    if (!loadShaderModule("../shaders/light_cluster.comp.spv", &clusterShader)) {
+        std::cout << "Error when building the light clustering shader, point lights are disabled" << std::endl;
+        clusterShader = VK_NULL_HANDLE;
+    }
 
-    stagingBufferInfo.size = bufferSize;
-    stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    //the lit shaders read the light bindings either way, without the clustering pass they stay empty
+    _clusteredLighting.init(_device, _allocator, _gpuMemory, _config.framesInFlight, MAX_LIGHTS, clusterShader,
+                            _frameAllocator.buffer());
+    _clusteredLightingReady = clusterShader != VK_NULL_HANDLE;
+    if (_clusteredLightingReady) {
+        vkDestroyShaderModule(_device, clusterShader, nullptr);
+    }
 
-    VmaAllocationCreateInfo vmaallocInfo = {};
-    vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    immediateSubmit([=](VkCommandBuffer cmd) {
+        _clusteredLighting.recordInitialization(cmd);
+    });
 
-    AllocatedBuffer stagingBuffer;
+    for (int i = 0; i < _config.framesInFlight; i++) {
+        VkDescriptorBufferInfo lightsInfo = {_clusteredLighting.lightBuffer(i), 0, VK_WHOLE_SIZE};
+        VkDescriptorBufferInfo gridInfo = {_clusteredLighting.gridBuffer(), 0, VK_WHOLE_SIZE};
+        VkDescriptorBufferInfo indicesInfo = {_clusteredLighting.indexBuffer(), 0, VK_WHOLE_SIZE};
+
+        VkWriteDescriptorSet writes[] = {
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].globalDescriptor,
+                                              &lightsInfo, 3),
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].globalDescriptor,
+                                              &gridInfo, 4),
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].globalDescriptor,
+                                              &indicesInfo, 5)
+        };
+        vkUpdateDescriptorSets(_device, 3, writes, 0, nullptr);
+    }
 
-    VK_CHECK(vmaCreateBuffer(_allocator, &stagingBufferInfo, &vmaallocInfo,
-                             &stagingBuffer._buffer,
-                             &stagingBuffer._allocation,
-                             nullptr));
+    _lightScope = _gpuProfiler.registerScope("light_clusters");
 
     _mainDeletionQueue.push_function([=]() {
-        vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation);
+        _clusteredLighting.cleanup();
     });
+}
 
-    void* data;
-    vmaMapMemory(_allocator, stagingBuffer._allocation, &data);
-    memcpy(data, mesh._vertices.data(), mesh._vertices.size() * sizeof(Vertex));
-    vmaUnmapMemory(_allocator, stagingBuffer._allocation);
-
-    VkBufferCreateInfo vertexBufferInfo = {};
-    vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    vertexBufferInfo.pNext = nullptr;
-    vertexBufferInfo.size = bufferSize;
-    vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-
-    VK_CHECK(vmaCreateBuffer(_allocator, &vertexBufferInfo, &vmaallocInfo,
-                             &mesh._vertexBuffer._buffer,
-                             &mesh._vertexBuffer._allocation,
-                             nullptr));
+void VulkanEngine::initShadows() {
+    VkShaderModule casterShader = VK_NULL_HANDLE;
+    if (!loadShaderModule("../shaders/shadow_caster.vert.spv", &casterShader)) {
+        std::cout << "Error when building the shadow caster shader, sun shadows are disabled" << std::endl;
+        casterShader = VK_NULL_HANDLE;
+    }
 
-    _mainDeletionQueue.push_function([=]() {
-        vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation);
-    });
+    //the lit shaders sample the maps either way, without casters prepareShadows ends every cascade at depth 0
+    _shadows.init(_device, _allocator, _gpuMemory, _config.shadowMapSize, _config.shadowDistance, casterShader,
+                  _objectSetLayout);
+    _shadowsReady = casterShader != VK_NULL_HANDLE;
+    if (_shadowsReady) {
+        vkDestroyShaderModule(_device, casterShader, nullptr);
+    }
 
     immediateSubmit([=](VkCommandBuffer cmd) {
-        VkBufferCopy copy;
-        copy.dstOffset = 0;
-        copy.srcOffset = 0;
-        copy.size = bufferSize;
-        vkCmdCopyBuffer(cmd, stagingBuffer._buffer, mesh._vertexBuffer._buffer, 1, &copy);
+        _shadows.recordInitialization(cmd);
     });
 
-    vmaDestroyBuffer(_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
-}
+    for (int i = 0; i < _config.framesInFlight; i++) {
+        VkDescriptorImageInfo staticInfo = {_shadows.sampler(), _shadows.layerView(SHADOW_LAYER_STATIC),
+                                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        VkDescriptorImageInfo dynamicInfo = {_shadows.sampler(), _shadows.layerView(SHADOW_LAYER_DYNAMIC),
+                                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+        VkWriteDescriptorSet writes[] = {
+                vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _frames[i].globalDescriptor,
+                                             &staticInfo, 6),
+                vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _frames[i].globalDescriptor,
+                                             &dynamicInfo, 7)
+        };
+        vkUpdateDescriptorSets(_device, 2, writes, 0, nullptr);
+    }
 
-Material *VulkanEngine::createMaterial(VkPipeline pipeline, VkPipelineLayout layout, const std::string &name) {
-    Material mat;
-    mat.pipeline = pipeline;
-    mat.pipelineLayout = layout;
-    _materials[name] = mat;
-    return &_materials[name];
+    _shadowStaticScope = _gpuProfiler.registerScope("shadow_static");
+    _shadowDynamicScope = _gpuProfiler.registerScope("shadow_dynamic");
+
+    _mainDeletionQueue.push_function([=]() {
+        _shadows.cleanup();
+    });
 }
 
-Material *VulkanEngine::getMaterial(const std::string &name) {
-    auto it = _materials.find(name);
-    if (it == _materials.end()) {
-        return nullptr;
-    } else {
-        return &(*it).second;
+void VulkanEngine::initUpscalePass() {
+    VkDescriptorSetLayoutBinding sceneColorBind = vkinit::descriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+
+    VkDescriptorSetLayoutCreateInfo setInfo = {};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setInfo.pNext = nullptr;
+    setInfo.flags = 0;
+    setInfo.bindingCount = 1;
+    setInfo.pBindings = &sceneColorBind;
+    VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_upscaleSetLayout));
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &_upscaleSetLayout;
+    VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, &_upscaleDescriptor));
+
+    //the shader clamps its taps to the rendered part, the edge mode only matters for the window sized scale of 1
+    VkSamplerCreateInfo samplerInfo = vkinit::samplerCreateInfo(VK_FILTER_LINEAR,
+                                                                VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+    VK_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr, &_upscaleSampler));
+
+    VkDescriptorImageInfo imageInfo = {_upscaleSampler, _sceneColorView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    VkWriteDescriptorSet imageWrite = vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                                   _upscaleDescriptor, &imageInfo, 0);
+    vkUpdateDescriptorSets(_device, 1, &imageWrite, 0, nullptr);
+
+    VkPushConstantRange pushConstant;
+    pushConstant.offset = 0;
+    pushConstant.size = sizeof(UpscalePushConstants);
+    pushConstant.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipelineLayoutCreateInfo();
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &_upscaleSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstant;
+    VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_upscaleLayout));
+
+    VkShaderModule fullscreenShader = VK_NULL_HANDLE;
+    if (!loadShaderModule("../shaders/fullscreen.vert.spv", &fullscreenShader)) {
+        std::cout << "Error when building the fullscreen vertex shader" << std::endl;
+        fullscreenShader = VK_NULL_HANDLE;
+    }
+    VkShaderModule upscaleShader = VK_NULL_HANDLE;
+    if (!loadShaderModule("../shaders/upscale.frag.spv", &upscaleShader)) {
+        std::cout << "Error when building the upscale shader" << std::endl;
+        upscaleShader = VK_NULL_HANDLE;
+    }
+
+    //without the pipeline the scene stays at the window resolution and drawUpscale copies it over instead
+    _upscaleReady = fullscreenShader != VK_NULL_HANDLE && upscaleShader != VK_NULL_HANDLE;
+    if (_upscaleReady) {
+        //one triangle over the whole swapchain image, no vertex input and no depth
+        PipelineBuilder pipelineBuilder;
+        pipelineBuilder.vertexInputInfo = vkinit::vertexInputStateCreateInfo();
+        pipelineBuilder.inputAssembly = vkinit::inputAssemblyCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        pipelineBuilder.viewport.x = 0.0f;
+        pipelineBuilder.viewport.y = 0.0f;
+        pipelineBuilder.viewport.width = (float) _windowExtent.width;
+        pipelineBuilder.viewport.height = (float) _windowExtent.height;
+        pipelineBuilder.viewport.minDepth = 0.0f;
+        pipelineBuilder.viewport.maxDepth = 1.0f;
+        pipelineBuilder.scissor.offset = {0, 0};
+        pipelineBuilder.scissor.extent = _windowExtent;
+        pipelineBuilder.rasterizer = vkinit::rasterizationStateCreateInfo(VK_POLYGON_MODE_FILL);
+        pipelineBuilder.multisampling = vkinit::multisamplingStateCreateInfo();
+        pipelineBuilder.colorBlendAttachment = vkinit::colorBlendAttachmentState();
+        pipelineBuilder.depthStencil = vkinit::depthStencilCreateInfo(false, false, VK_COMPARE_OP_ALWAYS);
+        pipelineBuilder.pipelineLayout = _upscaleLayout;
+        pipelineBuilder.shaderStages.push_back(
+                vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, fullscreenShader));
+        pipelineBuilder.shaderStages.push_back(
+                vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, upscaleShader));
+        _upscalePipeline = pipelineBuilder.buildPipeline(_device, _upscaleRenderPass);
+    } else {
+        std::cout << "Upscaling is disabled, rendering at " << _windowExtent.width << "x" << _windowExtent.height
+                  << std::endl;
+    }
+
+    vkDestroyShaderModule(_device, fullscreenShader, nullptr);
+    vkDestroyShaderModule(_device, upscaleShader, nullptr);
+
+    _upscaleScope = _gpuProfiler.registerScope("upscale");
+    //a budget of 0 pins the render scale at 1
+    _resolutionController.init(_upscaleReady ? _config.gpuBudgetMilliseconds : 0.0, _config.minResolutionScale,
+                               1.0f);
+
+    _mainDeletionQueue.push_function([=]() {
+        vkDestroyPipeline(_device, _upscalePipeline, nullptr);
+        vkDestroyPipelineLayout(_device, _upscaleLayout, nullptr);
+        vkDestroySampler(_device, _upscaleSampler, nullptr);
+        vkDestroyDescriptorSetLayout(_device, _upscaleSetLayout, nullptr);
+    });
+}
+
+void VulkanEngine::initLights() {
+    _lights.clear();
+    if (_renderables.empty()) {
+        return;
+    }
+
+    //everything the scene covers, the lights hover over it
+    Aabb sceneBounds;
+    for (const RenderObject &object : _renderables) {
+        const Mesh *mesh = _meshes.get(object.mesh);
+        glm::vec4 sphere = transformSphere(mesh->_boundsCenter, mesh->_boundsRadius,
+                                           objectMatrix(object, _sceneGraph));
+        sceneBounds.expand(Aabb::fromSphere(glm::vec3(sphere), sphere.w));
+    }
+
+    uint32_t count = _config.lightCount;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    _lights.resize(count);
+    for (GPUPointLight &light : _lights) {
+        glm::vec3 position = sceneBounds.minimum + (sceneBounds.maximum - sceneBounds.minimum) *
+                                                   glm::vec3(unit(random), unit(random), unit(random));
+        light.positionRadius = glm::vec4(position, 6.0f + 6.0f * unit(random));
+        //saturated hues so overlapping lights stay tellable apart
+        glm::vec3 color = glm::clamp(glm::abs(glm::mod(unit(random) * 6.0f + glm::vec3(0.0f, 4.0f, 2.0f), 6.0f) -
+                                              3.0f) - 1.0f, 0.0f, 1.0f);
+        light.color = glm::vec4(color * 8.0f, 1.0f);
+    }
+}
+
+void VulkanEngine::updateLights() {
+    if (!_clusteredLightingReady) {
+        return;
+    }
+
+    //every light bobs on its own phase, so the clusters change every frame
+    float time = _frameNumber / 60.0f;
+    GPUPointLight *mapped = _clusteredLighting.lights();
+    for (size_t i = 0; i < _lights.size(); i++) {
+        GPUPointLight light = _lights[i];
+        float phase = time + (float) i * 0.37f;
+        light.positionRadius += glm::vec4(2.0f * sinf(phase), 1.5f * sinf(phase * 1.3f), 2.0f * cosf(phase), 0.0f);
+        mapped[i] = light;
+    }
+}
+
+void VulkanEngine::loadMeshes() {
+    CPU_ZONE("loadMeshes");
+    Mesh triangleMesh{};
+
+    triangleMesh._vertices.resize(3);
+
+    triangleMesh._vertices[0].position = {1.f, 1.f, 0.0f};
+    triangleMesh._vertices[1].position = {-1.f, 1.f, 0.0f};
+    triangleMesh._vertices[2].position = {0.f, -1.f, 0.0f};
+
+    triangleMesh._vertices[0].color = {1.0f, 0.0f, 0.0f};
+    triangleMesh._vertices[1].color = {0.0f, 1.0f, 0.0f};
+    triangleMesh._vertices[2].color = {0.0f, 0.0f, 1.0f};
+    triangleMesh.computeBounds();
+    uploadMesh(triangleMesh);
+
+    Mesh bunnyMesh{};
+    loadMesh(bunnyMesh, "../assets/bunny.obj");
+    buildMeshLods(bunnyMesh);
+    bunnyMesh.computeBounds();
+
+    uploadMesh(bunnyMesh);
+
+    _meshes.add("bunny", bunnyMesh);
+    _meshes.add("triangle", triangleMesh);
+
+    Mesh lostEmpire{};
+    loadMesh(lostEmpire, "../assets/lost-empire/lost_empire.obj");
+    if (_config.chunkTriangles > 0) {
+        uploadMeshChunks("lostEmpire", lostEmpire);
+    } else {
+        buildMeshLods(lostEmpire);
+        lostEmpire.computeBounds();
+
+        uploadMesh(lostEmpire);
+
+        _meshes.add("lostEmpire", lostEmpire);
     }
+
+    if (!_config.sceneObj.empty()) {
+        //an empty mesh would ask for a zero sized buffer, initScene skips the scene when no chunks were registered
+        Mesh sceneObj{};
+        if (loadMesh(sceneObj, _config.sceneObj) && !sceneObj._vertices.empty()) {
+            uploadMeshParts("sceneObj", sceneObj);
+        } else {
+            std::cout << "Failed to load scene " << _config.sceneObj << ", running without it" << std::endl;
+        }
+    }
+    if (!_config.sceneGlb.empty()) {
+        loadGlbScene(_config.sceneGlb);
+    }
+
+    //the chunks were registered together with their shared buffer
+    _meshes.forEach([&](MeshHandle handle, Mesh &mesh) {
+        if (mesh._residencyId != INVALID_RESIDENCY_ID) {
+            return;
+        }
+        const std::string &name = _meshes.name(handle);
+        mesh._residencyId = addResidentAsset(RESIDENT_MESH, name, "", meshBytes(mesh._vertices.size()), 0,
+                                             handle.value);
+        if (mesh.lodCount() > 1) {
+            std::cout << "Mesh " << name << " has " << mesh.lodCount() << " detail levels, "
+                      << mesh.getLod(0).vertexCount / 3 << " to "
+                      << mesh.getLod(mesh.lodCount() - 1).vertexCount / 3 << " triangles" << std::endl;
+        }
+    });
+}
+
+bool VulkanEngine::loadMesh(Mesh &outMesh, const std::string &path) {
+    const ArchiveEntry *entry = _archive.mounted() ? _archive.find(path) : nullptr;
+    if (!entry || entry->type != ARCHIVE_MESH) {
+        return outMesh.loadFromObj(path.c_str());
+    }
+    //the vertices are already in the engine's layout, a stored blob is copied out of the mapping as it is
+    std::vector<uint8_t> decompressed;
+    const uint8_t *blob = _archive.data(*entry);
+    if (entry->compression != ARCHIVE_STORED) {
+        decompressed.resize((size_t) entry->size);
+        if (!_archive.read(*entry, decompressed.data())) {
+            std::cout << "Archived mesh " << path << " is corrupt" << std::endl;
+            return false;
+        }
+        blob = decompressed.data();
+    }
+    if (!unpackMesh(blob, (size_t) entry->size, outMesh)) {
+        std::cout << "Archived mesh " << path << " is malformed" << std::endl;
+        return false;
+    }
+    return true;
 }
 
-Mesh *VulkanEngine::getMesh(const std::string &name) {
-    auto it = _meshes.find(name);
-    if (it == _meshes.end()) {
+bool VulkanEngine::loadGlbScene(const std::string &path) {
+    CPU_ZONE("loadGlbScene");
+    GlbFile &file = _glbFiles[path];
+    std::vector<GlbPrimitive> primitives;
+    std::vector<GlbInstance> instances;
+    if (!file.open(path.c_str()) || !file.readScene(primitives, instances)) {
+        std::cout << "Failed to load glTF scene " << path << ", running without it" << std::endl;
+        file.close();
+        _glbFiles.erase(path);
+        return false;
+    }
+    //the embedded images are decoded out of the mapping, evicted ones again later
+    _mainDeletionQueue.push_function([=]() {
+        _glbFiles[path].close();
+    });
+
+    std::vector<std::string> textures(file.imageCount());
+    for (uint32_t image = 0; image < textures.size(); image++) {
+        std::string imagePath = file.imagePath(image);
+        textures[image] = imagePath.empty() ? path + "#image" + std::to_string(image) : imagePath;
+    }
+
+    std::vector<MeshHandle> meshes(primitives.size());
+    std::vector<std::string> primitiveTextures(primitives.size());
+    std::vector<std::string> textureFiles;
+    for (size_t p = 0; p < primitives.size(); p++) {
+        Mesh &mesh = primitives[p].mesh;
+        //a primitive without a whole triangle would ask for a zero sized buffer, its instances are dropped below
+        if (mesh._vertices.empty()) {
+            std::cout << "glTF " << path << ": primitive " << p << " has no triangles, skipping it" << std::endl;
+            continue;
+        }
+        buildMeshLods(mesh);
+        mesh.computeBounds();
+        uploadMesh(mesh);
+        meshes[p] = _meshes.add(path + "#mesh" + std::to_string(p), mesh);
+
+        //every image once, those with a uri are decoded together like any other texture files
+        int32_t image = primitives[p].baseColorImage;
+        if (image < 0) {
+            continue;
+        }
+        primitiveTextures[p] = textures[image];
+        if (!file.imagePath(image).empty()) {
+            textureFiles.push_back(textures[image]);
+        } else if (!_textures.find(textures[image]).valid()) {
+            loadTexture(textures[image], path, RESIDENT_GLB_TEXTURE, (uint32_t) image);
+        }
+    }
+    loadTextures(textureFiles);
+
+    for (const GlbInstance &instance : instances) {
+        if (!meshes[instance.primitive].valid()) {
+            continue;
+        }
+        GlbObject object;
+        object.mesh = meshes[instance.primitive];
+        object.texture = primitiveTextures[instance.primitive];
+        object.transform = instance.transform;
+        _glbObjects.push_back(object);
+    }
+    //grouped by texture, so the objects drawn with one material are neighbours in _renderables
+    std::stable_sort(_glbObjects.begin(), _glbObjects.end(), [](const GlbObject &a, const GlbObject &b) {
+        return a.texture < b.texture;
+    });
+
+    std::cout << "glTF " << path << ": " << primitives.size() << " primitives placed " << instances.size()
+              << " times, " << file.copiedStreams() << " vertex streams copied as is, " << file.convertedStreams()
+              << " converted" << std::endl;
+    return true;
+}
+
+void VulkanEngine::uploadMeshChunks(const std::string &name, Mesh &mesh) {
+    CPU_ZONE("uploadMeshChunks");
+    std::vector<Mesh> chunks = splitMeshIntoChunks(mesh, _config.chunkTriangles);
+    //simplifying chunk by chunk keeps their borders pinned, so neighbouring levels still meet
+    for (Mesh &chunk : chunks) {
+        buildMeshLods(chunk);
+        chunk.computeBounds();
+    }
+
+    std::cout << "Mesh " << name << " split into " << chunks.size() << " chunks of up to "
+              << _config.chunkTriangles << " triangles" << std::endl;
+    uploadSharedChunks(name, chunks);
+}
+
+void VulkanEngine::uploadMeshParts(const std::string &name, Mesh &mesh) {
+    CPU_ZONE("uploadMeshParts");
+    std::vector<Mesh> parts;
+    std::vector<std::string> &partTextures = _meshPartTextures[name];
+    auto submeshTexture = [&](size_t index) -> const std::string & {
+        static const std::string untextured;
+        uint32_t material = mesh._submeshes[index].material;
+        return material == ~0u ? untextured : mesh._materials[material].diffuseTexture;
+    };
+
+    //the loader put submeshes sharing a texture next to each other, they draw as one range with one material.
+    //untextured ones carry their colour in the vertices and merge as well
+    size_t first = 0;
+    while (first < mesh._submeshes.size()) {
+        size_t end = first + 1;
+        while (end < mesh._submeshes.size() && submeshTexture(end) == submeshTexture(first)) {
+            end++;
+        }
+        const SubMesh &last = mesh._submeshes[end - 1];
+        Mesh part{};
+        part._vertices.assign(mesh._vertices.begin() + mesh._submeshes[first].firstVertex,
+                              mesh._vertices.begin() + last.firstVertex + last.vertexCount);
+
+        std::vector<Mesh> chunks;
+        if (_config.chunkTriangles > 0) {
+            chunks = splitMeshIntoChunks(part, _config.chunkTriangles);
+        } else {
+            chunks.push_back(part);
+        }
+        for (Mesh &chunk : chunks) {
+            buildMeshLods(chunk);
+            chunk.computeBounds();
+            parts.push_back(chunk);
+            partTextures.push_back(submeshTexture(first));
+        }
+        first = end;
+    }
+
+    std::cout << "Mesh " << name << " has " << mesh._materials.size() << " materials in " << parts.size()
+              << " parts" << std::endl;
+    uploadSharedChunks(name, parts);
+    //all at once on the worker threads rather than one by one as initScene creates their materials
+    loadTextures(partTextures);
+}
+
+void VulkanEngine::uploadSharedChunks(const std::string &name, std::vector<Mesh> &chunks) {
+    Mesh shared{};
+    mergeChunkVertices(chunks, shared);
+    uploadMesh(shared);
+    uint32_t residencyId = addResidentAsset(RESIDENT_MESH_CHUNKS, name, "", meshBytes(shared._vertices.size()));
+    for (Mesh &chunk : chunks) {
+        chunk._residencyId = residencyId;
+    }
+
+    std::vector<MeshHandle> &handles = _meshChunks[name];
+    handles.clear();
+    for (size_t i = 0; i < chunks.size(); i++) {
+        handles.push_back(_meshes.add(name + "#chunk" + std::to_string(i), chunks[i]));
+    }
+    setChunkBuffers(name, shared._vertexBuffer, shared._positionBuffer);
+    _chunkVertices[name].swap(shared._vertices);
+}
+
+void VulkanEngine::uploadMesh(Mesh &mesh) {
+    mesh._vertexBuffer = uploadBuffer(mesh._vertices.data(), mesh._vertices.size() * sizeof(Vertex),
+                                      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MEMORY_MESH);
+
+    //12 of the 44 bytes per vertex, all the depth pre-pass fetches
+    std::vector<glm::vec3> positions(mesh._vertices.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        positions[i] = mesh._vertices[i].position;
+    }
+    mesh._positionBuffer = uploadBuffer(positions.data(), positions.size() * sizeof(glm::vec3),
+                                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MEMORY_MESH);
+}
+
+AllocatedBuffer VulkanEngine::uploadBuffer(const void *data, size_t size, VkBufferUsageFlags usage,
+                                           MemoryCategory category) {
+    AllocatedBuffer stagingBuffer = createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY,
+                                                 MEMORY_STAGING);
+
+    void *mapped;
+    vmaMapMemory(_allocator, stagingBuffer._allocation, &mapped);
+    memcpy(mapped, data, size);
+    vmaUnmapMemory(_allocator, stagingBuffer._allocation);
+
+    AllocatedBuffer buffer = _gpuMemory.createMovableBuffer(size, usage, category);
+    immediateSubmit([=](VkCommandBuffer cmd) {
+        VkBufferCopy copy;
+        copy.dstOffset = 0;
+        copy.srcOffset = 0;
+        copy.size = size;
+        vkCmdCopyBuffer(cmd, stagingBuffer._buffer, buffer._buffer, 1, &copy);
+    });
+
+    _gpuMemory.destroyBuffer(stagingBuffer);
+    return buffer;
+}
+
+void VulkanEngine::setChunkBuffers(const std::string &name, const AllocatedBuffer &vertexBuffer,
+                                   const AllocatedBuffer &positionBuffer) {
+    for (MeshHandle chunk : _meshChunks[name]) {
+        Mesh *mesh = _meshes.get(chunk);
+        mesh->_vertexBuffer = vertexBuffer;
+        mesh->_positionBuffer = positionBuffer;
+    }
+}
+
+uint32_t VulkanEngine::addResidentAsset(ResidentAssetType type, const std::string &name, const std::string &path,
+                                        uint64_t bytes, uint32_t image, uint32_t handle) {
+    ResidentAsset asset;
+    asset.type = type;
+    asset.name = name;
+    asset.path = path;
+    asset.image = image;
+    asset.handle = handle;
+    asset.reloadFailed = false;
+    _residentAssets.push_back(asset);
+    return _residency.add(bytes, _frameNumber);
+}
+
+void VulkanEngine::makeResident(const std::vector<uint32_t> &objects) {
+    for (uint32_t i : objects) {
+        const RenderObject &object = _renderables[i];
+        uint32_t meshId = _meshes.get(object.mesh)->_residencyId;
+        if (!_residency.resident(meshId)) {
+            reloadAsset(meshId);
+        }
+        uint32_t textureId = _materials.get(object.material)->textureResidencyId;
+        if (!_residency.resident(textureId)) {
+            reloadAsset(textureId);
+        }
+    }
+}
+
+void VulkanEngine::reloadAsset(uint32_t id) {
+    CPU_ZONE("reloadAsset");
+    ResidentAsset &asset = _residentAssets[id];
+    if (asset.type == RESIDENT_MESH) {
+        Mesh &mesh = *_meshes.get(MeshHandle(asset.handle));
+        uploadMesh(mesh);
+        _residency.setResident(id, meshBytes(mesh._vertices.size()), _frameNumber);
+    } else if (asset.type == RESIDENT_MESH_CHUNKS) {
+        Mesh shared{};
+        shared._vertices.swap(_chunkVertices[asset.name]);
+        uploadMesh(shared);
+        setChunkBuffers(asset.name, shared._vertexBuffer, shared._positionBuffer);
+        _residency.setResident(id, meshBytes(shared._vertices.size()), _frameNumber);
+        _chunkVertices[asset.name].swap(shared._vertices);
+    } else {
+        Texture &texture = *_textures.get(TextureHandle(asset.handle));
+        if (asset.reloadFailed || !decodeTexture(asset.type, asset.path, asset.image, texture.image)) {
+            if (!asset.reloadFailed) {
+                std::cout << "Failed to reload evicted texture " << asset.name << ", drawing it with a fallback"
+                          << std::endl;
+                asset.reloadFailed = true;
+            }
+            //resident without memory, so the draws don't try again every frame
+            texture.image = {};
+            bindMaterialTexture(id, fallbackTextureView());
+            _residency.setResident(id, 0, _frameNumber);
+            return;
+        }
+        VkImageViewCreateInfo imageinfo = vkinit::imageviewCreateInfo(VK_FORMAT_R8G8B8A8_SRGB, texture.image._image,
+                                                                      VK_IMAGE_ASPECT_COLOR_BIT);
+        vkCreateImageView(_device, &imageinfo, nullptr, &texture.imageView);
+        bindMaterialTexture(id, texture.imageView);
+
+        VmaAllocationInfo allocationInfo;
+        vmaGetAllocationInfo(_allocator, texture.image._allocation, &allocationInfo);
+        _residency.setResident(id, allocationInfo.size, _frameNumber);
+    }
+}
+
+void VulkanEngine::bindMaterialTexture(uint32_t textureResidencyId, VkImageView view) {
+    //the sets were last bound framesInFlight frames ago or earlier, no submission still reads them
+    VkDescriptorImageInfo imageBufferInfo;
+    imageBufferInfo.sampler = _textureSampler;
+    imageBufferInfo.imageView = view;
+    imageBufferInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    _materials.forEach([&](MaterialHandle, Material &material) {
+        if (material.textureResidencyId == textureResidencyId) {
+            VkWriteDescriptorSet write = vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                                      material.textureSet, &imageBufferInfo, 0);
+            vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+        }
+    });
+}
+
+VkImageView VulkanEngine::fallbackTextureView() {
+    if (_fallbackTextureView == VK_NULL_HANDLE) {
+        //mid grey, close to the average of a real texture and plain to spot
+        vkutil::createSolidImage(*this, 0xff808080u, _fallbackTexture);
+        VkImageViewCreateInfo imageinfo = vkinit::imageviewCreateInfo(VK_FORMAT_R8G8B8A8_SRGB,
+                                                                      _fallbackTexture._image,
+                                                                      VK_IMAGE_ASPECT_COLOR_BIT);
+        vkCreateImageView(_device, &imageinfo, nullptr, &_fallbackTextureView);
+    }
+    return _fallbackTextureView;
+}
+
+void VulkanEngine::evictAssets() {
+    CPU_ZONE("evictAssets");
+    //the running passes may be moving the buffers an eviction would destroy
+    if (_gpuMemory.defragmenting()) {
+        return;
+    }
+    _evictedAssets.clear();
+    _residency.evict(_frameNumber, _evictedAssets);
+
+    //nothing in flight used these, they go right away
+    for (uint32_t id : _evictedAssets) {
+        const ResidentAsset &asset = _residentAssets[id];
+        if (asset.type == RESIDENT_TEXTURE || asset.type == RESIDENT_GLB_TEXTURE) {
+            Texture &texture = *_textures.get(TextureHandle(asset.handle));
+            vkDestroyImageView(_device, texture.imageView, nullptr);
+            _gpuMemory.destroyImage(texture.image);
+            texture.imageView = VK_NULL_HANDLE;
+            texture.image = {};
+            continue;
+        }
+        Mesh &mesh = *_meshes.get(asset.type == RESIDENT_MESH ? MeshHandle(asset.handle)
+                                                              : _meshChunks[asset.name].front());
+        _gpuMemory.destroyBuffer(mesh._vertexBuffer);
+        _gpuMemory.destroyBuffer(mesh._positionBuffer);
+        if (asset.type == RESIDENT_MESH) {
+            mesh._vertexBuffer = {};
+            mesh._positionBuffer = {};
+        } else {
+            setChunkBuffers(asset.name, {}, {});
+        }
+    }
+}
+
+static void remapBuffer(AllocatedBuffer &buffer, const BufferMove &move) {
+    if (buffer._buffer == move.from) {
+        buffer._buffer = move.to;
+    }
+}
+
+void VulkanEngine::remapMeshBuffers(const std::vector<BufferMove> &moves) {
+    //the chunks are in _meshes as well
+    for (const BufferMove &move : moves) {
+        _meshes.forEach([&](MeshHandle, Mesh &mesh) {
+            remapBuffer(mesh._vertexBuffer, move);
+            remapBuffer(mesh._positionBuffer, move);
+        });
+    }
+}
+
+MaterialHandle VulkanEngine::createMaterial(VkPipeline pipeline, VkPipelineLayout layout, const std::string &name,
+                                            VkPipeline prepassPipeline) {
+    Material mat;
+    mat.pipeline = pipeline;
+    mat.prepassPipeline = prepassPipeline;
+    mat.pipelineLayout = layout;
+    mat.profileScope = _gpuProfiler.registerScope("material:" + name);
+    mat.prepassProfileScope = _gpuProfiler.registerScope("material:" + name + "+prepass");
+    return _materials.add(name, mat);
+}
+
+MaterialHandle VulkanEngine::getMaterial(const std::string &name) {
+    return _materials.find(name);
+}
+
+MaterialHandle VulkanEngine::getTextureMaterial(const std::string &texture) {
+    std::string name = "texturedmesh:" + texture;
+    MaterialHandle existing = getMaterial(name);
+    if (existing.valid()) {
+        return existing;
+    }
+
+    TextureHandle textureHandle = _textures.find(texture);
+    if (!textureHandle.valid()) {
+        if (!loadTexture(texture, texture)) {
+            return MaterialHandle();
+        }
+        textureHandle = _textures.find(texture);
+    }
+    const Texture &loaded = *_textures.get(textureHandle);
+
+    //same pipelines and profile scopes as the level, only the texture set differs
+    Material material = *_materials.get(getMaterial("texturedmesh"));
+    material.textureResidencyId = loaded.residencyId;
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &_singleTextureSetLayout;
+    if (vkAllocateDescriptorSets(_device, &allocInfo, &material.textureSet) != VK_SUCCESS) {
+        std::cout << "Out of texture sets, " << texture << " is drawn untextured" << std::endl;
+        return MaterialHandle();
+    }
+
+    VkDescriptorImageInfo imageBufferInfo;
+    imageBufferInfo.sampler = _textureSampler;
+    imageBufferInfo.imageView = loaded.imageView;
+    imageBufferInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkWriteDescriptorSet write = vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                                              material.textureSet, &imageBufferInfo, 0);
+    vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+    return _materials.add(name, material);
+}
+
+MeshHandle VulkanEngine::getMesh(const std::string &name) {
+    return _meshes.find(name);
+}
+
+std::vector<MeshHandle> *VulkanEngine::getMeshChunks(const std::string &name) {
+    auto it = _meshChunks.find(name);
+    if (it == _meshChunks.end()) {
         return nullptr;
     } else {
         return &(*it).second;
     }
 }
 
+void VulkanEngine::addMeshObjects(const std::string &meshName, MaterialHandle material, const glm::mat4 &transform) {
+    RenderObject object;
+    object.material = material;
+    object.transformMatrix = transform;
+
+    std::vector<MeshHandle> *chunks = getMeshChunks(meshName);
+    if (!chunks) {
+        object.mesh = getMesh(meshName);
+        _renderables.push_back(object);
+        return;
+    }
+    auto textures = _meshPartTextures.find(meshName);
+    for (size_t i = 0; i < chunks->size(); i++) {
+        object.mesh = (*chunks)[i];
+        object.material = material;
+        if (textures != _meshPartTextures.end() && !textures->second[i].empty()) {
+            MaterialHandle textured = getTextureMaterial(textures->second[i]);
+            if (textured.valid()) {
+                object.material = textured;
+            }
+        }
+        _renderables.push_back(object);
+    }
+}
+
 void VulkanEngine::initScene() {
+    VkSamplerCreateInfo samplerInfo = vkinit::samplerCreateInfo(VK_FILTER_NEAREST);
+
+    vkCreateSampler(_device, &samplerInfo, nullptr, &_textureSampler);
+    _mainDeletionQueue.push_function([=]() {
+        vkDestroySampler(_device, _textureSampler, nullptr);
+    });
+
     RenderObject monkey;
     monkey.mesh = getMesh("bunny");
     monkey.material = getMaterial("defaultmesh");
@@ -670,34 +2044,49 @@ void VulkanEngine::initScene() {
 
     _renderables.push_back(monkey);
 
-    RenderObject map;
-    map.mesh = getMesh("lostEmpire");
-    map.material = getMaterial("texturedmesh");
-    map.transformMatrix = glm::translate(glm::vec3{ 5,-10,0 });
-
-    _renderables.push_back(map);
+    addMeshObjects("lostEmpire", getMaterial(_virtualTexturing ? "virtualtexturedmesh" : "texturedmesh"),
+                   glm::translate(glm::vec3{ 5,-10,0 }));
+    if (getMeshChunks("sceneObj")) {
+        //faces without a texture draw with the vertex colour material
+        addMeshObjects("sceneObj", getMaterial("defaultmesh"), glm::translate(glm::vec3{0, -10, -60}));
+    }
+    //the glTF nodes place their primitives relative to a spot on the other side of the level
+    for (const GlbObject &glbObject : _glbObjects) {
+        RenderObject object;
+        object.mesh = glbObject.mesh;
+        object.material = glbObject.texture.empty() ? MaterialHandle() : getTextureMaterial(glbObject.texture);
+        if (!object.material.valid()) {
+            object.material = getMaterial("defaultmesh");
+        }
+        object.transformMatrix = glm::translate(glm::vec3{0, -10, 60}) * glbObject.transform;
+        _renderables.push_back(object);
+    }
 
+    //the triangles hang off one grid node, moving it moves all of them
+    uint32_t gridNode = _sceneGraph.createNode();
     for (int x = -20; x <= 20; x++) {
         for (int y = -20; y <= 20; y++) {
 
             RenderObject tri;
             tri.mesh = getMesh("triangle");
             tri.material = getMaterial("defaultmesh");
-            glm::mat4 translation = glm::translate(glm::mat4{1.0}, glm::vec3(x, 0, y));
-            glm::mat4 scale = glm::scale(glm::mat4{1.0}, glm::vec3(0.2, 0.2, 0.2));
-            tri.transformMatrix = translation * scale;
+            tri.transformMatrix = glm::mat4{1.0f};
+            tri.transformNode = _sceneGraph.createNode(gridNode, glm::vec3(x, 0, y),
+                                                       glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.2f));
             _renderables.push_back(tri);
         }
     }
+    _sceneGraph.updateAll();
 
-    VkSamplerCreateInfo samplerInfo = vkinit::samplerCreateInfo(VK_FILTER_NEAREST);
-
-    VkSampler blockySampler;
-    vkCreateSampler(_device, &samplerInfo, nullptr, &blockySampler);
-
-
+    _sceneParameters.sunlightDirection = glm::vec4(glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f)), 0.35f);
+    _sceneParameters.sunlightColor = glm::vec4(1.0f, 0.95f, 0.85f, 0.6f);
+    initLights();
 
-    Material* texturedMat=	getMaterial("texturedmesh");
+    Material* texturedMat=	_materials.get(getMaterial("texturedmesh"));
+    //the level binds the virtual texture's set of the frame instead
+    if (_virtualTexturing) {
+        return;
+    }
 
     //allocate the descriptor set for single-texture to use on the material
     VkDescriptorSetAllocateInfo allocInfo = {};
@@ -707,11 +2096,17 @@ void VulkanEngine::initScene() {
     allocInfo.descriptorSetCount = 1;
     allocInfo.pSetLayouts = &_singleTextureSetLayout;
 
+    const Texture *empireDiffuse = _textures.get(_textures.find("empire_diffuse"));
+    if (!empireDiffuse) {
+        std::cout << "The level texture failed to load, it is drawn untextured" << std::endl;
+        return;
+    }
     vkAllocateDescriptorSets(_device, &allocInfo, &texturedMat->textureSet);
+    texturedMat->textureResidencyId = empireDiffuse->residencyId;
 
     VkDescriptorImageInfo imageBufferInfo;
-    imageBufferInfo.sampler = blockySampler;
-    imageBufferInfo.imageView = _loadedTextures["empire_diffuse"].imageView;
+    imageBufferInfo.sampler = _textureSampler;
+    imageBufferInfo.imageView = empireDiffuse->imageView;
     imageBufferInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
     VkWriteDescriptorSet texture1 = vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texturedMat->textureSet, &imageBufferInfo, 0);
@@ -719,11 +2114,19 @@ void VulkanEngine::initScene() {
     vkUpdateDescriptorSets(_device, 1, &texture1, 0, nullptr);
 }
 
-void VulkanEngine::drawObjects(VkCommandBuffer cmd, RenderObject *first, int count) {
+bool VulkanEngine::prepareObjects(RenderObject *first, int count) {
+    CPU_ZONE("prepareObjects");
 
+    const float nearPlane = 0.1f;
+    const float farPlane = 200.0f;
+    const float fovY = glm::radians(70.f);
+    const float aspect = 1700.f / 900.f;
     glm::mat4 view = glm::lookAt(_cameraPos, _cameraPos + _cameraFront, _cameraUp);
-    glm::mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, 200.0f);
+    glm::mat4 projection = glm::perspective(fovY, aspect, nearPlane, farPlane);
     projection[1][1] *= -1;
+    //pixels covered by one unit at distance one, turns LOD errors into screen-space errors
+    //detail levels follow the pixels actually rendered, a lower resolution picks coarser ones
+    float projectionScale = _renderExtent.height / (2.0f * tanf(fovY * 0.5f));
 
 
     GPUCameraData camData;
@@ -731,69 +2134,409 @@ void VulkanEngine::drawObjects(VkCommandBuffer cmd, RenderObject *first, int cou
     camData.view = view;
     camData.viewproj = projection * view;
 
-    void *data;
-    vmaMapMemory(_allocator, getCurrentFrame().cameraBuffer._allocation, &data);
-
-    memcpy(data, &camData, sizeof(GPUCameraData));
-
-    vmaUnmapMemory(_allocator, getCurrentFrame().cameraBuffer._allocation);
-
-
     float framed = (_frameNumber / 120.f);
 
     _sceneParameters.ambientColor = {sin(framed), 0, cos(framed), 1};
 
-    char *sceneData;
-    vmaMapMemory(_allocator, _sceneParameterBuffer._allocation, (void **) &sceneData);
-
-    int frameIndex = _frameNumber % FRAME_OVERLAP;
-
-    sceneData += padUniformBufferSize(sizeof(GPUSceneData)) * frameIndex;
-
-    memcpy(sceneData, &_sceneParameters, sizeof(GPUSceneData));
-
-    vmaUnmapMemory(_allocator, _sceneParameterBuffer._allocation);
+    updateLights();
+    GPUClusterData clusterData = _clusteredLighting.makeClusterData(view, projection, nearPlane, farPlane,
+                                                                    _renderExtent, (uint32_t) _lights.size());
 
     void *objectData;
     vmaMapMemory(_allocator, getCurrentFrame().objectBuffer._allocation, &objectData);
-    GPUObjectData *objectSSBO = (GPUObjectData *) objectData;
+    packObjectData(first, count, _sceneGraph, (GPUObjectData *) objectData);
+    vmaUnmapMemory(_allocator, getCurrentFrame().objectBuffer._allocation);
 
+    _objectBounds.resize(count);
     for (int i = 0; i < count; i++) {
         RenderObject &object = first[i];
-        objectSSBO[i].modelMatrix = object.transformMatrix;
+        const Mesh &mesh = *_meshes.get(object.mesh);
+        const glm::mat4 &model = objectMatrix(object, _sceneGraph);
+        object.lodLevel = selectLod(mesh, model, _cameraPos, projectionScale, _config.lodErrorPixels,
+                                    object.lodLevel);
+        glm::vec4 sphere = transformSphere(mesh._boundsCenter, mesh._boundsRadius, model);
+        _objectBounds[i] = Aabb::fromSphere(glm::vec3(sphere), sphere.w);
+        if (_occlusionCulling) {
+            MeshLod lod = mesh.getLod(object.lodLevel);
+            _occlusionCuller.setObject(i, sphere, lod.vertexCount, lod.firstVertex);
+        }
+    }
+    updateObjectBvh();
+
+    //the cull shader tests the same frustum with the spheres inside these boxes, so it never draws an object the
+    //query missed. objects outside the list keep their commands and their visibility, they are just never drawn
+    _drawList.clear();
+    _objectBvh.queryFrustum(Frustum::fromViewProjection(camData.viewproj), _drawList);
+    //back into _renderables order, which groups materials and vertex buffers
+    std::sort(_drawList.begin(), _drawList.end());
+
+    //the scene data carries the shadow cascades, it can only go up once they are fitted
+    prepareShadows(view, fovY, aspect, nearPlane);
+    makeResident(_drawList);
+    for (uint32_t cascade = 0; cascade < SHADOW_CASCADE_COUNT; cascade++) {
+        for (uint32_t layer = 0; layer < SHADOW_LAYER_COUNT; layer++) {
+            makeResident(_shadowCasters[cascade][layer]);
+        }
+    }
+    if (!_frameAllocator.pushUniform(camData, _globalOffsets[0]) ||
+        !_frameAllocator.pushUniform(_sceneParameters, _globalOffsets[1]) ||
+        !_frameAllocator.pushUniform(clusterData, _globalOffsets[2])) {
+        return false;
     }
-    vmaUnmapMemory(_allocator, getCurrentFrame().objectBuffer._allocation);
 
-    Mesh *lastMesh = nullptr;
-    Material *lastMaterial = nullptr;
-    for (int i = 0; i < count; i++) {
-        RenderObject &object = first[i];
+    if (_occlusionCulling) {
+        glm::vec2 viewportScale((float) _renderExtent.width / _windowExtent.width,
+                                (float) _renderExtent.height / _windowExtent.height);
+        GPUCullData cullData = _occlusionCuller.makeCullData(view, projection, nearPlane, count, viewportScale);
+        if (!_frameAllocator.pushUniform(cullData, _cullDataOffset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void VulkanEngine::prepareShadows(const glm::mat4 &view, float fovY, float aspect, float znear) {
+    CPU_ZONE("prepareShadows");
+    if (!_shadowsReady) {
+        //every fragment lies past the last cascade, which the shaders treat as lit
+        _sceneParameters.cascadeSplits = glm::vec4(0.0f);
+        _sceneParameters.cascadeDynamic = glm::vec4(0.0f);
+        return;
+    }
+
+    //the root covers every renderable, the cascades' depth ranges have to hold all of them
+    Aabb casterBounds = _objectBvh.nodes().empty() ? Aabb() : _objectBvh.nodes()[0].bounds;
+    _shadows.update(view, fovY, aspect, znear, glm::vec3(_sceneParameters.sunlightDirection), casterBounds,
+                    _sceneParameters);
+
+    for (uint32_t cascade = 0; cascade < SHADOW_CASCADE_COUNT; cascade++) {
+        std::vector<uint32_t> &staticCasters = _shadowCasters[cascade][SHADOW_LAYER_STATIC];
+        std::vector<uint32_t> &dynamicCasters = _shadowCasters[cascade][SHADOW_LAYER_DYNAMIC];
+        staticCasters.clear();
+        dynamicCasters.clear();
+
+        _shadowQuery.clear();
+        _objectBvh.queryFrustum(_shadows.cascadeFrustum(cascade), _shadowQuery);
+        //_renderables order groups the position buffers
+        std::sort(_shadowQuery.begin(), _shadowQuery.end());
+
+        bool staticStale = _shadows.staticLayerStale(cascade);
+        for (uint32_t i : _shadowQuery) {
+            if (!isStaticObject(_renderables[i])) {
+                dynamicCasters.push_back(i);
+            } else if (staticStale) {
+                staticCasters.push_back(i);
+            }
+        }
+        _shadows.setDynamicCasters(cascade, !dynamicCasters.empty(), _sceneParameters);
+    }
+}
+
+void VulkanEngine::drawShadows(VkCommandBuffer cmd) {
+    CPU_ZONE("drawShadows");
+    if (!_shadowsReady) {
+        return;
+    }
+    for (uint32_t cascade = 0; cascade < SHADOW_CASCADE_COUNT; cascade++) {
+        //an empty static layer still has to be cleared once
+        if (_shadows.staticLayerStale(cascade)) {
+            GpuProfileScope staticScope(_gpuProfiler, cmd, _shadowStaticScope, true);
+            _shadows.beginLayer(cmd, cascade, SHADOW_LAYER_STATIC);
+            drawShadowCasters(cmd, _shadowCasters[cascade][SHADOW_LAYER_STATIC], cascade);
+            _shadows.endLayer(cmd);
+        }
+        //without casters the shaders ignore the layer, so it needs no clear either
+        if (!_shadowCasters[cascade][SHADOW_LAYER_DYNAMIC].empty()) {
+            GpuProfileScope dynamicScope(_gpuProfiler, cmd, _shadowDynamicScope, true);
+            _shadows.beginLayer(cmd, cascade, SHADOW_LAYER_DYNAMIC);
+            drawShadowCasters(cmd, _shadowCasters[cascade][SHADOW_LAYER_DYNAMIC], cascade);
+            _shadows.endLayer(cmd);
+        }
+    }
+}
+
+void VulkanEngine::drawShadowCasters(VkCommandBuffer cmd, const std::vector<uint32_t> &casters, uint32_t cascade) {
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _shadows.pipelineLayout(), 0, 1,
+                            &getCurrentFrame().objectDescriptor, 0, nullptr);
+
+    float maxError = _shadows.texelSize(cascade);
+    VkBuffer lastPositionBuffer = VK_NULL_HANDLE;
+    for (uint32_t i : casters) {
+        const RenderObject &object = _renderables[i];
+        const Mesh &mesh = *_meshes.get(object.mesh);
+        _residency.touch(mesh._residencyId, _frameNumber);
+        if (mesh._positionBuffer._buffer != lastPositionBuffer) {
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(cmd, 0, 1, &mesh._positionBuffer._buffer, &offset);
+            lastPositionBuffer = mesh._positionBuffer._buffer;
+        }
+        MeshLod lod = mesh.getLod(selectShadowLod(mesh, objectMatrix(object, _sceneGraph), maxError));
+        vkCmdDraw(cmd, lod.vertexCount, 1, lod.firstVertex, i);
+    }
+}
+
+void VulkanEngine::updateObjectBvh() {
+    CPU_ZONE("updateObjectBvh");
+    if (_objectBvh.itemCount() == _objectBounds.size()) {
+        _objectBvh.refit(_objectBounds);
+        if (!_objectBvh.needsRebuild()) {
+            return;
+        }
+    }
+    _objectBvh.build(_objectBounds);
+    _bvhRebuilds++;
+}
+
+void VulkanEngine::drawObjects(VkCommandBuffer cmd, RenderObject *objects, const std::vector<uint32_t> &drawList,
+                               VkBuffer indirectBuffer, VkDeviceSize indirectOffset) {
+    CPU_ZONE("drawObjects");
+
+    //materials without an EQUAL variant still draw correctly with their regular pipeline, they just shade overdraw
+    bool afterPrepass = _depthPrepass;
+
+    //the materials of a --scene-obj share the pipelines and scopes of texturedmesh, switching between them only
+    //binds another texture set
+    VkBuffer lastVertexBuffer = VK_NULL_HANDLE;
+    MaterialHandle lastMaterial;
+    uint32_t lastScope = ~0u;
+    VkPipeline lastPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout lastLayout = VK_NULL_HANDLE;
+    VkDescriptorSet lastTextureSet = VK_NULL_HANDLE;
+    for (uint32_t i : drawList) {
+        RenderObject &object = objects[i];
+        const Mesh *mesh = _meshes.get(object.mesh);
+        const Material *material = _materials.get(object.material);
+        _residency.touch(mesh->_residencyId, _frameNumber);
+        _residency.touch(material->textureResidencyId, _frameNumber);
         if (object.material != lastMaterial) {
-            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipeline);
+            uint32_t scope = afterPrepass ? material->prepassProfileScope : material->profileScope;
+            if (scope != lastScope) {
+                if (lastMaterial.valid()) {
+                    _gpuProfiler.endScope(cmd);
+                }
+                _gpuProfiler.beginScope(cmd, scope, true);
+                lastScope = scope;
+            }
+            bool usePrepassPipeline = afterPrepass && material->prepassPipeline != VK_NULL_HANDLE;
+            VkPipeline pipeline = usePrepassPipeline ? material->prepassPipeline : material->pipeline;
+            if (pipeline != lastPipeline) {
+                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                lastPipeline = pipeline;
+            }
             lastMaterial = object.material;
-            uint32_t uniformOffset = padUniformBufferSize(sizeof(GPUSceneData)) * frameIndex;
-            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 0, 1,
-                                    &getCurrentFrame().globalDescriptor, 1, &uniformOffset);
-
-            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 1, 1, &getCurrentFrame().objectDescriptor, 0, nullptr);
+            if (material->pipelineLayout != lastLayout) {
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 0, 1,
+                                        &getCurrentFrame().globalDescriptor, 3, _globalOffsets);
+
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 1, 1, &getCurrentFrame().objectDescriptor, 0, nullptr);
+                lastLayout = material->pipelineLayout;
+                lastTextureSet = VK_NULL_HANDLE;
+            }
         }
 
         MeshPushConstants constants;
-        constants.renderMatrix = object.transformMatrix;
-        vkCmdPushConstants(cmd, object.material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+        constants.renderMatrix = objectMatrix(object, _sceneGraph);
+        vkCmdPushConstants(cmd, material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
                            sizeof(MeshPushConstants), &constants);
 
-        if (object.mesh != lastMesh) {
+        //the chunks of a split mesh share one buffer
+        if (mesh->_vertexBuffer._buffer != lastVertexBuffer) {
             VkDeviceSize offset = 0;
-            vkCmdBindVertexBuffers(cmd, 0, 1, &object.mesh->_vertexBuffer._buffer, &offset);
-            lastMesh = object.mesh;
+            vkCmdBindVertexBuffers(cmd, 0, 1, &mesh->_vertexBuffer._buffer, &offset);
+            lastVertexBuffer = mesh->_vertexBuffer._buffer;
         }
 
-        if (object.material->textureSet != VK_NULL_HANDLE) {
-            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 2, 1, &object.material->textureSet, 0, nullptr);
+        VkDescriptorSet textureSet = material->virtualTexture
+                                     ? _virtualTexture.descriptor(getCurrentFrameIndex())
+                                     : material->textureSet;
+        if (textureSet != VK_NULL_HANDLE && textureSet != lastTextureSet) {
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 2, 1, &textureSet, 0, nullptr);
+            lastTextureSet = textureSet;
+        }
+        drawObject(cmd, object, i, indirectBuffer, indirectOffset);
+    }
+    if (lastMaterial.valid()) {
+        _gpuProfiler.endScope(cmd);
+    }
+}
 
+void VulkanEngine::drawDepthPrepass(VkCommandBuffer cmd, RenderObject *objects, const std::vector<uint32_t> &drawList,
+                                    VkBuffer indirectBuffer, VkDeviceSize indirectOffset) {
+    CPU_ZONE("drawDepthPrepass");
+    GpuProfileScope prepassScope(_gpuProfiler, cmd, _depthPrepassScope, true);
+
+    //one pipeline for every material, only the vertex stream changes between meshes
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _depthPrepassPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _depthPrepassLayout, 0, 1,
+                            &getCurrentFrame().globalDescriptor, 3, _globalOffsets);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _depthPrepassLayout, 1, 1,
+                            &getCurrentFrame().objectDescriptor, 0, nullptr);
+
+    VkBuffer lastPositionBuffer = VK_NULL_HANDLE;
+    for (uint32_t i : drawList) {
+        RenderObject &object = objects[i];
+        const Mesh *mesh = _meshes.get(object.mesh);
+        if (mesh->_positionBuffer._buffer != lastPositionBuffer) {
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(cmd, 0, 1, &mesh->_positionBuffer._buffer, &offset);
+            lastPositionBuffer = mesh->_positionBuffer._buffer;
         }
-        vkCmdDraw(cmd, object.mesh->_vertices.size(), 1, 0, i);
+        drawObject(cmd, object, i, indirectBuffer, indirectOffset);
+    }
+}
+
+void VulkanEngine::drawScene(VkCommandBuffer cmd, RenderObject *objects, const std::vector<uint32_t> &drawList,
+                             VkBuffer indirectBuffer, VkDeviceSize indirectOffset) {
+    if (_depthPrepass) {
+        drawDepthPrepass(cmd, objects, drawList, indirectBuffer, indirectOffset);
+    }
+    drawObjects(cmd, objects, drawList, indirectBuffer, indirectOffset);
+}
+
+void VulkanEngine::updateRenderScale() {
+    int64_t resolvedFrame = _gpuProfiler.lastResolvedFrame();
+    if (resolvedFrame > _lastScaleSampleFrame) {
+        _lastScaleSampleFrame = resolvedFrame;
+        if (resolvedFrame >= _resolutionChangeFrame &&
+            _resolutionController.addSample(_gpuProfiler.lastMilliseconds(_frameScope))) {
+            _resolutionChangeFrame = _frameNumber;
+        }
+    }
+
+    float scale = _resolutionController.scale();
+    _renderExtent.width = std::max(1u, (uint32_t) roundf(_windowExtent.width * scale));
+    _renderExtent.height = std::max(1u, (uint32_t) roundf(_windowExtent.height * scale));
+}
+
+void VulkanEngine::setRenderViewport(VkCommandBuffer cmd) {
+    VkViewport viewport = {0.0f, 0.0f, (float) _renderExtent.width, (float) _renderExtent.height, 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, _renderExtent};
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+void VulkanEngine::drawUpscale(VkCommandBuffer cmd, uint32_t swapchainImageIndex) {
+    GpuProfileScope upscaleScope(_gpuProfiler, cmd, _upscaleScope);
+    if (!_upscaleReady) {
+        copySceneColor(cmd, swapchainImageIndex);
+        return;
+    }
+
+    VkRenderPassBeginInfo rpInfo = {};
+    rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rpInfo.pNext = nullptr;
+    rpInfo.renderPass = _upscaleRenderPass;
+    rpInfo.renderArea.offset = {0, 0};
+    rpInfo.renderArea.extent = _windowExtent;
+    rpInfo.framebuffer = _frameBuffers[swapchainImageIndex];
+    rpInfo.clearValueCount = 0;
+    vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    UpscalePushConstants constants;
+    constants.renderScale = glm::vec2((float) _renderExtent.width / _windowExtent.width,
+                                      (float) _renderExtent.height / _windowExtent.height);
+    constants.texelSize = 1.0f / glm::vec2(_windowExtent.width, _windowExtent.height);
+    constants.filterMode = (uint32_t) _config.upscaleFilter;
+    constants.sharpness = UPSCALE_SHARPNESS;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _upscalePipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _upscaleLayout, 0, 1, &_upscaleDescriptor, 0,
+                            nullptr);
+    vkCmdPushConstants(cmd, _upscaleLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(UpscalePushConstants),
+                       &constants);
+    vkCmdDraw(cmd, 3, 1, 0, 0);
+    vkCmdEndRenderPass(cmd);
+}
+
+void VulkanEngine::copySceneColor(VkCommandBuffer cmd, uint32_t swapchainImageIndex) {
+    //the render scale stays at 1 without the upscale pass, so the scene target matches the swapchain image
+    VkImageMemoryBarrier barriers[2] = {};
+    for (VkImageMemoryBarrier &barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+    }
+    barriers[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].image = _sceneColorImage._image;
+    //waits on the acquire semaphore through the colour output stage, like the upscale pass would
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].image = _swapchainImages[swapchainImageIndex];
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                         nullptr, 0, nullptr, 2, barriers);
+
+    VkImageCopy region = {};
+    region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.extent = {_windowExtent.width, _windowExtent.height, 1};
+    vkCmdCopyImage(cmd, _sceneColorImage._image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   _swapchainImages[swapchainImageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    //the layout the upscale render pass would have left the image in
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = 0;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = _config.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &barriers[1]);
+}
+
+void VulkanEngine::drawObject(VkCommandBuffer cmd, const RenderObject &object, uint32_t index,
+                              VkBuffer indirectBuffer, VkDeviceSize indirectOffset) {
+    if (indirectBuffer != VK_NULL_HANDLE) {
+        //the cull shader set the instance count to 0 or 1
+        vkCmdDrawIndirect(cmd, indirectBuffer, indirectOffset + index * sizeof(VkDrawIndirectCommand), 1,
+                          sizeof(VkDrawIndirectCommand));
+    } else {
+        MeshLod lod = _meshes.get(object.mesh)->getLod(object.lodLevel);
+        vkCmdDraw(cmd, lod.vertexCount, 1, lod.firstVertex, index);
+    }
+}
+
+void VulkanEngine::reportDepthPrepass() {
+    //material scopes are split by mode, compare the fragment shader invocations of both
+    double withPrepass = 0.0;
+    double withoutPrepass = 0.0;
+    bool measuredWith = false;
+    bool measuredWithout = false;
+    const std::vector<GpuScopeHistory> &scopes = _gpuProfiler.getScopes();
+    //the texture materials share the scopes of texturedmesh, each scope may only count once
+    std::vector<bool> counted(scopes.size(), false);
+    _materials.forEach([&](MaterialHandle, const Material &material) {
+        if (!counted[material.profileScope]) {
+            counted[material.profileScope] = true;
+            const GpuScopeHistory &direct = scopes[material.profileScope];
+            if (direct.hasStatistics) {
+                withoutPrepass += direct.statistics[FRAGMENT_SHADER_INVOCATIONS].average();
+                measuredWithout = true;
+            }
+        }
+        if (!counted[material.prepassProfileScope]) {
+            counted[material.prepassProfileScope] = true;
+            const GpuScopeHistory &prepass = scopes[material.prepassProfileScope];
+            if (prepass.hasStatistics) {
+                withPrepass += prepass.statistics[FRAGMENT_SHADER_INVOCATIONS].average();
+                measuredWith = true;
+            }
+        }
+    });
+
+    if (measuredWith && measuredWithout && withoutPrepass > 0.0) {
+        std::cout << "Depth pre-pass: " << withPrepass << " fragment shader invocations per frame instead of "
+                  << withoutPrepass << ", " << 100.0 * (1.0 - withPrepass / withoutPrepass) << "% saved"
+                  << std::endl;
+    } else if (measuredWith) {
+        std::cout << "Depth pre-pass: " << withPrepass << " fragment shader invocations per frame, run without "
+                  << "it (or press F2) to compare" << std::endl;
     }
 }
 
@@ -802,6 +2545,27 @@ void VulkanEngine::processInput(GLFWwindow *window) {
     if (glfwGetKey(_window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(_window, true);
 
+    bool traceKeyDown = glfwGetKey(_window, GLFW_KEY_F12) == GLFW_PRESS;
+    if (traceKeyDown && !_traceKeyDown) {
+        CPU_PROFILER_WRITE_TRACE(_config.cpuTraceOutput);
+    }
+    _traceKeyDown = traceKeyDown;
+
+    bool memoryStatsKeyDown = glfwGetKey(_window, GLFW_KEY_F3) == GLFW_PRESS;
+    if (memoryStatsKeyDown && !_memoryStatsKeyDown && !_config.memoryStatsOutput.empty()) {
+        if (_gpuMemory.writeStats(_config.memoryStatsOutput)) {
+            std::cout << "Memory stats written to " << _config.memoryStatsOutput << std::endl;
+        }
+    }
+    _memoryStatsKeyDown = memoryStatsKeyDown;
+
+    bool prepassKeyDown = glfwGetKey(_window, GLFW_KEY_F2) == GLFW_PRESS;
+    if (prepassKeyDown && !_prepassKeyDown) {
+        _depthPrepass = !_depthPrepass;
+        std::cout << "Depth pre-pass " << (_depthPrepass ? "on" : "off") << std::endl;
+    }
+    _prepassKeyDown = prepassKeyDown;
+
     float cameraSpeed = 2.5 * _deltaTime;
     if (glfwGetKey(_window, GLFW_KEY_W) == GLFW_PRESS)
         _cameraPos += cameraSpeed * _cameraFront;
@@ -839,57 +2603,66 @@ void VulkanEngine::calculationDirection() {
 }
 
 FrameData &VulkanEngine::getCurrentFrame() {
-    return _frames[_frameNumber % FRAME_OVERLAP];
+    return _frames[getCurrentFrameIndex()];
 }
 
-AllocatedBuffer VulkanEngine::createBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) {
-    VkBufferCreateInfo bufferInfo = {};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.pNext = nullptr;
-    bufferInfo.size = allocSize;
-    bufferInfo.usage = usage;
-
-    VmaAllocationCreateInfo vmaallocInfo = {};
-    vmaallocInfo.usage = memoryUsage;
-
-    AllocatedBuffer newBuffer;
+uint32_t VulkanEngine::getCurrentFrameIndex() const {
+    return _frameNumber % _config.framesInFlight;
+}
 
-    VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo,
-                             &newBuffer._buffer,
-                             &newBuffer._allocation,
-                             nullptr));
+void VulkanEngine::waitForTimeline(uint64_t value) {
+    VkSemaphoreWaitInfoKHR waitInfo = vkinit::semaphoreWaitInfo(&_frameTimeline, &value);
+    VK_CHECK(_vkWaitSemaphores(_device, &waitInfo, 1000000000));
+}
 
-    return newBuffer;
+AllocatedBuffer VulkanEngine::createBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+                                           MemoryCategory category) {
+    return _gpuMemory.createBuffer(allocSize, usage, memoryUsage, category);
 }
 
 void VulkanEngine::initDescriptors() {
     std::vector<VkDescriptorPoolSize> sizes =
             {
                     {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10},
-                    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10},
-                    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10},
-                    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10 }
+                    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 16},
+                    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 32},
+                    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 20 + MAX_TEXTURE_MATERIALS }
             };
 
     VkDescriptorPoolCreateInfo pool_info = {};
     pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     pool_info.flags = 0;
-    pool_info.maxSets = 10;
+    pool_info.maxSets = 16 + MAX_TEXTURE_MATERIALS;
     pool_info.poolSizeCount = (uint32_t) sizes.size();
     pool_info.pPoolSizes = sizes.data();
 
     vkCreateDescriptorPool(_device, &pool_info, nullptr, &_descriptorPool);
 
     VkDescriptorSetLayoutBinding camBufferBinding = vkinit::descriptorSetLayoutBinding(
-            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0);
     VkDescriptorSetLayoutBinding sceneBind = vkinit::descriptorSetLayoutBinding(
             VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1);
-
-
-    VkDescriptorSetLayoutBinding bindings[] = {camBufferBinding, sceneBind};
+    //clustered point lights, see clustered_lights.glsl
+    VkDescriptorSetLayoutBinding clusterBind = vkinit::descriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT, 2);
+    VkDescriptorSetLayoutBinding lightsBind = vkinit::descriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3);
+    VkDescriptorSetLayoutBinding gridBind = vkinit::descriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4);
+    VkDescriptorSetLayoutBinding lightIndicesBind = vkinit::descriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5);
+
+    //static and dynamic layers of the sun shadow cascades, see cascaded_shadows.glsl
+    VkDescriptorSetLayoutBinding staticShadowBind = vkinit::descriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 6);
+    VkDescriptorSetLayoutBinding dynamicShadowBind = vkinit::descriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 7);
+
+    VkDescriptorSetLayoutBinding bindings[] = {camBufferBinding, sceneBind, clusterBind, lightsBind, gridBind,
+                                               lightIndicesBind, staticShadowBind, dynamicShadowBind};
 
     VkDescriptorSetLayoutCreateInfo setInfo = {};
-    setInfo.bindingCount = 2;
+    setInfo.bindingCount = 8;
     setInfo.flags = 0;
     setInfo.pNext = nullptr;
     setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -920,17 +2693,19 @@ void VulkanEngine::initDescriptors() {
 
     vkCreateDescriptorSetLayout(_device, &set2info, nullptr, &_objectSetLayout);
 
-    const size_t sceneParamBufferSize = FRAME_OVERLAP * padUniformBufferSize(sizeof(GPUSceneData));
-
-    _sceneParameterBuffer = createBuffer(sceneParamBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                         VMA_MEMORY_USAGE_CPU_TO_GPU);
+    //exactly what prepareObjects pushes, every uniform on its own aligned offset. the objects and lights have buffers
+    //of their own sized for MAX_OBJECTS and MAX_LIGHTS, so nothing here grows with the scene and a frame always fits
+    size_t uniformAlignment = std::max<size_t>(1, _gpuProperties.limits.minUniformBufferOffsetAlignment);
+    auto uniformBytes = [=](size_t size) {
+        return (size + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+    };
+    size_t frameRingBytes = uniformBytes(sizeof(GPUCameraData)) + uniformBytes(sizeof(GPUSceneData)) +
+                            uniformBytes(sizeof(GPUClusterData)) + uniformBytes(sizeof(GPUCullData));
+    _frameAllocator.init(_allocator, _gpuMemory, _gpuProperties.limits, frameRingBytes, _config.framesInFlight);
 
-    for (int i = 0; i < FRAME_OVERLAP; i++) {
-        const int MAX_OBJECTS = 10000;
+    for (int i = 0; i < _config.framesInFlight; i++) {
         _frames[i].objectBuffer = createBuffer(sizeof(GPUObjectData) * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                               VMA_MEMORY_USAGE_CPU_TO_GPU);
-        _frames[i].cameraBuffer = createBuffer(sizeof(GPUCameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                               VMA_MEMORY_USAGE_CPU_TO_GPU);
+                                               VMA_MEMORY_USAGE_CPU_TO_GPU, MEMORY_FRAME_DATA);
 
         VkDescriptorSetAllocateInfo allocInfo = {};
         allocInfo.pNext = nullptr;
@@ -951,60 +2726,58 @@ void VulkanEngine::initDescriptors() {
 
 
         VkDescriptorBufferInfo cameraInfo;
-        cameraInfo.buffer = _frames[i].cameraBuffer._buffer;
+        cameraInfo.buffer = _frameAllocator.buffer();
         cameraInfo.offset = 0;
         cameraInfo.range = sizeof(GPUCameraData);
 
         VkDescriptorBufferInfo sceneInfo;
-        sceneInfo.buffer = _sceneParameterBuffer._buffer;
+        sceneInfo.buffer = _frameAllocator.buffer();
         sceneInfo.offset = 0;
         sceneInfo.range = sizeof(GPUSceneData);
 
+        VkDescriptorBufferInfo clusterInfo;
+        clusterInfo.buffer = _frameAllocator.buffer();
+        clusterInfo.offset = 0;
+        clusterInfo.range = sizeof(GPUClusterData);
+
         VkDescriptorBufferInfo objectBufferInfo;
         objectBufferInfo.buffer = _frames[i].objectBuffer._buffer;
         objectBufferInfo.offset = 0;
         objectBufferInfo.range = sizeof(GPUObjectData) * MAX_OBJECTS;
 
-        VkWriteDescriptorSet cameraWrite = vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        VkWriteDescriptorSet cameraWrite = vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                                                                          _frames[i].globalDescriptor, &cameraInfo, 0);
 
         VkWriteDescriptorSet sceneWrite = vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                                                                         _frames[i].globalDescriptor, &sceneInfo, 1);
+        VkWriteDescriptorSet clusterWrite = vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                                                                          _frames[i].globalDescriptor, &clusterInfo, 2);
         VkWriteDescriptorSet objectWrite = vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                                                                          _frames[i].objectDescriptor,
                                                                          &objectBufferInfo, 0);
 
-        VkWriteDescriptorSet setWrites[] = {cameraWrite, sceneWrite, objectWrite};
+        VkWriteDescriptorSet setWrites[] = {cameraWrite, sceneWrite, clusterWrite, objectWrite};
 
-        vkUpdateDescriptorSets(_device, 3, setWrites, 0, nullptr);
+        vkUpdateDescriptorSets(_device, 4, setWrites, 0, nullptr);
     }
 
     _mainDeletionQueue.push_function([&]() {
 
-        vmaDestroyBuffer(_allocator, _sceneParameterBuffer._buffer, _sceneParameterBuffer._allocation);
+        _frameAllocator.cleanup();
         vkDestroyDescriptorSetLayout(_device, _objectSetLayout, nullptr);
         vkDestroyDescriptorSetLayout(_device, _globalSetLayout, nullptr);
 
         vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
 
-        for (int i = 0; i < FRAME_OVERLAP; i++) {
-            vmaDestroyBuffer(_allocator, _frames[i].cameraBuffer._buffer, _frames[i].cameraBuffer._allocation);
-            vmaDestroyBuffer(_allocator, _frames[i].objectBuffer._buffer, _frames[i].objectBuffer._allocation);
+        for (int i = 0; i < _config.framesInFlight; i++) {
+            _gpuMemory.destroyBuffer(_frames[i].objectBuffer);
         }
     });
 
 }
 
-size_t VulkanEngine::padUniformBufferSize(size_t originalSize) {
-    size_t minUboAlignment = _gpuProperties.limits.minUniformBufferOffsetAlignment;
-    size_t alignedSize = originalSize;
-    if (minUboAlignment > 0) {
-        alignedSize = (alignedSize + minUboAlignment - 1) & ~(minUboAlignment - 1);
-    }
-    return alignedSize;
-}
-
 void VulkanEngine::immediateSubmit(std::function<void(VkCommandBuffer)> &&function) {
+    CPU_ZONE("immediateSubmit");
     VkCommandBuffer cmd = _uploadContext._commandBuffer;
     VkCommandBufferBeginInfo cmdBeginInfo = vkinit::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
     VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
@@ -1019,16 +2792,95 @@ void VulkanEngine::immediateSubmit(std::function<void(VkCommandBuffer)> &&functi
 }
 
 void VulkanEngine::loadImages() {
-    Texture lostEmpire;
+    CPU_ZONE("loadImages");
+    //whatever the residency manager left of the textures, including those loaded with the scene later
+    _mainDeletionQueue.push_function([=]() {
+        _textures.forEach([&](TextureHandle, Texture &texture) {
+            if (_residency.resident(texture.residencyId)) {
+                vkDestroyImageView(_device, texture.imageView, nullptr);
+                _gpuMemory.destroyImage(texture.image);
+            }
+        });
+        if (_fallbackTextureView != VK_NULL_HANDLE) {
+            vkDestroyImageView(_device, _fallbackTextureView, nullptr);
+            _gpuMemory.destroyImage(_fallbackTexture);
+        }
+    });
+
+    //the virtual texture streams its pages instead
+    if (_virtualTexturing) {
+        return;
+    }
+    loadTexture("empire_diffuse", LOST_EMPIRE_TEXTURE);
+}
 
-    vkutil::loadImageFromFile(*this, "../assets/lost-empire/lost_empire-RGBA.png", lostEmpire.image);
+bool VulkanEngine::loadTexture(const std::string &name, const std::string &path, ResidentAssetType type,
+                               uint32_t image) {
+    AllocatedImage allocatedImage;
+    if (!decodeTexture(type, path, image, allocatedImage)) {
+        return false;
+    }
+    addTexture(name, path, type, image, allocatedImage);
+    return true;
+}
 
-    VkImageViewCreateInfo imageinfo = vkinit::imageviewCreateInfo(VK_FORMAT_R8G8B8A8_SRGB, lostEmpire.image._image, VK_IMAGE_ASPECT_COLOR_BIT);
-    vkCreateImageView(_device, &imageinfo, nullptr, &lostEmpire.imageView);
+void VulkanEngine::loadTextures(const std::vector<std::string> &paths) {
+    CPU_ZONE("loadTextures");
+    std::vector<std::string> files;
+    for (const std::string &path : paths) {
+        if (path.empty() || _textures.find(path).valid() ||
+            std::find(files.begin(), files.end(), path) != files.end()) {
+            continue;
+        }
+        if (_archive.mounted() && _archive.find(path)) {
+            loadTexture(path, path);
+        } else {
+            files.push_back(path);
+        }
+    }
 
-    _mainDeletionQueue.push_function([=]() {
-        vkDestroyImageView(_device, lostEmpire.imageView, nullptr);
-    });
+    auto start = std::chrono::steady_clock::now();
+    std::vector<AllocatedImage> images;
+    vkutil::loadImagesFromFiles(*this, files, _config.textureThreads, images);
+    for (size_t i = 0; i < files.size(); i++) {
+        if (images[i]._image != VK_NULL_HANDLE) {
+            addTexture(files[i], files[i], RESIDENT_TEXTURE, 0, images[i]);
+        }
+    }
+    if (!files.empty()) {
+        std::cout << "Loaded " << files.size() << " textures in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                  << " ms" << std::endl;
+    }
+}
+
+void VulkanEngine::addTexture(const std::string &name, const std::string &path, ResidentAssetType type,
+                              uint32_t image, const AllocatedImage &allocatedImage) {
+    Texture texture;
+    texture.image = allocatedImage;
 
-    _loadedTextures["empire_diffuse"] = lostEmpire;
+    VkImageViewCreateInfo imageinfo = vkinit::imageviewCreateInfo(VK_FORMAT_R8G8B8A8_SRGB, texture.image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+    vkCreateImageView(_device, &imageinfo, nullptr, &texture.imageView);
+
+    TextureHandle handle = _textures.add(name, texture);
+    VmaAllocationInfo allocationInfo;
+    vmaGetAllocationInfo(_allocator, texture.image._allocation, &allocationInfo);
+    _textures.get(handle)->residencyId = addResidentAsset(type, name, path, allocationInfo.size, image,
+                                                          handle.value);
+}
+
+bool VulkanEngine::decodeTexture(ResidentAssetType type, const std::string &path, uint32_t image,
+                                 AllocatedImage &outImage) {
+    if (type != RESIDENT_GLB_TEXTURE) {
+        //archived textures are decoded already, their texels go straight into staging memory
+        const ArchiveEntry *entry = _archive.mounted() ? _archive.find(path) : nullptr;
+        if (entry && entry->type == ARCHIVE_TEXTURE) {
+            return vkutil::loadImageFromArchive(*this, _archive, *entry, outImage);
+        }
+        return vkutil::loadImageFromFile(*this, path.c_str(), outImage);
+    }
+    //straight from the mapped file, the encoded image is never copied
+    size_t size = 0;
+    const uint8_t *data = _glbFiles[path].imageData(image, size);
+    return data && vkutil::loadImageFromMemory(*this, data, size, outImage);
 }
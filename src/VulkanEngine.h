@@ -9,19 +9,21 @@
 #include "deletion_queue.h"
 #include "vk_types.h"
 #include "vk_mesh.h"
-
-struct Material {
-    VkDescriptorSet textureSet{VK_NULL_HANDLE};
-    VkPipeline pipeline;
-    VkPipelineLayout pipelineLayout;
-};
-
-struct RenderObject {
-    Mesh *mesh;
-    Material *material;
-    glm::mat4 transformMatrix;
-};
-constexpr unsigned int FRAME_OVERLAP = 2;
+#include "render_object.h"
+#include "engine_config.h"
+#include "vk_profiler.h"
+#include "vk_deferred_destruction.h"
+#include "bvh.h"
+#include "vk_lighting.h"
+#include "vk_shadows.h"
+#include "vk_ring_buffer.h"
+#include "vk_occlusion.h"
+#include "resolution_controller.h"
+#include "vk_memory.h"
+#include "residency.h"
+#include "vk_virtual_texture.h"
+#include "glb_loader.h"
+#include "asset_archive.h"
 
 class VulkanEngine {
 public:
@@ -34,23 +36,33 @@ public:
 
     void immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function);
 
-    AllocatedBuffer createBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+    //release with _gpuMemory.destroyBuffer
+    AllocatedBuffer createBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+                                 MemoryCategory category);
 
     VmaAllocator _allocator;
 
+    //allocation categories, heap budgets and defragmentation on top of _allocator
+    GpuMemory _gpuMemory;
+
     deletion_queue _mainDeletionQueue;
 
+    //for resources released while frames are in flight, _mainDeletionQueue only runs at cleanup
+    DeferredDestructionQueue _deferredDestruction;
+
+    EngineConfig _config;
+
 private:
     VkExtent2D _windowExtent{800, 600};
 
     UploadContext _uploadContext;
 
-    GLFWwindow *_window;
+    GLFWwindow *_window = nullptr;
     VkInstance _instance;
     VkDebugUtilsMessengerEXT _debugMessenger;
     VkPhysicalDevice _chosenGPU;
     VkDevice _device;
-    VkSurfaceKHR _surface;
+    VkSurfaceKHR _surface = VK_NULL_HANDLE;
 
     VkPhysicalDeviceProperties _gpuProperties;
 
@@ -59,14 +71,49 @@ private:
     std::vector<VkImage> _swapchainImages;
     std::vector<VkImageView> _swapchainImageViews;
 
+    //headless mode renders into one of these per frame in flight instead of swapchain images
+    std::vector<AllocatedImage> _offscreenImages;
+
     VkQueue _graphicsQueue;
     uint32_t _graphicsQueueFamily;
 
-    FrameData _frames[FRAME_OVERLAP];
+    FrameData _frames[MAX_FRAMES_IN_FLIGHT];
+
+    VkSemaphore _frameTimeline;
+    uint64_t _frameTimelineValue = 0;
+    PFN_vkWaitSemaphoresKHR _vkWaitSemaphores;
+
+    GpuProfiler _gpuProfiler;
+    bool _pipelineStatisticsSupported = false;
+    uint32_t _frameScope;
+    uint32_t _mainPassScope;
 
     VkRenderPass _renderPass;
+    //occlusion culling splits the frame around the depth pyramid build, the early pass clears and the late one loads
+    VkRenderPass _earlyRenderPass = VK_NULL_HANDLE;
+    VkRenderPass _lateRenderPass = VK_NULL_HANDLE;
+    //the scene passes render into _sceneFramebuffer, the upscale pass into one of _frameBuffers per swapchain image
+    VkFramebuffer _sceneFramebuffer;
+    VkRenderPass _upscaleRenderPass;
     std::vector<VkFramebuffer> _frameBuffers;
 
+    //window sized, the scene covers _renderExtent of it
+    AllocatedImage _sceneColorImage;
+    VkImageView _sceneColorView;
+    VkExtent2D _renderExtent;
+    ResolutionController _resolutionController;
+    int64_t _lastScaleSampleFrame = -1;
+    //GPU times of frames recorded before the last scale change say nothing about the new one
+    int64_t _resolutionChangeFrame = 0;
+    VkDescriptorSetLayout _upscaleSetLayout;
+    VkDescriptorSet _upscaleDescriptor;
+    VkPipelineLayout _upscaleLayout;
+    VkPipeline _upscalePipeline = VK_NULL_HANDLE;
+    //false when the upscale shaders failed to load, the scene is then copied to the swapchain at scale 1
+    bool _upscaleReady = false;
+    VkSampler _upscaleSampler;
+    uint32_t _upscaleScope;
+
     VkImageView _depthImageView;
     AllocatedImage _depthImage;
     VkFormat _depthFormat;
@@ -77,13 +124,89 @@ private:
     VkDescriptorPool _descriptorPool;
 
     GPUSceneData _sceneParameters;
-    AllocatedBuffer _sceneParameterBuffer;
 
-    std::vector<RenderObject> _renderables;
-    std::unordered_map<std::string, Material> _materials;
-    std::unordered_map<std::string, Mesh> _meshes;
+    //transient uniforms of the frame being recorded, camera and scene data among them
+    FrameRingBuffer _frameAllocator;
+    //dynamic offsets of the global set, camera at binding 0, scene at binding 1 and cluster data at binding 2
+    uint32_t _globalOffsets[3];
+
+    ClusteredLighting _clusteredLighting;
+    bool _clusteredLightingReady = false;
+    uint32_t _lightScope;
+    //the lights at rest, updateLights animates them into the frame's light buffer
+    std::vector<GPUPointLight> _lights;
+
+    CascadedShadows _shadows;
+    bool _shadowsReady = false;
+    uint32_t _shadowStaticScope;
+    uint32_t _shadowDynamicScope;
+    //renderables per cascade and layer, the static lists are only filled while the layer is stale
+    std::vector<uint32_t> _shadowCasters[SHADOW_CASCADE_COUNT][SHADOW_LAYER_COUNT];
+    std::vector<uint32_t> _shadowQuery;
+
+    OcclusionCuller _occlusionCuller;
+    bool _occlusionCulling = false;
+    uint32_t _cullDataOffset = 0;
+    uint32_t _cullScope;
+    uint32_t _hizScope;
+
+    //depth-only draws over Mesh::_positionBuffer ahead of the colour draws, in the same subpass
+    bool _depthPrepass = false;
+    bool _prepassKeyDown = false;
+    VkPipeline _depthPrepassPipeline;
+    VkPipelineLayout _depthPrepassLayout;
+    uint32_t _depthPrepassScope;
 
-    std::unordered_map<std::string, Texture> _loadedTextures;
+    std::vector<RenderObject> _renderables;
+    //world space boxes of the renderables' bounding spheres and the hierarchy over them, for culling and queries
+    std::vector<Aabb> _objectBounds;
+    Bvh _objectBvh;
+    uint32_t _bvhRebuilds = 0;
+    //renderables drawn this frame in _renderables order, the BVH frustum query result. with occlusion culling the
+    //GPU only draws those of them that are not occluded
+    std::vector<uint32_t> _drawList;
+    SceneGraph _sceneGraph;
+    //render objects hold handles into these, names are only resolved while the scene loads
+    AssetPool<Material> _materials;
+    AssetPool<Mesh> _meshes;
+    //spatial chunks of the large static meshes and the material parts of a multi-material OBJ, every chunk of a
+    //mesh is in _meshes and draws from the same vertex buffer
+    std::unordered_map<std::string, std::vector<MeshHandle>> _meshChunks;
+    //diffuse texture of every chunk of a multi-material mesh, parallel to its _meshChunks entry. empty for the
+    //untextured ones
+    std::unordered_map<std::string, std::vector<std::string>> _meshPartTextures;
+
+    AssetPool<Texture> _textures;
+    VkSampler _textureSampler;
+
+    //meshes and textures leave the GPU least recently drawn first once they exceed the residency budget, and are
+    //uploaded again when something draws them. _residentAssets is indexed by residency id
+    ResidencyManager _residency;
+    std::vector<ResidentAsset> _residentAssets;
+    std::vector<uint32_t> _evictedAssets;
+    //1x1 texture for materials whose texture failed to reload, created the first time one does
+    AllocatedImage _fallbackTexture = {};
+    VkImageView _fallbackTextureView = VK_NULL_HANDLE;
+    //the merged vertices of every split mesh, the CPU side copy its chunks are uploaded again from
+    std::unordered_map<std::string, std::vector<Vertex>> _chunkVertices;
+
+    //the --scene-glb stays mapped, its embedded images are decoded from the mapping whenever they are uploaded
+    std::unordered_map<std::string, GlbFile> _glbFiles;
+    //a primitive of the --scene-glb placed by a node, turned into a render object by initScene
+    struct GlbObject {
+        MeshHandle mesh;
+        //name in _textures, empty when untextured
+        std::string texture;
+        glm::mat4 transform;
+    };
+    std::vector<GlbObject> _glbObjects;
+
+    //the --archive, mapped for the whole run since evicted textures are uploaded again from it
+    AssetArchive _archive;
+
+    //the level texture streamed in pages, replaces the empire_diffuse upload
+    VirtualTexture _virtualTexture;
+    bool _virtualTexturing = false;
 
     int _frameNumber = 0;
 
@@ -101,12 +224,19 @@ private:
     float _pitch = 0.0f;
     float _sensitivity = 0.05;
 
+    bool _traceKeyDown = false;
+    bool _memoryStatsKeyDown = false;
+    //buffers the defragmentation moved this frame
+    std::vector<BufferMove> _bufferMoves;
+
     void initWindow();
 
     void initVulkan();
 
     void initSwapchain();
 
+    void initOffscreenTargets();
+
     void initCommands();
 
     void initDefaultRenderPass();
@@ -115,17 +245,115 @@ private:
 
     void initSyncStructures();
 
+    void initProfiler();
+
     void initPipelines();
 
+    void initOcclusionCulling();
+
+    //before initPipelines, the textured material's set layout comes from the virtual texture
+    void initVirtualTexture();
+
+    //the light clustering pass and the light bindings of the global set
+    void initLighting();
+
+    //scatters _config.lightCount lights over the bounds of the scene
+    void initLights();
+
+    void updateLights();
+
+    //the cascaded shadow maps and their bindings in the global set
+    void initShadows();
+
+    //fits the cascades and sorts the casters of every cascade into its layers, needs the frame's _objectBvh
+    void prepareShadows(const glm::mat4 &view, float fovY, float aspect, float znear);
+
+    //redraws the stale static layers and the dynamic ones with casters, outside any render pass
+    void drawShadows(VkCommandBuffer cmd);
+
+    void drawShadowCasters(VkCommandBuffer cmd, const std::vector<uint32_t> &casters, uint32_t cascade);
+
+    //the pass that stretches the scene target over the swapchain image, and the resolution controller driving it
+    void initUpscalePass();
+
+    //feeds the latest resolved GPU frame time to the controller and sets _renderExtent for the frame
+    void updateRenderScale();
+
+    //viewport and scissor of the scene pipelines, call after beginning a scene render pass
+    void setRenderViewport(VkCommandBuffer cmd);
+
+    void drawUpscale(VkCommandBuffer cmd, uint32_t swapchainImageIndex);
+
+    void copySceneColor(VkCommandBuffer cmd, uint32_t swapchainImageIndex);
+
     void draw();
 
+    void runHeadless();
+
+    void runBenchmark();
+
+    //maps the --archive so the loaders below can take assets from it, false when it can't be mounted
+    bool initArchive();
+
     bool loadShaderModule(const char *filePath, VkShaderModule *outShaderModule);
 
     void loadMeshes();
 
+    //the archived copy of the OBJ at path when the archive has one, else the file itself
+    bool loadMesh(Mesh &outMesh, const std::string &path);
+
     void uploadMesh(Mesh &mesh);
 
-    void drawObjects(VkCommandBuffer cmd, RenderObject *first, int count);
+    //copies data into a new GPU only buffer through a staging buffer. the buffer belongs to _gpuMemory, which may
+    //move it while defragmenting
+    AllocatedBuffer uploadBuffer(const void *data, size_t size, VkBufferUsageFlags usage, MemoryCategory category);
+
+    //points the meshes holding a buffer the defragmentation moved at its new place
+    void remapMeshBuffers(const std::vector<BufferMove> &moves);
+
+    uint32_t addResidentAsset(ResidentAssetType type, const std::string &name, const std::string &path,
+                              uint64_t bytes, uint32_t image = 0, uint32_t handle = 0);
+
+    //uploads the evicted meshes and textures the objects draw with, call before recording their draws
+    void makeResident(const std::vector<uint32_t> &objects);
+
+    void reloadAsset(uint32_t id);
+
+    //writes view into the texture set of every material that uses the texture
+    void bindMaterialTexture(uint32_t textureResidencyId, VkImageView view);
+
+    VkImageView fallbackTextureView();
+
+    //drops what the residency budget has no room for, call once the frame's draws are recorded
+    void evictAssets();
+
+    //every chunk of a split mesh draws from the same buffers
+    void setChunkBuffers(const std::string &name, const AllocatedBuffer &vertexBuffer,
+                         const AllocatedBuffer &positionBuffer);
+
+    //uploads the frame's uniforms and object data, picks detail levels, updates _objectBvh and fills _drawList.
+    //false when the frame ring buffer is full
+    bool prepareObjects(RenderObject *first, int count);
+
+    //brings _objectBvh up to date with _objectBounds, refits while that keeps the tree good enough
+    void updateObjectBvh();
+
+    //drawList holds indices into objects in draw order. indirectBuffer holds one command per object starting at
+    //indirectOffset, VK_NULL_HANDLE draws directly
+    void drawObjects(VkCommandBuffer cmd, RenderObject *objects, const std::vector<uint32_t> &drawList,
+                     VkBuffer indirectBuffer, VkDeviceSize indirectOffset);
+
+    void drawDepthPrepass(VkCommandBuffer cmd, RenderObject *objects, const std::vector<uint32_t> &drawList,
+                          VkBuffer indirectBuffer, VkDeviceSize indirectOffset);
+
+    //the pre-pass when enabled, then the colour draws
+    void drawScene(VkCommandBuffer cmd, RenderObject *objects, const std::vector<uint32_t> &drawList,
+                   VkBuffer indirectBuffer, VkDeviceSize indirectOffset);
+
+    void drawObject(VkCommandBuffer cmd, const RenderObject &object, uint32_t index, VkBuffer indirectBuffer,
+                    VkDeviceSize indirectOffset);
+
+    void reportDepthPrepass();
 
     void initScene();
 
@@ -139,15 +367,59 @@ private:
 
     void loadImages();
 
-    Material *createMaterial(VkPipeline pipeline, VkPipelineLayout layout, const std::string &name);
+    //uploads the image file, or image of the .glb at path, as _textures[name] under the residency manager.
+    //false when it can't be read
+    bool loadTexture(const std::string &name, const std::string &path, ResidentAssetType type = RESIDENT_TEXTURE,
+                     uint32_t image = 0);
+
+    //loads every texture file of paths that is not loaded yet, each under its path, decoding them on
+    //--texture-threads threads. those the archive holds are uploaded from it instead
+    void loadTextures(const std::vector<std::string> &paths);
+
+    //creates the view of a decoded image and registers it in _textures under name
+    void addTexture(const std::string &name, const std::string &path, ResidentAssetType type, uint32_t image,
+                    const AllocatedImage &allocatedImage);
+
+    bool decodeTexture(ResidentAssetType type, const std::string &path, uint32_t image, AllocatedImage &outImage);
+
+    //every primitive of the .glb becomes a mesh in _meshes and every node placing one a _glbObjects entry. false
+    //when the file can't be read, nothing of it is loaded then
+    bool loadGlbScene(const std::string &path);
+
+    MaterialHandle createMaterial(VkPipeline pipeline, VkPipelineLayout layout, const std::string &name,
+                                  VkPipeline prepassPipeline = VK_NULL_HANDLE);
 
-    Material *getMaterial(const std::string &name);
+    MaterialHandle getMaterial(const std::string &name);
 
-    Mesh *getMesh(const std::string &name);
+    //a texturedmesh material drawing _textures[texture], created with its texture set on first use. a texture that
+    //is not loaded yet is read from the file of that name. the zero handle when it can't be loaded or the pool is
+    //out of sets
+    MaterialHandle getTextureMaterial(const std::string &texture);
+
+    MeshHandle getMesh(const std::string &name);
+
+    //null when the mesh was not split
+    std::vector<MeshHandle> *getMeshChunks(const std::string &name);
+
+    //splits mesh into chunks with their own detail levels and uploads all of them as one buffer
+    void uploadMeshChunks(const std::string &name, Mesh &mesh);
+
+    //one part per diffuse texture of a mesh loaded with its materials, split further into chunks like
+    //uploadMeshChunks. all parts share one buffer and _meshPartTextures records their textures
+    void uploadMeshParts(const std::string &name, Mesh &mesh);
+
+    //uploads the chunks' vertices as one buffer and registers them under name, each chunk in _meshes as name#chunkN
+    void uploadSharedChunks(const std::string &name, std::vector<Mesh> &chunks);
+
+    //one render object per chunk of a split mesh, the mesh itself otherwise. textured parts of a multi-material
+    //mesh use their texture's material instead of material
+    void addMeshObjects(const std::string &meshName, MaterialHandle material, const glm::mat4 &transform);
 
     FrameData& getCurrentFrame();
 
-    size_t padUniformBufferSize(size_t originalSize);
+    uint32_t getCurrentFrameIndex() const;
+
+    void waitForTimeline(uint64_t value);
 };
 
 
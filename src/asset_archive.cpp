@@ -0,0 +1,288 @@
+#include "asset_archive.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "lz_compress.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct PackedMeshHeader {
+    uint32_t vertexCount;
+    uint32_t submeshCount;
+    uint32_t materialCount;
+};
+
+struct PackedMaterialHeader {
+    glm::vec3 diffuseColor;
+    uint32_t nameLength;
+    uint32_t textureLength;
+};
+
+static void append(std::vector<uint8_t> &out, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *) data;
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+//copies size bytes at offset to dst and moves past them, false when the blob ends first
+static bool take(const uint8_t *blob, size_t blobSize, size_t &offset, void *dst, size_t size) {
+    if (size > blobSize - offset) {
+        return false;
+    }
+    if (size > 0) {
+        memcpy(dst, blob + offset, size);
+    }
+    offset += size;
+    return true;
+}
+
+void packMesh(const Mesh &mesh, std::vector<uint8_t> &out) {
+    PackedMeshHeader header;
+    header.vertexCount = (uint32_t) mesh._vertices.size();
+    header.submeshCount = (uint32_t) mesh._submeshes.size();
+    header.materialCount = (uint32_t) mesh._materials.size();
+    append(out, &header, sizeof(header));
+    append(out, mesh._vertices.data(), mesh._vertices.size() * sizeof(Vertex));
+    append(out, mesh._submeshes.data(), mesh._submeshes.size() * sizeof(SubMesh));
+    for (const MeshMaterial &material : mesh._materials) {
+        PackedMaterialHeader materialHeader;
+        materialHeader.diffuseColor = material.diffuseColor;
+        materialHeader.nameLength = (uint32_t) material.name.size();
+        materialHeader.textureLength = (uint32_t) material.diffuseTexture.size();
+        append(out, &materialHeader, sizeof(materialHeader));
+        append(out, material.name.data(), material.name.size());
+        append(out, material.diffuseTexture.data(), material.diffuseTexture.size());
+    }
+}
+
+bool unpackMesh(const uint8_t *blob, size_t size, Mesh &outMesh) {
+    size_t offset = 0;
+    PackedMeshHeader header;
+    if (!take(blob, size, offset, &header, sizeof(header)) ||
+        header.vertexCount > (size - offset) / sizeof(Vertex)) {
+        return false;
+    }
+    outMesh._vertices.resize(header.vertexCount);
+    if (!take(blob, size, offset, outMesh._vertices.data(), header.vertexCount * sizeof(Vertex)) ||
+        header.submeshCount > (size - offset) / sizeof(SubMesh)) {
+        return false;
+    }
+    outMesh._submeshes.resize(header.submeshCount);
+    if (!take(blob, size, offset, outMesh._submeshes.data(), header.submeshCount * sizeof(SubMesh)) ||
+        header.materialCount > (size - offset) / sizeof(PackedMaterialHeader)) {
+        return false;
+    }
+    outMesh._materials.resize(header.materialCount);
+    for (MeshMaterial &material : outMesh._materials) {
+        PackedMaterialHeader materialHeader;
+        if (!take(blob, size, offset, &materialHeader, sizeof(materialHeader)) ||
+            (size_t) materialHeader.nameLength + materialHeader.textureLength > size - offset) {
+            return false;
+        }
+        material.diffuseColor = materialHeader.diffuseColor;
+        material.name.assign((const char *) blob + offset, materialHeader.nameLength);
+        offset += materialHeader.nameLength;
+        material.diffuseTexture.assign((const char *) blob + offset, materialHeader.textureLength);
+        offset += materialHeader.textureLength;
+    }
+    for (const SubMesh &submesh : outMesh._submeshes) {
+        if (submesh.firstVertex > header.vertexCount ||
+            submesh.vertexCount > header.vertexCount - submesh.firstVertex ||
+            (submesh.material != ~0u && submesh.material >= header.materialCount)) {
+            return false;
+        }
+    }
+    return offset == size;
+}
+
+bool AssetArchive::mount(const char *path) {
+    unmount();
+#ifndef _WIN32
+    int file = ::open(path, O_RDONLY);
+    if (file < 0) {
+        std::cout << "Failed to open asset archive " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    void *mapped = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0) {
+        mapped = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    ::close(file);
+    if (mapped == MAP_FAILED) {
+        std::cout << "Failed to map asset archive " << path << std::endl;
+        return false;
+    }
+    _data = (const uint8_t *) mapped;
+    _size = (size_t) info.st_size;
+#else
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        std::cout << "Failed to open asset archive " << path << std::endl;
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    _contents.resize((size_t) ftell(file));
+    fseek(file, 0, SEEK_SET);
+    size_t read = fread(_contents.data(), 1, _contents.size(), file);
+    fclose(file);
+    _data = _contents.data();
+    _size = read;
+#endif
+
+    ArchiveHeader header;
+    if (_size < sizeof(header)) {
+        std::cout << path << " is no asset archive" << std::endl;
+        unmount();
+        return false;
+    }
+    memcpy(&header, _data, sizeof(header));
+    size_t tableEnd = sizeof(header) + (size_t) header.entryCount * sizeof(ArchiveEntry);
+    if (header.magic != ARCHIVE_MAGIC || header.version != ARCHIVE_VERSION ||
+        header.entryCount > _size / sizeof(ArchiveEntry) || tableEnd + header.namesSize > _size) {
+        std::cout << path << " is no asset archive of version " << ARCHIVE_VERSION << std::endl;
+        unmount();
+        return false;
+    }
+
+    //the header is 16 bytes, so the entries are aligned for their 64 bit fields
+    _entries = (const ArchiveEntry *) (_data + sizeof(header));
+    const char *names = (const char *) _data + tableEnd;
+    _index.reserve(header.entryCount);
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        const ArchiveEntry &entry = _entries[i];
+        bool valid = entry.nameOffset <= header.namesSize && entry.nameLength <= header.namesSize - entry.nameOffset &&
+                     entry.offset <= _size && entry.storedSize <= _size - entry.offset &&
+                     (entry.compression == ARCHIVE_LZ || entry.storedSize == entry.size);
+        if (!valid) {
+            std::cout << "Entry " << i << " of asset archive " << path << " is malformed" << std::endl;
+            unmount();
+            return false;
+        }
+        _index[std::string(names + entry.nameOffset, entry.nameLength)] = i;
+    }
+    return true;
+}
+
+void AssetArchive::unmount() {
+#ifndef _WIN32
+    if (_data) {
+        munmap((void *) _data, _size);
+    }
+#else
+    std::vector<uint8_t>().swap(_contents);
+#endif
+    _data = nullptr;
+    _size = 0;
+    _entries = nullptr;
+    _index.clear();
+}
+
+const ArchiveEntry *AssetArchive::find(const std::string &name) const {
+    auto it = _index.find(name);
+    return it == _index.end() ? nullptr : &_entries[it->second];
+}
+
+bool AssetArchive::read(const ArchiveEntry &entry, void *dst) const {
+    if (entry.compression == ARCHIVE_STORED) {
+        if (entry.size > 0) {
+            memcpy(dst, data(entry), (size_t) entry.size);
+        }
+        return true;
+    }
+    return lzDecompress(data(entry), (size_t) entry.storedSize, (uint8_t *) dst, (size_t) entry.size);
+}
+
+void AssetArchiveWriter::add(const std::string &name, ArchiveAssetType type, const uint8_t *data, size_t size,
+                             bool compress, uint32_t width, uint32_t height) {
+    Blob blob;
+    blob.name = name;
+    memset(&blob.entry, 0, sizeof(blob.entry));
+    blob.entry.size = size;
+    blob.entry.type = type;
+    blob.entry.width = width;
+    blob.entry.height = height;
+    blob.entry.compression = ARCHIVE_STORED;
+    if (compress) {
+        lzCompress(data, size, blob.bytes);
+        //a blob that barely shrinks is not worth decompressing at load
+        if (blob.bytes.size() < size - size / 8) {
+            blob.entry.compression = ARCHIVE_LZ;
+        } else {
+            blob.bytes.clear();
+        }
+    }
+    if (blob.entry.compression == ARCHIVE_STORED) {
+        blob.bytes.assign(data, data + size);
+    }
+    blob.entry.storedSize = blob.bytes.size();
+    _blobs.push_back(std::move(blob));
+}
+
+bool AssetArchiveWriter::write(const char *path) const {
+    ArchiveHeader header;
+    header.magic = ARCHIVE_MAGIC;
+    header.version = ARCHIVE_VERSION;
+    header.entryCount = (uint32_t) _blobs.size();
+    header.namesSize = 0;
+
+    std::vector<ArchiveEntry> entries;
+    entries.reserve(_blobs.size());
+    for (const Blob &blob : _blobs) {
+        entries.push_back(blob.entry);
+        entries.back().nameOffset = header.namesSize;
+        entries.back().nameLength = (uint32_t) blob.name.size();
+        header.namesSize += (uint32_t) blob.name.size();
+    }
+    uint64_t offset = sizeof(header) + entries.size() * sizeof(ArchiveEntry) + header.namesSize;
+    for (ArchiveEntry &entry : entries) {
+        offset = (offset + ARCHIVE_ALIGNMENT - 1) & ~(ARCHIVE_ALIGNMENT - 1);
+        entry.offset = offset;
+        offset += entry.storedSize;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        std::cout << "Failed to create asset archive " << path << std::endl;
+        return false;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (!entries.empty()) {
+        written = written && fwrite(entries.data(), sizeof(ArchiveEntry), entries.size(), file) == entries.size();
+    }
+    for (const Blob &blob : _blobs) {
+        written = written && fwrite(blob.name.data(), 1, blob.name.size(), file) == blob.name.size();
+    }
+    static const uint8_t padding[ARCHIVE_ALIGNMENT] = {};
+    uint64_t position = sizeof(header) + entries.size() * sizeof(ArchiveEntry) + header.namesSize;
+    for (size_t i = 0; i < _blobs.size() && written; i++) {
+        size_t padSize = (size_t) (entries[i].offset - position);
+        written = fwrite(padding, 1, padSize, file) == padSize &&
+                  fwrite(_blobs[i].bytes.data(), 1, _blobs[i].bytes.size(), file) == _blobs[i].bytes.size();
+        position = entries[i].offset + entries[i].storedSize;
+    }
+    written = fclose(file) == 0 && written;
+    if (!written) {
+        std::cout << "Failed to write asset archive " << path << std::endl;
+    }
+    return written;
+}
+
+uint64_t AssetArchiveWriter::storedBytes() const {
+    uint64_t bytes = 0;
+    for (const Blob &blob : _blobs) {
+        bytes += blob.entry.storedSize;
+    }
+    return bytes;
+}
+
+uint64_t AssetArchiveWriter::assetBytes() const {
+    uint64_t bytes = 0;
+    for (const Blob &blob : _blobs) {
+        bytes += blob.entry.size;
+    }
+    return bytes;
+}
@@ -0,0 +1,112 @@
+#ifndef VULKAN_STEP_BY_STEP_ASSET_ARCHIVE_H
+#define VULKAN_STEP_BY_STEP_ASSET_ARCHIVE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vk_mesh.h"
+
+//the archive starts with an ArchiveHeader, the entries and their names follow. every blob starts on an
+//ARCHIVE_ALIGNMENT boundary, so a mapped blob can go to the GPU or vkCreateShaderModule as it is
+static const uint32_t ARCHIVE_MAGIC = 0x4B415356;
+static const uint32_t ARCHIVE_VERSION = 1;
+static const uint64_t ARCHIVE_ALIGNMENT = 4096;
+
+enum ArchiveAssetType {
+    //a Mesh as packMesh writes it
+    ARCHIVE_MESH,
+    //RGBA8 texels, width and height in the entry
+    ARCHIVE_TEXTURE,
+    //SPIR-V words
+    ARCHIVE_SHADER
+};
+
+enum ArchiveCompression {
+    ARCHIVE_STORED,
+    //lzCompress, see lz_compress.h
+    ARCHIVE_LZ
+};
+
+struct ArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t namesSize;
+};
+
+struct ArchiveEntry {
+    uint64_t offset;
+    //bytes in the file, and bytes once decompressed
+    uint64_t storedSize;
+    uint64_t size;
+    //into the names that follow the entries, not terminated
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t type;
+    uint32_t compression;
+    uint32_t width;
+    uint32_t height;
+};
+
+//serializes the vertices, submeshes and materials of a mesh. levels of detail are not kept, the engine builds
+//them at load because they depend on how it chunks the mesh
+void packMesh(const Mesh &mesh, std::vector<uint8_t> &out);
+
+//false when the blob is malformed
+bool unpackMesh(const uint8_t *blob, size_t size, Mesh &outMesh);
+
+//a packed archive mapped into memory. entries are found by the path the asset was packed from, which is the path
+//the engine would otherwise open
+class AssetArchive {
+public:
+    //false when the file can't be mapped or is no archive of this version
+    bool mount(const char *path);
+
+    void unmount();
+
+    bool mounted() const { return _data != nullptr; }
+
+    //null when the archive has no such asset
+    const ArchiveEntry *find(const std::string &name) const;
+
+    //the stored bytes inside the mapping, the asset itself when the entry is ARCHIVE_STORED
+    const uint8_t *data(const ArchiveEntry &entry) const { return _data + entry.offset; }
+
+    //writes the entry's size bytes to dst, copied or decompressed. false when a compressed blob is corrupt
+    bool read(const ArchiveEntry &entry, void *dst) const;
+
+private:
+    const uint8_t *_data = nullptr;
+    size_t _size = 0;
+#ifdef _WIN32
+    std::vector<uint8_t> _contents;
+#endif
+    std::unordered_map<std::string, uint32_t> _index;
+    const ArchiveEntry *_entries = nullptr;
+};
+
+//collects blobs in memory and writes them out as an archive, used by the asset packer
+class AssetArchiveWriter {
+public:
+    //compress keeps the LZ form when it is at least an eighth smaller than the blob
+    void add(const std::string &name, ArchiveAssetType type, const uint8_t *data, size_t size, bool compress,
+             uint32_t width = 0, uint32_t height = 0);
+
+    bool write(const char *path) const;
+
+    uint64_t storedBytes() const;
+
+    uint64_t assetBytes() const;
+
+private:
+    struct Blob {
+        std::string name;
+        ArchiveEntry entry;
+        std::vector<uint8_t> bytes;
+    };
+
+    std::vector<Blob> _blobs;
+};
+
+#endif //VULKAN_STEP_BY_STEP_ASSET_ARCHIVE_H
@@ -0,0 +1,140 @@
+#ifndef VULKAN_STEP_BY_STEP_ASSET_REGISTRY_H
+#define VULKAN_STEP_BY_STEP_ASSET_REGISTRY_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//the low bits of a handle pick a slot, the high bits hold the slot's generation when the handle was made. a pool
+//holds up to 2^20 assets
+static const uint32_t HANDLE_INDEX_BITS = 20;
+static const uint32_t HANDLE_INDEX_MASK = (1u << HANDLE_INDEX_BITS) - 1;
+static const uint32_t HANDLE_GENERATION_MASK = (1u << (32 - HANDLE_INDEX_BITS)) - 1;
+
+//a reference to an asset of an AssetPool<T>. plain data, so it can be stored, copied and written out with the
+//scene. generations start at 1, so the zero handle never resolves
+template<typename T>
+struct Handle {
+    uint32_t value;
+
+    Handle() : value(0) {}
+
+    explicit Handle(uint32_t value) : value(value) {}
+
+    bool valid() const { return value != 0; }
+
+    uint32_t index() const { return value & HANDLE_INDEX_MASK; }
+
+    uint32_t generation() const { return value >> HANDLE_INDEX_BITS; }
+
+    bool operator==(const Handle &other) const { return value == other.value; }
+
+    bool operator!=(const Handle &other) const { return value != other.value; }
+};
+
+//assets of one kind in a dense slot array. names are resolved to handles once at load time, after that a handle
+//reaches its asset with an index and a generation check. a slot keeps its index while other assets are added, so
+//handles stay valid, but the array may grow, so a pointer from get() is only good until the next add. removing an
+//asset bumps the slot's generation so the handles still pointing at it stop resolving
+template<typename T>
+class AssetPool {
+public:
+    //adds the asset under name, or replaces the asset of that name and keeps its handle
+    Handle<T> add(const std::string &name, const T &asset) {
+        auto existing = _indices.find(name);
+        if (existing != _indices.end()) {
+            _slots[existing->second] = asset;
+            return makeHandle(existing->second);
+        }
+        uint32_t index;
+        if (!_freeSlots.empty()) {
+            index = _freeSlots.back();
+            _freeSlots.pop_back();
+            _slots[index] = asset;
+            _names[index] = name;
+        } else {
+            //a larger index would spill into the generation bits
+            if (_slots.size() > HANDLE_INDEX_MASK) {
+                std::cout << "Asset pool is full, can't add " << name << std::endl;
+                abort();
+            }
+            index = (uint32_t) _slots.size();
+            _slots.push_back(asset);
+            _names.push_back(name);
+            _generations.push_back(1);
+            _live.push_back(0);
+        }
+        _live[index] = 1;
+        _indices[name] = index;
+        return makeHandle(index);
+    }
+
+    //the zero handle when no asset has that name. hashes the name, so it belongs in loading code
+    Handle<T> find(const std::string &name) const {
+        auto it = _indices.find(name);
+        return it == _indices.end() ? Handle<T>() : makeHandle(it->second);
+    }
+
+    //null when the handle is the zero handle or its asset was removed
+    T *get(Handle<T> handle) {
+        return resolves(handle) ? &_slots[handle.index()] : nullptr;
+    }
+
+    const T *get(Handle<T> handle) const {
+        return resolves(handle) ? &_slots[handle.index()] : nullptr;
+    }
+
+    const std::string &name(Handle<T> handle) const {
+        static const std::string none;
+        return resolves(handle) ? _names[handle.index()] : none;
+    }
+
+    //frees the slot for the next add, the handles to the asset stop resolving
+    void remove(Handle<T> handle) {
+        if (!resolves(handle)) {
+            return;
+        }
+        uint32_t index = handle.index();
+        _indices.erase(_names[index]);
+        _slots[index] = T();
+        _names[index].clear();
+        _live[index] = 0;
+        //skips 0 when it wraps, generation 0 would make the zero handle for slot 0
+        _generations[index] = _generations[index] == HANDLE_GENERATION_MASK ? 1 : _generations[index] + 1;
+        _freeSlots.push_back(index);
+    }
+
+    //calls function(handle, asset) for every asset in slot order
+    template<typename Function>
+    void forEach(Function function) {
+        for (uint32_t index = 0; index < _slots.size(); index++) {
+            if (_live[index]) {
+                function(makeHandle(index), _slots[index]);
+            }
+        }
+    }
+
+    size_t size() const { return _indices.size(); }
+
+private:
+    Handle<T> makeHandle(uint32_t index) const {
+        return Handle<T>(_generations[index] << HANDLE_INDEX_BITS | index);
+    }
+
+    bool resolves(Handle<T> handle) const {
+        uint32_t index = handle.index();
+        return index < _slots.size() && _live[index] && _generations[index] == handle.generation();
+    }
+
+    std::vector<T> _slots;
+    std::vector<std::string> _names;
+    std::vector<uint32_t> _generations;
+    std::vector<uint8_t> _live;
+    std::vector<uint32_t> _freeSlots;
+    std::unordered_map<std::string, uint32_t> _indices;
+};
+
+#endif //VULKAN_STEP_BY_STEP_ASSET_REGISTRY_H
@@ -0,0 +1,104 @@
+#include "benchmark.h"
+#include "json.h"
+#include <fstream>
+#include <iostream>
+
+static std::vector<double> validSamples(const std::vector<double> &samples) {
+    std::vector<double> valid;
+    valid.reserve(samples.size());
+    for (double sample : samples) {
+        if (sample >= 0.0) {
+            valid.push_back(sample);
+        }
+    }
+    return valid;
+}
+
+static void writeSummaryJson(std::ofstream &file, const TimingSummary &summary) {
+    file << "{\"mean\": " << summary.mean << ", \"median\": " << summary.median << ", \"p95\": " << summary.p95
+         << ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max << "}";
+}
+
+bool BenchmarkResults::writeCsv(const std::string &path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Failed to write benchmark results " << path << std::endl;
+        return false;
+    }
+
+    const bool hasOccluded = !occludedObjects.empty();
+    file << "frame,cpu_ms,gpu_ms" << (hasOccluded ? ",occluded" : "") << "\n";
+    for (size_t i = 0; i < cpuMilliseconds.size(); i++) {
+        file << i << "," << cpuMilliseconds[i] << ",";
+        if (gpuMilliseconds[i] >= 0.0) {
+            file << gpuMilliseconds[i];
+        }
+        if (hasOccluded) {
+            file << ",";
+            if (occludedObjects[i] >= 0.0) {
+                file << occludedObjects[i];
+            }
+        }
+        file << "\n";
+    }
+    return true;
+}
+
+bool BenchmarkResults::writeJson(const std::string &path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Failed to write benchmark results " << path << std::endl;
+        return false;
+    }
+
+    file << "{\n";
+    file << "  \"camera_path\": ";
+    writeJsonString(file, cameraPath);
+    file << ",\n";
+    file << "  \"warmup_frames\": " << warmupFrames << ",\n";
+    file << "  \"measured_frames\": " << cpuMilliseconds.size() << ",\n";
+    file << "  \"timestep\": " << timestep << ",\n";
+    file << "  \"cpu_ms\": ";
+    writeSummaryJson(file, summarizeTimings(cpuMilliseconds));
+    file << ",\n  \"gpu_ms\": ";
+    writeSummaryJson(file, summarizeTimings(validSamples(gpuMilliseconds)));
+    if (!occludedObjects.empty()) {
+        file << ",\n  \"occluded\": ";
+        writeSummaryJson(file, summarizeTimings(validSamples(occludedObjects)));
+    }
+    file << ",\n  \"frames\": [\n";
+    for (size_t i = 0; i < cpuMilliseconds.size(); i++) {
+        file << "    {\"cpu_ms\": " << cpuMilliseconds[i] << ", \"gpu_ms\": ";
+        if (gpuMilliseconds[i] >= 0.0) {
+            file << gpuMilliseconds[i];
+        } else {
+            file << "null";
+        }
+        if (!occludedObjects.empty()) {
+            file << ", \"occluded\": ";
+            if (occludedObjects[i] >= 0.0) {
+                file << occludedObjects[i];
+            } else {
+                file << "null";
+            }
+        }
+        file << "}" << (i + 1 < cpuMilliseconds.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return true;
+}
+
+void BenchmarkResults::printSummary() const {
+    TimingSummary cpu = summarizeTimings(cpuMilliseconds);
+    TimingSummary gpu = summarizeTimings(validSamples(gpuMilliseconds));
+    std::cout << "Benchmark " << cameraPath << ": " << cpuMilliseconds.size() << " frames" << std::endl;
+    std::cout << "  cpu ms mean " << cpu.mean << " median " << cpu.median << " p95 " << cpu.p95 << " p99 " << cpu.p99
+              << " max " << cpu.max << std::endl;
+    std::cout << "  gpu ms mean " << gpu.mean << " median " << gpu.median << " p95 " << gpu.p95 << " p99 " << gpu.p99
+              << " max " << gpu.max << std::endl;
+    if (!occludedObjects.empty()) {
+        TimingSummary occluded = summarizeTimings(validSamples(occludedObjects));
+        std::cout << "  occluded objects mean " << occluded.mean << " median " << occluded.median << " max "
+                  << occluded.max << std::endl;
+    }
+}
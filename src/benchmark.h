@@ -0,0 +1,27 @@
+#ifndef VULKAN_STEP_BY_STEP_BENCHMARK_H
+#define VULKAN_STEP_BY_STEP_BENCHMARK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "timing_stats.h"
+
+//per-frame timings of the measured part of a benchmark run. gpuMilliseconds is negative for frames the GPU
+//profiler could not time
+struct BenchmarkResults {
+    std::string cameraPath;
+    uint32_t warmupFrames = 0;
+    float timestep = 0.0f;
+    std::vector<double> cpuMilliseconds;
+    std::vector<double> gpuMilliseconds;
+    //objects the occlusion culler skipped per frame, negative when not read back, empty when culling is off
+    std::vector<double> occludedObjects;
+
+    bool writeCsv(const std::string &path) const;
+
+    bool writeJson(const std::string &path) const;
+
+    void printSummary() const;
+};
+
+#endif //VULKAN_STEP_BY_STEP_BENCHMARK_H
@@ -0,0 +1,144 @@
+#ifndef VULKAN_STEP_BY_STEP_BOUNDS_H
+#define VULKAN_STEP_BY_STEP_BOUNDS_H
+
+#include <glm.hpp>
+#include <cfloat>
+
+enum FrustumPlane {
+    FRUSTUM_LEFT,
+    FRUSTUM_RIGHT,
+    FRUSTUM_BOTTOM,
+    FRUSTUM_TOP,
+    FRUSTUM_NEAR,
+    FRUSTUM_FAR,
+    FRUSTUM_PLANE_COUNT
+};
+
+struct Aabb {
+    //empty until the first expand
+    glm::vec3 minimum{FLT_MAX};
+    glm::vec3 maximum{-FLT_MAX};
+
+    static Aabb fromSphere(const glm::vec3 &center, float radius) {
+        Aabb box;
+        box.minimum = center - glm::vec3(radius);
+        box.maximum = center + glm::vec3(radius);
+        return box;
+    }
+
+    void expand(const glm::vec3 &point) {
+        minimum = glm::min(minimum, point);
+        maximum = glm::max(maximum, point);
+    }
+
+    void expand(const Aabb &other) {
+        minimum = glm::min(minimum, other.minimum);
+        maximum = glm::max(maximum, other.maximum);
+    }
+
+    glm::vec3 center() const {
+        return (minimum + maximum) * 0.5f;
+    }
+
+    //0 for an empty box, the SAH weighs nodes by this
+    float surfaceArea() const {
+        glm::vec3 extent = glm::max(maximum - minimum, glm::vec3(0.0f));
+        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+
+    bool overlaps(const Aabb &other) const {
+        return minimum.x <= other.maximum.x && maximum.x >= other.minimum.x &&
+               minimum.y <= other.maximum.y && maximum.y >= other.minimum.y &&
+               minimum.z <= other.maximum.z && maximum.z >= other.minimum.z;
+    }
+
+    bool overlapsSphere(const glm::vec3 &center, float radius) const {
+        glm::vec3 offset = center - glm::clamp(center, minimum, maximum);
+        return glm::dot(offset, offset) <= radius * radius;
+    }
+
+    //slab test, inverseDirection is 1 / ray direction per axis. outDistance is where the ray enters, 0 from inside
+    bool intersectsRay(const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxDistance,
+                       float &outDistance) const {
+        glm::vec3 t0 = (minimum - origin) * inverseDirection;
+        glm::vec3 t1 = (maximum - origin) * inverseDirection;
+        glm::vec3 tNear = glm::min(t0, t1);
+        glm::vec3 tFar = glm::max(t0, t1);
+        float enter = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+        float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, maxDistance));
+        outDistance = enter;
+        return enter <= exit;
+    }
+};
+
+enum FrustumOverlap {
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECTS,
+    FRUSTUM_INSIDE
+};
+
+//world space planes as (normal, distance), points inside have dot(normal, p) + distance >= 0
+struct Frustum {
+    glm::vec4 planes[FRUSTUM_PLANE_COUNT];
+
+    //works for the GL style projection the engine uses, the near plane is the -w clip plane and so a little looser
+    //than the one vulkan clips against, which only keeps more objects
+    static Frustum fromViewProjection(const glm::mat4 &viewProjection) {
+        glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+        Frustum frustum;
+        frustum.planes[FRUSTUM_LEFT] = row3 + row0;
+        frustum.planes[FRUSTUM_RIGHT] = row3 - row0;
+        frustum.planes[FRUSTUM_BOTTOM] = row3 + row1;
+        frustum.planes[FRUSTUM_TOP] = row3 - row1;
+        frustum.planes[FRUSTUM_NEAR] = row3 + row2;
+        frustum.planes[FRUSTUM_FAR] = row3 - row2;
+        for (glm::vec4 &plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    bool intersectsSphere(const glm::vec3 &center, float radius) const {
+        for (const glm::vec4 &plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //tests the box corner furthest along each plane normal, and the nearest one for full containment
+    FrustumOverlap classifyAabb(const Aabb &box) const {
+        FrustumOverlap result = FRUSTUM_INSIDE;
+        for (const glm::vec4 &plane : planes) {
+            glm::vec3 normal(plane);
+            glm::vec3 positive(normal.x >= 0.0f ? box.maximum.x : box.minimum.x,
+                               normal.y >= 0.0f ? box.maximum.y : box.minimum.y,
+                               normal.z >= 0.0f ? box.maximum.z : box.minimum.z);
+            if (glm::dot(normal, positive) + plane.w < 0.0f) {
+                return FRUSTUM_OUTSIDE;
+            }
+            glm::vec3 negative(normal.x >= 0.0f ? box.minimum.x : box.maximum.x,
+                               normal.y >= 0.0f ? box.minimum.y : box.maximum.y,
+                               normal.z >= 0.0f ? box.minimum.z : box.maximum.z);
+            if (glm::dot(normal, negative) + plane.w < 0.0f) {
+                result = FRUSTUM_INTERSECTS;
+            }
+        }
+        return result;
+    }
+};
+
+//bounding sphere of a mesh after model, xyz is the center and w the radius
+inline glm::vec4 transformSphere(const glm::vec3 &center, float radius, const glm::mat4 &model) {
+    //the largest axis scale keeps the sphere conservative under non-uniform scaling
+    float scale = glm::max(glm::length(glm::vec3(model[0])),
+                           glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    return glm::vec4(glm::vec3(model * glm::vec4(center, 1.0f)), radius * scale);
+}
+
+#endif //VULKAN_STEP_BY_STEP_BOUNDS_H
@@ -0,0 +1,350 @@
+#include "bvh.h"
+#include <algorithm>
+
+namespace {
+    //relative cost of visiting a node against testing an item, for the SAH
+    const float TRAVERSAL_COST = 1.0f;
+    const float ITEM_COST = 1.0f;
+    //below this depth nodes are halved instead, which bounds the tree depth for the fixed query stacks
+    const uint32_t SAH_MAX_DEPTH = 32;
+
+    struct Bin {
+        Aabb bounds;
+        uint32_t count = 0;
+    };
+
+    struct Split {
+        int axis = -1;
+        //items in bins [0, bin] go left
+        uint32_t bin = 0;
+        float cost = FLT_MAX;
+    };
+
+    Split findBestSplit(const std::vector<glm::vec3> &centroids, const std::vector<Aabb> &items,
+                        const uint32_t *first, uint32_t count, const Aabb &centroidBounds) {
+        Split best;
+        for (int axis = 0; axis < 3; axis++) {
+            float low = centroidBounds.minimum[axis];
+            float extent = centroidBounds.maximum[axis] - low;
+            if (extent <= 0.0f) {
+                continue;
+            }
+
+            Bin bins[Bvh::BIN_COUNT];
+            float scale = Bvh::BIN_COUNT / extent;
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t item = first[i];
+                uint32_t bin = std::min((uint32_t) ((centroids[item][axis] - low) * scale), Bvh::BIN_COUNT - 1);
+                bins[bin].bounds.expand(items[item]);
+                bins[bin].count++;
+            }
+
+            //sweep from the right to get the area and count of everything past each split plane
+            float rightArea[Bvh::BIN_COUNT];
+            uint32_t rightCount[Bvh::BIN_COUNT];
+            Aabb right;
+            uint32_t rightItems = 0;
+            for (uint32_t bin = Bvh::BIN_COUNT - 1; bin > 0; bin--) {
+                right.expand(bins[bin].bounds);
+                rightItems += bins[bin].count;
+                rightArea[bin] = right.surfaceArea();
+                rightCount[bin] = rightItems;
+            }
+
+            Aabb left;
+            uint32_t leftItems = 0;
+            for (uint32_t bin = 0; bin < Bvh::BIN_COUNT - 1; bin++) {
+                left.expand(bins[bin].bounds);
+                leftItems += bins[bin].count;
+                if (leftItems == 0 || rightCount[bin + 1] == 0) {
+                    continue;
+                }
+                float cost = left.surfaceArea() * leftItems + rightArea[bin + 1] * rightCount[bin + 1];
+                if (cost < best.cost) {
+                    best.axis = axis;
+                    best.bin = bin;
+                    best.cost = cost;
+                }
+            }
+        }
+        return best;
+    }
+}
+
+void Bvh::build(const std::vector<Aabb> &items) {
+    _nodes.clear();
+    _items.resize(items.size());
+    _itemBounds.resize(items.size());
+    if (items.empty()) {
+        _buildCost = _cost = 0.0f;
+        return;
+    }
+
+    std::vector<glm::vec3> centroids(items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        _items[i] = (uint32_t) i;
+        centroids[i] = items[i].center();
+    }
+
+    //a binary tree with at least one item per leaf has fewer than 2n nodes
+    _nodes.reserve(items.size() * 2);
+    BvhNode root = {};
+    root.itemCount = (uint32_t) items.size();
+    _nodes.push_back(root);
+
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> depths;
+    stack.push_back(0);
+    depths.push_back(0);
+    while (!stack.empty()) {
+        uint32_t nodeIndex = stack.back();
+        uint32_t depth = depths.back();
+        stack.pop_back();
+        depths.pop_back();
+
+        uint32_t firstItem = _nodes[nodeIndex].firstItem;
+        uint32_t itemCount = _nodes[nodeIndex].itemCount;
+        uint32_t *first = _items.data() + firstItem;
+
+        Aabb bounds;
+        Aabb centroidBounds;
+        for (uint32_t i = 0; i < itemCount; i++) {
+            bounds.expand(items[first[i]]);
+            centroidBounds.expand(centroids[first[i]]);
+        }
+        _nodes[nodeIndex].bounds = bounds;
+        if (itemCount <= MAX_LEAF_ITEMS) {
+            continue;
+        }
+
+        Split split;
+        if (depth < SAH_MAX_DEPTH) {
+            split = findBestSplit(centroids, items, first, itemCount, centroidBounds);
+        }
+        uint32_t leftCount;
+        if (split.axis < 0) {
+            //too deep or all centroids in one point, a median split along the widest axis keeps leaves small
+            glm::vec3 extent = centroidBounds.maximum - centroidBounds.minimum;
+            int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+            leftCount = itemCount / 2;
+            std::nth_element(first, first + leftCount, first + itemCount, [&](uint32_t a, uint32_t b) {
+                return centroids[a][axis] < centroids[b][axis];
+            });
+        } else {
+            //SAH leaf test relative to the node area, the traversal cost is what splitting has to beat
+            float splitCost = TRAVERSAL_COST + ITEM_COST * split.cost / bounds.surfaceArea();
+            if (bounds.surfaceArea() > 0.0f && splitCost >= ITEM_COST * itemCount && itemCount <= 4 * MAX_LEAF_ITEMS) {
+                continue;
+            }
+            int axis = split.axis;
+            float low = centroidBounds.minimum[axis];
+            float scale = BIN_COUNT / (centroidBounds.maximum[axis] - low);
+            uint32_t lastLeftBin = split.bin;
+            leftCount = (uint32_t) (std::partition(first, first + itemCount, [&](uint32_t item) {
+                return std::min((uint32_t) ((centroids[item][axis] - low) * scale), BIN_COUNT - 1) <= lastLeftBin;
+            }) - first);
+        }
+
+        uint32_t leftChild = (uint32_t) _nodes.size();
+        BvhNode left = {};
+        left.firstItem = firstItem;
+        left.itemCount = leftCount;
+        BvhNode right = {};
+        right.firstItem = firstItem + leftCount;
+        right.itemCount = itemCount - leftCount;
+        _nodes.push_back(left);
+        _nodes.push_back(right);
+        _nodes[nodeIndex].leftChild = leftChild;
+
+        stack.push_back(leftChild + 1);
+        stack.push_back(leftChild);
+        depths.push_back(depth + 1);
+        depths.push_back(depth + 1);
+    }
+
+    for (size_t i = 0; i < _items.size(); i++) {
+        _itemBounds[i] = items[_items[i]];
+    }
+    _buildCost = _cost = computeCost();
+}
+
+void Bvh::refit(const std::vector<Aabb> &items) {
+    for (size_t i = 0; i < _items.size(); i++) {
+        _itemBounds[i] = items[_items[i]];
+    }
+
+    //children are always created after their parent, so walking backwards visits them first
+    for (size_t n = _nodes.size(); n-- > 0;) {
+        BvhNode &node = _nodes[n];
+        Aabb bounds;
+        if (node.isLeaf()) {
+            for (uint32_t i = 0; i < node.itemCount; i++) {
+                bounds.expand(_itemBounds[node.firstItem + i]);
+            }
+        } else {
+            bounds.expand(_nodes[node.leftChild].bounds);
+            bounds.expand(_nodes[node.leftChild + 1].bounds);
+        }
+        node.bounds = bounds;
+    }
+    _cost = computeCost();
+}
+
+float Bvh::computeCost() const {
+    if (_nodes.empty()) {
+        return 0.0f;
+    }
+    float rootArea = _nodes[0].bounds.surfaceArea();
+    if (rootArea <= 0.0f) {
+        return 0.0f;
+    }
+
+    float cost = 0.0f;
+    for (const BvhNode &node : _nodes) {
+        float probability = node.bounds.surfaceArea() / rootArea;
+        cost += probability * (node.isLeaf() ? ITEM_COST * node.itemCount : TRAVERSAL_COST);
+    }
+    return cost;
+}
+
+float Bvh::costRatio() const {
+    return _buildCost > 0.0f ? _cost / _buildCost : 1.0f;
+}
+
+void Bvh::appendItems(const BvhNode &node, std::vector<uint32_t> &out) const {
+    out.insert(out.end(), _items.begin() + node.firstItem, _items.begin() + node.firstItem + node.itemCount);
+}
+
+void Bvh::queryFrustum(const Frustum &frustum, std::vector<uint32_t> &out) const {
+    if (_nodes.empty()) {
+        return;
+    }
+
+    uint32_t stack[MAX_DEPTH];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const BvhNode &node = _nodes[stack[--stackSize]];
+        FrustumOverlap overlap = frustum.classifyAabb(node.bounds);
+        if (overlap == FRUSTUM_OUTSIDE) {
+            continue;
+        }
+        //nothing below a contained node can be outside, skip the remaining tests
+        if (overlap == FRUSTUM_INSIDE) {
+            appendItems(node, out);
+        } else if (node.isLeaf()) {
+            for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; i++) {
+                if (frustum.classifyAabb(_itemBounds[i]) != FRUSTUM_OUTSIDE) {
+                    out.push_back(_items[i]);
+                }
+            }
+        } else {
+            stack[stackSize++] = node.leftChild + 1;
+            stack[stackSize++] = node.leftChild;
+        }
+    }
+}
+
+void Bvh::queryAabb(const Aabb &box, std::vector<uint32_t> &out) const {
+    if (_nodes.empty()) {
+        return;
+    }
+
+    uint32_t stack[MAX_DEPTH];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const BvhNode &node = _nodes[stack[--stackSize]];
+        if (!node.bounds.overlaps(box)) {
+            continue;
+        }
+        if (node.isLeaf()) {
+            for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; i++) {
+                if (_itemBounds[i].overlaps(box)) {
+                    out.push_back(_items[i]);
+                }
+            }
+        } else {
+            stack[stackSize++] = node.leftChild + 1;
+            stack[stackSize++] = node.leftChild;
+        }
+    }
+}
+
+void Bvh::querySphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &out) const {
+    if (_nodes.empty()) {
+        return;
+    }
+
+    uint32_t stack[MAX_DEPTH];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const BvhNode &node = _nodes[stack[--stackSize]];
+        if (!node.bounds.overlapsSphere(center, radius)) {
+            continue;
+        }
+        if (node.isLeaf()) {
+            for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; i++) {
+                if (_itemBounds[i].overlapsSphere(center, radius)) {
+                    out.push_back(_items[i]);
+                }
+            }
+        } else {
+            stack[stackSize++] = node.leftChild + 1;
+            stack[stackSize++] = node.leftChild;
+        }
+    }
+}
+
+bool Bvh::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, uint32_t &outItem,
+                  float &outDistance) const {
+    if (_nodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 inverseDirection = 1.0f / direction;
+    float closest = maxDistance;
+    bool hit = false;
+
+    uint32_t stack[MAX_DEPTH];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const BvhNode &node = _nodes[stack[--stackSize]];
+        float distance;
+        if (!node.bounds.intersectsRay(origin, inverseDirection, closest, distance)) {
+            continue;
+        }
+        if (node.isLeaf()) {
+            for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; i++) {
+                if (_itemBounds[i].intersectsRay(origin, inverseDirection, closest, distance)) {
+                    closest = distance;
+                    outItem = _items[i];
+                    hit = true;
+                }
+            }
+            continue;
+        }
+
+        //visit the nearer child first, so the hit distance shrinks early and prunes the farther one
+        const BvhNode &left = _nodes[node.leftChild];
+        const BvhNode &right = _nodes[node.leftChild + 1];
+        float leftDistance;
+        float rightDistance;
+        bool leftHit = left.bounds.intersectsRay(origin, inverseDirection, closest, leftDistance);
+        bool rightHit = right.bounds.intersectsRay(origin, inverseDirection, closest, rightDistance);
+        if (leftHit && rightHit) {
+            bool leftFirst = leftDistance <= rightDistance;
+            stack[stackSize++] = leftFirst ? node.leftChild + 1 : node.leftChild;
+            stack[stackSize++] = leftFirst ? node.leftChild : node.leftChild + 1;
+        } else if (leftHit) {
+            stack[stackSize++] = node.leftChild;
+        } else if (rightHit) {
+            stack[stackSize++] = node.leftChild + 1;
+        }
+    }
+
+    outDistance = closest;
+    return hit;
+}
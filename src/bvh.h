@@ -0,0 +1,71 @@
+#ifndef VULKAN_STEP_BY_STEP_BVH_H
+#define VULKAN_STEP_BY_STEP_BVH_H
+
+#include <cstdint>
+#include <vector>
+#include "bounds.h"
+
+struct BvhNode {
+    Aabb bounds;
+    //0 for leaves, the root is never a child. the second child sits right behind the first
+    uint32_t leftChild;
+    //every node covers the items [firstItem, firstItem + itemCount) of the reordered item list, inner nodes
+    //through their subtree
+    uint32_t firstItem;
+    uint32_t itemCount;
+
+    bool isLeaf() const { return leftChild == 0; }
+};
+
+//bounding volume hierarchy over item boxes, built top down with binned SAH splits. moving items are handled by
+//refitting the node bounds in place, which loosens the tree over time, so callers rebuild once needsRebuild()
+//says the SAH cost has grown too far. queries return item indices in the order of the boxes passed to build
+class Bvh {
+public:
+    static const uint32_t BIN_COUNT = 16;
+    static const uint32_t MAX_LEAF_ITEMS = 4;
+    //deepest tree the traversal stacks hold, build keeps below it for up to 2^31 items
+    static const uint32_t MAX_DEPTH = 64;
+
+    void build(const std::vector<Aabb> &items);
+
+    //same items in the same order as the last build, with new bounds
+    void refit(const std::vector<Aabb> &items);
+
+    //SAH cost of the current tree over its cost right after the last build
+    float costRatio() const;
+
+    bool needsRebuild(float maxCostRatio = 1.5f) const { return costRatio() > maxCostRatio; }
+
+    size_t itemCount() const { return _items.size(); }
+
+    const std::vector<BvhNode> &nodes() const { return _nodes; }
+
+    //the query functions append to out, items whose box touches the volume
+    void queryFrustum(const Frustum &frustum, std::vector<uint32_t> &out) const;
+
+    void queryAabb(const Aabb &box, std::vector<uint32_t> &out) const;
+
+    void querySphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &out) const;
+
+    //nearest item box the ray enters within maxDistance, direction does not need to be normalized but distances
+    //are in units of its length
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, uint32_t &outItem,
+                 float &outDistance) const;
+
+private:
+    //every item of a node once the frustum contains it fully
+    void appendItems(const BvhNode &node, std::vector<uint32_t> &out) const;
+
+    float computeCost() const;
+
+    std::vector<BvhNode> _nodes;
+    //item indices in leaf order
+    std::vector<uint32_t> _items;
+    //item boxes in the same order, so leaves read them sequentially
+    std::vector<Aabb> _itemBounds;
+    float _buildCost = 0.0f;
+    float _cost = 0.0f;
+};
+
+#endif //VULKAN_STEP_BY_STEP_BVH_H
@@ -0,0 +1,72 @@
+#include "camera_path.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+bool CameraPath::loadFromFile(const char *filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to open camera path " << filename << std::endl;
+        return false;
+    }
+
+    _keyframes.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream stream(line);
+        CameraKeyframe keyframe;
+        if (!(stream >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+                     >> keyframe.yaw >> keyframe.pitch)) {
+            std::cout << "Malformed camera keyframe at " << filename << ":" << lineNumber << std::endl;
+            return false;
+        }
+        if (!_keyframes.empty() && keyframe.time < _keyframes.back().time) {
+            std::cout << "Camera keyframes are not sorted by time at " << filename << ":" << lineNumber << std::endl;
+            return false;
+        }
+        _keyframes.push_back(keyframe);
+    }
+
+    if (_keyframes.empty()) {
+        std::cout << "Camera path " << filename << " has no keyframes" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void CameraPath::sample(float time, glm::vec3 &outPosition, float &outYaw, float &outPitch) const {
+    if (_keyframes.empty()) {
+        return;
+    }
+
+    size_t next = 0;
+    while (next < _keyframes.size() && _keyframes[next].time <= time) {
+        next++;
+    }
+
+    if (next == 0 || next == _keyframes.size()) {
+        const CameraKeyframe &edge = _keyframes[next == 0 ? 0 : next - 1];
+        outPosition = edge.position;
+        outYaw = edge.yaw;
+        outPitch = edge.pitch;
+        return;
+    }
+
+    const CameraKeyframe &a = _keyframes[next - 1];
+    const CameraKeyframe &b = _keyframes[next];
+    float span = b.time - a.time;
+    float t = span > 0.0f ? (time - a.time) / span : 1.0f;
+
+    outPosition = glm::mix(a.position, b.position, t);
+    outYaw = glm::mix(a.yaw, b.yaw, t);
+    outPitch = glm::mix(a.pitch, b.pitch, t);
+}
+
+float CameraPath::duration() const {
+    return _keyframes.empty() ? 0.0f : _keyframes.back().time;
+}
@@ -0,0 +1,32 @@
+#ifndef VULKAN_STEP_BY_STEP_CAMERA_PATH_H
+#define VULKAN_STEP_BY_STEP_CAMERA_PATH_H
+
+#include <glm.hpp>
+#include <vector>
+
+struct CameraKeyframe {
+    float time;
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+//keyframed camera flight for benchmark runs. the file holds one keyframe per line:
+//    time x y z yaw pitch
+//lines starting with # are comments, keyframes must be sorted by time
+class CameraPath {
+public:
+    bool loadFromFile(const char *filename);
+
+    //linear interpolation between the surrounding keyframes, clamped to the ends of the path
+    void sample(float time, glm::vec3 &outPosition, float &outYaw, float &outPitch) const;
+
+    float duration() const;
+
+    bool empty() const { return _keyframes.empty(); }
+
+private:
+    std::vector<CameraKeyframe> _keyframes;
+};
+
+#endif //VULKAN_STEP_BY_STEP_CAMERA_PATH_H
@@ -0,0 +1,150 @@
+#include "cpu_profiler.h"
+
+#ifdef ENABLE_CPU_PROFILER
+
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+    struct ZoneEvent {
+        uint32_t nameId;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    //a ring entry. the owning thread may overwrite it while a reader copies it, so every field is an atomic
+    struct ZoneSlot {
+        std::atomic<uint32_t> nameId;
+        std::atomic<uint64_t> start;
+        std::atomic<uint64_t> end;
+    };
+
+    //single producer ring, only the owning thread writes. readers take a snapshot up to the published head, then
+    //drop the oldest entries the writer may have started overwriting meanwhile, which reserved tells
+    struct ThreadBuffer {
+        uint32_t threadId;
+        std::vector<ZoneSlot> slots;
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> reserved;
+
+        explicit ThreadBuffer(uint32_t threadId)
+                : threadId(threadId), slots(cpuprof::RING_CAPACITY), head(0), reserved(0) {}
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::string> zoneNames;
+        std::vector<std::unique_ptr<ThreadBuffer>> threads;
+    };
+
+    Registry &registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    thread_local ThreadBuffer *threadBuffer = nullptr;
+
+    ThreadBuffer *createThreadBuffer() {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.threads.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer((uint32_t) reg.threads.size())));
+        return reg.threads.back().get();
+    }
+}
+
+uint32_t cpuprof::registerZone(const char *name) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.zoneNames.push_back(name);
+    return (uint32_t) reg.zoneNames.size() - 1;
+}
+
+void cpuprof::recordZone(uint32_t nameId, uint64_t start, uint64_t end) {
+    ThreadBuffer *buffer = threadBuffer;
+    if (!buffer) {
+        buffer = threadBuffer = createThreadBuffer();
+    }
+    uint64_t index = buffer->head.load(std::memory_order_relaxed);
+    //announced before the slot changes, a reader that sees any of the new fields also sees this
+    buffer->reserved.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ZoneSlot &slot = buffer->slots[index & (RING_CAPACITY - 1)];
+    slot.nameId.store(nameId, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    buffer->head.store(index + 1, std::memory_order_release);
+}
+
+bool cpuprof::writeChromeTrace(const std::string &path) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Failed to write CPU trace " << path << std::endl;
+        return false;
+    }
+
+    struct Snapshot {
+        uint32_t threadId;
+        std::vector<ZoneEvent> events;
+    };
+    std::vector<Snapshot> snapshots;
+    uint64_t origin = UINT64_MAX;
+
+    for (const std::unique_ptr<ThreadBuffer> &thread : reg.threads) {
+        uint64_t head = thread->head.load(std::memory_order_acquire);
+        uint64_t first = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+
+        Snapshot snapshot;
+        snapshot.threadId = thread->threadId;
+        snapshot.events.reserve(head - first);
+        for (uint64_t i = first; i < head; i++) {
+            const ZoneSlot &slot = thread->slots[i & (RING_CAPACITY - 1)];
+            ZoneEvent event;
+            event.nameId = slot.nameId.load(std::memory_order_relaxed);
+            event.start = slot.start.load(std::memory_order_relaxed);
+            event.end = slot.end.load(std::memory_order_relaxed);
+            snapshot.events.push_back(event);
+        }
+
+        //entries the thread reserved since the copy started may reuse the slots of the oldest copied ones
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t reserved = thread->reserved.load(std::memory_order_relaxed);
+        uint64_t intact = reserved > RING_CAPACITY ? reserved - RING_CAPACITY : 0;
+        if (intact > first) {
+            snapshot.events.erase(snapshot.events.begin(),
+                                  snapshot.events.begin() + (size_t) std::min(intact - first, head - first));
+        }
+        for (const ZoneEvent &event : snapshot.events) {
+            origin = std::min(origin, event.start);
+        }
+        snapshots.push_back(std::move(snapshot));
+    }
+
+    //trace_event timestamps are in microseconds
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+    bool first = true;
+    for (const Snapshot &snapshot : snapshots) {
+        for (const ZoneEvent &event : snapshot.events) {
+            file << (first ? "" : ",\n") << "{\"name\": \"" << reg.zoneNames[event.nameId]
+                 << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << snapshot.threadId
+                 << ", \"ts\": " << (event.start - origin) / 1000.0
+                 << ", \"dur\": " << (event.end - event.start) / 1000.0 << "}";
+            first = false;
+        }
+    }
+    file << "\n]}\n";
+
+    std::cout << "CPU trace written to " << path << std::endl;
+    return true;
+}
+
+#endif
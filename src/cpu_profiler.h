@@ -0,0 +1,64 @@
+#ifndef VULKAN_STEP_BY_STEP_CPU_PROFILER_H
+#define VULKAN_STEP_BY_STEP_CPU_PROFILER_H
+
+//CPU zone instrumentation. build with ENABLE_CPU_PROFILER to record zones, otherwise every macro expands to nothing.
+//
+//    void VulkanEngine::draw() {
+//        CPU_ZONE("draw");
+//        ...
+//    }
+
+#ifdef ENABLE_CPU_PROFILER
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace cpuprof {
+
+    //events kept per thread, older ones are overwritten
+    const uint32_t RING_CAPACITY = 1 << 16;
+
+    inline uint64_t now() {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    //call once per call site, CPU_ZONE caches the id in a function-local static
+    uint32_t registerZone(const char *name);
+
+    //appends to the calling thread's ring buffer, no locks or allocations after the thread's first zone
+    void recordZone(uint32_t nameId, uint64_t start, uint64_t end);
+
+    //writes the contents of every thread's ring as a chrome://tracing trace_event file
+    bool writeChromeTrace(const std::string &path);
+
+    struct ScopedZone {
+        uint32_t nameId;
+        uint64_t start;
+
+        explicit ScopedZone(uint32_t nameId) : nameId(nameId), start(now()) {}
+
+        ~ScopedZone() {
+            recordZone(nameId, start, now());
+        }
+    };
+}
+
+#define CPU_PROFILER_CONCAT_IMPL(a, b) a##b
+#define CPU_PROFILER_CONCAT(a, b) CPU_PROFILER_CONCAT_IMPL(a, b)
+
+#define CPU_ZONE(name)                                                                                  \
+    static const uint32_t CPU_PROFILER_CONCAT(cpuZoneId, __LINE__) = cpuprof::registerZone(name);       \
+    cpuprof::ScopedZone CPU_PROFILER_CONCAT(cpuZone, __LINE__)(CPU_PROFILER_CONCAT(cpuZoneId, __LINE__))
+
+#define CPU_PROFILER_WRITE_TRACE(path) cpuprof::writeChromeTrace(path)
+
+#else
+
+#define CPU_ZONE(name)
+#define CPU_PROFILER_WRITE_TRACE(path)
+
+#endif
+
+#endif //VULKAN_STEP_BY_STEP_CPU_PROFILER_H
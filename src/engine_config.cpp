@@ -0,0 +1,218 @@
+#include "engine_config.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+
+static bool parsePresentMode(const char *name, VkPresentModeKHR &outMode) {
+    if (strcmp(name, "fifo") == 0) {
+        outMode = VK_PRESENT_MODE_FIFO_KHR;
+    } else if (strcmp(name, "mailbox") == 0) {
+        outMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    } else if (strcmp(name, "immediate") == 0) {
+        outMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parseUpscaleFilter(const char *name, UpscaleFilter &outFilter) {
+    if (strcmp(name, "bilinear") == 0) {
+        outFilter = UPSCALE_BILINEAR;
+    } else if (strcmp(name, "edge") == 0) {
+        outFilter = UPSCALE_EDGE_AWARE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+//the whole of text as an integer between min and max, unlike atoi it rejects trailing garbage and overflow
+static bool parseInteger(const char *text, long min, long max, uint32_t &outValue) {
+    char *end;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || value < min || value > max) {
+        return false;
+    }
+    outValue = (uint32_t) value;
+    return true;
+}
+
+//the whole of text as a finite number
+static bool parseNumber(const char *text, float &outValue) {
+    char *end;
+    float value = strtof(text, &end);
+    if (end == text || *end != '\0' || !std::isfinite(value)) {
+        return false;
+    }
+    outValue = value;
+    return true;
+}
+
+bool EngineConfig::parseArgs(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (strcmp(arg, "--frames-in-flight") == 0 && value) {
+            if (!parseInteger(value, 1, MAX_FRAMES_IN_FLIGHT, framesInFlight)) {
+                std::cerr << "--frames-in-flight must be between 1 and " << MAX_FRAMES_IN_FLIGHT << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--present-mode") == 0 && value) {
+            if (!parsePresentMode(value, presentMode)) {
+                std::cerr << "Unknown present mode " << value << ", expected fifo, mailbox or immediate" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(arg, "--frames") == 0 && value) {
+            if (!parseInteger(value, 1, INT32_MAX, frameCount)) {
+                std::cerr << "--frames must be a positive number of frames" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--benchmark") == 0 && value) {
+            benchmarkPath = value;
+            i++;
+        } else if (strcmp(arg, "--warmup") == 0 && value) {
+            if (!parseInteger(value, 0, INT32_MAX, benchmarkWarmupFrames)) {
+                std::cerr << "--warmup must be a number of frames, 0 or more" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--timestep") == 0 && value) {
+            if (!parseNumber(value, benchmarkTimestep) || benchmarkTimestep <= 0.0f) {
+                std::cerr << "--timestep must be a number of seconds larger than 0" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--benchmark-out") == 0 && value) {
+            benchmarkOutput = value;
+            i++;
+        } else if (strcmp(arg, "--gpu-profile") == 0 && value) {
+            gpuProfileOutput = value;
+            i++;
+        } else if (strcmp(arg, "--cpu-trace") == 0 && value) {
+            cpuTraceOutput = value;
+            i++;
+        } else if (strcmp(arg, "--lod-error") == 0 && value) {
+            if (!parseNumber(value, lodErrorPixels) || lodErrorPixels < 0.0f) {
+                std::cerr << "--lod-error must be a number of pixels, 0 or more" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--no-occlusion-culling") == 0) {
+            occlusionCulling = false;
+        } else if (strcmp(arg, "--depth-prepass") == 0) {
+            depthPrepass = true;
+        } else if (strcmp(arg, "--lights") == 0 && value) {
+            if (!parseInteger(value, 0, MAX_LIGHTS, lightCount)) {
+                std::cerr << "--lights must be between 0 and " << MAX_LIGHTS << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--shadow-map-size") == 0 && value) {
+            if (!parseInteger(value, 64, 8192, shadowMapSize)) {
+                std::cerr << "--shadow-map-size must be between 64 and 8192" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--shadow-distance") == 0 && value) {
+            if (!parseNumber(value, shadowDistance) || shadowDistance <= 1.0f) {
+                std::cerr << "--shadow-distance must be a number larger than 1" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--gpu-budget") == 0 && value) {
+            if (!parseNumber(value, gpuBudgetMilliseconds) || gpuBudgetMilliseconds < 0.0f) {
+                std::cerr << "--gpu-budget must be a number of milliseconds, 0 keeps the full resolution" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--min-resolution-scale") == 0 && value) {
+            if (!parseNumber(value, minResolutionScale) || minResolutionScale < 0.1f || minResolutionScale > 1.0f) {
+                std::cerr << "--min-resolution-scale must be between 0.1 and 1" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--upscale-filter") == 0 && value) {
+            if (!parseUpscaleFilter(value, upscaleFilter)) {
+                std::cerr << "Unknown upscale filter " << value << ", expected bilinear or edge" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--defrag-mb") == 0 && value) {
+            if (!parseInteger(value, 0, INT32_MAX, defragMegabytesPerPass)) {
+                std::cerr << "--defrag-mb must be a number of megabytes, 0 never defragments" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--virtual-texture") == 0) {
+            virtualTexturing = true;
+        } else if (strcmp(arg, "--vt-cache") == 0 && value) {
+            //whole pages per side, and a power of two like the page size
+            if (!parseInteger(value, 2 * VIRTUAL_TEXTURE_PAGE_SIZE, 16384, virtualTextureCacheSize) ||
+                (virtualTextureCacheSize & (virtualTextureCacheSize - 1)) != 0) {
+                std::cerr << "--vt-cache must be a power of two between " << 2 * VIRTUAL_TEXTURE_PAGE_SIZE
+                          << " and 16384" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--scene-obj") == 0 && value) {
+            sceneObj = value;
+            i++;
+        } else if (strcmp(arg, "--texture-threads") == 0 && value) {
+            if (!parseInteger(value, 0, 256, textureThreads)) {
+                std::cerr << "--texture-threads must be between 0 and 256, 0 uses one per core" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--scene-glb") == 0 && value) {
+            sceneGlb = value;
+            i++;
+        } else if (strcmp(arg, "--archive") == 0 && value) {
+            archivePath = value;
+            i++;
+        } else if (strcmp(arg, "--residency-mb") == 0 && value) {
+            if (!parseInteger(value, 0, INT32_MAX, residencyBudgetMegabytes)) {
+                std::cerr << "--residency-mb must be a number of megabytes, 0 keeps everything resident" << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--memory-stats") == 0 && value) {
+            memoryStatsOutput = value;
+            i++;
+        } else if (strcmp(arg, "--chunk-triangles") == 0 && value) {
+            if (!parseInteger(value, 0, INT32_MAX, chunkTriangles)) {
+                std::cerr << "--chunk-triangles must be a number of triangles, 0 keeps meshes whole" << std::endl;
+                return false;
+            }
+            i++;
+        } else {
+            std::cerr << "Unknown argument " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+const char *presentModeName(VkPresentModeKHR mode) {
+    switch (mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR:
+            return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            return "fifo_relaxed";
+        default:
+            return "unknown";
+    }
+}
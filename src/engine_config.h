@@ -0,0 +1,86 @@
+#ifndef VULKAN_STEP_BY_STEP_ENGINE_CONFIG_H
+#define VULKAN_STEP_BY_STEP_ENGINE_CONFIG_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+
+//upper bound for the runtime frames-in-flight setting, sizes the per-frame arrays
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+//upper bound for --lights, sizes the light buffers
+constexpr uint32_t MAX_LIGHTS = 16384;
+//texels along each side of a virtual texture page, --vt-cache has to hold at least two pages per side
+constexpr uint32_t VIRTUAL_TEXTURE_PAGE_SIZE = 128;
+
+//how the scaled scene is stretched onto the swapchain image, matches upscale.frag
+enum UpscaleFilter {
+    UPSCALE_BILINEAR,
+    //bilinear plus contrast adaptive sharpening, which restores edges without ringing on flat areas
+    UPSCALE_EDGE_AWARE
+};
+
+struct EngineConfig {
+    uint32_t framesInFlight = 2;
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    //render into offscreen targets without GLFW, a surface or a swapchain, then exit after frameCount frames
+    bool headless = false;
+    //frames rendered by a headless run, or measured frames of a benchmark run
+    uint32_t frameCount = 1000;
+    //camera path file, enables a scripted benchmark run with a fixed timestep and no input
+    std::string benchmarkPath;
+    uint32_t benchmarkWarmupFrames = 120;
+    float benchmarkTimestep = 1.0f / 60.0f;
+    //per-frame timings go to <benchmarkOutput>.csv, per-frame timings and summary stats to <benchmarkOutput>.json
+    std::string benchmarkOutput = "benchmark";
+    //GPU scope timings are written to <gpuProfileOutput>.csv and .json on exit, empty disables the report
+    std::string gpuProfileOutput = "gpu_profile";
+    //chrome trace written on F12 and on exit when built with ENABLE_CPU_PROFILER
+    std::string cpuTraceOutput = "cpu_trace.json";
+    //largest on-screen simplification error in pixels a mesh LOD may have, 0 always draws full detail
+    float lodErrorPixels = 1.0f;
+    //two-phase hierarchical-Z occlusion culling, needs drawIndirectFirstInstance and rg32f storage images
+    bool occlusionCulling = true;
+    //lay down depth with a position-only pass first, so the colour pass shades every pixel once. F2 toggles it
+    bool depthPrepass = false;
+    //large static meshes are split into spatial chunks of about this many triangles that are culled separately,
+    //0 keeps them whole
+    uint32_t chunkTriangles = 4096;
+    //animated point lights scattered over the scene, shaded through the clustered light lists
+    uint32_t lightCount = 64;
+    //resolution of every sun shadow cascade
+    uint32_t shadowMapSize = 2048;
+    //view distance the shadow cascades cover
+    float shadowDistance = 80.0f;
+    //GPU frame time the render resolution is scaled to meet, 0 always renders at the window size
+    float gpuBudgetMilliseconds = 0.0f;
+    //lowest render scale per axis the budget may push the resolution to
+    float minResolutionScale = 0.5f;
+    UpscaleFilter upscaleFilter = UPSCALE_EDGE_AWARE;
+    //most bytes one incremental defragmentation pass copies, 0 never defragments
+    uint32_t defragMegabytesPerPass = 16;
+    //allocator statistics written on F3 and on exit, empty disables them
+    std::string memoryStatsOutput = "memory_stats.json";
+    //bytes of meshes and textures kept on the GPU, the least recently drawn go above it. 0 keeps everything
+    uint32_t residencyBudgetMegabytes = 0;
+    //stream the textured material's pages into a fixed size cache on demand instead of uploading the whole texture,
+    //needs fragmentStoresAndAtomics
+    bool virtualTexturing = false;
+    //side of the virtual texture's page cache in texels
+    uint32_t virtualTextureCacheSize = 2048;
+    //an OBJ drawn next to the level with the materials of its MTL file, e.g. sponza. empty adds nothing
+    std::string sceneObj;
+    //threads decoding the textures of a scene at once, 0 uses one per core
+    uint32_t textureThreads = 0;
+    //a binary glTF drawn on the other side of the level, its nodes placing the primitives. empty adds nothing
+    std::string sceneGlb;
+    //an archive baked by asset-packer. the meshes, textures and shaders it holds are read from it instead of their
+    //files, empty reads everything from files
+    std::string archivePath;
+
+    //reads the settings from the command line, returns false on a malformed argument
+    bool parseArgs(int argc, char **argv);
+};
+
+const char *presentModeName(VkPresentModeKHR mode);
+
+#endif //VULKAN_STEP_BY_STEP_ENGINE_CONFIG_H
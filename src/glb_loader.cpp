@@ -0,0 +1,527 @@
+#include "glb_loader.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/quaternion.hpp>
+#include <gtc/type_ptr.hpp>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t GLB_MAGIC = 0x46546C67;
+static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+static const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+static const uint32_t COMPONENT_BYTE = 5120;
+static const uint32_t COMPONENT_UNSIGNED_BYTE = 5121;
+static const uint32_t COMPONENT_SHORT = 5122;
+static const uint32_t COMPONENT_UNSIGNED_SHORT = 5123;
+static const uint32_t COMPONENT_UNSIGNED_INT = 5125;
+static const uint32_t COMPONENT_FLOAT = 5126;
+static const double MODE_TRIANGLES = 4.0;
+
+//the file is little endian, like every platform the engine runs on
+static uint32_t readU32(const uint8_t *bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static size_t componentSize(uint32_t componentType) {
+    switch (componentType) {
+        case COMPONENT_BYTE:
+        case COMPONENT_UNSIGNED_BYTE:
+            return 1;
+        case COMPONENT_SHORT:
+        case COMPONENT_UNSIGNED_SHORT:
+            return 2;
+        case COMPONENT_UNSIGNED_INT:
+        case COMPONENT_FLOAT:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+static uint32_t typeComponents(const JsonValue *type) {
+    if (!type || type->type != JSON_STRING) {
+        return 0;
+    }
+    if (type->string == "SCALAR") {
+        return 1;
+    } else if (type->string == "VEC2") {
+        return 2;
+    } else if (type->string == "VEC3") {
+        return 3;
+    } else if (type->string == "VEC4") {
+        return 4;
+    }
+    return 0;
+}
+
+static float readComponent(const uint8_t *bytes, uint32_t componentType, bool normalized) {
+    switch (componentType) {
+        case COMPONENT_FLOAT: {
+            float value;
+            memcpy(&value, bytes, sizeof(value));
+            return value;
+        }
+        case COMPONENT_BYTE: {
+            float value = (float) (int8_t) bytes[0];
+            return normalized ? glm::max(value / 127.0f, -1.0f) : value;
+        }
+        case COMPONENT_UNSIGNED_BYTE:
+            return normalized ? bytes[0] / 255.0f : (float) bytes[0];
+        case COMPONENT_SHORT: {
+            int16_t value;
+            memcpy(&value, bytes, sizeof(value));
+            return normalized ? glm::max(value / 32767.0f, -1.0f) : (float) value;
+        }
+        case COMPONENT_UNSIGNED_SHORT: {
+            uint16_t value;
+            memcpy(&value, bytes, sizeof(value));
+            return normalized ? value / 65535.0f : (float) value;
+        }
+        default:
+            return (float) readU32(bytes);
+    }
+}
+
+static uint32_t readIndex(const uint8_t *bytes, uint32_t componentType) {
+    if (componentType == COMPONENT_UNSIGNED_BYTE) {
+        return bytes[0];
+    } else if (componentType == COMPONENT_UNSIGNED_SHORT) {
+        uint16_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    return readU32(bytes);
+}
+
+static const JsonValue *findArray(const JsonValue &object, const char *key) {
+    const JsonValue *value = object.find(key);
+    return value && value->type == JSON_ARRAY ? value : nullptr;
+}
+
+//a reference to one of count elements
+static bool toIndex(const JsonValue *value, size_t count, uint32_t &outIndex) {
+    if (!value || value->type != JSON_NUMBER || value->number < 0.0 || value->number >= (double) count) {
+        return false;
+    }
+    outIndex = (uint32_t) value->number;
+    return true;
+}
+
+//sizes and offsets, negative or absurd values come back as SIZE_MAX so every bounds check fails
+static size_t sizeMember(const JsonValue &object, const char *key) {
+    double value = object.getNumber(key, 0.0);
+    return value >= 0.0 && value < 1e15 ? (size_t) value : SIZE_MAX;
+}
+
+bool GlbFile::open(const char *path) {
+    close();
+#ifndef _WIN32
+    int file = ::open(path, O_RDONLY);
+    if (file < 0) {
+        std::cout << "Failed to open glTF file " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    void *mapped = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0) {
+        mapped = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    ::close(file);
+    if (mapped == MAP_FAILED) {
+        std::cout << "Failed to map glTF file " << path << std::endl;
+        return false;
+    }
+    _data = (const uint8_t *) mapped;
+    _size = (size_t) info.st_size;
+#else
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        std::cout << "Failed to open glTF file " << path << std::endl;
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    _contents.resize((size_t) ftell(file));
+    fseek(file, 0, SEEK_SET);
+    size_t read = fread(_contents.data(), 1, _contents.size(), file);
+    fclose(file);
+    _data = _contents.data();
+    _size = read;
+#endif
+
+    //a 12 byte header, then chunks of length, type and data. the JSON chunk comes first, the binary one may follow
+    if (_size < 20 || readU32(_data) != GLB_MAGIC || readU32(_data + 4) != 2 || readU32(_data + 8) > _size) {
+        std::cout << path << " is no binary glTF 2.0 file" << std::endl;
+        close();
+        return false;
+    }
+    size_t length = readU32(_data + 8);
+    size_t offset = 12;
+    bool hasJson = false;
+    while (offset + 8 <= length) {
+        size_t chunkLength = readU32(_data + offset);
+        uint32_t chunkType = readU32(_data + offset + 4);
+        const uint8_t *chunk = _data + offset + 8;
+        if (chunkLength > length - offset - 8) {
+            break;
+        }
+        if (!hasJson) {
+            if (chunkType != GLB_CHUNK_JSON || !parseJson((const char *) chunk, chunkLength, _json)) {
+                break;
+            }
+            hasJson = true;
+        } else if (chunkType == GLB_CHUNK_BIN && !_binary) {
+            _binary = chunk;
+            _binarySize = chunkLength;
+        }
+        offset += 8 + ((chunkLength + 3) & ~(size_t) 3);
+    }
+    if (!hasJson) {
+        std::cout << "The JSON chunk of " << path << " is malformed" << std::endl;
+        close();
+        return false;
+    }
+
+    _directory = path;
+    size_t slash = _directory.find_last_of("/\\");
+    _directory = slash == std::string::npos ? "" : _directory.substr(0, slash + 1);
+    return true;
+}
+
+void GlbFile::close() {
+#ifndef _WIN32
+    if (_data) {
+        munmap((void *) _data, _size);
+    }
+#else
+    std::vector<uint8_t>().swap(_contents);
+#endif
+    _data = nullptr;
+    _size = 0;
+    _binary = nullptr;
+    _binarySize = 0;
+    _json = JsonValue();
+}
+
+bool GlbFile::findAccessor(const JsonValue *index, AccessorView &outView) const {
+    const JsonValue *accessors = findArray(_json, "accessors");
+    const JsonValue *views = findArray(_json, "bufferViews");
+    uint32_t accessorIndex;
+    if (!accessors || !views || !toIndex(index, accessors->size(), accessorIndex)) {
+        return false;
+    }
+    const JsonValue &accessor = (*accessors)[accessorIndex];
+    //sparse accessors and accessors without a buffer view, which read as zeros, are not supported
+    uint32_t viewIndex;
+    if (accessor.find("sparse") || !toIndex(accessor.find("bufferView"), views->size(), viewIndex)) {
+        return false;
+    }
+    const JsonValue &view = (*views)[viewIndex];
+
+    outView.components = typeComponents(accessor.find("type"));
+    outView.componentType = (uint32_t) accessor.getNumber("componentType", 0.0);
+    const JsonValue *normalized = accessor.find("normalized");
+    outView.normalized = normalized && normalized->type == JSON_BOOL && normalized->boolean;
+    outView.count = sizeMember(accessor, "count");
+    size_t elementSize = outView.components * componentSize(outView.componentType);
+    if (elementSize == 0) {
+        return false;
+    }
+
+    //only the buffer stored in the binary chunk, external .bin files are not read
+    size_t viewOffset = sizeMember(view, "byteOffset");
+    size_t viewLength = sizeMember(view, "byteLength");
+    size_t offset = sizeMember(accessor, "byteOffset");
+    outView.stride = sizeMember(view, "byteStride");
+    if (outView.stride == 0) {
+        outView.stride = elementSize;
+    }
+    if (view.getNumber("buffer", 0.0) != 0.0 || !_binary || viewOffset > _binarySize ||
+        viewLength > _binarySize - viewOffset || offset > viewLength || outView.count > viewLength ||
+        outView.stride > viewLength) {
+        return false;
+    }
+    if (outView.count > 0 && (outView.count - 1) * outView.stride + elementSize > viewLength - offset) {
+        return false;
+    }
+    outView.data = _binary + viewOffset + offset;
+    return true;
+}
+
+void GlbFile::copyStream(const AccessorView &view, uint32_t components, const std::vector<uint32_t> *indices,
+                         uint8_t *dst, size_t dstStride) {
+    size_t count = indices ? indices->size() : view.count;
+    if (view.componentType == COMPONENT_FLOAT) {
+        //the elements already are the floats Vertex holds, they only move
+        size_t elementBytes = components * sizeof(float);
+        for (size_t i = 0; i < count; i++) {
+            size_t element = indices ? (*indices)[i] : i;
+            memcpy(dst + i * dstStride, view.data + element * view.stride, elementBytes);
+        }
+        _copiedStreams++;
+        return;
+    }
+    size_t componentBytes = componentSize(view.componentType);
+    for (size_t i = 0; i < count; i++) {
+        size_t element = indices ? (*indices)[i] : i;
+        const uint8_t *source = view.data + element * view.stride;
+        for (uint32_t c = 0; c < components; c++) {
+            float value = readComponent(source + c * componentBytes, view.componentType, view.normalized);
+            memcpy(dst + i * dstStride + c * sizeof(float), &value, sizeof(float));
+        }
+    }
+    _convertedStreams++;
+}
+
+bool GlbFile::readPrimitive(const JsonValue &primitive, GlbPrimitive &outPrimitive) {
+    const JsonValue *attributes = primitive.find("attributes");
+    AccessorView position;
+    if (!attributes || !findAccessor(attributes->find("POSITION"), position) || position.components != 3) {
+        return false;
+    }
+    AccessorView normal, color, uv;
+    bool hasNormal = findAccessor(attributes->find("NORMAL"), normal) && normal.components == 3 &&
+                     normal.count == position.count;
+    bool hasColor = findAccessor(attributes->find("COLOR_0"), color) && color.components >= 3 &&
+                    color.count == position.count;
+    bool hasUv = findAccessor(attributes->find("TEXCOORD_0"), uv) && uv.components == 2 &&
+                 uv.count == position.count;
+
+    std::vector<uint32_t> indices;
+    const JsonValue *indicesIndex = primitive.find("indices");
+    if (indicesIndex) {
+        AccessorView view;
+        if (!findAccessor(indicesIndex, view) || view.components != 1 ||
+            (view.componentType != COMPONENT_UNSIGNED_BYTE && view.componentType != COMPONENT_UNSIGNED_SHORT &&
+             view.componentType != COMPONENT_UNSIGNED_INT)) {
+            return false;
+        }
+        indices.resize(view.count - view.count % 3);
+        for (size_t i = 0; i < indices.size(); i++) {
+            indices[i] = readIndex(view.data + i * view.stride, view.componentType);
+            if (indices[i] >= position.count) {
+                return false;
+            }
+        }
+    }
+
+    glm::vec3 baseColor(1.0f);
+    const JsonValue *materials = findArray(_json, "materials");
+    uint32_t materialIndex;
+    if (materials && toIndex(primitive.find("material"), materials->size(), materialIndex)) {
+        const JsonValue *pbr = (*materials)[materialIndex].find("pbrMetallicRoughness");
+        const JsonValue *factor = pbr ? findArray(*pbr, "baseColorFactor") : nullptr;
+        if (factor && factor->size() >= 3) {
+            baseColor = glm::vec3((*factor)[0].number, (*factor)[1].number, (*factor)[2].number);
+        }
+        const JsonValue *texture = pbr ? pbr->find("baseColorTexture") : nullptr;
+        const JsonValue *textures = findArray(_json, "textures");
+        uint32_t textureIndex, image;
+        if (texture && textures && toIndex(texture->find("index"), textures->size(), textureIndex) &&
+            toIndex((*textures)[textureIndex].find("source"), imageCount(), image)) {
+            outPrimitive.baseColorImage = (int32_t) image;
+        }
+    }
+
+    const std::vector<uint32_t> *gather = indicesIndex ? &indices : nullptr;
+    size_t vertexCount = gather ? indices.size() : position.count - position.count % 3;
+    std::vector<Vertex> &vertices = outPrimitive.mesh._vertices;
+    vertices.resize(vertexCount);
+    uint8_t *base = (uint8_t *) vertices.data();
+
+    //exported with the engine's own interleaved layout the whole vertex buffer is one copy
+    bool matchesVertex = !gather && hasNormal && hasColor && hasUv && color.components == 3 &&
+                         position.componentType == COMPONENT_FLOAT && normal.componentType == COMPONENT_FLOAT &&
+                         color.componentType == COMPONENT_FLOAT && uv.componentType == COMPONENT_FLOAT &&
+                         position.stride == sizeof(Vertex) && normal.stride == sizeof(Vertex) &&
+                         color.stride == sizeof(Vertex) && uv.stride == sizeof(Vertex) &&
+                         normal.data == position.data + offsetof(Vertex, normal) &&
+                         color.data == position.data + offsetof(Vertex, color) &&
+                         uv.data == position.data + offsetof(Vertex, uv);
+    if (matchesVertex) {
+        memcpy(base, position.data, vertexCount * sizeof(Vertex));
+        _copiedStreams++;
+        return true;
+    }
+
+    copyStream(position, 3, gather, base + offsetof(Vertex, position), sizeof(Vertex));
+    if (hasNormal) {
+        copyStream(normal, 3, gather, base + offsetof(Vertex, normal), sizeof(Vertex));
+    }
+    if (hasUv) {
+        copyStream(uv, 2, gather, base + offsetof(Vertex, uv), sizeof(Vertex));
+    }
+    if (hasColor) {
+        copyStream(color, 3, gather, base + offsetof(Vertex, color), sizeof(Vertex));
+    }
+    for (Vertex &vertex : vertices) {
+        if (!hasNormal) {
+            vertex.normal = glm::vec3(0.0f);
+        }
+        if (!hasUv) {
+            vertex.uv = glm::vec2(0.0f);
+        }
+        //like the OBJ loader, untextured surfaces shade with their base colour
+        if (!hasColor) {
+            vertex.color = outPrimitive.baseColorImage < 0 ? baseColor : vertex.normal;
+        }
+    }
+    return true;
+}
+
+bool GlbFile::readScene(std::vector<GlbPrimitive> &outPrimitives, std::vector<GlbInstance> &outInstances) {
+    const JsonValue *meshes = findArray(_json, "meshes");
+    std::vector<std::vector<uint32_t>> meshPrimitives(meshes ? meshes->size() : 0);
+    for (size_t m = 0; m < meshPrimitives.size(); m++) {
+        const JsonValue *primitives = findArray((*meshes)[m], "primitives");
+        for (size_t p = 0; primitives && p < primitives->size(); p++) {
+            const JsonValue &primitive = (*primitives)[p];
+            if (primitive.getNumber("mode", MODE_TRIANGLES) != MODE_TRIANGLES) {
+                std::cout << "Skipping a glTF primitive that is no triangle list" << std::endl;
+                continue;
+            }
+            meshPrimitives[m].push_back((uint32_t) outPrimitives.size());
+            outPrimitives.push_back(GlbPrimitive());
+            if (!readPrimitive(primitive, outPrimitives.back())) {
+                std::cout << "Primitive " << p << " of glTF mesh " << m << " has malformed accessors" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    const JsonValue *nodes = findArray(_json, "nodes");
+    if (!nodes) {
+        return true;
+    }
+    std::vector<uint32_t> roots;
+    const JsonValue *scenes = findArray(_json, "scenes");
+    if (scenes && scenes->size() > 0) {
+        uint32_t scene = 0;
+        toIndex(_json.find("scene"), scenes->size(), scene);
+        const JsonValue *sceneNodes = findArray((*scenes)[scene], "nodes");
+        for (size_t i = 0; sceneNodes && i < sceneNodes->size(); i++) {
+            uint32_t node;
+            if (toIndex(&(*sceneNodes)[i], nodes->size(), node)) {
+                roots.push_back(node);
+            }
+        }
+    } else {
+        //without scenes every node that is nobody's child is a root
+        std::vector<bool> isChild(nodes->size(), false);
+        for (size_t n = 0; n < nodes->size(); n++) {
+            const JsonValue *children = findArray((*nodes)[n], "children");
+            for (size_t i = 0; children && i < children->size(); i++) {
+                uint32_t child;
+                if (toIndex(&(*children)[i], nodes->size(), child)) {
+                    isChild[child] = true;
+                }
+            }
+        }
+        for (uint32_t n = 0; n < nodes->size(); n++) {
+            if (!isChild[n]) {
+                roots.push_back(n);
+            }
+        }
+    }
+    for (uint32_t root : roots) {
+        addNode(root, glm::mat4(1.0f), meshPrimitives, 0, outInstances);
+    }
+    return true;
+}
+
+void GlbFile::addNode(uint32_t node, const glm::mat4 &parent,
+                      const std::vector<std::vector<uint32_t>> &meshPrimitives, uint32_t depth,
+                      std::vector<GlbInstance> &outInstances) const {
+    const JsonValue &nodes = *findArray(_json, "nodes");
+    //a malformed hierarchy could loop, a valid one is never deeper than it has nodes
+    if (depth > nodes.size()) {
+        return;
+    }
+    const JsonValue &current = nodes[node];
+
+    glm::mat4 local(1.0f);
+    const JsonValue *matrix = findArray(current, "matrix");
+    if (matrix && matrix->size() == 16) {
+        //column major like glm
+        for (int i = 0; i < 16; i++) {
+            glm::value_ptr(local)[i] = (float) (*matrix)[i].number;
+        }
+    } else {
+        glm::vec3 translation(0.0f);
+        glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+        glm::vec3 scale(1.0f);
+        const JsonValue *t = findArray(current, "translation");
+        const JsonValue *r = findArray(current, "rotation");
+        const JsonValue *s = findArray(current, "scale");
+        if (t && t->size() == 3) {
+            translation = glm::vec3((*t)[0].number, (*t)[1].number, (*t)[2].number);
+        }
+        //glTF stores x, y, z, w
+        if (r && r->size() == 4) {
+            rotation = glm::quat((float) (*r)[3].number, (float) (*r)[0].number, (float) (*r)[1].number,
+                                 (float) (*r)[2].number);
+        }
+        if (s && s->size() == 3) {
+            scale = glm::vec3((*s)[0].number, (*s)[1].number, (*s)[2].number);
+        }
+        local = glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) *
+                glm::scale(glm::mat4(1.0f), scale);
+    }
+    glm::mat4 world = parent * local;
+
+    uint32_t mesh;
+    if (toIndex(current.find("mesh"), meshPrimitives.size(), mesh)) {
+        for (uint32_t primitive : meshPrimitives[mesh]) {
+            GlbInstance instance = {primitive, world};
+            outInstances.push_back(instance);
+        }
+    }
+    const JsonValue *children = findArray(current, "children");
+    for (size_t i = 0; children && i < children->size(); i++) {
+        uint32_t child;
+        if (toIndex(&(*children)[i], nodes.size(), child)) {
+            addNode(child, world, meshPrimitives, depth + 1, outInstances);
+        }
+    }
+}
+
+uint32_t GlbFile::imageCount() const {
+    const JsonValue *images = findArray(_json, "images");
+    return images ? (uint32_t) images->size() : 0;
+}
+
+const uint8_t *GlbFile::imageData(uint32_t image, size_t &outSize) const {
+    const JsonValue *images = findArray(_json, "images");
+    const JsonValue *views = findArray(_json, "bufferViews");
+    uint32_t viewIndex;
+    if (!images || !views || image >= images->size() || !_binary ||
+        !toIndex((*images)[image].find("bufferView"), views->size(), viewIndex)) {
+        return nullptr;
+    }
+    const JsonValue &view = (*views)[viewIndex];
+    size_t offset = sizeMember(view, "byteOffset");
+    size_t length = sizeMember(view, "byteLength");
+    if (view.getNumber("buffer", 0.0) != 0.0 || offset > _binarySize || length > _binarySize - offset) {
+        return nullptr;
+    }
+    outSize = length;
+    return _binary + offset;
+}
+
+std::string GlbFile::imagePath(uint32_t image) const {
+    const JsonValue *images = findArray(_json, "images");
+    const JsonValue *uri = images && image < images->size() ? (*images)[image].find("uri") : nullptr;
+    //base64 data URIs are not decoded
+    if (!uri || uri->type != JSON_STRING || uri->string.compare(0, 5, "data:") == 0) {
+        return "";
+    }
+    return _directory + uri->string;
+}
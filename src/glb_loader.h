@@ -0,0 +1,88 @@
+#ifndef VULKAN_STEP_BY_STEP_GLB_LOADER_H
+#define VULKAN_STEP_BY_STEP_GLB_LOADER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include "json.h"
+#include "vk_mesh.h"
+
+//one triangle primitive of a glTF mesh
+struct GlbPrimitive {
+    //a triangle list, indexed primitives are expanded since the renderer draws without index buffers
+    Mesh mesh;
+    //image of the base colour texture, -1 when untextured. untextured primitives carry their base colour in the
+    //vertex colour
+    int32_t baseColorImage = -1;
+};
+
+//a primitive placed by a node of the default scene
+struct GlbInstance {
+    uint32_t primitive;
+    glm::mat4 transform;
+};
+
+//a binary glTF 2.0 file. the file is memory mapped and only its JSON chunk is parsed, vertex data is copied out of
+//the binary chunk when the scene is read and images stay in the mapping until they are decoded
+class GlbFile {
+public:
+    //maps the file and parses the JSON chunk, false when it is no binary glTF 2.0 file
+    bool open(const char *path);
+
+    //unmaps the file, the pointers imageData returned become invalid
+    void close();
+
+    //every triangle primitive and the nodes placing them, converted in one pass over the accessors. false when an
+    //accessor points outside the binary chunk
+    bool readScene(std::vector<GlbPrimitive> &outPrimitives, std::vector<GlbInstance> &outInstances);
+
+    uint32_t imageCount() const;
+
+    //encoded bytes of an image stored in the binary chunk, null for images referenced by uri
+    const uint8_t *imageData(uint32_t image, size_t &outSize) const;
+
+    //file of an image referenced by uri, relative to the working directory like the .glb. empty for embedded ones
+    std::string imagePath(uint32_t image) const;
+
+    //vertex streams copied with memcpy because their layout matched Vertex, and those converted element by element
+    uint32_t copiedStreams() const { return _copiedStreams; }
+
+    uint32_t convertedStreams() const { return _convertedStreams; }
+
+private:
+    //the elements of an accessor inside the binary chunk
+    struct AccessorView {
+        const uint8_t *data;
+        size_t count;
+        size_t stride;
+        uint32_t componentType;
+        uint32_t components;
+        bool normalized;
+    };
+
+    bool findAccessor(const JsonValue *index, AccessorView &outView) const;
+
+    bool readPrimitive(const JsonValue &primitive, GlbPrimitive &outPrimitive);
+
+    //writes components floats of every vertex to dst, dstStride bytes apart. indices gathers the elements
+    void copyStream(const AccessorView &view, uint32_t components, const std::vector<uint32_t> *indices,
+                    uint8_t *dst, size_t dstStride);
+
+    void addNode(uint32_t node, const glm::mat4 &parent, const std::vector<std::vector<uint32_t>> &meshPrimitives,
+                 uint32_t depth, std::vector<GlbInstance> &outInstances) const;
+
+    const uint8_t *_data = nullptr;
+    size_t _size = 0;
+#ifdef _WIN32
+    std::vector<uint8_t> _contents;
+#endif
+    const uint8_t *_binary = nullptr;
+    size_t _binarySize = 0;
+    JsonValue _json;
+    std::string _directory;
+    uint32_t _copiedStreams = 0;
+    uint32_t _convertedStreams = 0;
+};
+
+#endif //VULKAN_STEP_BY_STEP_GLB_LOADER_H
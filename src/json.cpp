@@ -0,0 +1,273 @@
+#include "json.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    struct JsonParser {
+        const char *current;
+        const char *end;
+        //glTF nests a few levels deep, this only stops malicious input from exhausting the stack
+        int depth = 0;
+
+        void skipWhitespace() {
+            while (current < end && (*current == ' ' || *current == '\t' || *current == '\n' || *current == '\r')) {
+                current++;
+            }
+        }
+
+        bool consume(const char *literal) {
+            size_t length = strlen(literal);
+            if ((size_t) (end - current) < length || memcmp(current, literal, length) != 0) {
+                return false;
+            }
+            current += length;
+            return true;
+        }
+
+        static void appendUtf8(std::string &out, uint32_t codepoint) {
+            if (codepoint < 0x80) {
+                out += (char) codepoint;
+            } else if (codepoint < 0x800) {
+                out += (char) (0xC0 | (codepoint >> 6));
+                out += (char) (0x80 | (codepoint & 0x3F));
+            } else if (codepoint < 0x10000) {
+                out += (char) (0xE0 | (codepoint >> 12));
+                out += (char) (0x80 | ((codepoint >> 6) & 0x3F));
+                out += (char) (0x80 | (codepoint & 0x3F));
+            } else {
+                out += (char) (0xF0 | (codepoint >> 18));
+                out += (char) (0x80 | ((codepoint >> 12) & 0x3F));
+                out += (char) (0x80 | ((codepoint >> 6) & 0x3F));
+                out += (char) (0x80 | (codepoint & 0x3F));
+            }
+        }
+
+        bool parseHex(uint32_t &out) {
+            if (end - current < 4) {
+                return false;
+            }
+            out = 0;
+            for (int i = 0; i < 4; i++) {
+                char c = *current++;
+                out <<= 4;
+                if (c >= '0' && c <= '9') {
+                    out |= (uint32_t) (c - '0');
+                } else if (c >= 'a' && c <= 'f') {
+                    out |= (uint32_t) (c - 'a' + 10);
+                } else if (c >= 'A' && c <= 'F') {
+                    out |= (uint32_t) (c - 'A' + 10);
+                } else {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool parseString(std::string &out) {
+            if (current >= end || *current != '"') {
+                return false;
+            }
+            current++;
+            while (current < end && *current != '"') {
+                char c = *current++;
+                if (c != '\\') {
+                    out += c;
+                    continue;
+                }
+                if (current >= end) {
+                    return false;
+                }
+                char escape = *current++;
+                switch (escape) {
+                    case '"':
+                    case '\\':
+                    case '/':
+                        out += escape;
+                        break;
+                    case 'b':
+                        out += '\b';
+                        break;
+                    case 'f':
+                        out += '\f';
+                        break;
+                    case 'n':
+                        out += '\n';
+                        break;
+                    case 'r':
+                        out += '\r';
+                        break;
+                    case 't':
+                        out += '\t';
+                        break;
+                    case 'u': {
+                        uint32_t codepoint;
+                        if (!parseHex(codepoint)) {
+                            return false;
+                        }
+                        //a surrogate pair encodes one codepoint above the basic plane
+                        if (codepoint >= 0xD800 && codepoint < 0xDC00 && consume("\\u")) {
+                            uint32_t low;
+                            if (!parseHex(low) || low < 0xDC00 || low >= 0xE000) {
+                                return false;
+                            }
+                            codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        appendUtf8(out, codepoint);
+                        break;
+                    }
+                    default:
+                        return false;
+                }
+            }
+            if (current >= end) {
+                return false;
+            }
+            current++;
+            return true;
+        }
+
+        bool parseNumber(double &out) {
+            //strtod needs a terminated string and the text may end right after the number
+            char buffer[64];
+            size_t length = 0;
+            while (current + length < end && length < sizeof(buffer) - 1 && current[length] != '\0' &&
+                   strchr("+-0123456789.eE", current[length]) != nullptr) {
+                length++;
+            }
+            if (length == 0) {
+                return false;
+            }
+            memcpy(buffer, current, length);
+            buffer[length] = '\0';
+            char *parsedEnd;
+            out = strtod(buffer, &parsedEnd);
+            if (parsedEnd != buffer + length) {
+                return false;
+            }
+            current += length;
+            return true;
+        }
+
+        bool parseValue(JsonValue &out) {
+            skipWhitespace();
+            if (current >= end || depth > 64) {
+                return false;
+            }
+            switch (*current) {
+                case '{': {
+                    out.type = JSON_OBJECT;
+                    current++;
+                    depth++;
+                    skipWhitespace();
+                    if (current < end && *current == '}') {
+                        current++;
+                        depth--;
+                        return true;
+                    }
+                    while (true) {
+                        skipWhitespace();
+                        out.members.push_back(std::make_pair(std::string(), JsonValue()));
+                        if (!parseString(out.members.back().first)) {
+                            return false;
+                        }
+                        skipWhitespace();
+                        if (!consume(":") || !parseValue(out.members.back().second)) {
+                            return false;
+                        }
+                        skipWhitespace();
+                        if (consume("}")) {
+                            depth--;
+                            return true;
+                        }
+                        if (!consume(",")) {
+                            return false;
+                        }
+                    }
+                }
+                case '[': {
+                    out.type = JSON_ARRAY;
+                    current++;
+                    depth++;
+                    skipWhitespace();
+                    if (current < end && *current == ']') {
+                        current++;
+                        depth--;
+                        return true;
+                    }
+                    while (true) {
+                        out.elements.push_back(JsonValue());
+                        if (!parseValue(out.elements.back())) {
+                            return false;
+                        }
+                        skipWhitespace();
+                        if (consume("]")) {
+                            depth--;
+                            return true;
+                        }
+                        if (!consume(",")) {
+                            return false;
+                        }
+                    }
+                }
+                case '"':
+                    out.type = JSON_STRING;
+                    return parseString(out.string);
+                case 't':
+                    out.type = JSON_BOOL;
+                    out.boolean = true;
+                    return consume("true");
+                case 'f':
+                    out.type = JSON_BOOL;
+                    return consume("false");
+                case 'n':
+                    return consume("null");
+                default:
+                    out.type = JSON_NUMBER;
+                    return parseNumber(out.number);
+            }
+        }
+    };
+}
+
+const JsonValue *JsonValue::find(const char *key) const {
+    for (const auto &member : members) {
+        if (member.first == key) {
+            return &member.second;
+        }
+    }
+    return nullptr;
+}
+
+double JsonValue::getNumber(const char *key, double fallback) const {
+    const JsonValue *value = find(key);
+    return value && value->type == JSON_NUMBER ? value->number : fallback;
+}
+
+bool parseJson(const char *text, size_t length, JsonValue &outValue) {
+    JsonParser parser;
+    parser.current = text;
+    parser.end = text + length;
+    outValue = JsonValue();
+    if (!parser.parseValue(outValue)) {
+        return false;
+    }
+    //the JSON chunk of a .glb is padded with spaces
+    parser.skipWhitespace();
+    return parser.current == parser.end;
+}
+
+void writeJsonString(std::ostream &out, const std::string &text) {
+    static const char *HEX = "0123456789abcdef";
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if ((unsigned char) c < 0x20) {
+            out << "\\u00" << HEX[(unsigned char) c >> 4] << HEX[c & 0xF];
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
@@ -0,0 +1,46 @@
+#ifndef VULKAN_STEP_BY_STEP_JSON_H
+#define VULKAN_STEP_BY_STEP_JSON_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum JsonType {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+};
+
+//a parsed JSON document, just enough for the glTF headers. objects keep their members in file order and are searched
+//linearly, they rarely have more than a handful
+struct JsonValue {
+    JsonType type = JSON_NULL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> elements;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    //the member called key, null when this is no object or has no such member
+    const JsonValue *find(const char *key) const;
+
+    //the member's number, fallback when it is missing or no number
+    double getNumber(const char *key, double fallback) const;
+
+    size_t size() const { return type == JSON_OBJECT ? members.size() : elements.size(); }
+
+    const JsonValue &operator[](size_t index) const { return elements[index]; }
+};
+
+//parses length bytes of UTF-8 text, the whole text has to be one value. false on malformed input
+bool parseJson(const char *text, size_t length, JsonValue &outValue);
+
+//text as a quoted JSON string, escaping quotes, backslashes and control characters. for paths and names in reports
+void writeJsonString(std::ostream &out, const std::string &text);
+
+#endif //VULKAN_STEP_BY_STEP_JSON_H
@@ -0,0 +1,130 @@
+#include "lz_compress.h"
+#include <cstring>
+
+static const size_t MIN_MATCH = 4;
+static const size_t MAX_OFFSET = 65535;
+static const uint32_t HASH_BITS = 14;
+
+static uint32_t read32(const uint8_t *bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static uint32_t hash4(const uint8_t *bytes) {
+    return (read32(bytes) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+//a nibble of the token, the rest in bytes of 255 and a final smaller one
+static void writeLength(std::vector<uint8_t> &out, size_t length) {
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back((uint8_t) length);
+}
+
+static void writeSequence(std::vector<uint8_t> &out, const uint8_t *literals, size_t literalCount,
+                          size_t matchLength, size_t offset) {
+    size_t matchCode = matchLength >= MIN_MATCH ? matchLength - MIN_MATCH : 0;
+    uint8_t token = (uint8_t) ((literalCount < 15 ? literalCount : 15) << 4 | (matchCode < 15 ? matchCode : 15));
+    out.push_back(token);
+    if (literalCount >= 15) {
+        writeLength(out, literalCount - 15);
+    }
+    out.insert(out.end(), literals, literals + literalCount);
+    if (matchLength == 0) {
+        return;
+    }
+    out.push_back((uint8_t) (offset & 0xFF));
+    out.push_back((uint8_t) (offset >> 8));
+    if (matchCode >= 15) {
+        writeLength(out, matchCode - 15);
+    }
+}
+
+void lzCompress(const uint8_t *src, size_t size, std::vector<uint8_t> &out) {
+    //positions + 1, so 0 marks an empty slot
+    std::vector<uint32_t> table((size_t) 1 << HASH_BITS, 0);
+    size_t anchor = 0;
+    size_t position = 0;
+    while (size >= MIN_MATCH && position <= size - MIN_MATCH) {
+        uint32_t hash = hash4(src + position);
+        size_t candidate = table[hash];
+        table[hash] = (uint32_t) (position + 1);
+        if (candidate == 0 || position - (candidate - 1) > MAX_OFFSET ||
+            read32(src + candidate - 1) != read32(src + position)) {
+            position++;
+            continue;
+        }
+        candidate--;
+        size_t length = MIN_MATCH;
+        while (position + length < size && src[candidate + length] == src[position + length]) {
+            length++;
+        }
+        writeSequence(out, src + anchor, position - anchor, length, position - candidate);
+        position += length;
+        anchor = position;
+    }
+    writeSequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+//false when the length runs past the end of the input
+static bool readLength(const uint8_t *&src, const uint8_t *srcEnd, size_t &length) {
+    uint8_t byte;
+    do {
+        if (src >= srcEnd) {
+            return false;
+        }
+        byte = *src++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool lzDecompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize) {
+    const uint8_t *srcEnd = src + srcSize;
+    size_t written = 0;
+    while (src < srcEnd) {
+        uint8_t token = *src++;
+        size_t literalCount = token >> 4;
+        if (literalCount == 15 && !readLength(src, srcEnd, literalCount)) {
+            return false;
+        }
+        if (literalCount > (size_t) (srcEnd - src) || literalCount > dstSize - written) {
+            return false;
+        }
+        memcpy(dst + written, src, literalCount);
+        src += literalCount;
+        written += literalCount;
+        //the last sequence ends after its literals
+        if (src == srcEnd) {
+            break;
+        }
+
+        if (srcEnd - src < 2) {
+            return false;
+        }
+        size_t offset = src[0] | (size_t) src[1] << 8;
+        src += 2;
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !readLength(src, srcEnd, matchLength)) {
+            return false;
+        }
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > written || matchLength > dstSize - written) {
+            return false;
+        }
+        //an offset shorter than the match repeats the bytes just written, so this copies forwards byte by byte
+        const uint8_t *match = dst + written - offset;
+        if (offset >= matchLength) {
+            memcpy(dst + written, match, matchLength);
+        } else {
+            for (size_t i = 0; i < matchLength; i++) {
+                dst[written + i] = match[i];
+            }
+        }
+        written += matchLength;
+    }
+    return written == dstSize;
+}
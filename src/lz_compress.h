@@ -0,0 +1,19 @@
+#ifndef VULKAN_STEP_BY_STEP_LZ_COMPRESS_H
+#define VULKAN_STEP_BY_STEP_LZ_COMPRESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//LZ77 compression in the layout of LZ4 blocks: every sequence is a token holding the literal count and the match
+//length, the literals, then a 16 bit offset back into the last 64 KB. the last sequence has literals only.
+//compression is greedy with a small hash table, decompression is a plain copy loop that can write straight into
+//mapped upload memory
+
+//appends the compressed bytes of size bytes at src to out
+void lzCompress(const uint8_t *src, size_t size, std::vector<uint8_t> &out);
+
+//false when src is malformed or does not decompress to exactly dstSize bytes
+bool lzDecompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize);
+
+#endif //VULKAN_STEP_BY_STEP_LZ_COMPRESS_H
@@ -1,8 +1,11 @@
 #include "VulkanEngine.h"
-int main(){
+int main(int argc, char **argv){
     VulkanEngine vulkanEngine{};
+    if (!vulkanEngine._config.parseArgs(argc, argv)) {
+        return 1;
+    }
     vulkanEngine.init();
     vulkanEngine.run();
     vulkanEngine.cleanup();
     return 0;
-};
\ No newline at end of file
+};
@@ -0,0 +1,97 @@
+#include "mesh_chunks.h"
+#include <algorithm>
+
+namespace {
+    struct ChunkBuilder {
+        const std::vector<Vertex> &vertices;
+        std::vector<glm::vec3> centroids;
+        std::vector<uint32_t> triangles;
+        size_t targetTriangles;
+        std::vector<Mesh> chunks;
+
+        ChunkBuilder(const std::vector<Vertex> &vertices, size_t targetTriangles)
+                : vertices(vertices), targetTriangles(targetTriangles) {
+            size_t triangleCount = vertices.size() / 3;
+            centroids.resize(triangleCount);
+            triangles.resize(triangleCount);
+            for (size_t t = 0; t < triangleCount; t++) {
+                centroids[t] = (vertices[t * 3].position + vertices[t * 3 + 1].position +
+                                vertices[t * 3 + 2].position) / 3.0f;
+                triangles[t] = (uint32_t) t;
+            }
+        }
+
+        void split(size_t begin, size_t end) {
+            if (end - begin <= targetTriangles) {
+                emit(begin, end);
+                return;
+            }
+
+            glm::vec3 minimum = centroids[triangles[begin]];
+            glm::vec3 maximum = minimum;
+            for (size_t i = begin + 1; i < end; i++) {
+                minimum = glm::min(minimum, centroids[triangles[i]]);
+                maximum = glm::max(maximum, centroids[triangles[i]]);
+            }
+            glm::vec3 extent = maximum - minimum;
+            int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+            //the spatial middle keeps cells compact, the median only steps in when all centroids fall on one side
+            float middle = (minimum[axis] + maximum[axis]) * 0.5f;
+            std::vector<uint32_t>::iterator first = triangles.begin() + begin;
+            std::vector<uint32_t>::iterator last = triangles.begin() + end;
+            size_t mid = std::partition(first, last, [&](uint32_t t) {
+                return centroids[t][axis] < middle;
+            }) - triangles.begin();
+            if (mid == begin || mid == end) {
+                mid = begin + (end - begin) / 2;
+                std::nth_element(first, triangles.begin() + mid, last, [&](uint32_t a, uint32_t b) {
+                    return centroids[a][axis] < centroids[b][axis];
+                });
+            }
+
+            split(begin, mid);
+            split(mid, end);
+        }
+
+        void emit(size_t begin, size_t end) {
+            if (begin == end) {
+                return;
+            }
+            //source order within a chunk, so neighbouring triangles stay neighbours in the vertex buffer
+            std::sort(triangles.begin() + begin, triangles.begin() + end);
+
+            Mesh chunk;
+            chunk._vertices.reserve((end - begin) * 3);
+            for (size_t i = begin; i < end; i++) {
+                uint32_t t = triangles[i];
+                chunk._vertices.insert(chunk._vertices.end(), vertices.begin() + t * 3, vertices.begin() + t * 3 + 3);
+            }
+            chunk.computeBounds();
+            chunks.push_back(chunk);
+        }
+    };
+}
+
+std::vector<Mesh> splitMeshIntoChunks(const Mesh &mesh, size_t targetTriangles) {
+    //only the full detail triangles, detail levels are built per chunk afterwards
+    std::vector<Vertex> fullDetail(mesh._vertices.begin(), mesh._vertices.begin() + mesh.getLod(0).vertexCount);
+    ChunkBuilder builder(fullDetail, std::max(targetTriangles, (size_t) 1));
+    builder.split(0, builder.triangles.size());
+    return builder.chunks;
+}
+
+void mergeChunkVertices(std::vector<Mesh> &chunks, Mesh &outShared) {
+    for (Mesh &chunk : chunks) {
+        uint32_t baseVertex = (uint32_t) outShared._vertices.size();
+        if (chunk._lods.empty()) {
+            MeshLod fullDetail = {0, (uint32_t) chunk._vertices.size(), 0.0f};
+            chunk._lods.push_back(fullDetail);
+        }
+        for (MeshLod &lod : chunk._lods) {
+            lod.firstVertex += baseVertex;
+        }
+        outShared._vertices.insert(outShared._vertices.end(), chunk._vertices.begin(), chunk._vertices.end());
+        std::vector<Vertex>().swap(chunk._vertices);
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef VULKAN_STEP_BY_STEP_MESH_CHUNKS_H
+#define VULKAN_STEP_BY_STEP_MESH_CHUNKS_H
+
+#include <vector>
+#include "vk_mesh.h"
+
+//splits a triangle list into spatial chunks of at most targetTriangles triangles. cells are halved along their
+//longest axis, octree style, until they are small enough, every triangle goes to the cell of its centroid.
+//each chunk has its own bounds, so a large static mesh can be culled piece by piece
+std::vector<Mesh> splitMeshIntoChunks(const Mesh &mesh, size_t targetTriangles);
+
+//appends the vertices of every chunk, all detail levels, to outShared and rebases the chunks' levels onto them.
+//the chunks keep their bounds and levels but give up their own vertices, they draw from outShared's buffers
+void mergeChunkVertices(std::vector<Mesh> &chunks, Mesh &outShared);
+
+#endif //VULKAN_STEP_BY_STEP_MESH_CHUNKS_H
@@ -0,0 +1,464 @@
+#include "mesh_simplify.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <gtc/matrix_inverse.hpp>
+
+namespace {
+
+    //symmetric 4x4 matrix, upper triangle row by row
+    struct Quadric {
+        double m[10];
+
+        Quadric() {
+            memset(m, 0, sizeof(m));
+        }
+
+        Quadric(double a, double b, double c, double d) {
+            m[0] = a * a; m[1] = a * b; m[2] = a * c; m[3] = a * d;
+            m[4] = b * b; m[5] = b * c; m[6] = b * d;
+            m[7] = c * c; m[8] = c * d;
+            m[9] = d * d;
+        }
+
+        Quadric &operator+=(const Quadric &other) {
+            for (int i = 0; i < 10; i++) {
+                m[i] += other.m[i];
+            }
+            return *this;
+        }
+
+        Quadric operator+(const Quadric &other) const {
+            Quadric sum = *this;
+            sum += other;
+            return sum;
+        }
+
+        Quadric operator*(double scale) const {
+            Quadric scaled = *this;
+            for (int i = 0; i < 10; i++) {
+                scaled.m[i] *= scale;
+            }
+            return scaled;
+        }
+
+        double error(const glm::dvec3 &p) const {
+            return m[0] * p.x * p.x + 2 * m[1] * p.x * p.y + 2 * m[2] * p.x * p.z + 2 * m[3] * p.x
+                   + m[4] * p.y * p.y + 2 * m[5] * p.y * p.z + 2 * m[6] * p.y
+                   + m[7] * p.z * p.z + 2 * m[8] * p.z
+                   + m[9];
+        }
+    };
+
+    struct SimplifyVertex {
+        glm::dvec3 position;
+        Quadric quadric;
+        uint32_t refStart;
+        uint32_t refCount;
+        bool border;
+    };
+
+    struct SimplifyTriangle {
+        uint32_t v[3];
+        //source corner of every v, its normal, color and uv are kept when the position moves
+        uint32_t corner[3];
+        //collapse error of the edges v0-v1, v1-v2, v2-v0, and the smallest of them
+        double error[4];
+        glm::dvec3 normal;
+        bool deleted;
+        bool dirty;
+    };
+
+    struct TriangleRef {
+        uint32_t triangle;
+        uint32_t corner;
+    };
+
+    //keeps border edges in place, a larger weight trades silhouette stability for reduction
+    const double BORDER_WEIGHT = 10.0;
+    const int MAX_ITERATIONS = 100;
+    const double AGGRESSIVENESS = 7.0;
+
+    struct PositionKey {
+        float x, y, z;
+
+        bool operator==(const PositionKey &other) const {
+            return x == other.x && y == other.y && z == other.z;
+        }
+    };
+
+    struct PositionKeyHash {
+        size_t operator()(const PositionKey &key) const {
+            uint32_t bits[3];
+            memcpy(bits, &key, sizeof(bits));
+            return ((size_t) bits[0] * 73856093u) ^ ((size_t) bits[1] * 19349663u) ^ ((size_t) bits[2] * 83492791u);
+        }
+    };
+
+    class Simplifier {
+    public:
+        explicit Simplifier(const std::vector<Vertex> &corners) : _corners(corners) {
+            std::unordered_map<PositionKey, uint32_t, PositionKeyHash> welded;
+            welded.reserve(corners.size());
+
+            size_t triangleCount = corners.size() / 3;
+            _triangles.resize(triangleCount);
+            for (size_t t = 0; t < triangleCount; t++) {
+                SimplifyTriangle &triangle = _triangles[t];
+                for (int k = 0; k < 3; k++) {
+                    uint32_t corner = (uint32_t) (t * 3 + k);
+                    const glm::vec3 &position = corners[corner].position;
+                    PositionKey key = {position.x, position.y, position.z};
+                    auto found = welded.find(key);
+                    if (found == welded.end()) {
+                        SimplifyVertex vertex = {};
+                        vertex.position = glm::dvec3(position);
+                        found = welded.emplace(key, (uint32_t) _vertices.size()).first;
+                        _vertices.push_back(vertex);
+                    }
+                    triangle.v[k] = found->second;
+                    triangle.corner[k] = corner;
+                }
+                triangle.deleted = false;
+                triangle.dirty = false;
+            }
+        }
+
+        double run(size_t targetTriangles) {
+            size_t deletedCount = 0;
+            size_t triangleCount = _triangles.size();
+            double maxError = 0.0;
+            std::vector<uint8_t> deleted0;
+            std::vector<uint8_t> deleted1;
+
+            for (int iteration = 0; iteration < MAX_ITERATIONS; iteration++) {
+                if (triangleCount - deletedCount <= targetTriangles) {
+                    break;
+                }
+                //compacting and rebuilding the references every iteration costs more than it saves
+                if (iteration % 5 == 0) {
+                    updateMesh(iteration);
+                    triangleCount = _triangles.size();
+                    deletedCount = 0;
+                }
+                for (SimplifyTriangle &triangle : _triangles) {
+                    triangle.dirty = false;
+                }
+
+                //collapse cheap edges first, the threshold grows with every pass
+                double threshold = 0.000000001 * pow(double(iteration + 3), AGGRESSIVENESS);
+
+                for (size_t t = 0; t < _triangles.size(); t++) {
+                    SimplifyTriangle &triangle = _triangles[t];
+                    if (triangle.error[3] > threshold || triangle.deleted || triangle.dirty) {
+                        continue;
+                    }
+
+                    for (int j = 0; j < 3; j++) {
+                        if (triangle.error[j] >= threshold) {
+                            continue;
+                        }
+                        uint32_t i0 = triangle.v[j];
+                        uint32_t i1 = triangle.v[(j + 1) % 3];
+                        SimplifyVertex &v0 = _vertices[i0];
+                        SimplifyVertex &v1 = _vertices[i1];
+                        if (v0.border != v1.border) {
+                            continue;
+                        }
+
+                        glm::dvec3 position;
+                        double collapseError = edgeError(i0, i1, position);
+
+                        deleted0.resize(v0.refCount);
+                        deleted1.resize(v1.refCount);
+                        if (flipped(position, i1, v0, deleted0) || flipped(position, i0, v1, deleted1)) {
+                            continue;
+                        }
+
+                        v0.position = position;
+                        v0.quadric += v1.quadric;
+
+                        uint32_t refStart = (uint32_t) _refs.size();
+                        updateTriangles(i0, v0, deleted0, deletedCount);
+                        updateTriangles(i0, v1, deleted1, deletedCount);
+                        uint32_t refCount = (uint32_t) _refs.size() - refStart;
+
+                        //reuse v0's old reference range when the merged list fits
+                        if (refCount <= v0.refCount) {
+                            if (refCount > 0) {
+                                memmove(&_refs[v0.refStart], &_refs[refStart], refCount * sizeof(TriangleRef));
+                            }
+                            _refs.resize(refStart);
+                        } else {
+                            v0.refStart = refStart;
+                        }
+                        v0.refCount = refCount;
+
+                        maxError = std::max(maxError, collapseError);
+                        break;
+                    }
+
+                    if (triangleCount - deletedCount <= targetTriangles) {
+                        break;
+                    }
+                }
+            }
+
+            compact();
+            return maxError;
+        }
+
+        void write(std::vector<Vertex> &outVertices) const {
+            outVertices.clear();
+            outVertices.reserve(_triangles.size() * 3);
+            for (const SimplifyTriangle &triangle : _triangles) {
+                for (int k = 0; k < 3; k++) {
+                    Vertex vertex = _corners[triangle.corner[k]];
+                    vertex.position = glm::vec3(_vertices[triangle.v[k]].position);
+                    outVertices.push_back(vertex);
+                }
+            }
+        }
+
+    private:
+        const std::vector<Vertex> &_corners;
+        std::vector<SimplifyVertex> _vertices;
+        std::vector<SimplifyTriangle> _triangles;
+        std::vector<TriangleRef> _refs;
+
+        void compact() {
+            size_t kept = 0;
+            for (size_t t = 0; t < _triangles.size(); t++) {
+                if (!_triangles[t].deleted) {
+                    _triangles[kept++] = _triangles[t];
+                }
+            }
+            _triangles.resize(kept);
+        }
+
+        void updateMesh(int iteration) {
+            if (iteration > 0) {
+                compact();
+            }
+
+            for (SimplifyVertex &vertex : _vertices) {
+                vertex.refStart = 0;
+                vertex.refCount = 0;
+            }
+            for (const SimplifyTriangle &triangle : _triangles) {
+                for (int k = 0; k < 3; k++) {
+                    _vertices[triangle.v[k]].refCount++;
+                }
+            }
+            uint32_t refStart = 0;
+            for (SimplifyVertex &vertex : _vertices) {
+                vertex.refStart = refStart;
+                refStart += vertex.refCount;
+                vertex.refCount = 0;
+            }
+            _refs.resize(refStart);
+            for (uint32_t t = 0; t < _triangles.size(); t++) {
+                for (uint32_t k = 0; k < 3; k++) {
+                    SimplifyVertex &vertex = _vertices[_triangles[t].v[k]];
+                    _refs[vertex.refStart + vertex.refCount++] = {t, k};
+                }
+            }
+
+            if (iteration == 0) {
+                initQuadrics();
+            }
+        }
+
+        void initQuadrics() {
+            for (SimplifyTriangle &triangle : _triangles) {
+                const glm::dvec3 &p0 = _vertices[triangle.v[0]].position;
+                glm::dvec3 normal = glm::cross(_vertices[triangle.v[1]].position - p0,
+                                               _vertices[triangle.v[2]].position - p0);
+                double length = glm::length(normal);
+                triangle.normal = length > 0.0 ? normal / length : glm::dvec3(0.0);
+
+                Quadric plane(triangle.normal.x, triangle.normal.y, triangle.normal.z, -glm::dot(triangle.normal, p0));
+                for (int k = 0; k < 3; k++) {
+                    _vertices[triangle.v[k]].quadric += plane;
+                }
+            }
+
+            //an edge used by a single triangle is on a border, pin it with a plane through the edge that stands
+            //perpendicular on the triangle
+            std::unordered_map<uint64_t, uint32_t> edgeUses;
+            edgeUses.reserve(_triangles.size() * 3);
+            for (const SimplifyTriangle &triangle : _triangles) {
+                for (int k = 0; k < 3; k++) {
+                    edgeUses[edgeKey(triangle.v[k], triangle.v[(k + 1) % 3])]++;
+                }
+            }
+            for (const SimplifyTriangle &triangle : _triangles) {
+                for (int k = 0; k < 3; k++) {
+                    uint32_t a = triangle.v[k];
+                    uint32_t b = triangle.v[(k + 1) % 3];
+                    if (edgeUses[edgeKey(a, b)] != 1) {
+                        continue;
+                    }
+                    _vertices[a].border = true;
+                    _vertices[b].border = true;
+
+                    glm::dvec3 edge = _vertices[b].position - _vertices[a].position;
+                    glm::dvec3 normal = glm::cross(edge, triangle.normal);
+                    double length = glm::length(normal);
+                    if (length <= 0.0) {
+                        continue;
+                    }
+                    normal /= length;
+                    Quadric plane = Quadric(normal.x, normal.y, normal.z, -glm::dot(normal, _vertices[a].position))
+                                    * BORDER_WEIGHT;
+                    _vertices[a].quadric += plane;
+                    _vertices[b].quadric += plane;
+                }
+            }
+
+            for (SimplifyTriangle &triangle : _triangles) {
+                updateTriangleErrors(triangle);
+            }
+        }
+
+        static uint64_t edgeKey(uint32_t a, uint32_t b) {
+            return a < b ? ((uint64_t) a << 32) | b : ((uint64_t) b << 32) | a;
+        }
+
+        void updateTriangleErrors(SimplifyTriangle &triangle) {
+            glm::dvec3 position;
+            for (int k = 0; k < 3; k++) {
+                triangle.error[k] = edgeError(triangle.v[k], triangle.v[(k + 1) % 3], position);
+            }
+            triangle.error[3] = std::min(triangle.error[0], std::min(triangle.error[1], triangle.error[2]));
+        }
+
+        //error of collapsing the edge, and the position the merged vertex should take
+        double edgeError(uint32_t i0, uint32_t i1, glm::dvec3 &outPosition) const {
+            Quadric q = _vertices[i0].quadric + _vertices[i1].quadric;
+            const double *m = q.m;
+
+            //minimise the quadric by solving its 3x3 system, unless it is singular or the edge is on a border
+            glm::dmat3 system(m[0], m[1], m[2],
+                              m[1], m[4], m[5],
+                              m[2], m[5], m[7]);
+            double det = glm::determinant(system);
+            bool border = _vertices[i0].border && _vertices[i1].border;
+            if (std::fabs(det) > 1e-12 && !border) {
+                outPosition = glm::inverse(system) * glm::dvec3(-m[3], -m[6], -m[8]);
+                return q.error(outPosition);
+            }
+
+            const glm::dvec3 &p0 = _vertices[i0].position;
+            const glm::dvec3 &p1 = _vertices[i1].position;
+            glm::dvec3 middle = (p0 + p1) * 0.5;
+            double error0 = q.error(p0);
+            double error1 = q.error(p1);
+            double errorMiddle = q.error(middle);
+            double error = std::min(error0, std::min(error1, errorMiddle));
+            outPosition = error == error0 ? p0 : (error == error1 ? p1 : middle);
+            return error;
+        }
+
+        //true if moving the vertex to position would fold one of its triangles over. triangles that also use the
+        //other end of the edge disappear with the collapse and are flagged in deleted instead
+        bool flipped(const glm::dvec3 &position, uint32_t other, const SimplifyVertex &vertex,
+                     std::vector<uint8_t> &deleted) const {
+            for (uint32_t k = 0; k < vertex.refCount; k++) {
+                const TriangleRef &ref = _refs[vertex.refStart + k];
+                const SimplifyTriangle &triangle = _triangles[ref.triangle];
+                if (triangle.deleted) {
+                    continue;
+                }
+
+                uint32_t id1 = triangle.v[(ref.corner + 1) % 3];
+                uint32_t id2 = triangle.v[(ref.corner + 2) % 3];
+                if (id1 == other || id2 == other) {
+                    deleted[k] = 1;
+                    continue;
+                }
+                deleted[k] = 0;
+
+                glm::dvec3 d1 = _vertices[id1].position - position;
+                glm::dvec3 d2 = _vertices[id2].position - position;
+                double length1 = glm::length(d1);
+                double length2 = glm::length(d2);
+                if (length1 <= 0.0 || length2 <= 0.0) {
+                    return true;
+                }
+                d1 /= length1;
+                d2 /= length2;
+                if (std::fabs(glm::dot(d1, d2)) > 0.999) {
+                    return true;
+                }
+                glm::dvec3 normal = glm::normalize(glm::cross(d1, d2));
+                if (glm::dot(normal, triangle.normal) < 0.2) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void updateTriangles(uint32_t i0, const SimplifyVertex &vertex, const std::vector<uint8_t> &deleted,
+                             size_t &deletedCount) {
+            for (uint32_t k = 0; k < vertex.refCount; k++) {
+                TriangleRef ref = _refs[vertex.refStart + k];
+                SimplifyTriangle &triangle = _triangles[ref.triangle];
+                if (triangle.deleted) {
+                    continue;
+                }
+                if (deleted[k]) {
+                    triangle.deleted = true;
+                    deletedCount++;
+                    continue;
+                }
+                triangle.v[ref.corner] = i0;
+                triangle.dirty = true;
+                updateTriangleErrors(triangle);
+                _refs.push_back(ref);
+            }
+        }
+    };
+}
+
+void simplifyMesh(const std::vector<Vertex> &vertices, size_t targetTriangles, std::vector<Vertex> &outVertices,
+                  float &outError) {
+    Simplifier simplifier(vertices);
+    double error = simplifier.run(targetTriangles);
+    simplifier.write(outVertices);
+    //quadric errors are squared distances
+    outError = (float) std::sqrt(std::max(error, 0.0));
+}
+
+void buildMeshLods(Mesh &mesh, uint32_t maxLevels, size_t minTriangles) {
+    mesh._lods.clear();
+    MeshLod fullDetail = {0, (uint32_t) mesh._vertices.size(), 0.0f};
+    mesh._lods.push_back(fullDetail);
+
+    std::vector<Vertex> previous(mesh._vertices);
+    std::vector<Vertex> simplified;
+    while (mesh._lods.size() < maxLevels) {
+        size_t previousTriangles = previous.size() / 3;
+        if (previousTriangles / 2 < minTriangles) {
+            break;
+        }
+
+        float error;
+        simplifyMesh(previous, previousTriangles / 2, simplified, error);
+        size_t triangles = simplified.size() / 3;
+        if (triangles == 0 || triangles > previousTriangles * 3 / 4) {
+            break;
+        }
+
+        //every level is simplified from the previous one, so its distance to full detail is bounded by the sum
+        MeshLod lod;
+        lod.firstVertex = (uint32_t) mesh._vertices.size();
+        lod.vertexCount = (uint32_t) simplified.size();
+        lod.error = mesh._lods.back().error + error;
+        mesh._lods.push_back(lod);
+        mesh._vertices.insert(mesh._vertices.end(), simplified.begin(), simplified.end());
+
+        previous.swap(simplified);
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef VULKAN_STEP_BY_STEP_MESH_SIMPLIFY_H
+#define VULKAN_STEP_BY_STEP_MESH_SIMPLIFY_H
+
+#include <vector>
+#include "vk_mesh.h"
+
+//quadric error metric edge collapse over a triangle list. positions are welded to find the topology, normals,
+//colors and uvs stay with their triangle corners. outError is the largest collapse error as a distance in mesh units
+void simplifyMesh(const std::vector<Vertex> &vertices, size_t targetTriangles, std::vector<Vertex> &outVertices,
+                  float &outError);
+
+//appends coarser levels, each about half the triangles of the previous one, behind the full detail vertices.
+//stops at maxLevels or when a level no longer shrinks by a quarter
+void buildMeshLods(Mesh &mesh, uint32_t maxLevels = 5, size_t minTriangles = 64);
+
+#endif //VULKAN_STEP_BY_STEP_MESH_SIMPLIFY_H
@@ -0,0 +1,44 @@
+#include "render_object.h"
+
+void packObjectData(const RenderObject *first, int count, const SceneGraph &sceneGraph, GPUObjectData *outObjects) {
+    for (int i = 0; i < count; i++) {
+        outObjects[i].modelMatrix = objectMatrix(first[i], sceneGraph);
+    }
+}
+
+static const float LOD_HYSTERESIS = 0.75f;
+static const float LOD_MIN_DISTANCE = 0.1f;
+
+uint32_t selectLod(const Mesh &mesh, const glm::mat4 &model, const glm::vec3 &cameraPosition, float projectionScale,
+                   float maxPixelError, uint32_t currentLevel) {
+    uint32_t levelCount = mesh.lodCount();
+    if (levelCount <= 1 || maxPixelError <= 0.0f) {
+        return 0;
+    }
+
+    //errors are in mesh units, the largest axis scale keeps the estimate conservative
+    float scale = glm::max(glm::length(glm::vec3(model[0])),
+                           glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    glm::vec3 center = glm::vec3(model * glm::vec4(mesh._boundsCenter, 1.0f));
+    float distance = glm::max(glm::length(center - cameraPosition) - mesh._boundsRadius * scale, LOD_MIN_DISTANCE);
+    float pixelsPerUnit = scale * projectionScale / distance;
+
+    uint32_t level = currentLevel < levelCount ? currentLevel : levelCount - 1;
+    while (level > 0 && mesh.getLod(level).error * pixelsPerUnit > maxPixelError) {
+        level--;
+    }
+    while (level + 1 < levelCount && mesh.getLod(level + 1).error * pixelsPerUnit <= maxPixelError * LOD_HYSTERESIS) {
+        level++;
+    }
+    return level;
+}
+
+uint32_t selectShadowLod(const Mesh &mesh, const glm::mat4 &model, float maxError) {
+    float scale = glm::max(glm::length(glm::vec3(model[0])),
+                           glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    uint32_t level = 0;
+    while (level + 1 < mesh.lodCount() && mesh.getLod(level + 1).error * scale <= maxError) {
+        level++;
+    }
+    return level;
+}
@@ -0,0 +1,61 @@
+#ifndef VULKAN_STEP_BY_STEP_RENDER_OBJECT_H
+#define VULKAN_STEP_BY_STEP_RENDER_OBJECT_H
+
+#include "vk_types.h"
+#include "vk_mesh.h"
+#include "scene_graph.h"
+#include "asset_registry.h"
+
+struct Material {
+    VkDescriptorSet textureSet{VK_NULL_HANDLE};
+    //the texture textureSet points at, rewritten when it is uploaded again after an eviction
+    uint32_t textureResidencyId = INVALID_RESIDENCY_ID;
+    //binds the virtual texture's set of the frame instead of textureSet
+    bool virtualTexture = false;
+    VkPipeline pipeline;
+    //same shaders with an EQUAL depth test and no depth writes, used after the depth pre-pass
+    VkPipeline prepassPipeline{VK_NULL_HANDLE};
+    VkPipelineLayout pipelineLayout;
+    uint32_t profileScope;
+    //separate scopes per mode, so the GPU profile compares fragment work with and without the pre-pass
+    uint32_t prepassProfileScope;
+};
+
+typedef Handle<Mesh> MeshHandle;
+typedef Handle<Material> MaterialHandle;
+typedef Handle<Texture> TextureHandle;
+
+//handles rather than pointers, so objects stay valid however the engine's asset pools grow
+struct RenderObject {
+    MeshHandle mesh;
+    MaterialHandle material;
+    //used while the object is not attached to a scene graph node
+    glm::mat4 transformMatrix;
+    uint32_t transformNode = INVALID_NODE;
+    //detail level picked last frame, the starting point for the next selection
+    uint32_t lodLevel = 0;
+};
+
+inline const glm::mat4 &objectMatrix(const RenderObject &object, const SceneGraph &sceneGraph) {
+    return object.transformNode != INVALID_NODE ? sceneGraph.worldMatrix(object.transformNode) : object.transformMatrix;
+}
+
+//objects outside the scene graph keep their transformMatrix for good, their shadows are cached
+inline bool isStaticObject(const RenderObject &object) {
+    return object.transformNode == INVALID_NODE;
+}
+
+//coarsest level of the mesh whose error projects to at most maxPixelError pixels. projectionScale is the viewport
+//height divided by 2 * tan(fovY / 2). a coarser level than currentLevel has to stay below a fraction of the budget,
+//so objects near a switching distance don't pop back and forth
+uint32_t selectLod(const Mesh &mesh, const glm::mat4 &model, const glm::vec3 &cameraPosition, float projectionScale,
+                   float maxPixelError, uint32_t currentLevel);
+
+//coarsest level of the mesh whose world space error stays below maxError, shadow casters only have to be accurate
+//to a shadow texel
+uint32_t selectShadowLod(const Mesh &mesh, const glm::mat4 &model, float maxError);
+
+//fills the per-object SSBO, one entry per render object in draw order
+void packObjectData(const RenderObject *first, int count, const SceneGraph &sceneGraph, GPUObjectData *outObjects);
+
+#endif //VULKAN_STEP_BY_STEP_RENDER_OBJECT_H
@@ -0,0 +1,97 @@
+#include "residency.h"
+
+void ResidencyManager::init(uint64_t budgetBytes, uint32_t framesInFlight) {
+    _budget = budgetBytes;
+    _framesInFlight = framesInFlight;
+}
+
+uint32_t ResidencyManager::add(uint64_t bytes, int64_t frame) {
+    uint32_t id = (uint32_t) _resources.size();
+    Resource resource = {bytes, frame, true, INVALID_RESIDENCY_ID, INVALID_RESIDENCY_ID};
+    _resources.push_back(resource);
+    link(id);
+    _residentBytes += bytes;
+    _totalBytes += bytes;
+    return id;
+}
+
+void ResidencyManager::touch(uint32_t id, int64_t frame) {
+    if (id == INVALID_RESIDENCY_ID) {
+        return;
+    }
+    Resource &resource = _resources[id];
+    //most objects share their mesh and material with others, only the first use of a frame reorders
+    if (resource.lastUsed == frame) {
+        return;
+    }
+    resource.lastUsed = frame;
+    if (resource.resident && id != _newest) {
+        unlink(id);
+        link(id);
+    }
+}
+
+bool ResidencyManager::resident(uint32_t id) const {
+    return id == INVALID_RESIDENCY_ID || _resources[id].resident;
+}
+
+void ResidencyManager::setResident(uint32_t id, uint64_t bytes, int64_t frame) {
+    Resource &resource = _resources[id];
+    if (resource.resident) {
+        return;
+    }
+    _totalBytes += bytes - resource.bytes;
+    resource.bytes = bytes;
+    resource.lastUsed = frame;
+    resource.resident = true;
+    link(id);
+    _residentBytes += bytes;
+    _reloads++;
+}
+
+void ResidencyManager::evict(int64_t frame, std::vector<uint32_t> &evicted) {
+    if (_budget == 0) {
+        return;
+    }
+    while (_residentBytes > _budget && _oldest != INVALID_RESIDENCY_ID) {
+        uint32_t id = _oldest;
+        Resource &resource = _resources[id];
+        //the list is ordered by last use, everything behind the oldest was used at least as recently
+        if (resource.lastUsed + _framesInFlight > frame) {
+            return;
+        }
+        unlink(id);
+        resource.resident = false;
+        _residentBytes -= resource.bytes;
+        _evictions++;
+        evicted.push_back(id);
+    }
+}
+
+void ResidencyManager::link(uint32_t id) {
+    Resource &resource = _resources[id];
+    resource.previous = _newest;
+    resource.next = INVALID_RESIDENCY_ID;
+    if (_newest != INVALID_RESIDENCY_ID) {
+        _resources[_newest].next = id;
+    } else {
+        _oldest = id;
+    }
+    _newest = id;
+}
+
+void ResidencyManager::unlink(uint32_t id) {
+    Resource &resource = _resources[id];
+    if (resource.previous != INVALID_RESIDENCY_ID) {
+        _resources[resource.previous].next = resource.next;
+    } else {
+        _oldest = resource.next;
+    }
+    if (resource.next != INVALID_RESIDENCY_ID) {
+        _resources[resource.next].previous = resource.previous;
+    } else {
+        _newest = resource.previous;
+    }
+    resource.previous = INVALID_RESIDENCY_ID;
+    resource.next = INVALID_RESIDENCY_ID;
+}
@@ -0,0 +1,94 @@
+#ifndef VULKAN_STEP_BY_STEP_RESIDENCY_H
+#define VULKAN_STEP_BY_STEP_RESIDENCY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+constexpr uint32_t INVALID_RESIDENCY_ID = ~0u;
+
+enum ResidentAssetType {
+    //handle is one of _meshes
+    RESIDENT_MESH,
+    //name is a key of _meshChunks, the chunks share one vertex buffer and come and go together
+    RESIDENT_MESH_CHUNKS,
+    //handle is one of _textures, loaded again from path
+    RESIDENT_TEXTURE,
+    //handle is one of _textures, decoded again from image of the .glb at path
+    RESIDENT_GLB_TEXTURE
+};
+
+//what a residency id stands for on the engine side
+struct ResidentAsset {
+    ResidentAssetType type;
+    std::string name;
+    std::string path;
+    uint32_t image;
+    //value of the asset's pool handle, so reloads and evictions resolve it without hashing name
+    uint32_t handle;
+    //a texture that could not be decoded again, its materials sample the fallback texture from then on
+    bool reloadFailed;
+};
+
+//least recently used order over GPU resources that can be dropped and uploaded again. the engine touches what it
+//draws and asks which resources have to go to get back under the budget. a resource only goes once none of the
+//frames that may still be in flight used it, so it can be destroyed right away
+class ResidencyManager {
+public:
+    //a budget of 0 never evicts
+    void init(uint64_t budgetBytes, uint32_t framesInFlight);
+
+    //a resource that is on the GPU already, ids count up from 0 in the order of registration
+    uint32_t add(uint64_t bytes, int64_t frame);
+
+    //the frame being recorded uses the resource, ignores INVALID_RESIDENCY_ID
+    void touch(uint32_t id, int64_t frame);
+
+    //true for INVALID_RESIDENCY_ID
+    bool resident(uint32_t id) const;
+
+    //the resource was uploaded again after an eviction
+    void setResident(uint32_t id, uint64_t bytes, int64_t frame);
+
+    //call once the frame's draws are recorded. marks the least recently used resources evicted until the resident
+    //bytes fit the budget and appends their ids. what the last framesInFlight frames used stays, so the resident
+    //bytes can remain above the budget
+    void evict(int64_t frame, std::vector<uint32_t> &evicted);
+
+    uint64_t budget() const { return _budget; }
+
+    uint64_t residentBytes() const { return _residentBytes; }
+
+    uint64_t totalBytes() const { return _totalBytes; }
+
+    uint32_t evictions() const { return _evictions; }
+
+    uint32_t reloads() const { return _reloads; }
+
+private:
+    struct Resource {
+        uint64_t bytes;
+        int64_t lastUsed;
+        bool resident;
+        //neighbours in the least recently used list, only resident resources are linked
+        uint32_t previous;
+        uint32_t next;
+    };
+
+    void link(uint32_t id);
+
+    void unlink(uint32_t id);
+
+    uint64_t _budget = 0;
+    uint32_t _framesInFlight = 1;
+    std::vector<Resource> _resources;
+    //least recently used first
+    uint32_t _oldest = INVALID_RESIDENCY_ID;
+    uint32_t _newest = INVALID_RESIDENCY_ID;
+    uint64_t _residentBytes = 0;
+    uint64_t _totalBytes = 0;
+    uint32_t _evictions = 0;
+    uint32_t _reloads = 0;
+};
+
+#endif //VULKAN_STEP_BY_STEP_RESIDENCY_H
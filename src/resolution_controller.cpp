@@ -0,0 +1,63 @@
+#include "resolution_controller.h"
+#include <algorithm>
+#include <cmath>
+
+static const double PROPORTIONAL_GAIN = 0.6;
+static const double INTEGRAL_GAIN = 0.15;
+static const double DERIVATIVE_GAIN = 0.1;
+//largest relative change of the pixel count per step
+static const double MAX_STEP = 0.25;
+//relative error the controller ignores, so the resolution doesn't flicker around the budget
+static const double DEAD_BAND = 0.03;
+
+void ResolutionController::init(double targetMilliseconds, float minScale, float maxScale) {
+    _targetMilliseconds = targetMilliseconds;
+    _minScale = std::min(minScale, maxScale);
+    _maxScale = maxScale;
+    _scale = maxScale;
+    _sampleSum = 0.0;
+    _sampleCount = 0;
+    _integral = 0.0;
+    _previousError = 0.0;
+    _hasPreviousError = false;
+}
+
+bool ResolutionController::addSample(double gpuMilliseconds) {
+    if (!enabled() || gpuMilliseconds <= 0.0) {
+        return false;
+    }
+    _sampleSum += gpuMilliseconds;
+    _sampleCount++;
+    if (_sampleCount < UPDATE_INTERVAL) {
+        return false;
+    }
+    double average = _sampleSum / _sampleCount;
+    _sampleSum = 0.0;
+    _sampleCount = 0;
+
+    //positive while there is headroom, relative so the gains don't depend on the budget
+    double error = (_targetMilliseconds - average) / _targetMilliseconds;
+    if (std::fabs(error) < DEAD_BAND) {
+        error = 0.0;
+    }
+    double derivative = _hasPreviousError ? error - _previousError : 0.0;
+    _previousError = error;
+    _hasPreviousError = true;
+
+    double output = PROPORTIONAL_GAIN * error + INTEGRAL_GAIN * (_integral + error) + DERIVATIVE_GAIN * derivative;
+    output = std::max(-MAX_STEP, std::min(output, MAX_STEP));
+
+    double area = (double) _scale * _scale * (1.0 + output);
+    double minArea = (double) _minScale * _minScale;
+    double maxArea = (double) _maxScale * _maxScale;
+    //the integral only winds up while the scale can still follow it
+    if ((area > minArea || error > 0.0) && (area < maxArea || error < 0.0)) {
+        _integral += error;
+    }
+    area = std::max(minArea, std::min(area, maxArea));
+
+    float scale = (float) std::sqrt(area);
+    bool changed = scale != _scale;
+    _scale = scale;
+    return changed;
+}
@@ -0,0 +1,38 @@
+#ifndef VULKAN_STEP_BY_STEP_RESOLUTION_CONTROLLER_H
+#define VULKAN_STEP_BY_STEP_RESOLUTION_CONTROLLER_H
+
+#include <cstdint>
+
+//PID controller that scales the render resolution until the measured GPU frame time settles at a budget. the GPU
+//cost of a frame grows with its pixel count, so the controller steers the scale squared and applies its output as
+//a relative change, which keeps the loop gain the same at every resolution
+class ResolutionController {
+public:
+    //measured frames averaged into one controller step, the scale changes at most this often
+    static const uint32_t UPDATE_INTERVAL = 4;
+
+    //a target of 0 keeps the scale at maxScale
+    void init(double targetMilliseconds, float minScale, float maxScale);
+
+    //feeds the GPU time of one frame, true when the scale changed
+    bool addSample(double gpuMilliseconds);
+
+    float scale() const { return _scale; }
+
+    bool enabled() const { return _targetMilliseconds > 0.0; }
+
+private:
+    double _targetMilliseconds = 0.0;
+    float _minScale = 1.0f;
+    float _maxScale = 1.0f;
+    float _scale = 1.0f;
+
+    double _sampleSum = 0.0;
+    uint32_t _sampleCount = 0;
+
+    double _integral = 0.0;
+    double _previousError = 0.0;
+    bool _hasPreviousError = false;
+};
+
+#endif //VULKAN_STEP_BY_STEP_RESOLUTION_CONTROLLER_H
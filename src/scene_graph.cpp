@@ -0,0 +1,204 @@
+#include "scene_graph.h"
+#include <algorithm>
+#include "worker_pool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SCENE_GRAPH_SSE
+#endif
+
+void multiplyMatrix(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out) {
+#ifdef SCENE_GRAPH_SSE
+    const float *left = &a[0][0];
+    const float *right = &b[0][0];
+    __m128 column0 = _mm_loadu_ps(left);
+    __m128 column1 = _mm_loadu_ps(left + 4);
+    __m128 column2 = _mm_loadu_ps(left + 8);
+    __m128 column3 = _mm_loadu_ps(left + 12);
+
+    //every output column is a linear combination of a's columns, weighted by the matching column of b
+    __m128 result[4];
+    for (int i = 0; i < 4; i++) {
+        const float *weights = right + 4 * i;
+        __m128 column = _mm_mul_ps(column0, _mm_set1_ps(weights[0]));
+        column = _mm_add_ps(column, _mm_mul_ps(column1, _mm_set1_ps(weights[1])));
+        column = _mm_add_ps(column, _mm_mul_ps(column2, _mm_set1_ps(weights[2])));
+        column = _mm_add_ps(column, _mm_mul_ps(column3, _mm_set1_ps(weights[3])));
+        result[i] = column;
+    }
+
+    float *destination = &out[0][0];
+    for (int i = 0; i < 4; i++) {
+        _mm_storeu_ps(destination + 4 * i, result[i]);
+    }
+#else
+    out = a * b;
+#endif
+}
+
+SceneGraph::SceneGraph() = default;
+
+//out of line, WorkerPool is only complete here
+SceneGraph::~SceneGraph() = default;
+
+uint32_t SceneGraph::createNode(uint32_t parent, const glm::vec3 &translation, const glm::quat &rotation,
+                                const glm::vec3 &scale) {
+    uint32_t node = (uint32_t) _parents.size();
+
+    _parents.push_back(parent);
+    _translations.push_back(translation);
+    _rotations.push_back(rotation);
+    _scales.push_back(scale);
+    _worldMatrices.push_back(glm::mat4{1.0f});
+    _firstChildren.push_back(INVALID_NODE);
+    _lastChildren.push_back(INVALID_NODE);
+    _nextSiblings.push_back(INVALID_NODE);
+    if (parent != INVALID_NODE) {
+        if (_lastChildren[parent] == INVALID_NODE) {
+            _firstChildren[parent] = node;
+        } else {
+            _nextSiblings[_lastChildren[parent]] = node;
+        }
+        _lastChildren[parent] = node;
+    }
+    _dirty.push_back(0);
+    markDirty(node);
+    return node;
+}
+
+void SceneGraph::setTranslation(uint32_t node, const glm::vec3 &translation) {
+    _translations[node] = translation;
+    markDirty(node);
+}
+
+void SceneGraph::setRotation(uint32_t node, const glm::quat &rotation) {
+    _rotations[node] = rotation;
+    markDirty(node);
+}
+
+void SceneGraph::setScale(uint32_t node, const glm::vec3 &scale) {
+    _scales[node] = scale;
+    markDirty(node);
+}
+
+void SceneGraph::markDirty(uint32_t node) {
+    if (!_dirty[node]) {
+        _dirty[node] = 1;
+        _dirtyNodes.push_back(node);
+    }
+}
+
+bool SceneGraph::hasDirtyAncestor(uint32_t node) const {
+    for (uint32_t parent = _parents[node]; parent != INVALID_NODE; parent = _parents[parent]) {
+        if (_dirty[parent]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SceneGraph::clearDirty() {
+    for (uint32_t node : _dirtyNodes) {
+        _dirty[node] = 0;
+    }
+    _dirtyNodes.clear();
+}
+
+glm::mat4 SceneGraph::localMatrix(uint32_t node) const {
+    //translation * rotation * scale without the two full matrix products
+    glm::mat3 rotation = glm::mat3_cast(_rotations[node]);
+    const glm::vec3 &scale = _scales[node];
+
+    glm::mat4 local;
+    local[0] = glm::vec4(rotation[0] * scale.x, 0.0f);
+    local[1] = glm::vec4(rotation[1] * scale.y, 0.0f);
+    local[2] = glm::vec4(rotation[2] * scale.z, 0.0f);
+    local[3] = glm::vec4(_translations[node], 1.0f);
+    return local;
+}
+
+void SceneGraph::updateNodes(const uint32_t *nodes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t node = nodes[i];
+        uint32_t parent = _parents[node];
+        if (parent == INVALID_NODE) {
+            _worldMatrices[node] = localMatrix(node);
+        } else {
+            multiplyMatrix(_worldMatrices[parent], localMatrix(node), _worldMatrices[node]);
+        }
+    }
+}
+
+void SceneGraph::updateLevel(const uint32_t *nodes, size_t count, uint32_t workerCount) {
+    if (workerCount <= 1 || count < PARALLEL_LEVEL_SIZE) {
+        updateNodes(nodes, count);
+        return;
+    }
+    if (!_workers || _workers->threadCount() != workerCount - 1) {
+        _workers.reset(new WorkerPool(workerCount - 1));
+    }
+    size_t chunk = (count + workerCount - 1) / workerCount;
+    _workers->run(workerCount, [=](size_t worker) {
+        size_t first = worker * chunk;
+        if (first < count) {
+            updateNodes(nodes + first, std::min(chunk, count - first));
+        }
+    });
+}
+
+void SceneGraph::update(uint32_t workerCount) {
+    if (_dirtyNodes.empty()) {
+        return;
+    }
+
+    //a dirty node below another one is covered by that one's subtree
+    _updateNodes.clear();
+    for (uint32_t node : _dirtyNodes) {
+        if (!hasDirtyAncestor(node)) {
+            _updateNodes.push_back(node);
+        }
+    }
+
+    //the subtrees are disjoint and every node comes one level after its parent, whose matrix is then current
+    size_t levelStart = 0;
+    while (levelStart < _updateNodes.size()) {
+        size_t levelEnd = _updateNodes.size();
+        updateLevel(_updateNodes.data() + levelStart, levelEnd - levelStart, workerCount);
+        for (size_t i = levelStart; i < levelEnd; i++) {
+            for (uint32_t child = _firstChildren[_updateNodes[i]]; child != INVALID_NODE;
+                 child = _nextSiblings[child]) {
+                _updateNodes.push_back(child);
+            }
+        }
+        levelStart = levelEnd;
+    }
+
+    clearDirty();
+}
+
+void SceneGraph::updateAll() {
+    for (uint32_t node = 0; node < _parents.size(); node++) {
+        uint32_t parent = _parents[node];
+        if (parent == INVALID_NODE) {
+            _worldMatrices[node] = localMatrix(node);
+        } else {
+            multiplyMatrix(_worldMatrices[parent], localMatrix(node), _worldMatrices[node]);
+        }
+    }
+
+    clearDirty();
+}
+
+void SceneGraph::clear() {
+    _parents.clear();
+    _translations.clear();
+    _rotations.clear();
+    _scales.clear();
+    _worldMatrices.clear();
+    _firstChildren.clear();
+    _lastChildren.clear();
+    _nextSiblings.clear();
+    _dirty.clear();
+    _dirtyNodes.clear();
+    _updateNodes.clear();
+}
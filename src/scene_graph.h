@@ -0,0 +1,94 @@
+#ifndef VULKAN_STEP_BY_STEP_SCENE_GRAPH_H
+#define VULKAN_STEP_BY_STEP_SCENE_GRAPH_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+
+const uint32_t INVALID_NODE = ~0u;
+
+class WorkerPool;
+
+//out = a * b for column-major matrices, SSE when the target has it
+void multiplyMatrix(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out);
+
+//transform hierarchy in flat arrays. a parent always has a lower index than its children. an update walks down
+//from the dirty nodes only, one level of their subtrees at a time, so a wide level can be split across threads once
+//the level above it is done.
+class SceneGraph {
+public:
+    //levels with at least this many nodes are updated in parallel
+    static constexpr size_t PARALLEL_LEVEL_SIZE = 8192;
+
+    SceneGraph();
+
+    ~SceneGraph();
+
+    //the parent has to exist already, which keeps parents before their children
+    uint32_t createNode(uint32_t parent = INVALID_NODE, const glm::vec3 &translation = glm::vec3(0.0f),
+                        const glm::quat &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                        const glm::vec3 &scale = glm::vec3(1.0f));
+
+    void setTranslation(uint32_t node, const glm::vec3 &translation);
+
+    void setRotation(uint32_t node, const glm::quat &rotation);
+
+    void setScale(uint32_t node, const glm::vec3 &scale);
+
+    const glm::vec3 &getTranslation(uint32_t node) const { return _translations[node]; }
+
+    const glm::quat &getRotation(uint32_t node) const { return _rotations[node]; }
+
+    const glm::vec3 &getScale(uint32_t node) const { return _scales[node]; }
+
+    uint32_t getParent(uint32_t node) const { return _parents[node]; }
+
+    //world matrix as of the last update
+    const glm::mat4 &worldMatrix(uint32_t node) const { return _worldMatrices[node]; }
+
+    //recomputes dirty nodes and their subtrees only, wide levels are split over workerCount threads. the threads are
+    //started by the first update that needs them and kept for the next ones
+    void update(uint32_t workerCount = 1);
+
+    //recomputes every node, the baseline the incremental update is measured against
+    void updateAll();
+
+    size_t size() const { return _parents.size(); }
+
+    void clear();
+
+private:
+    glm::mat4 localMatrix(uint32_t node) const;
+
+    void updateNodes(const uint32_t *nodes, size_t count);
+
+    void updateLevel(const uint32_t *nodes, size_t count, uint32_t workerCount);
+
+    void markDirty(uint32_t node);
+
+    bool hasDirtyAncestor(uint32_t node) const;
+
+    void clearDirty();
+
+    std::vector<uint32_t> _parents;
+    std::vector<glm::vec3> _translations;
+    std::vector<glm::quat> _rotations;
+    std::vector<glm::vec3> _scales;
+    std::vector<glm::mat4> _worldMatrices;
+    //children as linked lists in creation order, INVALID_NODE ends them. an update then walks the nodes of a level
+    //in about the order they are stored
+    std::vector<uint32_t> _firstChildren;
+    std::vector<uint32_t> _lastChildren;
+    std::vector<uint32_t> _nextSiblings;
+    //a flag per node and the flagged nodes, so an update touches what moved rather than every node
+    std::vector<uint8_t> _dirty;
+    std::vector<uint32_t> _dirtyNodes;
+
+    //the nodes of an update level by level, the dirty roots first. kept to not allocate every frame
+    std::vector<uint32_t> _updateNodes;
+    std::unique_ptr<WorkerPool> _workers;
+};
+
+#endif //VULKAN_STEP_BY_STEP_SCENE_GRAPH_H
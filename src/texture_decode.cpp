@@ -0,0 +1,186 @@
+#include "texture_decode.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stb_image.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TEXTURE_DECODE_SSSE3
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#define TEXTURE_DECODE_NEON
+#include <arm_neon.h>
+#endif
+
+void expandToRgbaScalar(const uint8_t *src, uint32_t channels, size_t pixelCount, uint8_t *dst) {
+    for (size_t i = 0; i < pixelCount; i++, src += channels, dst += 4) {
+        switch (channels) {
+            case 1:
+                dst[0] = dst[1] = dst[2] = src[0];
+                dst[3] = 255;
+                break;
+            case 2:
+                dst[0] = dst[1] = dst[2] = src[0];
+                dst[3] = src[1];
+                break;
+            case 3:
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+                dst[3] = 255;
+                break;
+            default:
+                memcpy(dst, src, 4);
+                break;
+        }
+    }
+}
+
+#ifdef TEXTURE_DECODE_SSSE3
+//16 texels per iteration, three loads cover their 48 bytes and every shuffle spreads 12 of them over 16
+__attribute__((target("ssse3")))
+static size_t expandRgbSsse3(const uint8_t *src, size_t pixelCount, uint8_t *dst) {
+    const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32((int) 0xFF000000);
+    size_t i = 0;
+    for (; i + 16 <= pixelCount; i += 16, src += 48, dst += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *) src);
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *) (src + 32));
+        __m128i texels0 = _mm_shuffle_epi8(a, spread);
+        __m128i texels1 = _mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), spread);
+        __m128i texels2 = _mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), spread);
+        __m128i texels3 = _mm_shuffle_epi8(_mm_srli_si128(c, 4), spread);
+        _mm_storeu_si128((__m128i *) dst, _mm_or_si128(texels0, alpha));
+        _mm_storeu_si128((__m128i *) (dst + 16), _mm_or_si128(texels1, alpha));
+        _mm_storeu_si128((__m128i *) (dst + 32), _mm_or_si128(texels2, alpha));
+        _mm_storeu_si128((__m128i *) (dst + 48), _mm_or_si128(texels3, alpha));
+    }
+    return i;
+}
+
+//SSE2 is all this needs, which every x86-64 CPU has
+static size_t expandGreySse2(const uint8_t *src, size_t pixelCount, uint8_t *dst) {
+    const __m128i opaque = _mm_set1_epi8(-1);
+    size_t i = 0;
+    for (; i + 16 <= pixelCount; i += 16, src += 16, dst += 64) {
+        __m128i grey = _mm_loadu_si128((const __m128i *) src);
+        __m128i pairsLow = _mm_unpacklo_epi8(grey, grey);
+        __m128i pairsHigh = _mm_unpackhi_epi8(grey, grey);
+        __m128i alphaLow = _mm_unpacklo_epi8(grey, opaque);
+        __m128i alphaHigh = _mm_unpackhi_epi8(grey, opaque);
+        _mm_storeu_si128((__m128i *) dst, _mm_unpacklo_epi16(pairsLow, alphaLow));
+        _mm_storeu_si128((__m128i *) (dst + 16), _mm_unpackhi_epi16(pairsLow, alphaLow));
+        _mm_storeu_si128((__m128i *) (dst + 32), _mm_unpacklo_epi16(pairsHigh, alphaHigh));
+        _mm_storeu_si128((__m128i *) (dst + 48), _mm_unpackhi_epi16(pairsHigh, alphaHigh));
+    }
+    return i;
+}
+
+static bool hasSsse3() {
+    static const bool supported = __builtin_cpu_supports("ssse3");
+    return supported;
+}
+#endif
+
+#ifdef TEXTURE_DECODE_NEON
+static size_t expandRgbNeon(const uint8_t *src, size_t pixelCount, uint8_t *dst) {
+    size_t i = 0;
+    for (; i + 16 <= pixelCount; i += 16, src += 48, dst += 64) {
+        uint8x16x3_t rgb = vld3q_u8(src);
+        uint8x16x4_t rgba;
+        rgba.val[0] = rgb.val[0];
+        rgba.val[1] = rgb.val[1];
+        rgba.val[2] = rgb.val[2];
+        rgba.val[3] = vdupq_n_u8(255);
+        vst4q_u8(dst, rgba);
+    }
+    return i;
+}
+
+static size_t expandGreyNeon(const uint8_t *src, size_t pixelCount, uint8_t *dst) {
+    size_t i = 0;
+    for (; i + 16 <= pixelCount; i += 16, src += 16, dst += 64) {
+        uint8x16x4_t rgba;
+        rgba.val[0] = rgba.val[1] = rgba.val[2] = vld1q_u8(src);
+        rgba.val[3] = vdupq_n_u8(255);
+        vst4q_u8(dst, rgba);
+    }
+    return i;
+}
+#endif
+
+void expandToRgba(const uint8_t *src, uint32_t channels, size_t pixelCount, uint8_t *dst) {
+    if (channels == 4) {
+        memcpy(dst, src, pixelCount * 4);
+        return;
+    }
+    //the kernels stop at the last whole block, the scalar loop finishes the tail
+    size_t done = 0;
+#if defined(TEXTURE_DECODE_SSSE3)
+    if (channels == 3 && hasSsse3()) {
+        done = expandRgbSsse3(src, pixelCount, dst);
+    } else if (channels == 1) {
+        done = expandGreySse2(src, pixelCount, dst);
+    }
+#elif defined(TEXTURE_DECODE_NEON)
+    if (channels == 3) {
+        done = expandRgbNeon(src, pixelCount, dst);
+    } else if (channels == 1) {
+        done = expandGreyNeon(src, pixelCount, dst);
+    }
+#endif
+    expandToRgbaScalar(src + done * channels, channels, pixelCount - done, dst + done * 4);
+}
+
+bool readImageSize(ImageDecodeJob &job) {
+    int width, height, channels;
+    if (!stbi_info(job.file.c_str(), &width, &height, &channels) || width <= 0 || height <= 0) {
+        return false;
+    }
+    job.width = (uint32_t) width;
+    job.height = (uint32_t) height;
+    return true;
+}
+
+bool decodeImage(ImageDecodeJob &job) {
+    //in the file's own channel count, stb's scalar RGBA expansion would cost a second pass over the texels
+    int width, height, channels;
+    stbi_uc *pixels = stbi_load(job.file.c_str(), &width, &height, &channels, 0);
+    if (!pixels) {
+        return false;
+    }
+    bool matches = (uint32_t) width == job.width && (uint32_t) height == job.height;
+    if (matches) {
+        expandToRgba(pixels, (uint32_t) channels, (size_t) width * height, job.destination);
+    }
+    stbi_image_free(pixels);
+    return matches;
+}
+
+void decodeImages(std::vector<ImageDecodeJob> &jobs, uint32_t workerCount) {
+    if (workerCount == 0) {
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workerCount = (uint32_t) std::min<size_t>(workerCount, jobs.size());
+
+    //files differ a lot in size, so workers take the next one when they are done rather than a fixed share
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t job = next++; job < jobs.size(); job = next++) {
+            jobs[job].decoded = decodeImage(jobs[job]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (uint32_t worker = 1; worker < workerCount; worker++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread &thread : workers) {
+        thread.join();
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef VULKAN_STEP_BY_STEP_TEXTURE_DECODE_H
+#define VULKAN_STEP_BY_STEP_TEXTURE_DECODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//an image file decoded to RGBA8 texels at destination, which holds width * height * 4 bytes. the engine points
+//destination into mapped staging memory
+struct ImageDecodeJob {
+    std::string file;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t *destination = nullptr;
+    bool decoded = false;
+};
+
+//reads the size from the file header without decoding the texels, false when the file can't be read
+bool readImageSize(ImageDecodeJob &job);
+
+//decodes the file in its own channel count and expands it to RGBA8 straight into destination. false when the file
+//can't be decoded or its size differs from the job's
+bool decodeImage(ImageDecodeJob &job);
+
+//decodes the jobs on workerCount threads, 0 uses one per core. decoded tells which ones succeeded
+void decodeImages(std::vector<ImageDecodeJob> &jobs, uint32_t workerCount);
+
+//RGBA8 texels from 1 (grey), 2 (grey, alpha), 3 (RGB) or 4 channel ones, opaque where the source has no alpha.
+//uses SSSE3 or NEON when the CPU has them
+void expandToRgba(const uint8_t *src, uint32_t channels, size_t pixelCount, uint8_t *dst);
+
+//the same one texel at a time, the reference the SIMD kernels are measured against
+void expandToRgbaScalar(const uint8_t *src, uint32_t channels, size_t pixelCount, uint8_t *dst);
+
+#endif //VULKAN_STEP_BY_STEP_TEXTURE_DECODE_H
@@ -0,0 +1,73 @@
+#include "timing_stats.h"
+#include <algorithm>
+#include <cmath>
+
+double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    size_t rank = (size_t) std::ceil(p / 100.0 * samples.size());
+    size_t index = rank == 0 ? 0 : std::min(rank - 1, samples.size() - 1);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+TimingSummary summarizeTimings(const std::vector<double> &samples) {
+    TimingSummary summary;
+    if (samples.empty()) {
+        return summary;
+    }
+    std::vector<double> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for (double sample : sorted) {
+        sum += sample;
+    }
+    summary.mean = sum / sorted.size();
+    summary.median = percentile(sorted, 50.0);
+    summary.p95 = percentile(sorted, 95.0);
+    summary.p99 = percentile(sorted, 99.0);
+    summary.max = sorted.back();
+    return summary;
+}
+
+TimingHistory::TimingHistory(size_t capacity) : _capacity(capacity) {
+    _samples.reserve(capacity);
+}
+
+void TimingHistory::push(double value) {
+    if (_samples.size() < _capacity) {
+        _samples.push_back(value);
+    } else {
+        _samples[_next] = value;
+    }
+    _next = (_next + 1) % _capacity;
+}
+
+size_t TimingHistory::size() const {
+    return _samples.size();
+}
+
+double TimingHistory::min() const {
+    return _samples.empty() ? 0.0 : *std::min_element(_samples.begin(), _samples.end());
+}
+
+double TimingHistory::max() const {
+    return _samples.empty() ? 0.0 : *std::max_element(_samples.begin(), _samples.end());
+}
+
+double TimingHistory::average() const {
+    if (_samples.empty()) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (double sample : _samples) {
+        sum += sample;
+    }
+    return sum / _samples.size();
+}
+
+double TimingHistory::percentile(double p) const {
+    return ::percentile(_samples, p);
+}
@@ -0,0 +1,43 @@
+#ifndef VULKAN_STEP_BY_STEP_TIMING_STATS_H
+#define VULKAN_STEP_BY_STEP_TIMING_STATS_H
+
+#include <vector>
+#include <cstddef>
+
+//nearest-rank percentile, p in [0, 100]. takes a copy since the samples get partially sorted
+double percentile(std::vector<double> samples, double p);
+
+struct TimingSummary {
+    double mean = 0.0;
+    double median = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+TimingSummary summarizeTimings(const std::vector<double> &samples);
+
+//fixed size window over the most recent samples of a timing series
+class TimingHistory {
+public:
+    explicit TimingHistory(size_t capacity = 240);
+
+    void push(double value);
+
+    size_t size() const;
+
+    double min() const;
+
+    double max() const;
+
+    double average() const;
+
+    double percentile(double p) const;
+
+private:
+    std::vector<double> _samples;
+    size_t _capacity;
+    size_t _next = 0;
+};
+
+#endif //VULKAN_STEP_BY_STEP_TIMING_STATS_H
@@ -0,0 +1,107 @@
+#include "vk_deferred_destruction.h"
+
+void DeferredDestructionQueue::init(VkDevice device, VmaAllocator allocator, uint32_t framesInFlight,
+                                    size_t reservePerFrame) {
+    _device = device;
+    _allocator = allocator;
+    _framesInFlight = framesInFlight;
+    _currentFrame = 0;
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        _frames[i].reserve(reservePerFrame);
+    }
+}
+
+void DeferredDestructionQueue::beginFrame(uint32_t frameIndex) {
+    //anything queued after the previous frame was submitted went into that frame's slot, so it is only released
+    //after a submission that may still use it has finished
+    _currentFrame = frameIndex;
+    release(_frames[frameIndex]);
+}
+
+void DeferredDestructionQueue::destroyBuffer(const AllocatedBuffer &buffer) {
+    push(DEFERRED_BUFFER, (uint64_t) buffer._buffer, buffer._allocation);
+}
+
+void DeferredDestructionQueue::destroyImage(const AllocatedImage &image) {
+    push(DEFERRED_IMAGE, (uint64_t) image._image, image._allocation);
+}
+
+void DeferredDestructionQueue::destroyImageView(VkImageView imageView) {
+    push(DEFERRED_IMAGE_VIEW, (uint64_t) imageView);
+}
+
+void DeferredDestructionQueue::destroySampler(VkSampler sampler) {
+    push(DEFERRED_SAMPLER, (uint64_t) sampler);
+}
+
+void DeferredDestructionQueue::destroyFramebuffer(VkFramebuffer framebuffer) {
+    push(DEFERRED_FRAMEBUFFER, (uint64_t) framebuffer);
+}
+
+void DeferredDestructionQueue::destroyPipeline(VkPipeline pipeline) {
+    push(DEFERRED_PIPELINE, (uint64_t) pipeline);
+}
+
+void DeferredDestructionQueue::destroyDescriptorPool(VkDescriptorPool descriptorPool) {
+    push(DEFERRED_DESCRIPTOR_POOL, (uint64_t) descriptorPool);
+}
+
+void DeferredDestructionQueue::destroyQueryPool(VkQueryPool queryPool) {
+    push(DEFERRED_QUERY_POOL, (uint64_t) queryPool);
+}
+
+void DeferredDestructionQueue::flush() {
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        release(_frames[i]);
+    }
+}
+
+size_t DeferredDestructionQueue::pendingCount() const {
+    size_t count = 0;
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        count += _frames[i].size();
+    }
+    return count;
+}
+
+void DeferredDestructionQueue::push(DeferredHandleType type, uint64_t handle, VmaAllocation allocation) {
+    Entry entry;
+    entry.handle = handle;
+    entry.allocation = allocation;
+    entry.type = type;
+    _frames[_currentFrame].push_back(entry);
+}
+
+void DeferredDestructionQueue::release(std::vector<Entry> &entries) {
+    //reverse order, so views queued after their image go first like in the deletion queue
+    for (auto it = entries.rbegin(); it != entries.rend(); it++) {
+        switch (it->type) {
+            case DEFERRED_BUFFER:
+                vmaDestroyBuffer(_allocator, (VkBuffer) it->handle, it->allocation);
+                break;
+            case DEFERRED_IMAGE:
+                vmaDestroyImage(_allocator, (VkImage) it->handle, it->allocation);
+                break;
+            case DEFERRED_IMAGE_VIEW:
+                vkDestroyImageView(_device, (VkImageView) it->handle, nullptr);
+                break;
+            case DEFERRED_SAMPLER:
+                vkDestroySampler(_device, (VkSampler) it->handle, nullptr);
+                break;
+            case DEFERRED_FRAMEBUFFER:
+                vkDestroyFramebuffer(_device, (VkFramebuffer) it->handle, nullptr);
+                break;
+            case DEFERRED_PIPELINE:
+                vkDestroyPipeline(_device, (VkPipeline) it->handle, nullptr);
+                break;
+            case DEFERRED_DESCRIPTOR_POOL:
+                vkDestroyDescriptorPool(_device, (VkDescriptorPool) it->handle, nullptr);
+                break;
+            case DEFERRED_QUERY_POOL:
+                vkDestroyQueryPool(_device, (VkQueryPool) it->handle, nullptr);
+                break;
+        }
+    }
+    //clear keeps the capacity, so the next frame reuses the storage
+    entries.clear();
+}
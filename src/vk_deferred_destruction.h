@@ -0,0 +1,68 @@
+#ifndef VULKAN_STEP_BY_STEP_VK_DEFERRED_DESTRUCTION_H
+#define VULKAN_STEP_BY_STEP_VK_DEFERRED_DESTRUCTION_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "vk_types.h"
+#include "engine_config.h"
+
+enum DeferredHandleType {
+    DEFERRED_BUFFER,
+    DEFERRED_IMAGE,
+    DEFERRED_IMAGE_VIEW,
+    DEFERRED_SAMPLER,
+    DEFERRED_FRAMEBUFFER,
+    DEFERRED_PIPELINE,
+    DEFERRED_DESCRIPTOR_POOL,
+    DEFERRED_QUERY_POOL
+};
+
+//destroys resources released at runtime once the GPU is done with them. entries are plain values in one vector
+//per frame slot, so queueing and releasing doesn't allocate once the vectors have grown to the churn of a frame.
+class DeferredDestructionQueue {
+public:
+    void init(VkDevice device, VmaAllocator allocator, uint32_t framesInFlight, size_t reservePerFrame = 256);
+
+    //releases what was queued the last time this slot was recorded, call after waiting for the slot's timeline value
+    void beginFrame(uint32_t frameIndex);
+
+    void destroyBuffer(const AllocatedBuffer &buffer);
+
+    void destroyImage(const AllocatedImage &image);
+
+    void destroyImageView(VkImageView imageView);
+
+    void destroySampler(VkSampler sampler);
+
+    void destroyFramebuffer(VkFramebuffer framebuffer);
+
+    void destroyPipeline(VkPipeline pipeline);
+
+    void destroyDescriptorPool(VkDescriptorPool descriptorPool);
+
+    void destroyQueryPool(VkQueryPool queryPool);
+
+    //releases every slot, the device has to be idle
+    void flush();
+
+    size_t pendingCount() const;
+
+private:
+    struct Entry {
+        uint64_t handle;
+        VmaAllocation allocation;
+        DeferredHandleType type;
+    };
+
+    void push(DeferredHandleType type, uint64_t handle, VmaAllocation allocation = VK_NULL_HANDLE);
+
+    void release(std::vector<Entry> &entries);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    uint32_t _framesInFlight = 0;
+    uint32_t _currentFrame = 0;
+    std::vector<Entry> _frames[MAX_FRAMES_IN_FLIGHT];
+};
+
+#endif //VULKAN_STEP_BY_STEP_VK_DEFERRED_DESTRUCTION_H
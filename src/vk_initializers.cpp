@@ -120,6 +120,39 @@ VkSemaphoreCreateInfo vkinit::semaphoreCreateInfo(VkSemaphoreCreateFlags flags)
     return semCreateInfo;
 }
 
+VkSemaphoreTypeCreateInfoKHR vkinit::semaphoreTypeCreateInfo(VkSemaphoreTypeKHR type, uint64_t initialValue) {
+    VkSemaphoreTypeCreateInfoKHR info = {};
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+    info.pNext = nullptr;
+    info.semaphoreType = type;
+    info.initialValue = initialValue;
+    return info;
+}
+
+VkTimelineSemaphoreSubmitInfoKHR
+vkinit::timelineSemaphoreSubmitInfo(uint32_t waitValueCount, const uint64_t *waitValues, uint32_t signalValueCount,
+                                    const uint64_t *signalValues) {
+    VkTimelineSemaphoreSubmitInfoKHR info = {};
+    info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    info.pNext = nullptr;
+    info.waitSemaphoreValueCount = waitValueCount;
+    info.pWaitSemaphoreValues = waitValues;
+    info.signalSemaphoreValueCount = signalValueCount;
+    info.pSignalSemaphoreValues = signalValues;
+    return info;
+}
+
+VkSemaphoreWaitInfoKHR vkinit::semaphoreWaitInfo(const VkSemaphore *semaphore, const uint64_t *value) {
+    VkSemaphoreWaitInfoKHR info = {};
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+    info.pNext = nullptr;
+    info.flags = 0;
+    info.semaphoreCount = 1;
+    info.pSemaphores = semaphore;
+    info.pValues = value;
+    return info;
+}
+
 VkImageCreateInfo vkinit::imageCreateInfo(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent) {
     VkImageCreateInfo info = { };
     info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -30,6 +30,14 @@ namespace vkinit {
 
     VkSemaphoreCreateInfo semaphoreCreateInfo(VkSemaphoreCreateFlags flags = 0);
 
+    VkSemaphoreTypeCreateInfoKHR semaphoreTypeCreateInfo(VkSemaphoreTypeKHR type, uint64_t initialValue);
+
+    VkTimelineSemaphoreSubmitInfoKHR
+    timelineSemaphoreSubmitInfo(uint32_t waitValueCount, const uint64_t *waitValues, uint32_t signalValueCount,
+                                const uint64_t *signalValues);
+
+    VkSemaphoreWaitInfoKHR semaphoreWaitInfo(const VkSemaphore *semaphore, const uint64_t *value);
+
     VkImageCreateInfo imageCreateInfo(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent);
 
     VkImageViewCreateInfo imageviewCreateInfo(VkFormat format, VkImage image, VkImageAspectFlags aspectFlags);
@@ -0,0 +1,228 @@
+#include "vk_lighting.h"
+#include "vk_initializers.h"
+#include <cmath>
+#include <iostream>
+
+static VkDescriptorSetLayout createSetLayout(VkDevice device, const VkDescriptorSetLayoutBinding *bindings,
+                                             uint32_t bindingCount) {
+    VkDescriptorSetLayoutCreateInfo setInfo = {};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setInfo.pNext = nullptr;
+    setInfo.flags = 0;
+    setInfo.bindingCount = bindingCount;
+    setInfo.pBindings = bindings;
+
+    VkDescriptorSetLayout layout;
+    vkCreateDescriptorSetLayout(device, &setInfo, nullptr, &layout);
+    return layout;
+}
+
+void ClusteredLighting::init(VkDevice device, VmaAllocator allocator, GpuMemory &memory, uint32_t framesInFlight,
+                             uint32_t maxLights, VkShaderModule clusterShader, VkBuffer uniformBuffer) {
+    _device = device;
+    _allocator = allocator;
+    _memory = &memory;
+    _framesInFlight = framesInFlight;
+    _maxLights = maxLights;
+    _indexCapacity = CLUSTER_COUNT * AVERAGE_CLUSTER_LIGHTS;
+
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        FrameResources &frame = _frames[i];
+        //a buffer can't be empty, keep room for one light even when the scene has none
+        frame.lights = createMappedBuffer(sizeof(GPUPointLight) * (_maxLights > 0 ? _maxLights : 1),
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                          (void **) &frame.mappedLights);
+        frame.counters = createMappedBuffer(sizeof(LightingStats),
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                            VMA_MEMORY_USAGE_GPU_TO_CPU, (void **) &frame.mappedCounters);
+        frame.frameNumber = -1;
+    }
+    _grid = createMappedBuffer(sizeof(uint32_t) * 2 * CLUSTER_COUNT,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VMA_MEMORY_USAGE_GPU_ONLY, nullptr);
+    _indices = createMappedBuffer(sizeof(uint32_t) * _indexCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                  VMA_MEMORY_USAGE_GPU_ONLY, nullptr);
+
+    createDescriptors(uniformBuffer);
+
+    //without the shader the buffers still exist for the lit materials to read, the grid just stays empty
+    if (clusterShader == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipelineLayoutCreateInfo();
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &_clusterSetLayout;
+    vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_clusterLayout);
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = nullptr;
+    pipelineInfo.stage = vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, clusterShader);
+    pipelineInfo.layout = _clusterLayout;
+    if (vkCreateComputePipelines(_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_clusterPipeline) !=
+        VK_SUCCESS) {
+        std::cout << "Failed to create the light clustering pipeline" << std::endl;
+        abort();
+    }
+
+    std::cout << "Clustered lighting with " << CLUSTERS_X << "x" << CLUSTERS_Y << "x" << CLUSTERS_Z
+              << " clusters for up to " << _maxLights << " lights" << std::endl;
+}
+
+void ClusteredLighting::createDescriptors(VkBuffer uniformBuffer) {
+    VkDescriptorSetLayoutBinding bindings[] = {
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                                               VK_SHADER_STAGE_COMPUTE_BIT, 0),
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4)
+    };
+    _clusterSetLayout = createSetLayout(_device, bindings, 5);
+
+    std::vector<VkDescriptorPoolSize> sizes =
+            {
+                    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, _framesInFlight},
+                    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * _framesInFlight}
+            };
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = 0;
+    poolInfo.maxSets = _framesInFlight;
+    poolInfo.poolSizeCount = (uint32_t) sizes.size();
+    poolInfo.pPoolSizes = sizes.data();
+    vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool);
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &_clusterSetLayout;
+
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        FrameResources &frame = _frames[i];
+        vkAllocateDescriptorSets(_device, &allocInfo, &frame.clusterSet);
+
+        VkDescriptorBufferInfo clusterDataInfo = {uniformBuffer, 0, sizeof(GPUClusterData)};
+        VkDescriptorBufferInfo lightsInfo = {frame.lights._buffer, 0, VK_WHOLE_SIZE};
+        VkDescriptorBufferInfo gridInfo = {_grid._buffer, 0, VK_WHOLE_SIZE};
+        VkDescriptorBufferInfo indicesInfo = {_indices._buffer, 0, VK_WHOLE_SIZE};
+        VkDescriptorBufferInfo countersInfo = {frame.counters._buffer, 0, VK_WHOLE_SIZE};
+
+        VkWriteDescriptorSet writes[] = {
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frame.clusterSet,
+                                              &clusterDataInfo, 0),
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.clusterSet, &lightsInfo, 1),
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.clusterSet, &gridInfo, 2),
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.clusterSet, &indicesInfo, 3),
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.clusterSet, &countersInfo, 4)
+        };
+        vkUpdateDescriptorSets(_device, 5, writes, 0, nullptr);
+    }
+}
+
+AllocatedBuffer ClusteredLighting::createMappedBuffer(size_t size, VkBufferUsageFlags usage,
+                                                      VmaMemoryUsage memoryUsage, void **outMapped) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = nullptr;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = memoryUsage;
+    allocInfo.flags = outMapped ? VMA_ALLOCATION_CREATE_MAPPED_BIT : 0;
+
+    AllocatedBuffer buffer;
+    VmaAllocationInfo allocationInfo;
+    if (vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation,
+                        &allocationInfo) != VK_SUCCESS) {
+        std::cout << "Failed to create a lighting buffer of " << size << " bytes" << std::endl;
+        abort();
+    }
+    _memory->track(buffer._allocation, MEMORY_LIGHTING);
+    if (outMapped) {
+        *outMapped = allocationInfo.pMappedData;
+    }
+    return buffer;
+}
+
+void ClusteredLighting::recordInitialization(VkCommandBuffer cmd) {
+    //zero counts everywhere, so the first frames shade without lights if the build is skipped
+    vkCmdFillBuffer(cmd, _grid._buffer, 0, VK_WHOLE_SIZE, 0);
+}
+
+void ClusteredLighting::cleanup() {
+    vkDestroyPipeline(_device, _clusterPipeline, nullptr);
+    vkDestroyPipelineLayout(_device, _clusterLayout, nullptr);
+    vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _clusterSetLayout, nullptr);
+
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        _memory->destroyBuffer(_frames[i].lights);
+        _memory->destroyBuffer(_frames[i].counters);
+    }
+    _memory->destroyBuffer(_grid);
+    _memory->destroyBuffer(_indices);
+}
+
+void ClusteredLighting::beginFrame(VkCommandBuffer cmd, uint32_t frameIndex, int64_t frameNumber) {
+    _currentFrame = frameIndex;
+    FrameResources &frame = _frames[frameIndex];
+    if (frame.frameNumber >= 0) {
+        vmaInvalidateAllocation(_allocator, frame.counters._allocation, 0, VK_WHOLE_SIZE);
+        _lastStats = *frame.mappedCounters;
+        _lastStatsFrame = frame.frameNumber;
+    }
+    frame.frameNumber = frameNumber;
+    vkCmdFillBuffer(cmd, frame.counters._buffer, 0, sizeof(LightingStats), 0);
+}
+
+GPUClusterData ClusteredLighting::makeClusterData(const glm::mat4 &view, const glm::mat4 &projection, float znear,
+                                                  float zfar, VkExtent2D extent, uint32_t lightCount) const {
+    GPUClusterData data = {};
+    data.view = view;
+    data.projection = glm::vec4(projection[0][0], projection[1][1], znear, zfar);
+
+    //slice k starts at znear * (zfar / znear)^(k / CLUSTERS_Z), so slices get deeper with distance like the
+    //screen footprint of a tile does
+    float logRange = logf(zfar / znear);
+    data.slicing.x = CLUSTERS_Z / logRange;
+    data.slicing.y = CLUSTERS_Z * logf(znear) / logRange;
+    data.slicing.z = (float) extent.width / CLUSTERS_X;
+    data.slicing.w = (float) extent.height / CLUSTERS_Y;
+
+    data.grid = glm::uvec4(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z, lightCount < _maxLights ? lightCount : _maxLights);
+    data.limits = glm::uvec4(_indexCapacity, MAX_CLUSTER_LIGHTS, 0, 0);
+    return data;
+}
+
+void ClusteredLighting::buildClusters(VkCommandBuffer cmd, uint32_t clusterDataOffset) {
+    FrameResources &frame = _frames[_currentFrame];
+    vmaFlushAllocation(_allocator, frame.lights._allocation, 0, VK_WHOLE_SIZE);
+
+    //covers the counter reset, and the previous frame's fragment shaders still reading the grid and index list
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _clusterPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _clusterLayout, 0, 1, &frame.clusterSet, 1,
+                            &clusterDataOffset);
+    //a work group per cluster, its threads split the lights between them
+    vkCmdDispatch(cmd, CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z);
+
+    //the fragment shaders read the lists, the CPU reads the counters once the slot comes around again
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+}
@@ -0,0 +1,124 @@
+#ifndef VULKAN_STEP_BY_STEP_VK_LIGHTING_H
+#define VULKAN_STEP_BY_STEP_VK_LIGHTING_H
+
+#include <vulkan/vulkan.h>
+#include "vk_types.h"
+#include "engine_config.h"
+#include "vk_memory.h"
+
+//matches PointLight in light_cluster.comp and clustered_lights.glsl
+struct GPUPointLight {
+    //world space position in xyz, the distance the light reaches in w
+    glm::vec4 positionRadius;
+    //rgb color times intensity
+    glm::vec4 color;
+};
+
+//matches ClusterData in light_cluster.comp and clustered_lights.glsl
+struct GPUClusterData {
+    glm::mat4 view;
+    //P00 and P11 of the projection, near and far plane
+    glm::vec4 projection;
+    //log(view depth) * x - y is the depth slice, zw is the size of a screen tile in pixels
+    glm::vec4 slicing;
+    //clusters along x, y and depth, and the light count
+    glm::uvec4 grid;
+    //capacity of the light index list, lights one cluster can hold
+    glm::uvec4 limits;
+};
+
+//read back from the counter buffer, laid out like Counters in light_cluster.comp
+struct LightingStats {
+    uint32_t lightReferences = 0;
+    //clusters that had more lights than they can hold, or found the index list full
+    uint32_t overflowedClusters = 0;
+};
+
+//clustered forward lighting. the view frustum is cut into a grid of screen tiles and exponential depth slices, a
+//compute pass bins the lights into them and writes one compact index list per cluster. fragment shaders find their
+//cluster from the pixel and view depth and only loop over its lights
+class ClusteredLighting {
+public:
+    static const uint32_t CLUSTERS_X = 16;
+    static const uint32_t CLUSTERS_Y = 9;
+    static const uint32_t CLUSTERS_Z = 24;
+    static const uint32_t CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+    //matches MAX_CLUSTER_LIGHTS in light_cluster.comp
+    static const uint32_t MAX_CLUSTER_LIGHTS = 256;
+    //average lights per cluster the index list has room for
+    static const uint32_t AVERAGE_CLUSTER_LIGHTS = 64;
+
+    //clusterShader may be VK_NULL_HANDLE, then only the buffers are created and buildClusters must not be called
+    void init(VkDevice device, VmaAllocator allocator, GpuMemory &memory, uint32_t framesInFlight, uint32_t maxLights,
+              VkShaderModule clusterShader, VkBuffer uniformBuffer);
+
+    //clears the cluster grid so nothing is lit before the first build, record once before the first frame
+    void recordInitialization(VkCommandBuffer cmd);
+
+    void cleanup();
+
+    //collects the statistics this slot gathered last time and resets them, must be recorded outside a render pass
+    void beginFrame(VkCommandBuffer cmd, uint32_t frameIndex, int64_t frameNumber);
+
+    //this frame's light buffer, write up to maxLights() lights before buildClusters
+    GPUPointLight *lights() { return _frames[_currentFrame].mappedLights; }
+
+    uint32_t maxLights() const { return _maxLights; }
+
+    GPUClusterData makeClusterData(const glm::mat4 &view, const glm::mat4 &projection, float znear, float zfar,
+                                   VkExtent2D extent, uint32_t lightCount) const;
+
+    //clusterDataOffset is the dynamic offset of a GPUClusterData in the uniform buffer passed to init. the grid
+    //and index list are ready for fragment shaders afterwards
+    void buildClusters(VkCommandBuffer cmd, uint32_t clusterDataOffset);
+
+    //bound by the lit materials next to the cluster data
+    VkBuffer lightBuffer(uint32_t frameIndex) const { return _frames[frameIndex].lights._buffer; }
+
+    VkBuffer gridBuffer() const { return _grid._buffer; }
+
+    VkBuffer indexBuffer() const { return _indices._buffer; }
+
+    const LightingStats &lastStats() const { return _lastStats; }
+
+    int64_t lastStatsFrame() const { return _lastStatsFrame; }
+
+private:
+    struct FrameResources {
+        AllocatedBuffer lights;
+        GPUPointLight *mappedLights = nullptr;
+        AllocatedBuffer counters;
+        LightingStats *mappedCounters = nullptr;
+        VkDescriptorSet clusterSet = VK_NULL_HANDLE;
+        int64_t frameNumber = -1;
+    };
+
+    AllocatedBuffer createMappedBuffer(size_t size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+                                       void **outMapped);
+
+    void createDescriptors(VkBuffer uniformBuffer);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    GpuMemory *_memory = nullptr;
+    uint32_t _framesInFlight = 0;
+    uint32_t _currentFrame = 0;
+    uint32_t _maxLights = 0;
+
+    //offset and count into the index list per cluster, rebuilt every frame
+    AllocatedBuffer _grid = {};
+    AllocatedBuffer _indices = {};
+    uint32_t _indexCapacity = 0;
+
+    FrameResources _frames[MAX_FRAMES_IN_FLIGHT];
+
+    VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _clusterSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout _clusterLayout = VK_NULL_HANDLE;
+    VkPipeline _clusterPipeline = VK_NULL_HANDLE;
+
+    LightingStats _lastStats;
+    int64_t _lastStatsFrame = -1;
+};
+
+#endif //VULKAN_STEP_BY_STEP_VK_LIGHTING_H
@@ -0,0 +1,304 @@
+#include "vk_memory.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const char *CATEGORY_NAMES[MEMORY_CATEGORY_COUNT] = {"mesh", "texture", "staging", "frame_data",
+                                                               "render_target", "shadow", "culling", "lighting",
+                                                               "other"};
+
+const char *memoryCategoryName(MemoryCategory category) {
+    return CATEGORY_NAMES[category];
+}
+
+void GpuMemory::init(VkDevice device, VmaAllocator allocator, bool budgetEnabled, VkDeviceSize bytesPerPass) {
+    _device = device;
+    _allocator = allocator;
+    _budgetEnabled = budgetEnabled;
+    _bytesPerPass = bytesPerPass;
+}
+
+void GpuMemory::cleanup() {
+    if (_passOpen) {
+        endPass();
+    }
+    if (_context != VK_NULL_HANDLE) {
+        vmaEndDefragmentation(_allocator, _context, nullptr);
+        _context = VK_NULL_HANDLE;
+    }
+
+    for (auto &entry : _entries) {
+        if (entry.second.movable) {
+            vmaDestroyBuffer(_allocator, entry.second.buffer, entry.first);
+        }
+    }
+    _entries.clear();
+}
+
+GpuMemory::Entry &GpuMemory::addEntry(VmaAllocation allocation, MemoryCategory category) {
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(_allocator, allocation, &info);
+
+    Entry &entry = _entries[allocation];
+    entry = {};
+    entry.category = category;
+    entry.size = info.size;
+    //the defragmentation passes find the entry through the allocation, the stats string shows the name
+    vmaSetAllocationUserData(_allocator, allocation, &entry);
+    vmaSetAllocationName(_allocator, allocation, CATEGORY_NAMES[category]);
+    return entry;
+}
+
+void GpuMemory::track(VmaAllocation allocation, MemoryCategory category) {
+    addEntry(allocation, category);
+}
+
+void GpuMemory::untrack(VmaAllocation allocation) {
+    if (_entries.erase(allocation) > 0) {
+        vmaSetAllocationUserData(_allocator, allocation, nullptr);
+    }
+}
+
+AllocatedBuffer GpuMemory::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+                                        MemoryCategory category) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = nullptr;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = memoryUsage;
+
+    AllocatedBuffer buffer;
+    if (vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation, nullptr) !=
+        VK_SUCCESS) {
+        std::cout << "Failed to allocate a " << size << " byte " << CATEGORY_NAMES[category] << " buffer" << std::endl;
+        abort();
+    }
+    addEntry(buffer._allocation, category);
+    return buffer;
+}
+
+AllocatedBuffer GpuMemory::createMovableBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                               MemoryCategory category) {
+    //a move copies the old buffer into the new one
+    usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    AllocatedBuffer buffer = createBuffer(size, usage, VMA_MEMORY_USAGE_GPU_ONLY, category);
+
+    Entry &entry = _entries[buffer._allocation];
+    entry.movable = true;
+    entry.buffer = buffer._buffer;
+    entry.bufferSize = size;
+    entry.usage = usage;
+    return buffer;
+}
+
+void GpuMemory::destroyBuffer(const AllocatedBuffer &buffer) {
+    untrack(buffer._allocation);
+    vmaDestroyBuffer(_allocator, buffer._buffer, buffer._allocation);
+}
+
+void GpuMemory::destroyImage(const AllocatedImage &image) {
+    untrack(image._allocation);
+    vmaDestroyImage(_allocator, image._image, image._allocation);
+}
+
+void GpuMemory::defragment(VkCommandBuffer cmd, uint32_t frameIndex, int64_t frameNumber,
+                           std::vector<BufferMove> &moves) {
+    moves.clear();
+    if (_passOpen) {
+        //the copies finished once the slot that recorded them is free again
+        if (frameIndex != _passFrameIndex) {
+            return;
+        }
+        endPass();
+        if (_context == VK_NULL_HANDLE) {
+            return;
+        }
+    }
+
+    if (_context == VK_NULL_HANDLE) {
+        if (_bytesPerPass == 0 || frameNumber - _lastCheckFrame < CHECK_INTERVAL) {
+            return;
+        }
+        _lastCheckFrame = frameNumber;
+        if (fragmentation() < FRAGMENTATION_THRESHOLD) {
+            return;
+        }
+
+        VmaDefragmentationInfo info = {};
+        info.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+        info.pool = VK_NULL_HANDLE;
+        info.maxBytesPerPass = _bytesPerPass;
+        info.maxAllocationsPerPass = 0;
+        if (vmaBeginDefragmentation(_allocator, &info, &_context) != VK_SUCCESS) {
+            _context = VK_NULL_HANDLE;
+            return;
+        }
+    }
+
+    if (beginPass(cmd, moves)) {
+        _passOpen = true;
+        _passFrameIndex = frameIndex;
+    }
+}
+
+bool GpuMemory::beginPass(VkCommandBuffer cmd, std::vector<BufferMove> &moves) {
+    VkResult result = vmaBeginDefragmentationPass(_allocator, _context, &_pass);
+    if (result != VK_INCOMPLETE) {
+        vmaEndDefragmentation(_allocator, _context, nullptr);
+        _context = VK_NULL_HANDLE;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < _pass.moveCount; i++) {
+        VmaDefragmentationMove &move = _pass.pMoves[i];
+        VmaAllocationInfo info;
+        vmaGetAllocationInfo(_allocator, move.srcAllocation, &info);
+        Entry *entry = (Entry *) info.pUserData;
+        if (entry == nullptr || !entry->movable) {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.pNext = nullptr;
+        bufferInfo.size = entry->bufferSize;
+        bufferInfo.usage = entry->usage;
+
+        VkBuffer newBuffer;
+        if (vkCreateBuffer(_device, &bufferInfo, nullptr, &newBuffer) != VK_SUCCESS) {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+        if (vmaBindBufferMemory(_allocator, move.dstTmpAllocation, newBuffer) != VK_SUCCESS) {
+            vkDestroyBuffer(_device, newBuffer, nullptr);
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        VkBufferCopy copy;
+        copy.srcOffset = 0;
+        copy.dstOffset = 0;
+        copy.size = entry->bufferSize;
+        vkCmdCopyBuffer(cmd, entry->buffer, newBuffer, 1, &copy);
+
+        moves.push_back({entry->buffer, newBuffer});
+        _retiredBuffers.push_back(entry->buffer);
+        entry->buffer = newBuffer;
+        _bytesMoved += entry->size;
+        _allocationsMoved++;
+    }
+
+    if (!_retiredBuffers.empty()) {
+        //the frame draws from the new buffers right after the copies
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                             nullptr, 0, nullptr);
+    }
+    return true;
+}
+
+void GpuMemory::endPass() {
+    for (VkBuffer buffer : _retiredBuffers) {
+        //the old memory belongs to the allocation until vmaEndDefragmentationPass frees it
+        vkDestroyBuffer(_device, buffer, nullptr);
+    }
+    _retiredBuffers.clear();
+    _passOpen = false;
+    _passes++;
+
+    if (vmaEndDefragmentationPass(_allocator, _context, &_pass) == VK_SUCCESS) {
+        vmaEndDefragmentation(_allocator, _context, nullptr);
+        _context = VK_NULL_HANDLE;
+    }
+}
+
+MemoryUsage GpuMemory::categoryUsage(MemoryCategory category) const {
+    MemoryUsage usage;
+    for (const auto &entry : _entries) {
+        if (entry.second.category == category) {
+            usage.bytes += entry.second.size;
+            usage.allocations++;
+        }
+    }
+    return usage;
+}
+
+std::vector<HeapUsage> GpuMemory::heapUsage() const {
+    const VkPhysicalDeviceMemoryProperties *properties;
+    vmaGetMemoryProperties(_allocator, &properties);
+
+    std::vector<VmaBudget> budgets(properties->memoryHeapCount);
+    vmaGetHeapBudgets(_allocator, budgets.data());
+
+    std::vector<HeapUsage> heaps(properties->memoryHeapCount);
+    for (uint32_t i = 0; i < properties->memoryHeapCount; i++) {
+        heaps[i].deviceLocal = (properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heaps[i].budget = budgets[i].budget;
+        heaps[i].usage = budgets[i].usage;
+        heaps[i].blockBytes = budgets[i].statistics.blockBytes;
+        heaps[i].allocationBytes = budgets[i].statistics.allocationBytes;
+    }
+    return heaps;
+}
+
+float GpuMemory::fragmentation() const {
+    VmaTotalStatistics stats;
+    vmaCalculateStatistics(_allocator, &stats);
+    if (stats.total.statistics.blockBytes == 0) {
+        return 0.0f;
+    }
+    VkDeviceSize unused = stats.total.statistics.blockBytes - stats.total.statistics.allocationBytes;
+    return (float) ((double) unused / (double) stats.total.statistics.blockBytes);
+}
+
+std::string GpuMemory::statsJson() const {
+    std::ostringstream json;
+    json << "{\n  \"memory_budget_extension\": " << (_budgetEnabled ? "true" : "false") << ",\n";
+
+    json << "  \"categories\": {\n";
+    for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+        MemoryUsage usage = categoryUsage((MemoryCategory) i);
+        json << "    \"" << CATEGORY_NAMES[i] << "\": {\"bytes\": " << usage.bytes << ", \"allocations\": "
+             << usage.allocations << "}" << (i + 1 < MEMORY_CATEGORY_COUNT ? "," : "") << "\n";
+    }
+    json << "  },\n";
+
+    std::vector<HeapUsage> heaps = heapUsage();
+    json << "  \"heaps\": [\n";
+    for (size_t i = 0; i < heaps.size(); i++) {
+        json << "    {\"device_local\": " << (heaps[i].deviceLocal ? "true" : "false") << ", \"budget\": "
+             << heaps[i].budget << ", \"usage\": " << heaps[i].usage << ", \"block_bytes\": " << heaps[i].blockBytes
+             << ", \"allocation_bytes\": " << heaps[i].allocationBytes << "}" << (i + 1 < heaps.size() ? "," : "")
+             << "\n";
+    }
+    json << "  ],\n";
+
+    json << "  \"defragmentation\": {\"fragmentation\": " << fragmentation() << ", \"running\": "
+         << (defragmenting() ? "true" : "false") << ", \"passes\": " << _passes << ", \"bytes_moved\": "
+         << _bytesMoved << ", \"allocations_moved\": " << _allocationsMoved << "},\n";
+
+    char *vmaStats;
+    vmaBuildStatsString(_allocator, &vmaStats, VK_TRUE);
+    json << "  \"allocator\": " << vmaStats << "\n}\n";
+    vmaFreeStatsString(_allocator, vmaStats);
+    return json.str();
+}
+
+bool GpuMemory::writeStats(const std::string &path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Failed to write memory stats " << path << std::endl;
+        return false;
+    }
+    file << statsJson();
+    return true;
+}
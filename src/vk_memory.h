@@ -0,0 +1,146 @@
+#ifndef VULKAN_STEP_BY_STEP_VK_MEMORY_H
+#define VULKAN_STEP_BY_STEP_VK_MEMORY_H
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vk_types.h"
+
+enum MemoryCategory {
+    //vertex data of the loaded meshes
+    MEMORY_MESH,
+    MEMORY_TEXTURE,
+    //CPU side copies that only live until their upload is done
+    MEMORY_STAGING,
+    //buffers the CPU rewrites every frame
+    MEMORY_FRAME_DATA,
+    //depth, scene colour and the headless targets, all sized by the window
+    MEMORY_RENDER_TARGET,
+    MEMORY_SHADOW,
+    //depth pyramid, per-object bounds, indirect commands and visibility of the occlusion culler
+    MEMORY_CULLING,
+    //light lists and the cluster grid
+    MEMORY_LIGHTING,
+    MEMORY_OTHER,
+    MEMORY_CATEGORY_COUNT
+};
+
+const char *memoryCategoryName(MemoryCategory category);
+
+struct MemoryUsage {
+    VkDeviceSize bytes = 0;
+    uint32_t allocations = 0;
+};
+
+struct HeapUsage {
+    bool deviceLocal;
+    //what the driver lets the process use and what it uses, estimated from the allocator's own blocks without
+    //VK_EXT_memory_budget
+    VkDeviceSize budget;
+    VkDeviceSize usage;
+    //device memory blocks the allocator holds and the part of them handed out to allocations
+    VkDeviceSize blockBytes;
+    VkDeviceSize allocationBytes;
+};
+
+//a buffer the defragmentation recreated somewhere else, whatever holds from has to use to from now on
+struct BufferMove {
+    VkBuffer from;
+    VkBuffer to;
+};
+
+//categorised view of the VMA allocations and incremental defragmentation of the movable ones. allocations are
+//tagged through their user data, so the stats and the defragmentation passes can tell what they belong to.
+//only buffers registered with createMovableBuffer are moved, everything else is skipped by the passes
+class GpuMemory {
+public:
+    //frames between two fragmentation checks
+    static constexpr uint32_t CHECK_INTERVAL = 240;
+    //share of the allocated block bytes that has to be unused before a defragmentation starts
+    static constexpr float FRAGMENTATION_THRESHOLD = 0.25f;
+
+    //budgetEnabled is whether the allocator was created with VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT. a
+    //bytesPerPass of 0 never defragments
+    void init(VkDevice device, VmaAllocator allocator, bool budgetEnabled, VkDeviceSize bytesPerPass);
+
+    //finishes a running defragmentation and destroys the movable buffers, the device has to be idle
+    void cleanup();
+
+    //tags an allocation made elsewhere, it has to be released with destroyBuffer, destroyImage or untrack
+    void track(VmaAllocation allocation, MemoryCategory category);
+
+    void untrack(VmaAllocation allocation);
+
+    AllocatedBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+                                 MemoryCategory category);
+
+    //a GPU only buffer the defragmentation may move. it stays owned by this class, which destroys it in cleanup
+    AllocatedBuffer createMovableBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryCategory category);
+
+    void destroyBuffer(const AllocatedBuffer &buffer);
+
+    void destroyImage(const AllocatedImage &image);
+
+    //call after waiting for the frame slot's timeline value and outside a render pass. finishes the pass recorded
+    //the last time the slot was used, records the copies of the next one and returns the buffers it moved
+    void defragment(VkCommandBuffer cmd, uint32_t frameIndex, int64_t frameNumber, std::vector<BufferMove> &moves);
+
+    MemoryUsage categoryUsage(MemoryCategory category) const;
+
+    std::vector<HeapUsage> heapUsage() const;
+
+    //unused share of the device memory blocks the allocator holds
+    float fragmentation() const;
+
+    bool defragmenting() const { return _context != VK_NULL_HANDLE; }
+
+    VkDeviceSize bytesMoved() const { return _bytesMoved; }
+
+    uint32_t allocationsMoved() const { return _allocationsMoved; }
+
+    //categories, heaps, defragmentation totals and the allocator's detailed stats string
+    std::string statsJson() const;
+
+    bool writeStats(const std::string &path) const;
+
+private:
+    struct Entry {
+        MemoryCategory category;
+        VkDeviceSize size;
+        //movable buffers only, the create info they are recreated with after a move
+        bool movable;
+        VkBuffer buffer;
+        VkDeviceSize bufferSize;
+        VkBufferUsageFlags usage;
+    };
+
+    Entry &addEntry(VmaAllocation allocation, MemoryCategory category);
+
+    //records the copies of a new pass, false when the defragmentation has nothing left to move
+    bool beginPass(VkCommandBuffer cmd, std::vector<BufferMove> &moves);
+
+    //the copies of the pass are done, the old buffers go and the allocations switch to their new place
+    void endPass();
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    bool _budgetEnabled = false;
+    VkDeviceSize _bytesPerPass = 0;
+
+    std::unordered_map<VmaAllocation, Entry> _entries;
+
+    VmaDefragmentationContext _context = VK_NULL_HANDLE;
+    VmaDefragmentationPassMoveInfo _pass = {};
+    bool _passOpen = false;
+    uint32_t _passFrameIndex = 0;
+    //buffers the open pass moved away from, destroyed when it ends
+    std::vector<VkBuffer> _retiredBuffers;
+    int64_t _lastCheckFrame = 0;
+
+    VkDeviceSize _bytesMoved = 0;
+    uint32_t _allocationsMoved = 0;
+    uint32_t _passes = 0;
+};
+
+#endif //VULKAN_STEP_BY_STEP_VK_MEMORY_H
@@ -1,4 +1,10 @@
 #include "vk_mesh.h"
+#include <algorithm>
+#include <cstdio>
+#ifndef _WIN32
+#include <dirent.h>
+#include <strings.h>
+#endif
 
 VertexInputDescription Vertex::getVertexDescription() {
     VertexInputDescription description;
@@ -45,6 +51,51 @@ VertexInputDescription Vertex::getVertexDescription() {
     return description;
 }
 
+VertexInputDescription Vertex::getPositionOnlyDescription() {
+    VertexInputDescription description;
+
+    VkVertexInputBindingDescription positionBinding = {};
+    positionBinding.binding = 0;
+    positionBinding.stride = sizeof(glm::vec3);
+    positionBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    description.bindings.push_back(positionBinding);
+
+    VkVertexInputAttributeDescription positionAttribute = {};
+    positionAttribute.binding = 0;
+    positionAttribute.location = 0;
+    positionAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+    positionAttribute.offset = 0;
+    description.attributes.push_back(positionAttribute);
+    return description;
+}
+
+//the texture names in sponza.mtl are upper case, the files are not. file systems on windows ignore the case anyway,
+//elsewhere the directory is searched for a name that only differs in case. empty when there is no such file
+static std::string findTextureFile(const std::string &directory, std::string name) {
+    std::replace(name.begin(), name.end(), '\\', '/');
+    std::string path = directory + name;
+    if (FILE *file = fopen(path.c_str(), "rb")) {
+        fclose(file);
+        return path;
+    }
+#ifndef _WIN32
+    size_t slash = path.find_last_of('/');
+    std::string folder = slash == std::string::npos ? "." : path.substr(0, slash);
+    std::string fileName = slash == std::string::npos ? path : path.substr(slash + 1);
+    if (DIR *dir = opendir(folder.c_str())) {
+        while (dirent *entry = readdir(dir)) {
+            if (strcasecmp(entry->d_name, fileName.c_str()) == 0) {
+                path = folder + "/" + entry->d_name;
+                closedir(dir);
+                return path;
+            }
+        }
+        closedir(dir);
+    }
+#endif
+    return "";
+}
+
 bool Mesh::loadFromObj(const char *filename) {
     tinyobj::ObjReaderConfig reader_config;
     tinyobj::ObjReader reader;
@@ -64,11 +115,36 @@ bool Mesh::loadFromObj(const char *filename) {
     auto &shapes = reader.GetShapes();
     auto &materials = reader.GetMaterials();
 
+    //texture names in the MTL file are relative to the OBJ
+    std::string directory = filename;
+    size_t slash = directory.find_last_of("/\\");
+    directory = slash == std::string::npos ? "" : directory.substr(0, slash + 1);
+
+    _materials.resize(materials.size());
+    for (size_t m = 0; m < materials.size(); m++) {
+        MeshMaterial &material = _materials[m];
+        material.name = materials[m].name;
+        material.diffuseColor = glm::vec3(materials[m].diffuse[0], materials[m].diffuse[1], materials[m].diffuse[2]);
+        if (!materials[m].diffuse_texname.empty()) {
+            material.diffuseTexture = findTextureFile(directory, materials[m].diffuse_texname);
+            if (material.diffuseTexture.empty()) {
+                std::cout << "Texture " << materials[m].diffuse_texname << " of material " << material.name
+                          << " not found" << std::endl;
+            }
+        }
+    }
+
+    //one bucket per material and a last one for the faces without, so a single pass sorts the faces
+    std::vector<std::vector<Vertex>> buckets(materials.size() + 1);
     for (size_t s = 0; s < shapes.size(); s++) {
         size_t index_offset = 0;
         for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
             int fv = 3;
 
+            int materialId = f < shapes[s].mesh.material_ids.size() ? shapes[s].mesh.material_ids[f] : -1;
+            bool hasMaterial = materialId >= 0 && (size_t) materialId < materials.size();
+            std::vector<Vertex> &bucket = buckets[hasMaterial ? (size_t) materialId : materials.size()];
+
             for (size_t v = 0; v < fv; v++) {
                 tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
                 tinyobj::real_t vx = attrib.vertices[3 * size_t(idx.vertex_index) + 0];
@@ -99,11 +175,76 @@ bool Mesh::loadFromObj(const char *filename) {
                     new_vert.uv.y = 1-uy;
                 }
 
-                new_vert.color = new_vert.normal;
-                _vertices.push_back(new_vert);
+                //untextured materials shade with their diffuse colour
+                bool colored = hasMaterial && _materials[materialId].diffuseTexture.empty();
+                new_vert.color = colored ? _materials[materialId].diffuseColor : new_vert.normal;
+                bucket.push_back(new_vert);
             }
             index_offset += fv;
         }
     }
+
+    //textured materials first, those sharing a texture next to each other, so they can be drawn as one range
+    std::vector<uint32_t> order(materials.size());
+    for (uint32_t m = 0; m < order.size(); m++) {
+        order[m] = m;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        const std::string &textureA = _materials[a].diffuseTexture;
+        const std::string &textureB = _materials[b].diffuseTexture;
+        if (textureA.empty() != textureB.empty()) {
+            return textureB.empty();
+        }
+        return textureA < textureB;
+    });
+    order.push_back(~0u);
+
+    size_t vertexCount = 0;
+    for (const std::vector<Vertex> &bucket : buckets) {
+        vertexCount += bucket.size();
+    }
+    _vertices.reserve(_vertices.size() + vertexCount);
+    for (uint32_t material : order) {
+        std::vector<Vertex> &bucket = buckets[material == ~0u ? materials.size() : material];
+        if (bucket.empty()) {
+            continue;
+        }
+        SubMesh submesh = {(uint32_t) _vertices.size(), (uint32_t) bucket.size(), material};
+        _submeshes.push_back(submesh);
+        _vertices.insert(_vertices.end(), bucket.begin(), bucket.end());
+        std::vector<Vertex>().swap(bucket);
+    }
     return true;
 }
+
+void Mesh::computeBounds() {
+    if (_vertices.empty()) {
+        return;
+    }
+    glm::vec3 minimum = _vertices[0].position;
+    glm::vec3 maximum = _vertices[0].position;
+    for (const Vertex &vertex : _vertices) {
+        minimum = glm::min(minimum, vertex.position);
+        maximum = glm::max(maximum, vertex.position);
+    }
+    _boundsCenter = (minimum + maximum) * 0.5f;
+
+    float radiusSquared = 0.0f;
+    for (const Vertex &vertex : _vertices) {
+        glm::vec3 offset = vertex.position - _boundsCenter;
+        radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+    }
+    _boundsRadius = glm::sqrt(radiusSquared);
+}
+
+uint32_t Mesh::lodCount() const {
+    return _lods.empty() ? 1 : (uint32_t) _lods.size();
+}
+
+MeshLod Mesh::getLod(uint32_t level) const {
+    if (_lods.empty()) {
+        MeshLod full = {0, (uint32_t) _vertices.size(), 0.0f};
+        return full;
+    }
+    return _lods[level < _lods.size() ? level : _lods.size() - 1];
+}
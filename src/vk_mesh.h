@@ -4,6 +4,7 @@
 #include "vk_types.h"
 #include "vec3.hpp"
 #include <vector>
+#include <string>
 #include "tiny_obj_loader.h"
 #include <iostream>
 
@@ -20,11 +21,60 @@ struct Vertex {
     glm::vec2 uv;
 
     static VertexInputDescription getVertexDescription();
+
+    //a packed vec3 stream at location 0, for passes that only need depth
+    static VertexInputDescription getPositionOnlyDescription();
+};
+
+//a detail level, drawn as vertexCount vertices starting at firstVertex of the mesh's vertex buffer
+struct MeshLod {
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    //how far the level may deviate from full detail, in mesh units
+    float error;
+};
+
+//a material of the OBJ's MTL file, the parts of it the lit shaders use
+struct MeshMaterial {
+    std::string name;
+    //path of the diffuse texture as the engine opens it, empty when the material has none or the file is missing
+    std::string diffuseTexture;
+    glm::vec3 diffuseColor;
+};
+
+//vertexCount vertices starting at firstVertex of _vertices that share one material
+struct SubMesh {
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    //index into _materials, ~0u for faces without a material
+    uint32_t material;
 };
 
 struct Mesh {
     std::vector<Vertex> _vertices;
+    //finest first, all levels share _vertices. empty draws every vertex
+    std::vector<MeshLod> _lods;
+    glm::vec3 _boundsCenter{0.0f};
+    float _boundsRadius = 0.0f;
     AllocatedBuffer _vertexBuffer;
+    //the positions of _vertices on their own, read by the depth pre-pass
+    AllocatedBuffer _positionBuffer;
+    //the buffers are null while the residency manager has the mesh evicted
+    uint32_t _residencyId = INVALID_RESIDENCY_ID;
+    //the materials of the OBJ and the ranges of _vertices using them, one per material in use. filled by
+    //loadFromObj, empty for meshes built in code
+    std::vector<SubMesh> _submeshes;
+    std::vector<MeshMaterial> _materials;
+
+    //reads all shapes in one pass and groups the faces by material, materials sharing a diffuse texture are
+    //adjacent and the faces without a material come last
     bool loadFromObj(const char* filename);
+
+    //bounding sphere of the vertex positions
+    void computeBounds();
+
+    uint32_t lodCount() const;
+
+    MeshLod getLod(uint32_t level) const;
 };
 #endif //VULKAN_STEP_BY_STEP_VK_MESH_H
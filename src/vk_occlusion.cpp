@@ -0,0 +1,471 @@
+#include "vk_occlusion.h"
+#include "vk_initializers.h"
+#include <iostream>
+
+static const uint32_t CULL_GROUP_SIZE = 64;
+static const uint32_t REDUCE_GROUP_SIZE = 8;
+
+//matches the push constants of hiz_reduce.comp
+struct ReduceConstants {
+    int32_t sourceWidth;
+    int32_t sourceHeight;
+    int32_t destinationWidth;
+    int32_t destinationHeight;
+    uint32_t sourceIsDepth;
+};
+
+static uint32_t previousPowerOfTwo(uint32_t value) {
+    uint32_t result = 1;
+    while (result * 2 <= value) {
+        result *= 2;
+    }
+    return result;
+}
+
+static VkDescriptorSetLayout createSetLayout(VkDevice device, const VkDescriptorSetLayoutBinding *bindings,
+                                             uint32_t bindingCount) {
+    VkDescriptorSetLayoutCreateInfo setInfo = {};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setInfo.pNext = nullptr;
+    setInfo.flags = 0;
+    setInfo.bindingCount = bindingCount;
+    setInfo.pBindings = bindings;
+
+    VkDescriptorSetLayout layout;
+    vkCreateDescriptorSetLayout(device, &setInfo, nullptr, &layout);
+    return layout;
+}
+
+static VkPipeline createComputePipeline(VkDevice device, VkShaderModule shader, VkPipelineLayout layout) {
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = nullptr;
+    pipelineInfo.stage = vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, shader);
+    pipelineInfo.layout = layout;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        std::cout << "Failed to create an occlusion culling compute pipeline" << std::endl;
+        abort();
+    }
+    return pipeline;
+}
+
+void OcclusionCuller::init(VkDevice device, VmaAllocator allocator, GpuMemory &memory, uint32_t framesInFlight,
+                           uint32_t maxObjects, VkExtent2D depthExtent, VkImageView depthView,
+                           VkShaderModule reduceShader, VkShaderModule cullShader, VkBuffer uniformBuffer) {
+    _device = device;
+    _allocator = allocator;
+    _memory = &memory;
+    _framesInFlight = framesInFlight;
+    _maxObjects = maxObjects;
+    _depthExtent = depthExtent;
+    _depthView = depthView;
+
+    createPyramid();
+
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        FrameResources &frame = _frames[i];
+        frame.bounds = createMappedBuffer(sizeof(glm::vec4) * _maxObjects, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                          VMA_MEMORY_USAGE_CPU_TO_GPU, (void **) &frame.mappedBounds);
+        //early commands first, late commands behind them
+        frame.commands = createMappedBuffer(sizeof(VkDrawIndirectCommand) * _maxObjects * 2,
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                            VMA_MEMORY_USAGE_CPU_TO_GPU, (void **) &frame.mappedCommands);
+        frame.stats = createMappedBuffer(sizeof(OcclusionStats),
+                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                         VMA_MEMORY_USAGE_GPU_TO_CPU, (void **) &frame.mappedStats);
+        frame.frameNumber = -1;
+    }
+    _visibility = createMappedBuffer(sizeof(uint32_t) * _maxObjects,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     VMA_MEMORY_USAGE_GPU_ONLY, nullptr);
+
+    createDescriptors(uniformBuffer);
+    createPipelines(reduceShader, cullShader);
+
+    std::cout << "Occlusion culling with a " << _pyramidExtent.width << "x" << _pyramidExtent.height
+              << " depth pyramid, " << _pyramidLevels << " levels" << std::endl;
+}
+
+void OcclusionCuller::createPyramid() {
+    _pyramidExtent.width = previousPowerOfTwo(_depthExtent.width);
+    _pyramidExtent.height = previousPowerOfTwo(_depthExtent.height);
+    uint32_t largest = _pyramidExtent.width > _pyramidExtent.height ? _pyramidExtent.width : _pyramidExtent.height;
+    _pyramidLevels = 1;
+    while ((largest >> _pyramidLevels) > 0) {
+        _pyramidLevels++;
+    }
+
+    VkExtent3D extent = {_pyramidExtent.width, _pyramidExtent.height, 1};
+    VkImageCreateInfo imageInfo = vkinit::imageCreateInfo(VK_FORMAT_R32G32_SFLOAT,
+                                                          VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                          extent);
+    imageInfo.mipLevels = _pyramidLevels;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (vmaCreateImage(_allocator, &imageInfo, &allocInfo, &_pyramid._image, &_pyramid._allocation, nullptr) !=
+        VK_SUCCESS) {
+        std::cout << "Failed to create the depth pyramid" << std::endl;
+        abort();
+    }
+    _memory->track(_pyramid._allocation, MEMORY_CULLING);
+
+    VkImageViewCreateInfo viewInfo = vkinit::imageviewCreateInfo(VK_FORMAT_R32G32_SFLOAT, _pyramid._image,
+                                                                 VK_IMAGE_ASPECT_COLOR_BIT);
+    viewInfo.subresourceRange.levelCount = _pyramidLevels;
+    vkCreateImageView(_device, &viewInfo, nullptr, &_pyramidView);
+
+    _pyramidLevelViews.resize(_pyramidLevels);
+    for (uint32_t level = 0; level < _pyramidLevels; level++) {
+        viewInfo.subresourceRange.baseMipLevel = level;
+        viewInfo.subresourceRange.levelCount = 1;
+        vkCreateImageView(_device, &viewInfo, nullptr, &_pyramidLevelViews[level]);
+    }
+
+    //the shaders only use texelFetch, the sampler just has to exist
+    VkSamplerCreateInfo samplerInfo = vkinit::samplerCreateInfo(VK_FILTER_NEAREST,
+                                                                VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.maxLod = (float) _pyramidLevels;
+    vkCreateSampler(_device, &samplerInfo, nullptr, &_sampler);
+}
+
+void OcclusionCuller::createDescriptors(VkBuffer uniformBuffer) {
+    VkDescriptorSetLayoutBinding reduceBindings[] = {
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                               VK_SHADER_STAGE_COMPUTE_BIT, 0),
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1)
+    };
+    _reduceSetLayout = createSetLayout(_device, reduceBindings, 2);
+
+    VkDescriptorSetLayoutBinding cullBindings[] = {
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                                               VK_SHADER_STAGE_COMPUTE_BIT, 0),
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                               VK_SHADER_STAGE_COMPUTE_BIT, 5)
+    };
+    _cullSetLayout = createSetLayout(_device, cullBindings, 6);
+
+    std::vector<VkDescriptorPoolSize> sizes =
+            {
+                    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _pyramidLevels + _framesInFlight},
+                    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, _pyramidLevels},
+                    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, _framesInFlight},
+                    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * _framesInFlight}
+            };
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = 0;
+    poolInfo.maxSets = _pyramidLevels + _framesInFlight;
+    poolInfo.poolSizeCount = (uint32_t) sizes.size();
+    poolInfo.pPoolSizes = sizes.data();
+    vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool);
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+
+    //level 0 reads the depth attachment, every other level the one above it
+    _reduceSets.resize(_pyramidLevels);
+    for (uint32_t level = 0; level < _pyramidLevels; level++) {
+        allocInfo.pSetLayouts = &_reduceSetLayout;
+        vkAllocateDescriptorSets(_device, &allocInfo, &_reduceSets[level]);
+
+        VkDescriptorImageInfo sourceInfo;
+        sourceInfo.sampler = _sampler;
+        sourceInfo.imageView = level == 0 ? _depthView : _pyramidLevelViews[level - 1];
+        sourceInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+        VkDescriptorImageInfo destinationInfo;
+        destinationInfo.sampler = VK_NULL_HANDLE;
+        destinationInfo.imageView = _pyramidLevelViews[level];
+        destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet writes[] = {
+                vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _reduceSets[level],
+                                             &sourceInfo, 0),
+                vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, _reduceSets[level],
+                                             &destinationInfo, 1)
+        };
+        vkUpdateDescriptorSets(_device, 2, writes, 0, nullptr);
+    }
+
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        FrameResources &frame = _frames[i];
+        allocInfo.pSetLayouts = &_cullSetLayout;
+        vkAllocateDescriptorSets(_device, &allocInfo, &frame.cullSet);
+
+        VkDescriptorBufferInfo cullDataInfo = {uniformBuffer, 0, sizeof(GPUCullData)};
+        VkDescriptorBufferInfo boundsInfo = {frame.bounds._buffer, 0, VK_WHOLE_SIZE};
+        VkDescriptorBufferInfo commandsInfo = {frame.commands._buffer, 0, VK_WHOLE_SIZE};
+        VkDescriptorBufferInfo visibilityInfo = {_visibility._buffer, 0, VK_WHOLE_SIZE};
+        VkDescriptorBufferInfo statsInfo = {frame.stats._buffer, 0, VK_WHOLE_SIZE};
+
+        VkDescriptorImageInfo pyramidInfo;
+        pyramidInfo.sampler = _sampler;
+        pyramidInfo.imageView = _pyramidView;
+        pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet writes[] = {
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frame.cullSet,
+                                              &cullDataInfo, 0),
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.cullSet, &boundsInfo, 1),
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.cullSet, &commandsInfo, 2),
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.cullSet, &visibilityInfo, 3),
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.cullSet, &statsInfo, 4),
+                vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frame.cullSet,
+                                             &pyramidInfo, 5)
+        };
+        vkUpdateDescriptorSets(_device, 6, writes, 0, nullptr);
+    }
+}
+
+void OcclusionCuller::createPipelines(VkShaderModule reduceShader, VkShaderModule cullShader) {
+    VkPushConstantRange reduceConstants;
+    reduceConstants.offset = 0;
+    reduceConstants.size = sizeof(ReduceConstants);
+    reduceConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo reduceLayoutInfo = vkinit::pipelineLayoutCreateInfo();
+    reduceLayoutInfo.setLayoutCount = 1;
+    reduceLayoutInfo.pSetLayouts = &_reduceSetLayout;
+    reduceLayoutInfo.pushConstantRangeCount = 1;
+    reduceLayoutInfo.pPushConstantRanges = &reduceConstants;
+    vkCreatePipelineLayout(_device, &reduceLayoutInfo, nullptr, &_reduceLayout);
+
+    //the phase, 0 for early and 1 for late
+    VkPushConstantRange cullConstants;
+    cullConstants.offset = 0;
+    cullConstants.size = sizeof(uint32_t);
+    cullConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo cullLayoutInfo = vkinit::pipelineLayoutCreateInfo();
+    cullLayoutInfo.setLayoutCount = 1;
+    cullLayoutInfo.pSetLayouts = &_cullSetLayout;
+    cullLayoutInfo.pushConstantRangeCount = 1;
+    cullLayoutInfo.pPushConstantRanges = &cullConstants;
+    vkCreatePipelineLayout(_device, &cullLayoutInfo, nullptr, &_cullLayout);
+
+    _reducePipeline = createComputePipeline(_device, reduceShader, _reduceLayout);
+    _cullPipeline = createComputePipeline(_device, cullShader, _cullLayout);
+}
+
+AllocatedBuffer OcclusionCuller::createMappedBuffer(size_t size, VkBufferUsageFlags usage,
+                                                    VmaMemoryUsage memoryUsage, void **outMapped) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = nullptr;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = memoryUsage;
+    allocInfo.flags = outMapped ? VMA_ALLOCATION_CREATE_MAPPED_BIT : 0;
+
+    AllocatedBuffer buffer;
+    VmaAllocationInfo allocationInfo;
+    if (vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation,
+                        &allocationInfo) != VK_SUCCESS) {
+        std::cout << "Failed to create an occlusion culling buffer of " << size << " bytes" << std::endl;
+        abort();
+    }
+    _memory->track(buffer._allocation, MEMORY_CULLING);
+    if (outMapped) {
+        *outMapped = allocationInfo.pMappedData;
+    }
+    return buffer;
+}
+
+void OcclusionCuller::recordInitialization(VkCommandBuffer cmd) {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = _pyramid._image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = _pyramidLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &barrier);
+
+    //nothing counts as visible before the first frame, so the first early pass draws nothing and the late pass
+    //draws everything that survives the frustum test
+    vkCmdFillBuffer(cmd, _visibility._buffer, 0, VK_WHOLE_SIZE, 0);
+}
+
+void OcclusionCuller::cleanup() {
+    vkDestroyPipeline(_device, _cullPipeline, nullptr);
+    vkDestroyPipeline(_device, _reducePipeline, nullptr);
+    vkDestroyPipelineLayout(_device, _cullLayout, nullptr);
+    vkDestroyPipelineLayout(_device, _reduceLayout, nullptr);
+    vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _cullSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _reduceSetLayout, nullptr);
+
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        _memory->destroyBuffer(_frames[i].bounds);
+        _memory->destroyBuffer(_frames[i].commands);
+        _memory->destroyBuffer(_frames[i].stats);
+    }
+    _memory->destroyBuffer(_visibility);
+
+    vkDestroySampler(_device, _sampler, nullptr);
+    for (VkImageView view : _pyramidLevelViews) {
+        vkDestroyImageView(_device, view, nullptr);
+    }
+    vkDestroyImageView(_device, _pyramidView, nullptr);
+    _memory->destroyImage(_pyramid);
+}
+
+void OcclusionCuller::beginFrame(VkCommandBuffer cmd, uint32_t frameIndex, int64_t frameNumber) {
+    _currentFrame = frameIndex;
+    FrameResources &frame = _frames[frameIndex];
+    if (frame.frameNumber >= 0) {
+        vmaInvalidateAllocation(_allocator, frame.stats._allocation, 0, VK_WHOLE_SIZE);
+        _lastStats = *frame.mappedStats;
+        _lastStatsFrame = frame.frameNumber;
+    }
+    frame.frameNumber = frameNumber;
+    vkCmdFillBuffer(cmd, frame.stats._buffer, 0, sizeof(OcclusionStats), 0);
+}
+
+void OcclusionCuller::setObject(uint32_t index, const glm::vec4 &sphere, uint32_t vertexCount,
+                                uint32_t firstVertex) {
+    FrameResources &frame = _frames[_currentFrame];
+    frame.mappedBounds[index] = sphere;
+
+    VkDrawIndirectCommand command;
+    command.vertexCount = vertexCount;
+    command.instanceCount = 0;
+    command.firstVertex = firstVertex;
+    command.firstInstance = index;
+    frame.mappedCommands[index] = command;
+    frame.mappedCommands[_maxObjects + index] = command;
+}
+
+GPUCullData OcclusionCuller::makeCullData(const glm::mat4 &view, const glm::mat4 &projection, float znear,
+                                          uint32_t objectCount, const glm::vec2 &viewportScale) const {
+    GPUCullData data = {};
+    data.view = view;
+    Frustum frustum = Frustum::fromViewProjection(projection * view);
+    for (uint32_t i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+        data.frustumPlanes[i] = frustum.planes[i];
+    }
+    data.projection = glm::vec4(projection[0][0], projection[1][1], projection[2][2], projection[3][2]);
+    data.pyramidSize = glm::vec2((float) _pyramidExtent.width, (float) _pyramidExtent.height);
+    data.znear = znear;
+    data.pyramidLevels = _pyramidLevels;
+    data.objectCount = objectCount;
+    data.lateCommandIndex = _maxObjects;
+    data.viewportScale = viewportScale;
+    return data;
+}
+
+void OcclusionCuller::cullEarly(VkCommandBuffer cmd, uint32_t cullDataOffset, uint32_t objectCount) {
+    FrameResources &frame = _frames[_currentFrame];
+    vmaFlushAllocation(_allocator, frame.bounds._allocation, 0, VK_WHOLE_SIZE);
+    vmaFlushAllocation(_allocator, frame.commands._allocation, 0, VK_WHOLE_SIZE);
+
+    //covers the stats reset, and the previous frame's late phase writing the visibility flags and reading the
+    //pyramid this frame rebuilds
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    dispatchCull(cmd, cullDataOffset, objectCount, 0);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+}
+
+void OcclusionCuller::buildPyramid(VkCommandBuffer cmd) {
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _reducePipeline);
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = _pyramid._image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    ReduceConstants constants;
+    constants.sourceWidth = (int32_t) _depthExtent.width;
+    constants.sourceHeight = (int32_t) _depthExtent.height;
+    for (uint32_t level = 0; level < _pyramidLevels; level++) {
+        uint32_t width = _pyramidExtent.width >> level;
+        uint32_t height = _pyramidExtent.height >> level;
+        constants.destinationWidth = (int32_t) (width > 0 ? width : 1);
+        constants.destinationHeight = (int32_t) (height > 0 ? height : 1);
+        constants.sourceIsDepth = level == 0 ? 1 : 0;
+
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _reduceLayout, 0, 1, &_reduceSets[level], 0,
+                                nullptr);
+        vkCmdPushConstants(cmd, _reduceLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReduceConstants), &constants);
+        vkCmdDispatch(cmd, (constants.destinationWidth + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+                      (constants.destinationHeight + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+
+        //the next level and the late cull read this one
+        barrier.subresourceRange.baseMipLevel = level;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                             nullptr, 0, nullptr, 1, &barrier);
+
+        constants.sourceWidth = constants.destinationWidth;
+        constants.sourceHeight = constants.destinationHeight;
+    }
+}
+
+void OcclusionCuller::cullLate(VkCommandBuffer cmd, uint32_t cullDataOffset, uint32_t objectCount) {
+    dispatchCull(cmd, cullDataOffset, objectCount, 1);
+
+    //the late draws read the commands, the CPU reads the stats once the slot comes around again
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+}
+
+void OcclusionCuller::dispatchCull(VkCommandBuffer cmd, uint32_t cullDataOffset, uint32_t objectCount,
+                                   uint32_t latePhase) {
+    FrameResources &frame = _frames[_currentFrame];
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullLayout, 0, 1, &frame.cullSet, 1,
+                            &cullDataOffset);
+    vkCmdPushConstants(cmd, _cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &latePhase);
+    vkCmdDispatch(cmd, (objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+}
@@ -0,0 +1,142 @@
+#ifndef VULKAN_STEP_BY_STEP_VK_OCCLUSION_H
+#define VULKAN_STEP_BY_STEP_VK_OCCLUSION_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "vk_types.h"
+#include "engine_config.h"
+#include "bounds.h"
+#include "vk_memory.h"
+
+//counters the cull shader accumulates over one frame, laid out like the Stats buffer of occlusion_cull.comp
+struct OcclusionStats {
+    uint32_t frustumCulled = 0;
+    uint32_t occluded = 0;
+    uint32_t drawnEarly = 0;
+    uint32_t drawnLate = 0;
+};
+
+//matches CullData in occlusion_cull.comp
+struct GPUCullData {
+    glm::mat4 view;
+    glm::vec4 frustumPlanes[FRUSTUM_PLANE_COUNT];
+    //P00, P11, P22 and P32 of the projection matrix
+    glm::vec4 projection;
+    glm::vec2 pyramidSize;
+    float znear;
+    uint32_t pyramidLevels;
+    uint32_t objectCount;
+    uint32_t lateCommandIndex;
+    //part of the depth attachment the frame renders to, the pyramid is built over all of it
+    glm::vec2 viewportScale;
+};
+
+//two-phase hierarchical-Z occlusion culling. objects that were visible last frame are drawn first, the depth they
+//leave behind is reduced into a min/max pyramid and everything in the frustum is tested against it. objects that
+//pass but were not drawn yet go into a second pass, and the result becomes next frame's visibility.
+//every object has one indirect command per pass, the CPU fills in the vertex range and the cull shader decides
+//the instance count
+class OcclusionCuller {
+public:
+    void init(VkDevice device, VmaAllocator allocator, GpuMemory &memory, uint32_t framesInFlight,
+              uint32_t maxObjects, VkExtent2D depthExtent, VkImageView depthView, VkShaderModule reduceShader,
+              VkShaderModule cullShader, VkBuffer uniformBuffer);
+
+    //moves the pyramid into GENERAL and clears the visibility flags, record once before the first frame
+    void recordInitialization(VkCommandBuffer cmd);
+
+    void cleanup();
+
+    //collects the statistics this slot gathered last time and resets them, must be recorded outside a render pass
+    void beginFrame(VkCommandBuffer cmd, uint32_t frameIndex, int64_t frameNumber);
+
+    //world space bounding sphere and vertex range of an object, it is drawn with firstInstance = index
+    void setObject(uint32_t index, const glm::vec4 &sphere, uint32_t vertexCount, uint32_t firstVertex);
+
+    //viewportScale is the rendered size over the depth extent passed to init, the rest of the depth attachment has
+    //to be cleared to the far plane
+    GPUCullData makeCullData(const glm::mat4 &view, const glm::mat4 &projection, float znear, uint32_t objectCount,
+                             const glm::vec2 &viewportScale) const;
+
+    //cullDataOffset is the dynamic offset of a GPUCullData in the uniform buffer passed to init
+    void cullEarly(VkCommandBuffer cmd, uint32_t cullDataOffset, uint32_t objectCount);
+
+    //reduces the depth the early pass wrote, which has to be in SHADER_READ_ONLY_OPTIMAL by now
+    void buildPyramid(VkCommandBuffer cmd);
+
+    void cullLate(VkCommandBuffer cmd, uint32_t cullDataOffset, uint32_t objectCount);
+
+    VkBuffer commandBuffer() const { return _frames[_currentFrame].commands._buffer; }
+
+    //object i's command of a pass lives at this offset + i * sizeof(VkDrawIndirectCommand)
+    VkDeviceSize earlyCommandOffset() const { return 0; }
+
+    VkDeviceSize lateCommandOffset() const { return _maxObjects * sizeof(VkDrawIndirectCommand); }
+
+    uint32_t maxObjects() const { return _maxObjects; }
+
+    const OcclusionStats &lastStats() const { return _lastStats; }
+
+    //frame number lastStats belongs to, -1 before the first frame is read back
+    int64_t lastStatsFrame() const { return _lastStatsFrame; }
+
+private:
+    struct FrameResources {
+        AllocatedBuffer bounds;
+        glm::vec4 *mappedBounds = nullptr;
+        AllocatedBuffer commands;
+        VkDrawIndirectCommand *mappedCommands = nullptr;
+        AllocatedBuffer stats;
+        OcclusionStats *mappedStats = nullptr;
+        VkDescriptorSet cullSet = VK_NULL_HANDLE;
+        int64_t frameNumber = -1;
+    };
+
+    void createPyramid();
+
+    void createPipelines(VkShaderModule reduceShader, VkShaderModule cullShader);
+
+    void createDescriptors(VkBuffer uniformBuffer);
+
+    void dispatchCull(VkCommandBuffer cmd, uint32_t cullDataOffset, uint32_t objectCount, uint32_t latePhase);
+
+    AllocatedBuffer createMappedBuffer(size_t size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+                                       void **outMapped);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    GpuMemory *_memory = nullptr;
+    uint32_t _framesInFlight = 0;
+    uint32_t _currentFrame = 0;
+    uint32_t _maxObjects = 0;
+
+    VkExtent2D _depthExtent = {};
+    VkImageView _depthView = VK_NULL_HANDLE;
+
+    //largest power of two that fits into the depth extent, so every level halves cleanly
+    VkExtent2D _pyramidExtent = {};
+    uint32_t _pyramidLevels = 0;
+    AllocatedImage _pyramid = {};
+    VkImageView _pyramidView = VK_NULL_HANDLE;
+    std::vector<VkImageView> _pyramidLevelViews;
+    VkSampler _sampler = VK_NULL_HANDLE;
+
+    //one flag per object, written by the late phase and read by the next early phase
+    AllocatedBuffer _visibility = {};
+
+    FrameResources _frames[MAX_FRAMES_IN_FLIGHT];
+
+    VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _reduceSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _cullSetLayout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> _reduceSets;
+    VkPipelineLayout _reduceLayout = VK_NULL_HANDLE;
+    VkPipelineLayout _cullLayout = VK_NULL_HANDLE;
+    VkPipeline _reducePipeline = VK_NULL_HANDLE;
+    VkPipeline _cullPipeline = VK_NULL_HANDLE;
+
+    OcclusionStats _lastStats;
+    int64_t _lastStatsFrame = -1;
+};
+
+#endif //VULKAN_STEP_BY_STEP_VK_OCCLUSION_H
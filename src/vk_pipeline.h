@@ -16,6 +16,10 @@ public:
     VkPipelineMultisampleStateCreateInfo multisampling;
     VkPipelineLayout pipelineLayout;
     VkPipelineDepthStencilStateCreateInfo depthStencil;
+    //0 for depth-only render passes, colorBlendAttachment is ignored then
+    uint32_t colorAttachmentCount = 1;
+    //viewport and scissor are set with vkCmdSetViewport and vkCmdSetScissor instead of the two members above
+    bool dynamicViewport = false;
     VkPipeline buildPipeline(VkDevice device, VkRenderPass pass);
 };
 
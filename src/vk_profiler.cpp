@@ -0,0 +1,306 @@
+#include "vk_profiler.h"
+#include "json.h"
+#include <fstream>
+#include <iostream>
+
+static const uint32_t INVALID_SCOPE = ~0u;
+
+void GpuProfiler::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight,
+                       bool pipelineStatisticsSupported) {
+    _device = device;
+    _framesInFlight = framesInFlight;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+    uint32_t validBits = families[queueFamily].timestampValidBits;
+    if (validBits == 0) {
+        std::cout << "GPU profiler disabled, the graphics queue does not support timestamps" << std::endl;
+        return;
+    }
+    _timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+    _timestampPeriod = properties.limits.timestampPeriod;
+    _statisticsEnabled = pipelineStatisticsSupported;
+
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        VkQueryPoolCreateInfo timestampInfo = {};
+        timestampInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        timestampInfo.pNext = nullptr;
+        timestampInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        timestampInfo.queryCount = MAX_SCOPES_PER_FRAME * 2;
+        vkCreateQueryPool(_device, &timestampInfo, nullptr, &_frames[i].timestampPool);
+
+        if (_statisticsEnabled) {
+            VkQueryPoolCreateInfo statisticsInfo = {};
+            statisticsInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            statisticsInfo.pNext = nullptr;
+            statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            statisticsInfo.queryCount = MAX_SCOPES_PER_FRAME;
+            statisticsInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+                                                VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                                VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                                VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+            vkCreateQueryPool(_device, &statisticsInfo, nullptr, &_frames[i].statisticsPool);
+        }
+        _frames[i].records.reserve(MAX_SCOPES_PER_FRAME);
+    }
+    _enabled = true;
+}
+
+void GpuProfiler::cleanup() {
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        if (_frames[i].timestampPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(_device, _frames[i].timestampPool, nullptr);
+        }
+        if (_frames[i].statisticsPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(_device, _frames[i].statisticsPool, nullptr);
+        }
+    }
+    _enabled = false;
+}
+
+uint32_t GpuProfiler::registerScope(const std::string &name) {
+    auto it = _scopeIds.find(name);
+    if (it != _scopeIds.end()) {
+        return it->second;
+    }
+    uint32_t id = (uint32_t) _scopes.size();
+    GpuScopeHistory history;
+    history.name = name;
+    _scopes.push_back(history);
+    _lastMilliseconds.push_back(0.0);
+    _scopeIds[name] = id;
+    return id;
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer cmd, uint32_t frameIndex, int64_t frameNumber) {
+    if (!_enabled) {
+        return;
+    }
+    _currentFrame = frameIndex;
+    FrameQueries &frame = _frames[frameIndex];
+
+    //the caller already waited for this slot's previous submission, so its queries are complete
+    resolveFrame(frame);
+
+    vkCmdResetQueryPool(cmd, frame.timestampPool, 0, MAX_SCOPES_PER_FRAME * 2);
+    if (_statisticsEnabled) {
+        vkCmdResetQueryPool(cmd, frame.statisticsPool, 0, MAX_SCOPES_PER_FRAME);
+    }
+    frame.timestampCount = 0;
+    frame.statisticsCount = 0;
+    frame.frameNumber = frameNumber;
+    frame.records.clear();
+    _openScopes.clear();
+    _statisticsOwner = -1;
+}
+
+void GpuProfiler::beginScope(VkCommandBuffer cmd, uint32_t scopeId, bool withStatistics) {
+    if (!_enabled) {
+        return;
+    }
+    FrameQueries &frame = _frames[_currentFrame];
+
+    ScopeRecord record;
+    record.scopeId = scopeId;
+    record.timestampQuery = frame.timestampCount;
+    record.statisticsQuery = -1;
+
+    if (frame.timestampCount + 2 > MAX_SCOPES_PER_FRAME * 2) {
+        //out of queries, keep the open/close pairing intact but measure nothing
+        record.scopeId = INVALID_SCOPE;
+    } else {
+        frame.timestampCount += 2;
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.timestampPool, record.timestampQuery);
+
+        if (withStatistics && _statisticsEnabled && _statisticsOwner < 0) {
+            record.statisticsQuery = (int32_t) frame.statisticsCount++;
+            vkCmdBeginQuery(cmd, frame.statisticsPool, record.statisticsQuery, 0);
+            _statisticsOwner = (int32_t) frame.records.size();
+        }
+    }
+
+    _openScopes.push_back((uint32_t) frame.records.size());
+    frame.records.push_back(record);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer cmd) {
+    if (!_enabled || _openScopes.empty()) {
+        return;
+    }
+    FrameQueries &frame = _frames[_currentFrame];
+    uint32_t recordIndex = _openScopes.back();
+    _openScopes.pop_back();
+
+    const ScopeRecord &record = frame.records[recordIndex];
+    if (record.scopeId == INVALID_SCOPE) {
+        return;
+    }
+    if (record.statisticsQuery >= 0) {
+        vkCmdEndQuery(cmd, frame.statisticsPool, record.statisticsQuery);
+        _statisticsOwner = -1;
+    }
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, record.timestampQuery + 1);
+}
+
+void GpuProfiler::resolveFrame(FrameQueries &frame) {
+    if (frame.records.empty()) {
+        return;
+    }
+
+    //value + availability pairs
+    std::vector<uint64_t> &timestamps = _timestampResults;
+    timestamps.assign(frame.timestampCount * 2, 0);
+    vkGetQueryPoolResults(_device, frame.timestampPool, 0, frame.timestampCount,
+                          timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t) * 2,
+                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    const uint32_t statisticsStride = PIPELINE_STATISTIC_COUNT + 1;
+    std::vector<uint64_t> &statistics = _statisticsResults;
+    statistics.assign(frame.statisticsCount * statisticsStride, 0);
+    if (frame.statisticsCount > 0) {
+        vkGetQueryPoolResults(_device, frame.statisticsPool, 0, frame.statisticsCount,
+                              statistics.size() * sizeof(uint64_t), statistics.data(),
+                              sizeof(uint64_t) * statisticsStride,
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    }
+
+    //a scope can be opened several times per frame (one per material switch), sum them up
+    std::vector<double> &frameMilliseconds = _frameMilliseconds;
+    std::vector<uint64_t> &frameStatistics = _frameStatistics;
+    std::vector<uint8_t> &measured = _measured;
+    std::vector<uint8_t> &hasStatistics = _measuredStatistics;
+    frameMilliseconds.assign(_scopes.size(), 0.0);
+    frameStatistics.assign(_scopes.size() * PIPELINE_STATISTIC_COUNT, 0);
+    measured.assign(_scopes.size(), 0);
+    hasStatistics.assign(_scopes.size(), 0);
+
+    for (const ScopeRecord &record : frame.records) {
+        if (record.scopeId == INVALID_SCOPE) {
+            continue;
+        }
+        const uint64_t *begin = &timestamps[record.timestampQuery * 2];
+        const uint64_t *end = &timestamps[(record.timestampQuery + 1) * 2];
+        if (begin[1] == 0 || end[1] == 0) {
+            continue;
+        }
+        uint64_t ticks = ((end[0] & _timestampMask) - (begin[0] & _timestampMask)) & _timestampMask;
+        frameMilliseconds[record.scopeId] += (double) ticks * _timestampPeriod / 1000000.0;
+        measured[record.scopeId] = 1;
+
+        if (record.statisticsQuery >= 0) {
+            const uint64_t *values = &statistics[record.statisticsQuery * statisticsStride];
+            if (values[PIPELINE_STATISTIC_COUNT] != 0) {
+                for (uint32_t s = 0; s < PIPELINE_STATISTIC_COUNT; s++) {
+                    frameStatistics[record.scopeId * PIPELINE_STATISTIC_COUNT + s] += values[s];
+                }
+                hasStatistics[record.scopeId] = 1;
+            }
+        }
+    }
+
+    //the first scope is the frame's outermost one. when its timestamps never landed the frame has no total, and its
+    //other scopes are skipped too so every history holds the same frames
+    const ScopeRecord &outermost = frame.records.front();
+    if (outermost.scopeId == INVALID_SCOPE || !measured[outermost.scopeId]) {
+        return;
+    }
+    _lastResolvedFrame = frame.frameNumber;
+    for (size_t i = 0; i < _scopes.size(); i++) {
+        if (!measured[i]) {
+            continue;
+        }
+        _scopes[i].milliseconds.push(frameMilliseconds[i]);
+        _lastMilliseconds[i] = frameMilliseconds[i];
+        if (hasStatistics[i]) {
+            _scopes[i].hasStatistics = true;
+            for (uint32_t s = 0; s < PIPELINE_STATISTIC_COUNT; s++) {
+                _scopes[i].statistics[s].push((double) frameStatistics[i * PIPELINE_STATISTIC_COUNT + s]);
+            }
+        }
+    }
+}
+
+double GpuProfiler::lastMilliseconds(uint32_t scopeId) const {
+    return scopeId < _lastMilliseconds.size() ? _lastMilliseconds[scopeId] : 0.0;
+}
+
+//RFC 4180 field, always quoted so commas and line breaks in a path stay inside their column
+static void writeCsvField(std::ostream &out, const std::string &text) {
+    out << '"';
+    for (char c : text) {
+        if (c == '"') {
+            out << '"';
+        }
+        out << c;
+    }
+    out << '"';
+}
+
+static const char *STATISTIC_NAMES[PIPELINE_STATISTIC_COUNT] = {
+        "ia_primitives",
+        "vs_invocations",
+        "clipping_primitives",
+        "fs_invocations"
+};
+
+bool GpuProfiler::writeCsv(const std::string &path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Failed to write GPU profile " << path << std::endl;
+        return false;
+    }
+
+    file << "scope,samples,min_ms,avg_ms,p99_ms,max_ms";
+    for (uint32_t s = 0; s < PIPELINE_STATISTIC_COUNT; s++) {
+        file << ",avg_" << STATISTIC_NAMES[s];
+    }
+    file << "\n";
+
+    for (const GpuScopeHistory &scope : _scopes) {
+        writeCsvField(file, scope.name);
+        file << "," << scope.milliseconds.size() << "," << scope.milliseconds.min() << ","
+             << scope.milliseconds.average() << "," << scope.milliseconds.percentile(99.0) << ","
+             << scope.milliseconds.max();
+        for (uint32_t s = 0; s < PIPELINE_STATISTIC_COUNT; s++) {
+            file << ",";
+            if (scope.hasStatistics) {
+                file << scope.statistics[s].average();
+            }
+        }
+        file << "\n";
+    }
+    return true;
+}
+
+bool GpuProfiler::writeJson(const std::string &path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cout << "Failed to write GPU profile " << path << std::endl;
+        return false;
+    }
+
+    file << "{\n  \"scopes\": [\n";
+    for (size_t i = 0; i < _scopes.size(); i++) {
+        const GpuScopeHistory &scope = _scopes[i];
+        file << "    {\"name\": ";
+        writeJsonString(file, scope.name);
+        file << ", \"samples\": " << scope.milliseconds.size()
+             << ", \"min_ms\": " << scope.milliseconds.min() << ", \"avg_ms\": " << scope.milliseconds.average()
+             << ", \"p99_ms\": " << scope.milliseconds.percentile(99.0) << ", \"max_ms\": "
+             << scope.milliseconds.max();
+        if (scope.hasStatistics) {
+            for (uint32_t s = 0; s < PIPELINE_STATISTIC_COUNT; s++) {
+                file << ", \"avg_" << STATISTIC_NAMES[s] << "\": " << scope.statistics[s].average();
+            }
+        }
+        file << "}" << (i + 1 < _scopes.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return true;
+}
@@ -0,0 +1,121 @@
+#ifndef VULKAN_STEP_BY_STEP_VK_PROFILER_H
+#define VULKAN_STEP_BY_STEP_VK_PROFILER_H
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "engine_config.h"
+#include "timing_stats.h"
+
+enum PipelineStatistic {
+    INPUT_ASSEMBLY_PRIMITIVES,
+    VERTEX_SHADER_INVOCATIONS,
+    CLIPPING_PRIMITIVES,
+    FRAGMENT_SHADER_INVOCATIONS,
+    PIPELINE_STATISTIC_COUNT
+};
+
+struct GpuScopeHistory {
+    std::string name;
+    TimingHistory milliseconds;
+    TimingHistory statistics[PIPELINE_STATISTIC_COUNT];
+    bool hasStatistics = false;
+};
+
+//GPU timing and pipeline statistics per named scope. every frame slot owns its own query pools, which are read
+//back when the slot comes around again, so results are always at least one frame old and never stall the CPU.
+class GpuProfiler {
+public:
+    static const uint32_t MAX_SCOPES_PER_FRAME = 128;
+
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight,
+              bool pipelineStatisticsSupported);
+
+    void cleanup();
+
+    //returns a stable id for a scope name, do this once outside the hot path
+    uint32_t registerScope(const std::string &name);
+
+    //collects the previous results of this slot and resets its queries, must be recorded outside a render pass
+    void beginFrame(VkCommandBuffer cmd, uint32_t frameIndex, int64_t frameNumber);
+
+    //pipeline statistics are only gathered for the outermost scope that asks for them
+    void beginScope(VkCommandBuffer cmd, uint32_t scopeId, bool withStatistics = false);
+
+    void endScope(VkCommandBuffer cmd);
+
+    const std::vector<GpuScopeHistory> &getScopes() const { return _scopes; }
+
+    //latest resolved frame value of a scope, 0 if it has not been measured yet
+    double lastMilliseconds(uint32_t scopeId) const;
+
+    //frame number the lastMilliseconds values belong to, -1 before the first frame is resolved. only advances for
+    //frames whose outermost scope was measured
+    int64_t lastResolvedFrame() const { return _lastResolvedFrame; }
+
+    bool writeCsv(const std::string &path) const;
+
+    bool writeJson(const std::string &path) const;
+
+private:
+    struct ScopeRecord {
+        uint32_t scopeId;
+        uint32_t timestampQuery;
+        int32_t statisticsQuery;
+    };
+
+    struct FrameQueries {
+        VkQueryPool timestampPool = VK_NULL_HANDLE;
+        VkQueryPool statisticsPool = VK_NULL_HANDLE;
+        uint32_t timestampCount = 0;
+        uint32_t statisticsCount = 0;
+        int64_t frameNumber = -1;
+        std::vector<ScopeRecord> records;
+    };
+
+    void resolveFrame(FrameQueries &frame);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    bool _enabled = false;
+    bool _statisticsEnabled = false;
+    float _timestampPeriod = 1.0f;
+    uint64_t _timestampMask = ~0ull;
+
+    FrameQueries _frames[MAX_FRAMES_IN_FLIGHT];
+    uint32_t _framesInFlight = 0;
+    uint32_t _currentFrame = 0;
+
+    //indices into the current frame's records, innermost last
+    std::vector<uint32_t> _openScopes;
+    int32_t _statisticsOwner = -1;
+
+    std::vector<GpuScopeHistory> _scopes;
+    //resolveFrame's scratch, kept so reading back a frame allocates nothing once they have grown
+    std::vector<uint64_t> _timestampResults;
+    std::vector<uint64_t> _statisticsResults;
+    std::vector<double> _frameMilliseconds;
+    std::vector<uint64_t> _frameStatistics;
+    std::vector<uint8_t> _measured;
+    std::vector<uint8_t> _measuredStatistics;
+    std::vector<double> _lastMilliseconds;
+    int64_t _lastResolvedFrame = -1;
+    std::unordered_map<std::string, uint32_t> _scopeIds;
+};
+
+//records a GPU scope for the lifetime of the object
+struct GpuProfileScope {
+    GpuProfiler &profiler;
+    VkCommandBuffer cmd;
+
+    GpuProfileScope(GpuProfiler &profiler, VkCommandBuffer cmd, uint32_t scopeId, bool withStatistics = false)
+            : profiler(profiler), cmd(cmd) {
+        profiler.beginScope(cmd, scopeId, withStatistics);
+    }
+
+    ~GpuProfileScope() {
+        profiler.endScope(cmd);
+    }
+};
+
+#endif //VULKAN_STEP_BY_STEP_VK_PROFILER_H
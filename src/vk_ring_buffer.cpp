@@ -0,0 +1,76 @@
+#include "vk_ring_buffer.h"
+#include <iostream>
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void FrameRingBuffer::init(VmaAllocator allocator, GpuMemory &memory, const VkPhysicalDeviceLimits &limits,
+                           size_t bytesPerFrame, uint32_t framesInFlight) {
+    _allocator = allocator;
+    _memory = &memory;
+    _uniformAlignment = limits.minUniformBufferOffsetAlignment > 0 ? limits.minUniformBufferOffsetAlignment : 1;
+    _storageAlignment = limits.minStorageBufferOffsetAlignment > 0 ? limits.minStorageBufferOffsetAlignment : 1;
+    //every region has to start on an offset that is valid for both descriptor types
+    size_t regionAlignment = _uniformAlignment > _storageAlignment ? _uniformAlignment : _storageAlignment;
+    _bytesPerFrame = alignUp(bytesPerFrame, regionAlignment);
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = nullptr;
+    bufferInfo.size = _bytesPerFrame * framesInFlight;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo allocationInfo;
+    if (vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &_buffer._buffer, &_buffer._allocation,
+                        &allocationInfo) != VK_SUCCESS) {
+        std::cout << "Failed to create the frame ring buffer" << std::endl;
+        abort();
+    }
+    _memory->track(_buffer._allocation, MEMORY_FRAME_DATA);
+    _mapped = (char *) allocationInfo.pMappedData;
+}
+
+void FrameRingBuffer::cleanup() {
+    _memory->destroyBuffer(_buffer);
+}
+
+void FrameRingBuffer::beginFrame(uint32_t frameIndex) {
+    _frameStart = _bytesPerFrame * frameIndex;
+    _head = _frameStart;
+}
+
+bool FrameRingBuffer::allocateUniform(size_t size, RingAllocation &outAllocation) {
+    return allocate(size, _uniformAlignment, outAllocation);
+}
+
+bool FrameRingBuffer::allocateStorage(size_t size, RingAllocation &outAllocation) {
+    return allocate(size, _storageAlignment, outAllocation);
+}
+
+bool FrameRingBuffer::allocate(size_t size, size_t alignment, RingAllocation &outAllocation) {
+    size_t offset = alignUp(_head, alignment);
+    if (offset + size > _frameStart + _bytesPerFrame) {
+        if (!_overflowReported) {
+            std::cout << "Frame ring buffer is full, " << _bytesPerFrame << " bytes per frame are not enough"
+                      << std::endl;
+            _overflowReported = true;
+        }
+        return false;
+    }
+    _head = offset + size;
+
+    outAllocation.data = _mapped + offset;
+    outAllocation.offset = (uint32_t) offset;
+    return true;
+}
+
+void FrameRingBuffer::flush() {
+    if (_head > _frameStart) {
+        vmaFlushAllocation(_allocator, _buffer._allocation, _frameStart, _head - _frameStart);
+    }
+}
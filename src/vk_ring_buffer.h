@@ -0,0 +1,68 @@
+#ifndef VULKAN_STEP_BY_STEP_VK_RING_BUFFER_H
+#define VULKAN_STEP_BY_STEP_VK_RING_BUFFER_H
+
+#include <vulkan/vulkan.h>
+#include <cstring>
+#include "vk_types.h"
+#include "engine_config.h"
+#include "vk_memory.h"
+
+struct RingAllocation {
+    void *data = nullptr;
+    //offset from the start of the ring buffer, pass it as the dynamic offset of a descriptor with offset 0
+    uint32_t offset = 0;
+};
+
+//linear allocator for transient per-frame data. one persistently mapped buffer is split into a region per frame in
+//flight, a frame's region is rewound in beginFrame once the slot's timeline value has been reached.
+class FrameRingBuffer {
+public:
+    void init(VmaAllocator allocator, GpuMemory &memory, const VkPhysicalDeviceLimits &limits, size_t bytesPerFrame,
+              uint32_t framesInFlight);
+
+    void cleanup();
+
+    void beginFrame(uint32_t frameIndex);
+
+    //returns false when the frame's region is full
+    bool allocateUniform(size_t size, RingAllocation &outAllocation);
+
+    bool allocateStorage(size_t size, RingAllocation &outAllocation);
+
+    template<typename T>
+    bool pushUniform(const T &value, uint32_t &outOffset) {
+        RingAllocation allocation;
+        if (!allocateUniform(sizeof(T), allocation)) {
+            return false;
+        }
+        memcpy(allocation.data, &value, sizeof(T));
+        outOffset = allocation.offset;
+        return true;
+    }
+
+    //makes this frame's writes visible to the GPU on non-coherent memory, call before submitting
+    void flush();
+
+    VkBuffer buffer() const { return _buffer._buffer; }
+
+    size_t usedBytes() const { return _head - _frameStart; }
+
+    size_t bytesPerFrame() const { return _bytesPerFrame; }
+
+private:
+    bool allocate(size_t size, size_t alignment, RingAllocation &outAllocation);
+
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    GpuMemory *_memory = nullptr;
+    AllocatedBuffer _buffer = {};
+    char *_mapped = nullptr;
+    size_t _bytesPerFrame = 0;
+    size_t _uniformAlignment = 1;
+    size_t _storageAlignment = 1;
+
+    size_t _frameStart = 0;
+    size_t _head = 0;
+    bool _overflowReported = false;
+};
+
+#endif //VULKAN_STEP_BY_STEP_VK_RING_BUFFER_H
@@ -0,0 +1,365 @@
+#include "vk_shadows.h"
+#include "vk_initializers.h"
+#include "vk_pipeline.h"
+#include "vk_mesh.h"
+#include <gtc/matrix_transform.hpp>
+#include <cmath>
+#include <iostream>
+
+static const VkFormat SHADOW_FORMAT = VK_FORMAT_D32_SFLOAT;
+
+void CascadedShadows::init(VkDevice device, VmaAllocator allocator, GpuMemory &memory, uint32_t mapSize,
+                           float shadowDistance, VkShaderModule casterShader, VkDescriptorSetLayout objectSetLayout) {
+    _device = device;
+    _allocator = allocator;
+    _memory = &memory;
+    _mapSize = mapSize;
+    _shadowDistance = shadowDistance;
+
+    createRenderPass();
+    createLayers();
+    if (casterShader == VK_NULL_HANDLE) {
+        return;
+    }
+    createPipeline(casterShader, objectSetLayout);
+
+    std::cout << "Cascaded shadows with " << SHADOW_CASCADE_COUNT << " cascades of " << _mapSize << "x" << _mapSize
+              << " up to " << _shadowDistance << " units" << std::endl;
+}
+
+void CascadedShadows::createRenderPass() {
+    VkAttachmentDescription depthAttachment = {};
+    depthAttachment.flags = 0;
+    depthAttachment.format = SHADOW_FORMAT;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef = {};
+    depthAttachmentRef.attachment = 0;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subPass = {};
+    subPass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subPass.colorAttachmentCount = 0;
+    subPass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    //the previous frame may still be sampling the layer that is about to be cleared
+    VkSubpassDependency readDependency = {};
+    readDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    readDependency.dstSubpass = 0;
+    readDependency.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    readDependency.srcAccessMask = 0;
+    readDependency.dstStageMask =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    readDependency.dstAccessMask =
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    VkSubpassDependency writeDependency = {};
+    writeDependency.srcSubpass = 0;
+    writeDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    writeDependency.srcStageMask =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    writeDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    writeDependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    writeDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkSubpassDependency dependencies[2] = {readDependency, writeDependency};
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &depthAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subPass;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = &dependencies[0];
+    if (vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_renderPass) != VK_SUCCESS) {
+        std::cout << "Failed to create the shadow render pass" << std::endl;
+        abort();
+    }
+}
+
+void CascadedShadows::createLayers() {
+    VkExtent3D extent = {_mapSize, _mapSize, 1};
+    VkImageCreateInfo imageInfo = vkinit::imageCreateInfo(SHADOW_FORMAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                                                         VK_IMAGE_USAGE_SAMPLED_BIT, extent);
+    imageInfo.arrayLayers = SHADOW_CASCADE_COUNT;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    for (LayerImage &layer : _layers) {
+        if (vmaCreateImage(_allocator, &imageInfo, &allocInfo, &layer.image._image, &layer.image._allocation,
+                           nullptr) != VK_SUCCESS) {
+            std::cout << "Failed to create a shadow map" << std::endl;
+            abort();
+        }
+        _memory->track(layer.image._allocation, MEMORY_SHADOW);
+
+        VkImageViewCreateInfo viewInfo = vkinit::imageviewCreateInfo(SHADOW_FORMAT, layer.image._image,
+                                                                     VK_IMAGE_ASPECT_DEPTH_BIT);
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+        viewInfo.subresourceRange.layerCount = SHADOW_CASCADE_COUNT;
+        vkCreateImageView(_device, &viewInfo, nullptr, &layer.arrayView);
+
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.subresourceRange.layerCount = 1;
+        for (uint32_t cascade = 0; cascade < SHADOW_CASCADE_COUNT; cascade++) {
+            viewInfo.subresourceRange.baseArrayLayer = cascade;
+            vkCreateImageView(_device, &viewInfo, nullptr, &layer.cascadeViews[cascade]);
+
+            VkFramebufferCreateInfo fbInfo = {};
+            fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            fbInfo.pNext = nullptr;
+            fbInfo.renderPass = _renderPass;
+            fbInfo.attachmentCount = 1;
+            fbInfo.pAttachments = &layer.cascadeViews[cascade];
+            fbInfo.width = _mapSize;
+            fbInfo.height = _mapSize;
+            fbInfo.layers = 1;
+            vkCreateFramebuffer(_device, &fbInfo, nullptr, &layer.framebuffers[cascade]);
+        }
+    }
+
+    //hardware depth compare with bilinear filtering gives 2x2 PCF for free
+    VkSamplerCreateInfo samplerInfo = vkinit::samplerCreateInfo(VK_FILTER_LINEAR,
+                                                                VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER);
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    vkCreateSampler(_device, &samplerInfo, nullptr, &_sampler);
+}
+
+void CascadedShadows::createPipeline(VkShaderModule casterShader, VkDescriptorSetLayout objectSetLayout) {
+    VkPushConstantRange pushConstant;
+    pushConstant.offset = 0;
+    pushConstant.size = sizeof(glm::mat4);
+    pushConstant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipelineLayoutCreateInfo();
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &objectSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstant;
+    vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout);
+
+    PipelineBuilder pipelineBuilder;
+
+    VertexInputDescription positionDescription = Vertex::getPositionOnlyDescription();
+    pipelineBuilder.vertexInputInfo = vkinit::vertexInputStateCreateInfo();
+    pipelineBuilder.vertexInputInfo.pVertexAttributeDescriptions = positionDescription.attributes.data();
+    pipelineBuilder.vertexInputInfo.vertexAttributeDescriptionCount = positionDescription.attributes.size();
+    pipelineBuilder.vertexInputInfo.pVertexBindingDescriptions = positionDescription.bindings.data();
+    pipelineBuilder.vertexInputInfo.vertexBindingDescriptionCount = positionDescription.bindings.size();
+    pipelineBuilder.inputAssembly = vkinit::inputAssemblyCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+
+    pipelineBuilder.viewport.x = 0.0f;
+    pipelineBuilder.viewport.y = 0.0f;
+    pipelineBuilder.viewport.width = (float) _mapSize;
+    pipelineBuilder.viewport.height = (float) _mapSize;
+    pipelineBuilder.viewport.minDepth = 0.0f;
+    pipelineBuilder.viewport.maxDepth = 1.0f;
+    pipelineBuilder.scissor.offset = {0, 0};
+    pipelineBuilder.scissor.extent = {_mapSize, _mapSize};
+
+    //slope scaled bias against acne on surfaces at grazing angles to the sun
+    pipelineBuilder.rasterizer = vkinit::rasterizationStateCreateInfo(VK_POLYGON_MODE_FILL);
+    pipelineBuilder.rasterizer.depthBiasEnable = VK_TRUE;
+    pipelineBuilder.rasterizer.depthBiasConstantFactor = 1.25f;
+    pipelineBuilder.rasterizer.depthBiasSlopeFactor = 1.75f;
+
+    pipelineBuilder.multisampling = vkinit::multisamplingStateCreateInfo();
+    pipelineBuilder.colorBlendAttachment = vkinit::colorBlendAttachmentState();
+    pipelineBuilder.colorAttachmentCount = 0;
+    pipelineBuilder.depthStencil = vkinit::depthStencilCreateInfo(true, true, VK_COMPARE_OP_LESS_OR_EQUAL);
+    pipelineBuilder.pipelineLayout = _pipelineLayout;
+    pipelineBuilder.shaderStages.push_back(
+            vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, casterShader));
+
+    _pipeline = pipelineBuilder.buildPipeline(_device, _renderPass);
+    if (_pipeline == VK_NULL_HANDLE) {
+        std::cout << "Failed to create the shadow caster pipeline" << std::endl;
+        abort();
+    }
+}
+
+void CascadedShadows::recordInitialization(VkCommandBuffer cmd) {
+    //the dynamic layer of a cascade may never be drawn, it still has to be in a layout the descriptors allow
+    VkImageMemoryBarrier barriers[SHADOW_LAYER_COUNT];
+    for (uint32_t i = 0; i < SHADOW_LAYER_COUNT; i++) {
+        VkImageMemoryBarrier &barrier = barriers[i];
+        barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = _layers[i].image._image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = SHADOW_CASCADE_COUNT;
+    }
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+                         nullptr, 0, nullptr, SHADOW_LAYER_COUNT, barriers);
+}
+
+void CascadedShadows::cleanup() {
+    vkDestroyPipeline(_device, _pipeline, nullptr);
+    vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+    vkDestroySampler(_device, _sampler, nullptr);
+    for (LayerImage &layer : _layers) {
+        for (uint32_t cascade = 0; cascade < SHADOW_CASCADE_COUNT; cascade++) {
+            vkDestroyFramebuffer(_device, layer.framebuffers[cascade], nullptr);
+            vkDestroyImageView(_device, layer.cascadeViews[cascade], nullptr);
+        }
+        vkDestroyImageView(_device, layer.arrayView, nullptr);
+        _memory->destroyImage(layer.image);
+    }
+    vkDestroyRenderPass(_device, _renderPass, nullptr);
+}
+
+void CascadedShadows::update(const glm::mat4 &view, float fovY, float aspect, float znear,
+                             const glm::vec3 &sunDirection, const Aabb &casterBounds, GPUSceneData &sceneData) {
+    glm::vec3 direction = glm::normalize(sunDirection);
+    if (glm::dot(direction, _sunDirection) < LIGHT_CHANGE_COSINE) {
+        //light space looks along the sunlight, x and y span the shadow maps
+        glm::vec3 up = fabsf(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        _lightView = glm::lookAt(glm::vec3(0.0f), -direction, up);
+        _sunDirection = direction;
+        for (Cascade &cascade : _cascades) {
+            cascade.fitted = false;
+        }
+    }
+
+    //distances of the casters along the sunlight, every cascade's depth range has to hold them
+    glm::vec2 depthRange(0.0f, 1.0f);
+    if (casterBounds.minimum.x <= casterBounds.maximum.x) {
+        depthRange = glm::vec2(FLT_MAX, -FLT_MAX);
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 point(corner & 1 ? casterBounds.maximum.x : casterBounds.minimum.x,
+                            corner & 2 ? casterBounds.maximum.y : casterBounds.minimum.y,
+                            corner & 4 ? casterBounds.maximum.z : casterBounds.minimum.z);
+            float depth = -(_lightView * glm::vec4(point, 1.0f)).z;
+            depthRange.x = glm::min(depthRange.x, depth);
+            depthRange.y = glm::max(depthRange.y, depth);
+        }
+    }
+
+    glm::mat4 inverseView = glm::inverse(view);
+    float tanHalfFov = tanf(fovY * 0.5f);
+    float sliceNear = znear;
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        float fraction = (float) (i + 1) / (float) SHADOW_CASCADE_COUNT;
+        float logSplit = znear * powf(_shadowDistance / znear, fraction);
+        float uniformSplit = znear + (_shadowDistance - znear) * fraction;
+        float sliceFar = SPLIT_LAMBDA * logSplit + (1.0f - SPLIT_LAMBDA) * uniformSplit;
+
+        //bounding sphere of the slice around its corner centroid, turning the camera moves it but keeps the radius
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (int corner = 0; corner < 8; corner++) {
+            float depth = corner & 4 ? sliceFar : sliceNear;
+            glm::vec3 point((corner & 1 ? 1.0f : -1.0f) * depth * tanHalfFov * aspect,
+                            (corner & 2 ? 1.0f : -1.0f) * depth * tanHalfFov, -depth);
+            corners[corner] = glm::vec3(inverseView * glm::vec4(point, 1.0f));
+            center += corners[corner];
+        }
+        center /= 8.0f;
+        float radius = 0.0f;
+        for (const glm::vec3 &corner : corners) {
+            radius = glm::max(radius, glm::length(corner - center));
+        }
+
+        //the cached fit stays while the slice and the casters are still inside it
+        Cascade &cascade = _cascades[i];
+        glm::vec2 lightCenter = glm::vec2(_lightView * glm::vec4(center, 1.0f));
+        bool covered = cascade.fitted && glm::length(lightCenter - cascade.center) + radius <= cascade.radius &&
+                       depthRange.x >= cascade.nearDepth && depthRange.y <= cascade.farDepth;
+        if (!covered) {
+            fitCascade(cascade, lightCenter, radius * (1.0f + CACHE_MARGIN), depthRange);
+        }
+
+        sceneData.shadowMatrices[i] = cascade.viewProjection;
+        sceneData.cascadeSplits[i] = sliceFar;
+        sceneData.cascadeTexelSizes[i] = texelSize(i);
+        sceneData.cascadeDynamic[i] = 0.0f;
+        sliceNear = sliceFar;
+    }
+}
+
+void CascadedShadows::fitCascade(Cascade &cascade, const glm::vec2 &center, float radius,
+                                 const glm::vec2 &depthRange) {
+    //whole texel steps, so a refit doesn't make static shadow edges crawl
+    float texel = 2.0f * radius / (float) _mapSize;
+    cascade.center = glm::floor(center / texel) * texel;
+    cascade.radius = radius;
+
+    //slack along the sunlight too, so moving casters don't refit every frame
+    float padding = (depthRange.y - depthRange.x) * CACHE_MARGIN + 1.0f;
+    cascade.nearDepth = depthRange.x - padding;
+    cascade.farDepth = depthRange.y + padding;
+
+    //orthographic projection into vulkan's [0, 1] depth range, the near end of the casters maps to 0
+    float depthScale = 1.0f / (cascade.farDepth - cascade.nearDepth);
+    glm::mat4 projection(1.0f);
+    projection[0][0] = 1.0f / cascade.radius;
+    projection[1][1] = 1.0f / cascade.radius;
+    projection[2][2] = -depthScale;
+    projection[3][0] = -cascade.center.x / cascade.radius;
+    projection[3][1] = -cascade.center.y / cascade.radius;
+    projection[3][2] = -cascade.nearDepth * depthScale;
+
+    cascade.viewProjection = projection * _lightView;
+    cascade.frustum = Frustum::fromViewProjection(cascade.viewProjection);
+    cascade.fitted = true;
+    cascade.staticValid = false;
+}
+
+void CascadedShadows::setDynamicCasters(uint32_t cascade, bool hasCasters, GPUSceneData &sceneData) {
+    sceneData.cascadeDynamic[cascade] = hasCasters ? 1.0f : 0.0f;
+}
+
+void CascadedShadows::beginLayer(VkCommandBuffer cmd, uint32_t cascade, ShadowLayer layer) {
+    _activeCascade = cascade;
+    _activeLayer = layer;
+
+    VkClearValue depthClear;
+    depthClear.depthStencil.depth = 1.0f;
+    depthClear.depthStencil.stencil = 0;
+
+    VkRenderPassBeginInfo rpInfo = {};
+    rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rpInfo.pNext = nullptr;
+    rpInfo.renderPass = _renderPass;
+    rpInfo.renderArea.offset.x = 0;
+    rpInfo.renderArea.offset.y = 0;
+    rpInfo.renderArea.extent = {_mapSize, _mapSize};
+    rpInfo.framebuffer = _layers[layer].framebuffers[cascade];
+    rpInfo.clearValueCount = 1;
+    rpInfo.pClearValues = &depthClear;
+    vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline);
+    vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4),
+                       &_cascades[cascade].viewProjection);
+}
+
+void CascadedShadows::endLayer(VkCommandBuffer cmd) {
+    vkCmdEndRenderPass(cmd);
+    if (_activeLayer == SHADOW_LAYER_STATIC) {
+        _cascades[_activeCascade].staticValid = true;
+        _staticRefreshes++;
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef VULKAN_STEP_BY_STEP_VK_SHADOWS_H
+#define VULKAN_STEP_BY_STEP_VK_SHADOWS_H
+
+#include <vulkan/vulkan.h>
+#include "vk_types.h"
+#include "bounds.h"
+#include "vk_memory.h"
+
+enum ShadowLayer {
+    //casters that never move, rendered once and kept until the cascade is refitted
+    SHADOW_LAYER_STATIC,
+    //everything else, rendered again every frame it has casters
+    SHADOW_LAYER_DYNAMIC,
+    SHADOW_LAYER_COUNT
+};
+
+//cascaded shadow maps for the sun with a cached static layer. every cascade covers a slice of the view frustum
+//from a light space square that is larger than the slice and stays put while the slice moves around inside it,
+//so the static casters only have to be drawn again when the camera leaves that square, the sun turns or the
+//casters outgrow the cached depth range. dynamic casters go into a second layer the shaders combine with the
+//first one
+class CascadedShadows {
+public:
+    //how much larger than its view frustum slice a cascade is fitted, the room the camera has before a refit
+    static constexpr float CACHE_MARGIN = 0.25f;
+    //cosine of the sun rotation that refits every cascade, about half a degree
+    static constexpr float LIGHT_CHANGE_COSINE = 0.99996f;
+    //blend between logarithmic and uniform cascade splits
+    static constexpr float SPLIT_LAMBDA = 0.75f;
+
+    //casterShader may be VK_NULL_HANDLE, then only the maps are created for the lit shaders to bind and
+    //beginLayer must not be called
+    void init(VkDevice device, VmaAllocator allocator, GpuMemory &memory, uint32_t mapSize, float shadowDistance,
+              VkShaderModule casterShader, VkDescriptorSetLayout objectSetLayout);
+
+    //moves both layers into SHADER_READ_ONLY_OPTIMAL, record once before the first frame
+    void recordInitialization(VkCommandBuffer cmd);
+
+    void cleanup();
+
+    //fits the cascades to the camera, refits the ones the camera left and fills the shadow part of sceneData.
+    //sunDirection points towards the sun, casterBounds has to contain every caster
+    void update(const glm::mat4 &view, float fovY, float aspect, float znear, const glm::vec3 &sunDirection,
+                const Aabb &casterBounds, GPUSceneData &sceneData);
+
+    //true until the static layer has been drawn for the cascade's current fit
+    bool staticLayerStale(uint32_t cascade) const { return !_cascades[cascade].staticValid; }
+
+    //has to be told before the scene data is uploaded, the shaders skip a dynamic layer that was not drawn
+    void setDynamicCasters(uint32_t cascade, bool hasCasters, GPUSceneData &sceneData);
+
+    const Frustum &cascadeFrustum(uint32_t cascade) const { return _cascades[cascade].frustum; }
+
+    //world size of one shadow texel, casters can use detail levels with errors below it
+    float texelSize(uint32_t cascade) const { return 2.0f * _cascades[cascade].radius / (float) _mapSize; }
+
+    //clears the layer of the cascade and binds the caster pipeline. draws use pipelineLayout() with the object set
+    //at set 0, firstInstance is the object index and the vertex stream is Mesh::_positionBuffer
+    void beginLayer(VkCommandBuffer cmd, uint32_t cascade, ShadowLayer layer);
+
+    void endLayer(VkCommandBuffer cmd);
+
+    VkPipelineLayout pipelineLayout() const { return _pipelineLayout; }
+
+    VkImageView layerView(ShadowLayer layer) const { return _layers[layer].arrayView; }
+
+    //depth compare sampler, outside the map everything is lit
+    VkSampler sampler() const { return _sampler; }
+
+    uint32_t mapSize() const { return _mapSize; }
+
+    //static layers drawn since init, one per cascade refit
+    uint32_t staticRefreshes() const { return _staticRefreshes; }
+
+private:
+    struct Cascade {
+        glm::mat4 viewProjection{1.0f};
+        Frustum frustum;
+        //light space square the cascade covers, snapped to whole texels
+        glm::vec2 center{0.0f};
+        float radius = 0.0f;
+        //light space depth range, distances along the sun direction
+        float nearDepth = 0.0f;
+        float farDepth = 0.0f;
+        bool fitted = false;
+        bool staticValid = false;
+    };
+
+    struct LayerImage {
+        AllocatedImage image = {};
+        VkImageView arrayView = VK_NULL_HANDLE;
+        VkImageView cascadeViews[SHADOW_CASCADE_COUNT] = {};
+        VkFramebuffer framebuffers[SHADOW_CASCADE_COUNT] = {};
+    };
+
+    void createLayers();
+
+    void createRenderPass();
+
+    void createPipeline(VkShaderModule casterShader, VkDescriptorSetLayout objectSetLayout);
+
+    //refits the cascade around a light space sphere, depthRange is the caster extent along the sun direction
+    void fitCascade(Cascade &cascade, const glm::vec2 &center, float radius, const glm::vec2 &depthRange);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    GpuMemory *_memory = nullptr;
+    uint32_t _mapSize = 0;
+    float _shadowDistance = 0.0f;
+
+    LayerImage _layers[SHADOW_LAYER_COUNT];
+    VkRenderPass _renderPass = VK_NULL_HANDLE;
+    VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline _pipeline = VK_NULL_HANDLE;
+    VkSampler _sampler = VK_NULL_HANDLE;
+
+    Cascade _cascades[SHADOW_CASCADE_COUNT];
+    //the rotation the cascades were fitted with, a new one invalidates all of them
+    glm::mat4 _lightView{1.0f};
+    glm::vec3 _sunDirection{0.0f};
+
+    //the layer between beginLayer and endLayer
+    uint32_t _activeCascade = 0;
+    ShadowLayer _activeLayer = SHADOW_LAYER_STATIC;
+    uint32_t _staticRefreshes = 0;
+};
+
+#endif //VULKAN_STEP_BY_STEP_VK_SHADOWS_H
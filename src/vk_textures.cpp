@@ -1,47 +1,21 @@
 #include "vk_textures.h"
+#include <cstring>
+#include <functional>
 #include <iostream>
 
 #include "vk_initializers.h"
-
-#define STB_IMAGE_IMPLEMENTATION
+#include "texture_decode.h"
 
 #include <stb_image.h>
 
-bool vkutil::loadImageFromFile(VulkanEngine &engine, const char *file, AllocatedImage &outImage) {
-    int texWidth, texHeight, texChannels;
-
-    stbi_uc *pixels = stbi_load(file, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+//staging memory a parallel texture load fills before it submits the copies, a larger file gets a batch to itself
+static const VkDeviceSize TEXTURE_BATCH_BYTES = 256ull << 20;
 
-    if (!pixels) {
-        std::cout << "Failed to load texture file " << file << std::endl;
-        return false;
-    }
-
-    void *pixelPtr = pixels;
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-    VkFormat imageFormat = VK_FORMAT_R8G8B8A8_SRGB;
-
-    AllocatedBuffer stagingBuffer = engine.createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                                        VMA_MEMORY_USAGE_CPU_ONLY);
-
-    void *data;
-    vmaMapMemory(engine._allocator, stagingBuffer._allocation, &data);
-
-    memcpy(data, pixelPtr, static_cast<size_t>(imageSize));
-
-    vmaUnmapMemory(engine._allocator, stagingBuffer._allocation);
-
-    stbi_image_free(pixels);
-
-    VkExtent3D imageExtent;
-    imageExtent.width = static_cast<uint32_t>(texWidth);
-    imageExtent.height = static_cast<uint32_t>(texHeight);
-    imageExtent.depth = 1;
-
-    VkImageCreateInfo dimgInfo = vkinit::imageCreateInfo(imageFormat,
+//a sampled RGBA8 image the size of extent, tracked as MEMORY_TEXTURE
+static AllocatedImage createTextureImage(VulkanEngine &engine, VkExtent3D extent) {
+    VkImageCreateInfo dimgInfo = vkinit::imageCreateInfo(VK_FORMAT_R8G8B8A8_SRGB,
                                                           VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-                                                         imageExtent);
+                                                         extent);
 
     AllocatedImage newImage;
 
@@ -49,65 +23,220 @@ bool vkutil::loadImageFromFile(VulkanEngine &engine, const char *file, Allocated
     dimgAllocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
     vmaCreateImage(engine._allocator, &dimgInfo, &dimgAllocinfo, &newImage._image, &newImage._allocation, nullptr);
+    engine._gpuMemory.track(newImage._allocation, MEMORY_TEXTURE);
+    return newImage;
+}
+
+//copies the texels at bufferOffset of the staging buffer into image and leaves it ready for sampling
+static void recordImageUpload(VkCommandBuffer cmd, VkBuffer stagingBuffer, VkDeviceSize bufferOffset, VkImage image,
+                              VkExtent3D extent) {
+    VkImageSubresourceRange range;
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel = 0;
+    range.levelCount = 1;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+
+    VkImageMemoryBarrier imageBarrier_toTransfer = {};
+    imageBarrier_toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+
+    imageBarrier_toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageBarrier_toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier_toTransfer.image = image;
+    imageBarrier_toTransfer.subresourceRange = range;
+
+    imageBarrier_toTransfer.srcAccessMask = 0;
+    imageBarrier_toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &imageBarrier_toTransfer);
+
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.bufferOffset = bufferOffset;
+    copyRegion.bufferRowLength = 0;
+    copyRegion.bufferImageHeight = 0;
+
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel = 0;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageExtent = extent;
+
+    vkCmdCopyBufferToImage(cmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+    VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
+
+    imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &imageBarrier_toReadable);
+}
+
+static VkExtent3D imageExtent(uint32_t width, uint32_t height) {
+    VkExtent3D extent;
+    extent.width = width;
+    extent.height = height;
+    extent.depth = 1;
+    return extent;
+}
+
+//creates an RGBA8 image whose texels fill writes into the mapped staging buffer, false when fill fails
+static bool uploadImage(VulkanEngine &engine, uint32_t texWidth, uint32_t texHeight,
+                        const std::function<bool(void *)> &fill, AllocatedImage &outImage) {
+    VkDeviceSize imageSize = (VkDeviceSize) texWidth * texHeight * 4;
 
-    engine.immediateSubmit([&](VkCommandBuffer cmd) {
-        VkImageSubresourceRange range;
-        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        range.baseMipLevel = 0;
-        range.levelCount = 1;
-        range.baseArrayLayer = 0;
-        range.layerCount = 1;
-
-        VkImageMemoryBarrier imageBarrier_toTransfer = {};
-        imageBarrier_toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-
-        imageBarrier_toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageBarrier_toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageBarrier_toTransfer.image = newImage._image;
-        imageBarrier_toTransfer.subresourceRange = range;
-
-        imageBarrier_toTransfer.srcAccessMask = 0;
-        imageBarrier_toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    AllocatedBuffer stagingBuffer = engine.createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                        VMA_MEMORY_USAGE_CPU_ONLY, MEMORY_STAGING);
 
-        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
-                             nullptr, 1, &imageBarrier_toTransfer);
+    void *data;
+    vmaMapMemory(engine._allocator, stagingBuffer._allocation, &data);
 
-        VkBufferImageCopy copyRegion = {};
-        copyRegion.bufferOffset = 0;
-        copyRegion.bufferRowLength = 0;
-        copyRegion.bufferImageHeight = 0;
+    bool filled = fill(data);
 
-        copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        copyRegion.imageSubresource.mipLevel = 0;
-        copyRegion.imageSubresource.baseArrayLayer = 0;
-        copyRegion.imageSubresource.layerCount = 1;
-        copyRegion.imageExtent = imageExtent;
+    vmaUnmapMemory(engine._allocator, stagingBuffer._allocation);
 
-        vkCmdCopyBufferToImage(cmd, stagingBuffer._buffer, newImage._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                               &copyRegion);
+    if (!filled) {
+        engine._gpuMemory.destroyBuffer(stagingBuffer);
+        return false;
+    }
 
-        VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
+    VkExtent3D extent = imageExtent(texWidth, texHeight);
+    AllocatedImage newImage = createTextureImage(engine, extent);
 
-        imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    engine.immediateSubmit([&](VkCommandBuffer cmd) {
+        recordImageUpload(cmd, stagingBuffer._buffer, 0, newImage._image, extent);
+    });
 
-        imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    engine._gpuMemory.destroyBuffer(stagingBuffer);
 
-        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
-                             0, nullptr, 1, &imageBarrier_toReadable);
-    });
+    outImage = newImage;
+    return true;
+}
 
+bool vkutil::loadImageFromFile(VulkanEngine &engine, const char *file, AllocatedImage &outImage) {
+    ImageDecodeJob job;
+    job.file = file;
+    //decoded straight into staging memory
+    bool loaded = readImageSize(job) && uploadImage(engine, job.width, job.height, [&](void *data) {
+        job.destination = (uint8_t *) data;
+        return decodeImage(job);
+    }, outImage);
+
+    if (!loaded) {
+        std::cout << "Failed to load texture file " << file << std::endl;
+        return false;
+    }
+    std::cout << "Texture loaded succesfully " << file << std::endl;
+    return true;
+}
+
+void vkutil::loadImagesFromFiles(VulkanEngine &engine, const std::vector<std::string> &files, uint32_t workerCount,
+                                 std::vector<AllocatedImage> &outImages) {
+    std::vector<ImageDecodeJob> jobs(files.size());
+    outImages.assign(files.size(), AllocatedImage{VK_NULL_HANDLE, VK_NULL_HANDLE});
+    for (size_t i = 0; i < files.size(); i++) {
+        jobs[i].file = files[i];
+        if (!readImageSize(jobs[i])) {
+            std::cout << "Failed to load texture file " << files[i] << std::endl;
+        }
+    }
 
-    engine._mainDeletionQueue.push_function([=]() {
+    //one staging buffer, one parallel decode and one submit per batch of files
+    size_t first = 0;
+    while (first < jobs.size()) {
+        VkDeviceSize batchSize = 0;
+        size_t end = first;
+        while (end < jobs.size()) {
+            VkDeviceSize imageSize = (VkDeviceSize) jobs[end].width * jobs[end].height * 4;
+            if (end > first && batchSize + imageSize > TEXTURE_BATCH_BYTES) {
+                break;
+            }
+            batchSize += imageSize;
+            end++;
+        }
+        if (batchSize == 0) {
+            first = end;
+            continue;
+        }
+
+        AllocatedBuffer stagingBuffer = engine.createBuffer(batchSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                            VMA_MEMORY_USAGE_CPU_ONLY, MEMORY_STAGING);
+        void *data;
+        vmaMapMemory(engine._allocator, stagingBuffer._allocation, &data);
+        std::vector<ImageDecodeJob> batch(jobs.begin() + first, jobs.begin() + end);
+        std::vector<VkDeviceSize> offsets(batch.size());
+        VkDeviceSize offset = 0;
+        for (size_t i = 0; i < batch.size(); i++) {
+            offsets[i] = offset;
+            batch[i].destination = (uint8_t *) data + offset;
+            offset += (VkDeviceSize) batch[i].width * batch[i].height * 4;
+        }
+        decodeImages(batch, workerCount);
+        vmaUnmapMemory(engine._allocator, stagingBuffer._allocation);
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (batch[i].decoded) {
+                outImages[first + i] = createTextureImage(engine, imageExtent(batch[i].width, batch[i].height));
+                std::cout << "Texture loaded succesfully " << batch[i].file << std::endl;
+            } else if (batch[i].width > 0) {
+                std::cout << "Failed to load texture file " << batch[i].file << std::endl;
+            }
+        }
+        engine.immediateSubmit([&](VkCommandBuffer cmd) {
+            for (size_t i = 0; i < batch.size(); i++) {
+                if (batch[i].decoded) {
+                    recordImageUpload(cmd, stagingBuffer._buffer, offsets[i], outImages[first + i]._image,
+                                      imageExtent(batch[i].width, batch[i].height));
+                }
+            }
+        });
+        engine._gpuMemory.destroyBuffer(stagingBuffer);
+        first = end;
+    }
+}
 
-        vmaDestroyImage(engine._allocator, newImage._image, newImage._allocation);
-    });
+bool vkutil::loadImageFromMemory(VulkanEngine &engine, const uint8_t *data, size_t size, AllocatedImage &outImage) {
+    int texWidth, texHeight, texChannels;
 
-    vmaDestroyBuffer(engine._allocator, stagingBuffer._buffer, stagingBuffer._allocation);
+    stbi_uc *pixels = stbi_load_from_memory(data, (int) size, &texWidth, &texHeight, &texChannels, 0);
 
-    std::cout << "Texture loaded succesfully " << file << std::endl;
+    if (!pixels) {
+        std::cout << "Failed to decode embedded texture: " << stbi_failure_reason() << std::endl;
+        return false;
+    }
 
-    outImage = newImage;
+    uploadImage(engine, (uint32_t) texWidth, (uint32_t) texHeight, [&](void *staging) {
+        expandToRgba(pixels, (uint32_t) texChannels, (size_t) texWidth * texHeight, (uint8_t *) staging);
+        return true;
+    }, outImage);
+    stbi_image_free(pixels);
+    return true;
+}
+
+bool vkutil::createSolidImage(VulkanEngine &engine, uint32_t rgba, AllocatedImage &outImage) {
+    return uploadImage(engine, 1, 1, [&](void *staging) {
+        memcpy(staging, &rgba, sizeof(rgba));
+        return true;
+    }, outImage);
+}
+
+bool vkutil::loadImageFromArchive(VulkanEngine &engine, const AssetArchive &archive, const ArchiveEntry &entry,
+                                  AllocatedImage &outImage) {
+    if (entry.type != ARCHIVE_TEXTURE || entry.width == 0 ||
+        entry.size != (uint64_t) entry.width * entry.height * 4) {
+        std::cout << "Archived texture has no RGBA8 texels" << std::endl;
+        return false;
+    }
+    //the texels are already decoded, a stored blob is a single copy from the mapping into staging
+    if (!uploadImage(engine, entry.width, entry.height, [&](void *data) {
+        return archive.read(entry, data);
+    }, outImage)) {
+        std::cout << "Archived texture is corrupt" << std::endl;
+        return false;
+    }
     return true;
-}
\ No newline at end of file
+}
@@ -2,9 +2,26 @@
 
 #include "vk_types.h"
 #include "VulkanEngine.h"
+#include "asset_archive.h"
 
 namespace vkutil {
 
+    //the image is tracked as MEMORY_TEXTURE, the caller releases it with engine._gpuMemory.destroyImage
     bool loadImageFromFile(VulkanEngine &engine, const char *file, AllocatedImage &outImage);
 
+    //decodes the files on workerCount threads (0 uses one per core) straight into staging memory and uploads them
+    //with one submit per batch. outImages[i] has a null _image when files[i] can't be loaded
+    void loadImagesFromFiles(VulkanEngine &engine, const std::vector<std::string> &files, uint32_t workerCount,
+                             std::vector<AllocatedImage> &outImages);
+
+    //the same for an encoded image already in memory, like those stored inside a .glb
+    bool loadImageFromMemory(VulkanEngine &engine, const uint8_t *data, size_t size, AllocatedImage &outImage);
+
+    //a 1x1 image of one RGBA8 colour, with red in the lowest byte
+    bool createSolidImage(VulkanEngine &engine, uint32_t rgba, AllocatedImage &outImage);
+
+    //raw RGBA8 texels baked by the asset packer, read straight from the mounted archive into staging memory
+    bool loadImageFromArchive(VulkanEngine &engine, const AssetArchive &archive, const ArchiveEntry &entry,
+                              AllocatedImage &outImage);
+
 }
\ No newline at end of file
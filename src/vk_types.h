@@ -3,6 +3,7 @@
 
 #include <vk_mem_alloc.h>
 #include <glm.hpp>
+#include "residency.h"
 
 struct AllocatedBuffer {
     VkBuffer _buffer;
@@ -25,22 +26,36 @@ struct GPUCameraData{
     glm::mat4 viewproj;
 };
 
+//sun shadow cascades, the lit shaders loop over this many
+const uint32_t SHADOW_CASCADE_COUNT = 4;
+
 struct GPUSceneData {
     glm::vec4 fogColor;
     glm::vec4 fogDistances;
     glm::vec4 ambientColor;
+    //xyz points towards the sun, w is the ambient term of the lit materials
     glm::vec4 sunlightDirection;
+    //rgb times the intensity in w
     glm::vec4 sunlightColor;
+    //world to shadow map transform of every cascade, x and y in [-1, 1], depth in [0, 1]
+    glm::mat4 shadowMatrices[SHADOW_CASCADE_COUNT];
+    //view depth where each cascade ends
+    glm::vec4 cascadeSplits;
+    //world size of a shadow texel per cascade, the normal offset that keeps surfaces from shadowing themselves
+    glm::vec4 cascadeTexelSizes;
+    //1 where the dynamic layer of the cascade was drawn this frame, it holds stale depth otherwise
+    glm::vec4 cascadeDynamic;
 };
 
 struct FrameData {
     VkSemaphore _presentSemaphore, _renderSemaphore;
-    VkFence _renderFence;
+    //value the frame timeline semaphore reaches once this frame's last submission has finished
+    uint64_t _timelineValue;
 
     VkCommandPool _commandPool;
     VkCommandBuffer _mainCommandBuffer;
 
-    AllocatedBuffer cameraBuffer;
+    //camera and scene data come from the frame ring buffer through dynamic offsets
     VkDescriptorSet globalDescriptor;
 
     AllocatedBuffer objectBuffer;
@@ -60,6 +75,7 @@ struct GPUObjectData{
 struct Texture {
     AllocatedImage image;
     VkImageView imageView;
+    uint32_t residencyId = INVALID_RESIDENCY_ID;
 };
 
 
@@ -0,0 +1,390 @@
+#include "vk_virtual_texture.h"
+#include "vk_initializers.h"
+#include <stb_image.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+
+static const VkFormat CACHE_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+//a page table entry without a cache slot, matches INVALID_PAGE in textured_lit_vt.frag
+static const uint32_t INVALID_PAGE = ~0u;
+static const VkDeviceSize PAGE_BYTES = VirtualTexture::PAGE_SIZE * VirtualTexture::PAGE_SIZE * 4;
+
+bool VirtualTexture::init(VkDevice device, VmaAllocator allocator, GpuMemory &memory, uint32_t framesInFlight,
+                          const char *file, uint32_t cacheSize) {
+    _device = device;
+    _allocator = allocator;
+    _memory = &memory;
+    _framesInFlight = framesInFlight;
+
+    int width, height, channels;
+    stbi_uc *pixels = stbi_load(file, &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels) {
+        std::cout << "Failed to load virtual texture " << file << std::endl;
+        return false;
+    }
+    buildLevels(pixels, (uint32_t) width, (uint32_t) height);
+    stbi_image_free(pixels);
+
+    //room for the pinned coarsest page and at least one more
+    _cachePages = std::max(cacheSize / PAGE_SIZE, 2u);
+    _cacheSize = _cachePages * PAGE_SIZE;
+    _slotEntries.assign(_cachePages * _cachePages, INVALID_PAGE);
+    _slotLastWanted.assign(_cachePages * _cachePages, -1);
+
+    size_t tableSize = sizeof(GPUVirtualTextureHeader) + sizeof(uint32_t) * _entries.size();
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        FrameResources &frame = _frames[i];
+        frame.pageTable = createMappedBuffer(tableSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                             VMA_MEMORY_USAGE_CPU_TO_GPU, MEMORY_FRAME_DATA,
+                                             (void **) &frame.mappedPageTable);
+        frame.feedback = createMappedBuffer(sizeof(uint32_t) * _entries.size(),
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                            VMA_MEMORY_USAGE_GPU_TO_CPU, MEMORY_FRAME_DATA,
+                                            (void **) &frame.mappedFeedback);
+        frame.staging = createMappedBuffer(PAGE_BYTES * UPLOADS_PER_FRAME, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                           VMA_MEMORY_USAGE_CPU_ONLY, MEMORY_STAGING, (void **) &frame.mappedStaging);
+        frame.tableVersion = ~0u;
+        frame.frameNumber = -1;
+    }
+
+    createCache();
+    createDescriptors();
+
+    std::cout << "Virtual texture " << file << " of " << width << "x" << height << " in " << _levels.size()
+              << " levels and " << _entries.size() << " pages of " << PAGE_SIZE << "x" << PAGE_SIZE << ", "
+              << _cachePages * _cachePages << " of them fit the cache" << std::endl;
+    return true;
+}
+
+void VirtualTexture::buildLevels(const uint8_t *pixels, uint32_t width, uint32_t height) {
+    Level finest;
+    finest.width = width;
+    finest.height = height;
+    finest.texels.assign(pixels, pixels + (size_t) width * height * 4);
+    _levels.push_back(finest);
+
+    //down to a level that fits one page, that one is always resident
+    while ((_levels.back().width > PAGE_SIZE || _levels.back().height > PAGE_SIZE) && _levels.size() < MAX_LEVELS) {
+        const Level &source = _levels.back();
+        Level level;
+        level.width = std::max(source.width / 2, 1u);
+        level.height = std::max(source.height / 2, 1u);
+        level.texels.resize((size_t) level.width * level.height * 4);
+        //2x2 box filter on the sRGB values, odd sizes repeat their last row and column
+        for (uint32_t y = 0; y < level.height; y++) {
+            uint32_t y0 = std::min(2 * y, source.height - 1);
+            uint32_t y1 = std::min(2 * y + 1, source.height - 1);
+            for (uint32_t x = 0; x < level.width; x++) {
+                uint32_t x0 = std::min(2 * x, source.width - 1);
+                uint32_t x1 = std::min(2 * x + 1, source.width - 1);
+                for (uint32_t c = 0; c < 4; c++) {
+                    uint32_t sum = source.texels[((size_t) y0 * source.width + x0) * 4 + c] +
+                                   source.texels[((size_t) y0 * source.width + x1) * 4 + c] +
+                                   source.texels[((size_t) y1 * source.width + x0) * 4 + c] +
+                                   source.texels[((size_t) y1 * source.width + x1) * 4 + c];
+                    level.texels[((size_t) y * level.width + x) * 4 + c] = (uint8_t) ((sum + 2) / 4);
+                }
+            }
+        }
+        _levels.push_back(level);
+    }
+
+    _header.size = glm::uvec4(width, height, (uint32_t) _levels.size(), 0);
+    uint32_t entryCount = 0;
+    for (uint32_t i = 0; i < _levels.size(); i++) {
+        uint32_t pagesX = (_levels[i].width + PAGE_SIZE - 1) / PAGE_SIZE;
+        uint32_t pagesY = (_levels[i].height + PAGE_SIZE - 1) / PAGE_SIZE;
+        _header.levels[i] = glm::uvec4(pagesX, pagesY, entryCount, 0);
+        entryCount += pagesX * pagesY;
+        _entryLevels.insert(_entryLevels.end(), pagesX * pagesY, i);
+        _textureBytes += (VkDeviceSize) _levels[i].width * _levels[i].height * 4;
+    }
+    _entries.assign(entryCount, INVALID_PAGE);
+}
+
+AllocatedBuffer VirtualTexture::createMappedBuffer(size_t size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+                                                   MemoryCategory category, void **outMapped) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = nullptr;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = memoryUsage;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    AllocatedBuffer buffer;
+    VmaAllocationInfo allocationInfo;
+    if (vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation,
+                        &allocationInfo) != VK_SUCCESS) {
+        std::cout << "Failed to create a virtual texture buffer of " << size << " bytes" << std::endl;
+        abort();
+    }
+    _memory->track(buffer._allocation, category);
+    *outMapped = allocationInfo.pMappedData;
+    return buffer;
+}
+
+void VirtualTexture::createCache() {
+    VkExtent3D extent = {_cacheSize, _cacheSize, 1};
+    VkImageCreateInfo imageInfo = vkinit::imageCreateInfo(CACHE_FORMAT, VK_IMAGE_USAGE_SAMPLED_BIT |
+                                                                        VK_IMAGE_USAGE_TRANSFER_DST_BIT, extent);
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    if (vmaCreateImage(_allocator, &imageInfo, &allocInfo, &_cache._image, &_cache._allocation, nullptr) !=
+        VK_SUCCESS) {
+        std::cout << "Failed to create the virtual texture cache" << std::endl;
+        abort();
+    }
+    _memory->track(_cache._allocation, MEMORY_TEXTURE);
+
+    VkImageViewCreateInfo viewInfo = vkinit::imageviewCreateInfo(CACHE_FORMAT, _cache._image,
+                                                                 VK_IMAGE_ASPECT_COLOR_BIT);
+    vkCreateImageView(_device, &viewInfo, nullptr, &_cacheView);
+
+    //the shader fetches texels directly, the sampler is only there for the combined descriptor
+    VkSamplerCreateInfo samplerInfo = vkinit::samplerCreateInfo(VK_FILTER_NEAREST);
+    vkCreateSampler(_device, &samplerInfo, nullptr, &_sampler);
+}
+
+void VirtualTexture::createDescriptors() {
+    VkDescriptorSetLayoutBinding bindings[] = {
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                               VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+            vkinit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2)
+    };
+    VkDescriptorSetLayoutCreateInfo setInfo = {};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setInfo.pNext = nullptr;
+    setInfo.flags = 0;
+    setInfo.bindingCount = 3;
+    setInfo.pBindings = bindings;
+    vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout);
+
+    std::vector<VkDescriptorPoolSize> sizes =
+            {
+                    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _framesInFlight},
+                    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * _framesInFlight}
+            };
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = 0;
+    poolInfo.maxSets = _framesInFlight;
+    poolInfo.poolSizeCount = (uint32_t) sizes.size();
+    poolInfo.pPoolSizes = sizes.data();
+    vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool);
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &_setLayout;
+
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        FrameResources &frame = _frames[i];
+        vkAllocateDescriptorSets(_device, &allocInfo, &frame.set);
+
+        VkDescriptorImageInfo cacheInfo = {_sampler, _cacheView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        VkDescriptorBufferInfo pageTableInfo = {frame.pageTable._buffer, 0, VK_WHOLE_SIZE};
+        VkDescriptorBufferInfo feedbackInfo = {frame.feedback._buffer, 0, VK_WHOLE_SIZE};
+
+        VkWriteDescriptorSet writes[] = {
+                vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frame.set, &cacheInfo, 0),
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.set, &pageTableInfo, 1),
+                vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.set, &feedbackInfo, 2)
+        };
+        vkUpdateDescriptorSets(_device, 3, writes, 0, nullptr);
+    }
+}
+
+void VirtualTexture::recordInitialization(VkCommandBuffer cmd) {
+    uint32_t coarsest = (uint32_t) _entries.size() - 1;
+    _copies.clear();
+    stagePage(_frames[0], 0, coarsest, 0, _copies);
+    //never replaced, findSlot skips it
+    _slotLastWanted[0] = INT64_MAX;
+    recordCopies(cmd, _frames[0].staging._buffer, _copies, VK_IMAGE_LAYOUT_UNDEFINED);
+}
+
+void VirtualTexture::cleanup() {
+    vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+    vkDestroySampler(_device, _sampler, nullptr);
+    vkDestroyImageView(_device, _cacheView, nullptr);
+    _memory->destroyImage(_cache);
+
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        _memory->destroyBuffer(_frames[i].pageTable);
+        _memory->destroyBuffer(_frames[i].feedback);
+        _memory->destroyBuffer(_frames[i].staging);
+    }
+}
+
+void VirtualTexture::beginFrame(VkCommandBuffer cmd, uint32_t frameIndex, int64_t frameNumber) {
+    FrameResources &frame = _frames[frameIndex];
+
+    _requests.clear();
+    int64_t wantedFrame = frame.frameNumber;
+    if (frame.frameNumber >= 0) {
+        vmaInvalidateAllocation(_allocator, frame.feedback._allocation, 0, VK_WHOLE_SIZE);
+        for (uint32_t entry = 0; entry < _entries.size(); entry++) {
+            if (frame.mappedFeedback[entry] == 0) {
+                continue;
+            }
+            uint32_t slot = _entries[entry];
+            if (slot == INVALID_PAGE) {
+                _requests.push_back(entry);
+            } else {
+                _slotLastWanted[slot] = std::max(_slotLastWanted[slot], frame.frameNumber);
+            }
+        }
+    }
+    frame.frameNumber = frameNumber;
+    vkCmdFillBuffer(cmd, frame.feedback._buffer, 0, VK_WHOLE_SIZE, 0);
+
+    //coarse levels first, they cover more of the screen and stand in for the finer pages still missing
+    std::sort(_requests.begin(), _requests.end(), std::greater<uint32_t>());
+    _copies.clear();
+    for (uint32_t entry : _requests) {
+        if (_copies.size() == UPLOADS_PER_FRAME) {
+            break;
+        }
+        uint32_t slot = findSlot(wantedFrame);
+        if (slot == INVALID_PAGE) {
+            break;
+        }
+        stagePage(frame, (uint32_t) _copies.size(), entry, slot, _copies);
+        _slotLastWanted[slot] = wantedFrame;
+    }
+    if (!_copies.empty()) {
+        vmaFlushAllocation(_allocator, frame.staging._allocation, 0, VK_WHOLE_SIZE);
+        recordCopies(cmd, frame.staging._buffer, _copies, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        _pagesUploaded += (uint32_t) _copies.size();
+        _tableVersion++;
+    }
+
+    //the header changes every frame, the entries only when pages came or went
+    _header.size.w = (uint32_t) (frameNumber % (FEEDBACK_STRIDE * FEEDBACK_STRIDE));
+    memcpy(frame.mappedPageTable, &_header, sizeof(GPUVirtualTextureHeader));
+    if (frame.tableVersion != _tableVersion) {
+        memcpy(frame.mappedPageTable + sizeof(GPUVirtualTextureHeader), _entries.data(),
+               sizeof(uint32_t) * _entries.size());
+        frame.tableVersion = _tableVersion;
+    }
+    vmaFlushAllocation(_allocator, frame.pageTable._allocation, 0, VK_WHOLE_SIZE);
+
+    //the feedback reset has to land before the fragment shaders mark pages
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier,
+                         0, nullptr, 0, nullptr);
+}
+
+void VirtualTexture::endFrame(VkCommandBuffer cmd) {
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+}
+
+uint32_t VirtualTexture::findSlot(int64_t wantedFrame) {
+    uint32_t oldest = INVALID_PAGE;
+    for (uint32_t slot = 0; slot < _slotEntries.size(); slot++) {
+        if (_slotEntries[slot] == INVALID_PAGE) {
+            return slot;
+        }
+        if (_slotLastWanted[slot] < wantedFrame &&
+            (oldest == INVALID_PAGE || _slotLastWanted[slot] < _slotLastWanted[oldest])) {
+            oldest = slot;
+        }
+    }
+    return oldest;
+}
+
+void VirtualTexture::stagePage(FrameResources &frame, uint32_t index, uint32_t entry, uint32_t slot,
+                               std::vector<VkBufferImageCopy> &copies) {
+    //the frames still in flight have their own page tables, the copy waits for their fragment shaders
+    if (_slotEntries[slot] != INVALID_PAGE) {
+        _entries[_slotEntries[slot]] = INVALID_PAGE;
+        _residentPages--;
+    }
+    _slotEntries[slot] = entry;
+    _entries[entry] = slot;
+    _residentPages++;
+
+    uint32_t levelIndex = _entryLevels[entry];
+    const Level &level = _levels[levelIndex];
+    const glm::uvec4 &info = _header.levels[levelIndex];
+    uint32_t page = entry - info.z;
+    uint32_t firstX = (page % info.x) * PAGE_SIZE;
+    uint32_t firstY = (page / info.x) * PAGE_SIZE;
+    //pages on the right and bottom edge may be partial, the shader never fetches past the level
+    uint32_t width = level.width - firstX < PAGE_SIZE ? level.width - firstX : PAGE_SIZE;
+    uint32_t height = level.height - firstY < PAGE_SIZE ? level.height - firstY : PAGE_SIZE;
+
+    uint8_t *staging = frame.mappedStaging + PAGE_BYTES * index;
+    for (uint32_t y = 0; y < height; y++) {
+        memcpy(staging + (size_t) y * PAGE_SIZE * 4,
+               level.texels.data() + ((size_t) (firstY + y) * level.width + firstX) * 4, (size_t) width * 4);
+    }
+
+    VkBufferImageCopy copy = {};
+    copy.bufferOffset = PAGE_BYTES * index;
+    copy.bufferRowLength = PAGE_SIZE;
+    copy.bufferImageHeight = PAGE_SIZE;
+    copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.imageSubresource.mipLevel = 0;
+    copy.imageSubresource.baseArrayLayer = 0;
+    copy.imageSubresource.layerCount = 1;
+    copy.imageOffset = {(int32_t) ((slot % _cachePages) * PAGE_SIZE), (int32_t) ((slot / _cachePages) * PAGE_SIZE), 0};
+    copy.imageExtent = {width, height, 1};
+    copies.push_back(copy);
+}
+
+void VirtualTexture::recordCopies(VkCommandBuffer cmd, VkBuffer staging, const std::vector<VkBufferImageCopy> &copies,
+                                  VkImageLayout oldLayout) {
+    VkImageSubresourceRange range;
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel = 0;
+    range.levelCount = 1;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+
+    //earlier frames may still sample the slots that are about to be overwritten
+    VkImageMemoryBarrier toTransfer = {};
+    toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toTransfer.oldLayout = oldLayout;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.image = _cache._image;
+    toTransfer.subresourceRange = range;
+    toTransfer.srcAccessMask = 0;
+    toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &toTransfer);
+
+    vkCmdCopyBufferToImage(cmd, staging, _cache._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           (uint32_t) copies.size(), copies.data());
+
+    VkImageMemoryBarrier toReadable = toTransfer;
+    toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &toReadable);
+}
@@ -0,0 +1,140 @@
+#ifndef VULKAN_STEP_BY_STEP_VK_VIRTUAL_TEXTURE_H
+#define VULKAN_STEP_BY_STEP_VK_VIRTUAL_TEXTURE_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "vk_types.h"
+#include "engine_config.h"
+#include "vk_memory.h"
+
+//laid out like the head of PageTable in textured_lit_vt.frag, the page entries follow it
+struct GPUVirtualTextureHeader {
+    //width and height of the finest level, the level count and the pixel of a feedback block that writes this frame
+    glm::uvec4 size;
+    //pages along x and y and the first entry of every level
+    glm::uvec4 levels[16];
+};
+
+//a texture that only keeps the pages the camera needs on the GPU. the image and its mip chain stay on the CPU, cut
+//into square pages. the lit shader finds its texel through a page table, falls back to the finest resident level
+//and marks the page it wanted in a feedback buffer. the feedback is read back once the frame slot comes around
+//again, and the missing pages are copied into a fixed size cache image, replacing the least recently wanted ones.
+//GPU memory follows the size of the cache, which only has to cover what the screen shows
+class VirtualTexture {
+public:
+    //texels along each side of a page, matches PAGE_SIZE in textured_lit_vt.frag
+    static const uint32_t PAGE_SIZE = VIRTUAL_TEXTURE_PAGE_SIZE;
+    static const uint32_t MAX_LEVELS = 16;
+    //most pages copied into the cache per frame, the rest waits for the next feedback
+    static const uint32_t UPLOADS_PER_FRAME = 16;
+    //one pixel of every FEEDBACK_STRIDE x FEEDBACK_STRIDE block writes feedback, a different one each frame.
+    //matches FEEDBACK_STRIDE in textured_lit_vt.frag
+    static const uint32_t FEEDBACK_STRIDE = 4;
+
+    //decodes the image and builds its mip chain, nothing goes to the GPU yet. cacheSize is the side of the cache
+    //image in texels. false when the file can't be loaded
+    bool init(VkDevice device, VmaAllocator allocator, GpuMemory &memory, uint32_t framesInFlight, const char *file,
+              uint32_t cacheSize);
+
+    //uploads the coarsest level, which is a single page that stays resident so every lookup finds something.
+    //record once before the first frame
+    void recordInitialization(VkCommandBuffer cmd);
+
+    void cleanup();
+
+    //reads back the feedback this slot gathered last time, copies in the missing pages it asked for and updates
+    //the slot's page table. must be recorded outside a render pass
+    void beginFrame(VkCommandBuffer cmd, uint32_t frameIndex, int64_t frameNumber);
+
+    //the CPU reads the feedback once the slot comes around again, record after the passes that sample the texture
+    void endFrame(VkCommandBuffer cmd);
+
+    //set 2 of the virtual texture material: cache image, page table and feedback buffer
+    VkDescriptorSetLayout setLayout() const { return _setLayout; }
+
+    VkDescriptorSet descriptor(uint32_t frameIndex) const { return _frames[frameIndex].set; }
+
+    uint32_t residentPages() const { return _residentPages; }
+
+    uint32_t totalPages() const { return (uint32_t) _entries.size(); }
+
+    uint32_t pagesUploaded() const { return _pagesUploaded; }
+
+    VkDeviceSize cacheBytes() const { return (VkDeviceSize) _cacheSize * _cacheSize * 4; }
+
+    //the whole mip chain, what a fully resident texture would take
+    VkDeviceSize textureBytes() const { return _textureBytes; }
+
+private:
+    struct FrameResources {
+        AllocatedBuffer pageTable;
+        uint8_t *mappedPageTable = nullptr;
+        AllocatedBuffer feedback;
+        uint32_t *mappedFeedback = nullptr;
+        AllocatedBuffer staging;
+        uint8_t *mappedStaging = nullptr;
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        //_tableVersion the slot's page table was last written with
+        uint32_t tableVersion = ~0u;
+        int64_t frameNumber = -1;
+    };
+
+    struct Level {
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> texels;
+    };
+
+    AllocatedBuffer createMappedBuffer(size_t size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
+                                       MemoryCategory category, void **outMapped);
+
+    void buildLevels(const uint8_t *pixels, uint32_t width, uint32_t height);
+
+    void createCache();
+
+    void createDescriptors();
+
+    //cache slot for a new page, a free one or the least recently wanted one not asked for since wantedFrame. ~0u
+    //when every slot is still wanted
+    uint32_t findSlot(int64_t wantedFrame);
+
+    //copies the page into the staging buffer at index and records the copy into the slot
+    void stagePage(FrameResources &frame, uint32_t index, uint32_t entry, uint32_t slot,
+                   std::vector<VkBufferImageCopy> &copies);
+
+    void recordCopies(VkCommandBuffer cmd, VkBuffer staging, const std::vector<VkBufferImageCopy> &copies,
+                      VkImageLayout oldLayout);
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    GpuMemory *_memory = nullptr;
+    uint32_t _framesInFlight = 0;
+
+    std::vector<Level> _levels;
+    VkDeviceSize _textureBytes = 0;
+    GPUVirtualTextureHeader _header = {};
+    //level of every page table entry, and the cache slot holding its page or ~0u
+    std::vector<uint32_t> _entryLevels;
+    std::vector<uint32_t> _entries;
+    uint32_t _tableVersion = 0;
+    uint32_t _residentPages = 0;
+    uint32_t _pagesUploaded = 0;
+
+    uint32_t _cacheSize = 0;
+    uint32_t _cachePages = 0;
+    AllocatedImage _cache = {};
+    VkImageView _cacheView = VK_NULL_HANDLE;
+    VkSampler _sampler = VK_NULL_HANDLE;
+    //entry held by every cache slot and the last frame whose feedback wanted it
+    std::vector<uint32_t> _slotEntries;
+    std::vector<int64_t> _slotLastWanted;
+    std::vector<uint32_t> _requests;
+    std::vector<VkBufferImageCopy> _copies;
+
+    FrameResources _frames[MAX_FRAMES_IN_FLIGHT];
+
+    VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout _setLayout = VK_NULL_HANDLE;
+};
+
+#endif //VULKAN_STEP_BY_STEP_VK_VIRTUAL_TEXTURE_H
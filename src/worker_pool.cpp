@@ -0,0 +1,67 @@
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(uint32_t threadCount) : _nextJob(0) {
+    for (uint32_t i = 0; i < threadCount; i++) {
+        _threads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+    for (std::thread &thread : _threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::run(size_t jobCount, const std::function<void(size_t)> &job) {
+    if (_threads.empty() || jobCount <= 1) {
+        for (size_t i = 0; i < jobCount; i++) {
+            job(i);
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _job = &job;
+        _jobCount = jobCount;
+        _nextJob = 0;
+        _busy = (uint32_t) _threads.size();
+        _batch++;
+    }
+    _wake.notify_all();
+    takeJobs();
+
+    //the job lives on the caller's stack, no worker may still be looking at it when run returns
+    std::unique_lock<std::mutex> lock(_mutex);
+    _finished.wait(lock, [this]() { return _busy == 0; });
+    _job = nullptr;
+}
+
+void WorkerPool::workerLoop() {
+    uint64_t seenBatch = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [&]() { return _stopping || _batch != seenBatch; });
+            if (_stopping) {
+                return;
+            }
+            seenBatch = _batch;
+        }
+        takeJobs();
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (--_busy == 0) {
+            _finished.notify_one();
+        }
+    }
+}
+
+void WorkerPool::takeJobs() {
+    for (size_t i = _nextJob++; i < _jobCount; i = _nextJob++) {
+        (*_job)(i);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef VULKAN_STEP_BY_STEP_WORKER_POOL_H
+#define VULKAN_STEP_BY_STEP_WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//threads started once and parked between batches, for work that is split up every frame and too short to pay for
+//starting threads each time
+class WorkerPool {
+public:
+    //threadCount workers besides the thread calling run
+    explicit WorkerPool(uint32_t threadCount);
+
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    //calls job(index) for every index below jobCount on the workers and the calling thread, returns once all are done
+    void run(size_t jobCount, const std::function<void(size_t)> &job);
+
+    uint32_t threadCount() const { return (uint32_t) _threads.size(); }
+
+private:
+    void workerLoop();
+
+    void takeJobs();
+
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _finished;
+
+    const std::function<void(size_t)> *_job = nullptr;
+    size_t _jobCount = 0;
+    std::atomic<size_t> _nextJob;
+    //workers still in the current batch
+    uint32_t _busy = 0;
+    uint64_t _batch = 0;
+    bool _stopping = false;
+};
+
+#endif //VULKAN_STEP_BY_STEP_WORKER_POOL_H
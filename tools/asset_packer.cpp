@@ -0,0 +1,138 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include "asset_archive.h"
+#include "vk_mesh.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stb_image.h>
+
+static std::string extension(const std::string &path) {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return "";
+    }
+    std::string result = path.substr(dot + 1);
+    for (char &c : result) {
+        if (c >= 'A' && c <= 'Z') {
+            c = (char) (c - 'A' + 'a');
+        }
+    }
+    return result;
+}
+
+static bool isImage(const std::string &extension) {
+    return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" ||
+           extension == "bmp";
+}
+
+static bool readFile(const std::string &path, std::vector<uint8_t> &outBytes) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    outBytes.resize((size_t) ftell(file));
+    fseek(file, 0, SEEK_SET);
+    size_t read = fread(outBytes.data(), 1, outBytes.size(), file);
+    fclose(file);
+    return read == outBytes.size();
+}
+
+//decoded to the RGBA8 texels vkutil uploads, so the engine never runs stb_image on an archived texture
+static bool packImage(AssetArchiveWriter &writer, const std::string &path, bool compress) {
+    int width, height, channels;
+    stbi_uc *pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels) {
+        std::cerr << "Failed to load texture file " << path << std::endl;
+        return false;
+    }
+    writer.add(path, ARCHIVE_TEXTURE, pixels, (size_t) width * height * 4, compress, (uint32_t) width,
+               (uint32_t) height);
+    stbi_image_free(pixels);
+    return true;
+}
+
+//asset-packer --out <archive> [--compress] <files...>
+//files are keyed by their path as given, run it from the directory the engine runs in
+int main(int argc, char **argv) {
+    std::string output;
+    bool compress = false;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--out") == 0 && value) {
+            output = value;
+            i++;
+        } else if (strcmp(arg, "--compress") == 0) {
+            compress = true;
+        } else if (strncmp(arg, "--", 2) == 0) {
+            std::cerr << "Unknown argument " << arg << std::endl;
+            return 1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (output.empty() || inputs.empty()) {
+        std::cerr << "Usage: asset-packer --out <archive> [--compress] <files...>" << std::endl;
+        return 1;
+    }
+
+    AssetArchiveWriter writer;
+    std::set<std::string> packed;
+    std::vector<std::string> textures;
+    for (const std::string &input : inputs) {
+        if (!packed.insert(input).second) {
+            continue;
+        }
+        std::string type = extension(input);
+        if (type == "obj") {
+            Mesh mesh;
+            if (!mesh.loadFromObj(input.c_str())) {
+                return 1;
+            }
+            std::vector<uint8_t> blob;
+            packMesh(mesh, blob);
+            writer.add(input, ARCHIVE_MESH, blob.data(), blob.size(), compress);
+            //the textures the engine will ask for by the paths loadFromObj resolved
+            for (const MeshMaterial &material : mesh._materials) {
+                if (!material.diffuseTexture.empty()) {
+                    textures.push_back(material.diffuseTexture);
+                }
+            }
+        } else if (isImage(type)) {
+            if (!packImage(writer, input, compress)) {
+                return 1;
+            }
+        } else if (type == "spv") {
+            std::vector<uint8_t> bytes;
+            if (!readFile(input, bytes)) {
+                std::cerr << "Failed to read shader " << input << std::endl;
+                return 1;
+            }
+            writer.add(input, ARCHIVE_SHADER, bytes.data(), bytes.size(), compress);
+        } else {
+            std::cerr << "Don't know how to pack " << input << std::endl;
+            return 1;
+        }
+    }
+    for (const std::string &texture : textures) {
+        if (packed.insert(texture).second && !packImage(writer, texture, compress)) {
+            return 1;
+        }
+    }
+
+    if (!writer.write(output.c_str())) {
+        return 1;
+    }
+    std::cout << "Packed " << packed.size() << " assets into " << output << ", " << writer.assetBytes() / 1024
+              << " KiB stored as " << writer.storedBytes() / 1024 << " KiB" << std::endl;
+    return 0;
+}